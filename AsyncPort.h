@@ -0,0 +1,97 @@
+/**
+ * AsyncPort.h
+ *
+ * Asynchronous reads and writes on a port's file handle through io_uring
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_ASYNC_PORT
+#define _H_ASYNC_PORT
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Constants.h"
+#include "DataTypes.h"
+#include "IPort.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        class IoUring;
+
+        /**
+         * Result is the number of bytes transferred or a negative errno
+         */
+        using AsyncCompletion = std::function<void (int result)>;
+
+        const uint32_t sc_async_default_queue_depth = 64;
+        const int64_t sc_async_current_position = -1;
+
+        /**
+         * Several operations may be in flight at once on one handle. Completions
+         * run on the internal completion thread, or on whichever thread calls
+         * process_completions() when that thread is disabled. Any file handle
+         * works: spidev, i2c-dev, gpio, but also plain files and pipes.
+         */
+        class AsyncPort
+        {
+            public:
+                AsyncPort();
+                virtual ~AsyncPort();
+
+                bool initialize(int file_handle, uint32_t queue_depth = sc_async_default_queue_depth, bool completion_thread = true);
+                bool initialize(IPortSPtr p_port, uint32_t queue_depth = sc_async_default_queue_depth, bool completion_thread = true);
+                void shutdown();
+
+                // buffers must not be resized while registered, the kernel pins them once
+                bool register_buffers(std::vector<data::Buffer> &buffers);
+
+                bool write(const uint8_t *p_data, size_t length, AsyncCompletion completion, int64_t offset = sc_async_current_position);
+                bool read(uint8_t *p_data, size_t length, AsyncCompletion completion, int64_t offset = sc_async_current_position);
+                bool write_fixed(uint16_t buffer_index, size_t length, AsyncCompletion completion, int64_t offset = sc_async_current_position);
+                bool read_fixed(uint16_t buffer_index, size_t length, AsyncCompletion completion, int64_t offset = sc_async_current_position);
+
+                std::future<int> write(const uint8_t *p_data, size_t length, int64_t offset = sc_async_current_position);
+                std::future<int> read(uint8_t *p_data, size_t length, int64_t offset = sc_async_current_position);
+
+                size_t process_completions(bool wait);
+                size_t get_in_flight() const { return m_in_flight; }
+
+                // for an event loop to poll when there's no completion thread
+                int get_completion_handle() const;
+
+            private:
+                bool submit(uint8_t opcode, void *p_data, size_t length, uint16_t buffer_index, int64_t offset, AsyncCompletion completion);
+                std::future<int> submit(uint8_t opcode, void *p_data, size_t length, int64_t offset);
+                bool drain();
+                size_t cancel_in_flight();
+                void run();
+
+            private:
+                std::unique_ptr<IoUring>        m_ring;
+                int                             m_file_handle = constants::sc_invalid_file_handle;
+                IPortSPtr                       m_pport = nullptr;
+                std::mutex                      m_submit_mutex;
+                std::mutex                      m_slot_mutex;
+                std::mutex                      m_reap_mutex;
+                std::vector<AsyncCompletion>    m_completions;
+                std::vector<uint32_t>           m_free_slots;
+                std::vector<data::Buffer *>     m_registered_buffers;
+                std::atomic<size_t>             m_in_flight;
+                std::atomic<bool>               m_running;
+                std::thread                     m_completion_thread;
+        };
+
+        using AsyncPortSPtr = std::shared_ptr<AsyncPort>;
+    }
+}
+#endif
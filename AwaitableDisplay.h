@@ -0,0 +1,83 @@
+/**
+ * AwaitableDisplay.h
+ *
+ * Mapped framebuffer whose flush a coroutine can co_await on an EventLoop
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_AWAITABLE_DISPLAY
+#define _H_AWAITABLE_DISPLAY
+
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "EventLoop.h"
+#include "IDisplay.h"
+#include "MappedFramebuffer.h"
+#include "Task.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        class AwaitableDisplay;
+
+        using AwaitableDisplaySPtr = std::shared_ptr<AwaitableDisplay>;
+
+        /**
+         * Tasks draw into get_pixels() and co_await flush() when they want
+         * the panel to show it. The first flush() of a frame waits for the
+         * frame to be due, so everything drawn by the time it is (by any
+         * task) goes out in one MappedFramebuffer pass; the other tasks
+         * flushing in the meantime just wait for that pass. Frames are at
+         * least 1 / refresh_rate_hz apart, 0 sends on the next turn of the
+         * loop.
+         *
+         * The pass itself runs on the loop thread. Stop before the loop is
+         * shut down.
+         */
+        class AwaitableDisplay
+        {
+            public:
+                AwaitableDisplay(communication::EventLoopSPtr p_loop, IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution,
+                    uint32_t refresh_rate_hz = sc_mapped_framebuffer_refresh_rate_hz);
+                virtual ~AwaitableDisplay();
+
+                bool start();
+                void stop();
+
+                communication::Task<void> flush();
+
+                data::Color *get_pixels() const { return m_framebuffer.get_pixels(); }
+                uint16_t get_width() const { return m_framebuffer.get_width(); }
+                uint16_t get_height() const { return m_framebuffer.get_height(); }
+
+                MappedFramebufferStatistics get_statistics() { return m_framebuffer.get_statistics(); }
+
+            private:
+                /**
+                 * Parks a task until the pass already on its way is done
+                 */
+                struct PassAwaiter
+                {
+                    AwaitableDisplay *p_display;
+
+                    bool await_ready() const noexcept { return false; }
+                    void await_suspend(std::coroutine_handle<> handle) { p_display->m_waiters.push_back(handle); }
+                    void await_resume() const noexcept {}
+                };
+
+            private:
+                communication::EventLoopSPtr m_loop = nullptr;
+                MappedFramebuffer m_framebuffer;
+                uint64_t m_period_ns = 0;
+                uint64_t m_last_pass_ns = 0;
+                bool m_is_pass_pending = false;
+                std::vector<std::coroutine_handle<>> m_waiters;
+        };
+    }
+}
+#endif
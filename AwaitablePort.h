@@ -0,0 +1,127 @@
+/**
+ * AwaitablePort.h
+ *
+ * Port reads and writes, and gpio edges, that a coroutine can co_await on an EventLoop
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_AWAITABLE_PORT
+#define _H_AWAITABLE_PORT
+
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "AsyncPort.h"
+#include "DataTypes.h"
+#include "EventLoop.h"
+#include "IPort.h"
+#include "Task.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        class AwaitablePort;
+        class GPIOChip;
+
+        // edges read from the kernel in one go, the rest wait for the next wait_edge()
+        const size_t sc_awaitable_gpio_events = 16;
+
+        /**
+         * One read or write; submitted when the coroutine suspends, resumed
+         * with the number of bytes transferred or a negative errno
+         */
+        class PortAwaiter
+        {
+            public:
+                PortAwaiter(AwaitablePort *p_port, bool is_write, uint8_t *p_data, size_t length, int64_t offset)
+                    : m_p_port(p_port), m_is_write(is_write), m_p_data(p_data), m_length(length), m_offset(offset) {}
+
+                bool await_ready() const noexcept { return false; }
+                bool await_suspend(std::coroutine_handle<> handle);
+                int await_resume() const noexcept { return m_result; }
+
+            private:
+                AwaitablePort *m_p_port = nullptr;
+                bool m_is_write = false;
+                uint8_t *m_p_data = nullptr;
+                size_t m_length = 0;
+                int64_t m_offset = sc_async_current_position;
+                int m_result = 0;
+                std::coroutine_handle<> m_handle = nullptr;
+        };
+
+        /**
+         * An AsyncPort without its completion thread: the io_uring
+         * completion queue is a source on the loop, so the transfer runs in
+         * the kernel while other tasks carry on and the awaiting task is
+         * resumed on the loop thread once it's done. Several operations may
+         * be in flight, they can complete in any order. The buffer belongs
+         * to the kernel until the co_await returns.
+         *
+         * shutdown() (or destruction) before the loop's; it waits out
+         * anything still in flight.
+         */
+        class AwaitablePort
+        {
+            public:
+                explicit AwaitablePort(EventLoopSPtr p_loop);
+                virtual ~AwaitablePort();
+
+                bool initialize(int file_handle, uint32_t queue_depth = sc_async_default_queue_depth);
+                bool initialize(IPortSPtr p_port, uint32_t queue_depth = sc_async_default_queue_depth);
+                void shutdown();
+
+                PortAwaiter write(std::span<const uint8_t> data, int64_t offset = sc_async_current_position);
+                PortAwaiter read(std::span<uint8_t> data, int64_t offset = sc_async_current_position);
+
+                size_t get_in_flight() const { return m_async.get_in_flight(); }
+
+            private:
+                friend class PortAwaiter;
+
+                bool attach();
+
+            private:
+                EventLoopSPtr m_loop = nullptr;
+                AsyncPort m_async;
+                int m_completion_handle = constants::sc_invalid_file_handle;
+        };
+
+        using AwaitablePortSPtr = std::shared_ptr<AwaitablePort>;
+
+        /**
+         * Edges on a gpiochip line, read straight from the line's file
+         * handle while the loop waits on it rather than through the
+         * interrupt reactor. The kernel timestamps and queues edges that
+         * arrive between waits, so none are missed; changing the edge
+         * reconfigures the line and drops what was queued for the old one.
+         */
+        class AwaitableGPIO
+        {
+            public:
+                explicit AwaitableGPIO(EventLoopSPtr p_loop);
+                virtual ~AwaitableGPIO();
+
+                bool initialize(IPortSPtr p_port);
+                void shutdown();
+
+                // edge NONE in the result when the line can't be waited on
+                Task<data::GPIOEvent> wait_edge(data::GPIOInterruptEdge edge);
+
+            private:
+                EventLoopSPtr m_loop = nullptr;
+                std::shared_ptr<GPIOChip> m_gpio = nullptr;
+                data::GPIOInterruptEdge m_edge = data::GPIOInterruptEdge::NONE;
+                data::GPIOEvent m_events[sc_awaitable_gpio_events];
+                size_t m_event_count = 0;
+                size_t m_next_event = 0;
+        };
+
+        using AwaitableGPIOSPtr = std::shared_ptr<AwaitableGPIO>;
+    }
+}
+#endif
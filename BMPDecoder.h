@@ -0,0 +1,61 @@
+/**
+ * BMPDecoder.h
+ *
+ * Streaming decoder for Windows bitmaps
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_BMP_DECODER
+#define _H_BMP_DECODER
+
+#include <vector>
+
+#include "ImageDecoder.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const size_t sc_bmp_max_palette = 256;
+
+        /**
+         * Uncompressed 1, 4, 8, 16, 24 and 32 bit bitmaps, with or without
+         * bit field masks, top down or bottom up. RLE isn't supported. Holds
+         * one file row and the palette.
+         */
+        class BMPDecoder : public ImageDecoder
+        {
+            public:
+                BMPDecoder(uint8_t strip_rows = sc_image_strip_rows);
+                virtual ~BMPDecoder();
+
+            protected:
+                virtual bool on_read_header(std::istream &input) override;
+                virtual bool on_decode(std::istream &input) override;
+
+            private:
+                struct Channel
+                {
+                    uint32_t    mask;
+                    uint8_t     shift;
+                    uint32_t    maximum;
+                };
+
+                void set_masks(uint32_t red, uint32_t green, uint32_t blue);
+                static Channel make_channel(uint32_t mask);
+                static uint8_t get_channel(const Channel &channel, uint32_t pixel);
+                void convert_row(data::Color *p_row) const;
+
+            private:
+                uint16_t m_bits_per_pixel = 0;
+                uint32_t m_stride = 0;
+                Channel m_red = {};
+                Channel m_green = {};
+                Channel m_blue = {};
+                std::vector<data::Color> m_palette;
+                std::vector<uint8_t> m_row;
+        };
+    }
+}
+#endif
@@ -0,0 +1,95 @@
+/**
+ * BufferPool.h
+ *
+ * Transfer buffers recycled between the port and display layers so steady
+ * state traffic doesn't touch the heap
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_BUFFER_POOL
+#define _H_BUFFER_POOL
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace afm
+{
+    namespace data
+    {
+        // spidev's default bufsiz, enough for any single message
+        const size_t sc_buffer_pool_buffer_size = 4096;
+        const size_t sc_buffer_pool_count = 8;
+
+        class BufferPool;
+
+        using BufferPoolSPtr = std::shared_ptr<BufferPool>;
+
+        /**
+         * A buffer on loan from a pool, it goes back when this goes out of
+         * scope. Only moves, so there is always one owner.
+         */
+        class PooledBuffer
+        {
+            public:
+                PooledBuffer();
+                PooledBuffer(BufferPool *p_pool, std::unique_ptr<Buffer> p_buffer);
+                PooledBuffer(PooledBuffer &&other);
+                PooledBuffer(const PooledBuffer &) = delete;
+                virtual ~PooledBuffer();
+
+                PooledBuffer &operator=(PooledBuffer &&other);
+                PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+                Buffer &operator*() const { return *m_p_buffer; }
+                Buffer *operator->() const { return m_p_buffer.get(); }
+                Buffer *get() const { return m_p_buffer.get(); }
+
+                void release();
+
+            private:
+                BufferPool             *m_p_pool = nullptr;
+                std::unique_ptr<Buffer> m_p_buffer = nullptr;
+        };
+
+        /**
+         * Buffers keep their capacity while they sit in the pool, so once
+         * every size in use has been seen acquire and release only move
+         * pointers. A pool that runs dry makes another buffer and keeps it.
+         * The pool has to outlive anything acquired from it, the shared one
+         * lives for the whole process.
+         */
+        class BufferPool
+        {
+            public:
+                BufferPool(size_t buffer_size = sc_buffer_pool_buffer_size, size_t count = sc_buffer_pool_count);
+                virtual ~BufferPool();
+
+                static BufferPoolSPtr getInstance();
+
+                // sized to length, only allocates when length is past anything seen before
+                PooledBuffer acquire(size_t length);
+
+                size_t get_available();
+                size_t get_total();
+                uint64_t get_misses();
+
+            private:
+                friend class PooledBuffer;
+
+                void release(std::unique_ptr<Buffer> p_buffer);
+
+            private:
+                std::mutex                              m_mutex;
+                std::vector<std::unique_ptr<Buffer>>    m_free;
+                size_t                                  m_buffer_size;
+                size_t                                  m_total = 0;
+                uint64_t                                m_misses = 0;
+        };
+    }
+}
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Compositor.h
+ *
+ * Stacks retained surfaces and sends only what changed to a display
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_COMPOSITOR
+#define _H_COMPOSITOR
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Constants.h"
+#include "IDisplay.h"
+#include "Surface.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        /**
+         * What the last compose() sent
+         */
+        struct CompositorStatistics
+        {
+            uint32_t    windows = 0;
+            uint32_t    pixels = 0;
+        };
+
+        /**
+         * Layers are surfaces placed on the screen, later ones on top. Layers
+         * are drawn into directly and never redrawn by the compositor; compose()
+         * gathers their damage (plus anything uncovered by moving or hiding a
+         * layer), rebuilds each damaged rectangle from the layers that overlap
+         * it, starting at the topmost opaque layer that covers it, and sends it
+         * with one draw_image(). Updating one layer costs its own footprint.
+         *
+         * Not thread safe, and it assumes nothing else draws on the display;
+         * call invalidate() when something has.
+         */
+        class Compositor
+        {
+            public:
+                Compositor(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution,
+                    const data::Color &background = constants::BLACK);
+                virtual ~Compositor();
+
+                SurfaceSPtr add_layer(const data::Coordinate_8t &position, uint16_t width, uint16_t height, bool is_opaque);
+                void remove_layer(const SurfaceSPtr &p_surface);
+                void move_layer(const SurfaceSPtr &p_surface, const data::Coordinate_8t &position);
+                void set_visible(const SurfaceSPtr &p_surface, bool is_visible);
+
+                void compose();
+                void invalidate();
+
+                const CompositorStatistics &get_statistics() const { return m_statistics; }
+
+                // the composition loops for one row, source over destination
+                static void copy_row(data::Color *p_destination, const data::Color *p_source, size_t count);
+                static void blend_row(data::Color *p_destination, const data::Color *p_source, const uint8_t *p_alpha, size_t count);
+
+            private:
+                struct Layer
+                {
+                    SurfaceSPtr     p_surface;
+                    uint16_t        x;
+                    uint16_t        y;
+                    bool            is_visible;
+                };
+
+                Layer *find(const SurfaceSPtr &p_surface);
+                void damage_layer(const Layer &layer);
+                DamageRectangle get_bounds(const Layer &layer) const;
+                void compose_rectangle(const DamageRectangle &rectangle);
+
+            private:
+                IDisplaySPtr m_display = nullptr;
+                uint16_t m_width = 0;
+                uint16_t m_height = 0;
+                data::Color m_background;
+                std::vector<Layer> m_layers;
+                DamageRegion m_damage;
+                std::vector<data::Color> m_output;
+                CompositorStatistics m_statistics;
+        };
+
+        using CompositorSPtr = std::shared_ptr<Compositor>;
+    }
+}
+#endif
@@ -0,0 +1,140 @@
+/**
+ * Console.h
+ *
+ * Character cell console on top of a display, with a small ANSI subset
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_CONSOLE
+#define _H_CONSOLE
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Constants.h"
+#include "Font5x7.h"
+#include "IDisplay.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint8_t sc_console_tab_width = 8;
+        const uint8_t sc_console_max_parameters = 4;
+
+        // unchanged cells worth resending to keep two changed ones in the same text window
+        const uint8_t sc_console_gap_cells = 2;
+
+        /**
+         * One character cell, what it shows and in which colors
+         */
+        struct ConsoleCell
+        {
+            char            glyph;
+            data::Color     foreground;
+            data::Color     background;
+        };
+
+        enum ConsoleParseState
+        {
+            CONSOLE_TEXT,
+            CONSOLE_ESCAPE,
+            CONSOLE_CSI,
+            END_CONSOLE_PARSE_STATES
+        };
+
+        /**
+         * A grid of character cells sized to the display's font. write() only
+         * changes the grid, refresh() sends the cells that differ from what the
+         * display is showing, one print() per run of changed cells sharing
+         * colors on a row, so updating a counter costs its changed glyphs.
+         *
+         * Understood in the text: \n \r \b \t, ESC 7/8 (save/restore cursor),
+         * ESC D/M/E (index, reverse index, next line) and CSI
+         * A B C D E F G H d f (cursor moves), J K (erase), m (colors: 0 1 7
+         * 22 27 30-37 39 40-47 49 90-97 100-107), r (scroll region),
+         * S T (scroll) and s u. Anything else is swallowed.
+         *
+         * Not thread safe, and it assumes nothing else draws where it lives;
+         * call invalidate() when something has.
+         */
+        class Console
+        {
+            public:
+                Console(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution,
+                    const data::Color &foreground = constants::WHITE, const data::Color &background = constants::BLACK);
+                virtual ~Console();
+
+                void write(const char *p_text, size_t length);
+                void write(const char *p_text);
+                void printf(const char * __format, ...);
+
+                void refresh();
+                void invalidate();
+
+                uint8_t get_columns() const { return m_columns; }
+                uint8_t get_rows() const { return m_rows; }
+                const ConsoleCell &get_cell(uint8_t column, uint8_t row) const;
+
+                // 1 based like the display
+                data::Coordinate_8t get_cursor() const;
+
+            private:
+                void put(char glyph);
+                void execute_escape(char final);
+                void execute_csi(char final);
+                void select_graphic_rendition();
+                void update_colors();
+                void line_feed();
+                void reverse_line_feed();
+                void scroll_up(uint8_t top, uint8_t bottom, uint8_t count);
+                void scroll_down(uint8_t top, uint8_t bottom, uint8_t count);
+                void erase(uint8_t row, uint8_t first_column, uint8_t last_column);
+                void move_to(int column, int row);
+                uint16_t get_parameter(uint8_t index, uint16_t default_value) const;
+                ConsoleCell &cell(uint8_t column, uint8_t row) { return m_cells[(size_t)row * m_columns + column]; }
+                void refresh_row(uint8_t row);
+
+                static bool is_same_colors(const ConsoleCell &left, const ConsoleCell &right);
+                static bool is_same_cell(const ConsoleCell &left, const ConsoleCell &right);
+
+            private:
+                IDisplaySPtr m_display = nullptr;
+                Font5x7 m_font;
+                uint8_t m_columns = 0;
+                uint8_t m_rows = 0;
+
+                std::vector<ConsoleCell> m_cells;
+                std::vector<ConsoleCell> m_shown;           // what the display has, valid when m_is_shown_known
+                std::vector<uint8_t> m_is_row_dirty;
+                std::vector<char> m_run;                    // one row of glyphs plus terminator
+                bool m_is_shown_known = false;
+
+                uint8_t m_column = 0;
+                uint8_t m_row = 0;
+                bool m_is_wrap_pending = false;
+                uint8_t m_saved_column = 0;
+                uint8_t m_saved_row = 0;
+                uint8_t m_top = 0;                          // scroll region, inclusive
+                uint8_t m_bottom = 0;
+
+                data::Color m_default_foreground;
+                data::Color m_default_background;
+                data::Color m_foreground;
+                data::Color m_background;
+                uint8_t m_foreground_index;
+                uint8_t m_background_index;
+                bool m_is_bold = false;
+                bool m_is_inverse = false;
+
+                ConsoleParseState m_state = CONSOLE_TEXT;
+                uint16_t m_parameters[sc_console_max_parameters];
+                uint8_t m_parameter_count = 0;
+        };
+
+        using ConsoleSPtr = std::shared_ptr<Console>;
+    }
+}
+#endif
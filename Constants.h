@@ -25,6 +25,7 @@ namespace afm
 
         const uint8_t sc_gpio_high = 1;
         const uint8_t sc_gpio_low = 0;
+        const uint32_t sc_gpio_default_debounce_us = 1000;
 
         const data::Color RED(0xFF, 0x00, 0x00);
         const data::Color GREEN(0x00, 0xFF, 0x00);
@@ -34,10 +35,13 @@ namespace afm
         const data::Color GREY(0x7F, 0x7F, 0x7F);
 
         const std::string sc_gpio_port = "gpio";
+        const std::string sc_gpio_chip_port = "gpiochip";
         const std::string sc_i2c_port = "i2c";
         const std::string sc_spi_port = "spi";
+        const std::string sc_emulated_port = "emulated";
 
         const std::string sc_sesp525_display = "sesp525";
+        const std::string sc_client_display = "client";
     }
 }
 #endif
\ No newline at end of file
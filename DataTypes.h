@@ -29,6 +29,8 @@ namespace afm
             PORT_I2C,
             PORT_SPI,
             PORT_GPIO,
+            PORT_GPIO_CHIP,
+            PORT_EMULATED,
             END_PORT_TYPES
         };
 
@@ -46,6 +48,18 @@ namespace afm
             END_GPIO_INTERRUPT_EDGES
         };
 
+        /**
+         * A single edge seen on a pin, timestamp is CLOCK_MONOTONIC in nanoseconds
+         */
+        struct GPIOEvent
+        {
+            uint32_t            pin;
+            GPIOInterruptEdge   edge;
+            uint64_t            timestamp_ns;
+        };
+
+        using GPIOEventRoutine = std::function<void (const GPIOEvent &)>;
+
         template <typename T>
         struct Coordinate
         {
@@ -76,12 +90,22 @@ namespace afm
             uint8_t green;
         };
 
+        /**
+         * One point of a batched update
+         */
+        struct Pixel
+        {
+            Coordinate_8t   position;
+            Color           color;
+        };
+
         /**
          * Display Types
          */
         enum DisplayType
         {
             SESP525,
+            DISPLAY_CLIENT,
             END_DISPLAY_TYPES
         };
     }
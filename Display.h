@@ -31,6 +31,11 @@ namespace afm
                 virtual bool initialize(const nlohmann::json &configuration) final;
                 virtual void clear_screen(const data::Color &color) override;
                 virtual void set_pixel(const data::Coordinate_8t &position, const data::Color &color) override;
+                virtual void set_pixels(const data::Pixel *p_pixels, size_t count) override;
+                virtual void draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels) override;
+                virtual void set_foreground(const data::Color &color) override { m_foreground = color; }
+                virtual void set_background(const data::Color &color) override { m_background = color; }
+                virtual void set_cursor(const data::Coordinate_8t &position) override { m_cursor = position; }
                 virtual bool reset() final;
 
             protected:
@@ -39,6 +44,9 @@ namespace afm
                 const communication::IPortSPtr &get_port() const;
                 uint16_t get_x_resolution() const { return m_xres; }
                 uint16_t get_y_resolution() const { return m_yres; }
+                const data::Color &get_foreground() const { return m_foreground; }
+                const data::Color &get_background() const { return m_background; }
+                data::Coordinate_8t &get_cursor() { return m_cursor; }
 
                 communication::IPortSPtr get_port() { return m_pport; }
 
@@ -46,6 +54,9 @@ namespace afm
                 communication::IPortSPtr m_pport = nullptr;
                 uint16_t m_xres = 0;
                 uint16_t m_yres = 0;
+                data::Color m_foreground = constants::WHITE;
+                data::Color m_background = constants::BLACK;
+                data::Coordinate_8t m_cursor = data::Coordinate_8t(1, 1); // 1 based like the rest of the display
         };
     }
 }
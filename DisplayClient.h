@@ -0,0 +1,89 @@
+/**
+ * DisplayClient.h
+ *
+ * Display that draws into the display server's shared framebuffer
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_DISPLAY_CLIENT
+#define _H_DISPLAY_CLIENT
+
+#include <memory>
+#include <string>
+
+#include "Constants.h"
+#include "Font5x7.h"
+#include "IDisplay.h"
+#include "Surface.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const std::string sc_socket = "socket";
+
+        class SharedFramebuffer;
+
+        /**
+         * For processes that share the panel with others through
+         * display_server. initialize() connects to the server's socket
+         * ("socket" in the configuration, the server's default otherwise)
+         * and maps its framebuffer; every primitive then renders straight
+         * into the shared pixels and queues the rectangle it touched. No
+         * pixel crosses the socket and nothing here touches the bus, the
+         * server decides when to send.
+         *
+         * Primitives behave as on SESP525Display: fill_rectangle and the
+         * rectangle outlines use the foreground color, print uses Font5x7
+         * with the foreground and background at the cursor. reset() only
+         * has the server resend the whole screen, the panel isn't ours.
+         */
+        class DisplayClient : public IDisplay
+        {
+            public:
+                DisplayClient();
+                virtual ~DisplayClient();
+
+                virtual bool initialize(const nlohmann::json &configuration) override;
+                virtual void clear_screen(const data::Color &color) override;
+                virtual void set_pixel(const data::Coordinate_8t &position, const data::Color &color) override;
+                virtual void set_pixels(const data::Pixel *p_pixels, size_t count) override;
+                virtual void draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) override;
+                virtual void draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t thickness) override;
+                virtual void fill_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) override;
+                virtual void draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color) override;
+                virtual void draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels) override;
+                virtual void set_foreground(const data::Color &color) override { m_foreground = color; }
+                virtual void set_background(const data::Color &color) override { m_background = color; }
+                virtual void set_cursor(const data::Coordinate_8t &position) override { m_cursor = position; }
+                virtual void print(char *data) override;
+                virtual void print_line(char *data) override;
+                virtual void printf(const char * __format, ...) override;
+                virtual bool reset() override;
+
+                uint16_t get_x_resolution() const { return m_width; }
+                uint16_t get_y_resolution() const { return m_height; }
+
+            private:
+                bool connect(const std::string &socket_path);
+                bool clip(uint16_t &x1, uint16_t &y1, uint16_t &x2, uint16_t &y2) const;
+                void fill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const data::Color &color);
+                void damage(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+                void draw_text(uint16_t x, uint16_t y, const char *p_text, size_t length);
+
+            private:
+                std::shared_ptr<SharedFramebuffer> m_framebuffer = nullptr;
+                int m_socket_handle = constants::sc_invalid_file_handle;
+                int m_damage_handle = constants::sc_invalid_file_handle;
+                uint16_t m_width = 0;
+                uint16_t m_height = 0;
+                Font5x7 m_font;
+                data::Color m_foreground = constants::WHITE;
+                data::Color m_background = constants::BLACK;
+                data::Coordinate_8t m_cursor = data::Coordinate_8t(1, 1);
+                DamageRegion m_batch;                       // set_pixels gathers here before queueing
+        };
+    }
+}
+#endif
@@ -0,0 +1,181 @@
+/**
+ * EventLoop.h
+ *
+ * Single threaded epoll loop that resumes coroutines when their file handle or timer is ready
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_EVENT_LOOP
+#define _H_EVENT_LOOP
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * Called on the loop thread each time its file handle is ready, the
+         * source is responsible for draining the handle
+         */
+        using EventLoopHandler = std::function<void ()>;
+
+        class EventLoop;
+
+        using EventLoopSPtr = std::shared_ptr<EventLoop>;
+
+        /**
+         * Suspends until the file handle is readable or writable, resumes
+         * with the epoll events that fired (errors and hang ups included)
+         */
+        class ReadinessAwaiter
+        {
+            public:
+                ReadinessAwaiter(EventLoop *p_loop, int file_handle, uint32_t events)
+                    : m_p_loop(p_loop), m_file_handle(file_handle), m_events(events) {}
+
+                bool await_ready() const noexcept { return false; }
+                bool await_suspend(std::coroutine_handle<> handle);
+                uint32_t await_resume() const noexcept { return m_result; }
+
+            private:
+                friend class EventLoop;
+
+                EventLoop *m_p_loop = nullptr;
+                int m_file_handle = constants::sc_invalid_file_handle;
+                uint32_t m_events = 0;
+                uint32_t m_result = 0;
+                std::coroutine_handle<> m_handle = nullptr;
+        };
+
+        /**
+         * Suspends until the monotonic clock reaches the deadline, or just
+         * for one turn of the loop when the deadline has already passed
+         */
+        class TimerAwaiter
+        {
+            public:
+                TimerAwaiter(EventLoop *p_loop, uint64_t deadline_ns)
+                    : m_p_loop(p_loop), m_deadline_ns(deadline_ns) {}
+
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> handle);
+                void await_resume() const noexcept {}
+
+            private:
+                EventLoop *m_p_loop = nullptr;
+                uint64_t m_deadline_ns = 0;
+        };
+
+        /**
+         * Every task runs on the thread calling run(), one at a time, and
+         * only gives the thread up at a co_await; what runs next is decided
+         * by the order things became ready in, so the same inputs give the
+         * same interleaving. Nothing here is thread safe except stop().
+         *
+         * Waiting on a file handle costs one epoll_ctl per wait and nothing
+         * while idle; one coroutine may wait for reading and another for
+         * writing the same handle, but not two for the same direction.
+         * Sources (add_source()) stay registered and are for things like the
+         * io_uring completion queue, their handler runs every time they are
+         * ready. Timers share one timerfd armed for the earliest deadline.
+         *
+         * Shut down anything that may still resume a task (ports, displays)
+         * before the loop; shutdown() destroys every task not yet finished.
+         */
+        class EventLoop
+        {
+            public:
+                EventLoop();
+                virtual ~EventLoop();
+
+                bool initialize();
+                void shutdown();
+
+                void spawn(Task<void> task);
+                void run();
+                void stop();
+
+                ReadinessAwaiter readable(int file_handle);
+                ReadinessAwaiter writable(int file_handle);
+                TimerAwaiter sleep_for(uint64_t duration_us);
+                TimerAwaiter sleep_until(uint64_t deadline_ns);
+                TimerAwaiter yield();
+
+                // resumed on the next turn of the loop, from the loop thread only
+                void schedule(std::coroutine_handle<> handle);
+
+                bool add_source(int file_handle, uint32_t events, EventLoopHandler handler);
+                void remove_source(int file_handle);
+
+                // call before closing a handle that has been waited on
+                void forget(int file_handle);
+
+                size_t get_task_count() const { return m_tasks.size(); }
+
+                static uint64_t get_timestamp();
+
+            private:
+                struct Watch
+                {
+                    ReadinessAwaiter    *p_reader = nullptr;
+                    ReadinessAwaiter    *p_writer = nullptr;
+                    bool                is_registered = false;
+                };
+
+                struct Timer
+                {
+                    uint64_t                deadline_ns;
+                    uint64_t                sequence;       // equal deadlines resume in the order they were set
+                    std::coroutine_handle<> handle;
+
+                    bool operator>(const Timer &other) const
+                    {
+                        return (deadline_ns > other.deadline_ns) ||
+                            ((deadline_ns == other.deadline_ns) && (sequence > other.sequence));
+                    }
+                };
+
+                friend class ReadinessAwaiter;
+                friend class TimerAwaiter;
+
+                static Task<void> run_task(EventLoop *p_loop, Task<void> task);
+
+                bool watch(ReadinessAwaiter *p_awaiter);
+                bool arm(int file_handle, Watch &watch);
+                void dispatch(int file_handle, uint32_t events);
+                void add_timer(uint64_t deadline_ns, std::coroutine_handle<> handle);
+                void expire_timers();
+                void arm_timer();
+                void reap_tasks();
+
+            private:
+                int m_epoll_handle = constants::sc_invalid_file_handle;
+                int m_wakeup_handle = constants::sc_invalid_file_handle;
+                int m_timer_handle = constants::sc_invalid_file_handle;
+                std::atomic<bool> m_running;
+
+                std::vector<Task<void>> m_tasks;                         // spawned and not yet reaped
+                size_t m_finished_tasks = 0;
+                std::deque<std::coroutine_handle<>> m_ready;
+                std::map<int, Watch> m_watches;
+                std::map<int, EventLoopHandler> m_sources;
+                std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+                uint64_t m_timer_sequence = 0;
+                uint64_t m_armed_deadline_ns = 0;                       // what the timerfd is set to, 0 when disarmed
+        };
+    }
+}
+#endif
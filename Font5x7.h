@@ -0,0 +1,30 @@
+/**
+ * Font5x7.h
+ *
+ * Fixed 5x7 ASCII font in a 6x8 cell
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_FONT_5X7
+#define _H_FONT_5X7
+
+#include "IFont.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        class Font5x7 : public IFont
+        {
+            public:
+                Font5x7();
+                virtual ~Font5x7();
+
+                virtual uint8_t get_width() const override;
+                virtual uint8_t get_height() const override;
+                virtual uint8_t get_column(char character, uint8_t column) const override;
+        };
+    }
+}
+#endif
@@ -27,10 +27,15 @@ namespace afm
                 virtual bool initialize(const nlohmann::json &configuration) = 0;
                 virtual void clear_screen(const data::Color &color) = 0;
                 virtual void set_pixel(const data::Coordinate_8t &position, const data::Color &color) = 0;
+                virtual void set_pixels(const data::Pixel *p_pixels, size_t count) = 0;
                 virtual void draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) = 0;
                 virtual void draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t thickness) = 0;
                 virtual void fill_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) = 0;
                 virtual void draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color) = 0;
+                virtual void draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels) = 0;
+                virtual void set_foreground(const data::Color &color) = 0;
+                virtual void set_background(const data::Color &color) = 0;
+                virtual void set_cursor(const data::Coordinate_8t &position) = 0;
                 virtual void print(char *data) = 0;
                 virtual void print_line(char *data) = 0;
                 virtual void printf(const char * __format, ...) = 0;
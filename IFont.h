@@ -22,6 +22,13 @@ namespace afm
         {
             public:
                 virtual ~IFont() {}
+
+                // size of a character cell including spacing
+                virtual uint8_t get_width() const = 0;
+                virtual uint8_t get_height() const = 0;
+
+                // one column of a character, bit 0 is the top row
+                virtual uint8_t get_column(char character, uint8_t column) const = 0;
         };
 
         using IFontSPtr = std::shared_ptr<IFont>;
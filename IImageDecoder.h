@@ -0,0 +1,37 @@
+/**
+ * IImageDecoder.h
+ *
+ * Interface definition for image decoders
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_IIMAGE_DECODER
+#define _H_IIMAGE_DECODER
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+
+#include "IDisplay.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        class IImageDecoder
+        {
+            public:
+                virtual ~IImageDecoder() {}
+
+                // decodes from the current position of input, top left corner of the image at position
+                virtual bool draw(std::istream &input, IDisplaySPtr p_display, const data::Coordinate_8t &position) = 0;
+                virtual void set_background(const data::Color &color) = 0;
+                virtual uint32_t get_width() const = 0;
+                virtual uint32_t get_height() const = 0;
+        };
+
+        using IImageDecoderSPtr = std::shared_ptr<IImageDecoder>;
+    }
+}
+#endif
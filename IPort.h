@@ -27,11 +27,22 @@ namespace afm
 
                 virtual bool read(uint8_t &value) = 0;
                 virtual bool write(uint8_t value) = 0;
+                // reads buffer.size() bytes, or everything available into an empty buffer; sized to what arrived
                 virtual uint16_t read(data::Buffer &buffer) = 0;
                 virtual uint16_t write(const data::Buffer &buffer) = 0;
                 virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) = 0;
 
                 virtual bool is_port(uint32_t instance, uint32_t device) = 0;
+
+                /**
+                 * Ports are shared between everything configured on them. Hold
+                 * the port (std::lock_guard<IPort>) across any multi-step
+                 * transaction, e.g. index then data, so other threads can't
+                 * interleave bytes. Recursive, nested holds are fine.
+                 */
+                virtual void lock() = 0;
+                virtual void unlock() = 0;
+                virtual bool try_lock() = 0;
         };
 
         using IPortSPtr = std::shared_ptr<IPort>;
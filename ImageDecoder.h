@@ -0,0 +1,84 @@
+/**
+ * ImageDecoder.h
+ *
+ * Base for decoders that stream an image to a display a strip at a time
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_IMAGE_DECODER
+#define _H_IMAGE_DECODER
+
+#include <vector>
+
+#include "Constants.h"
+#include "IImageDecoder.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint8_t sc_image_strip_rows = 8;
+
+        // bounds the row buffers a header can ask for
+        const uint32_t sc_image_max_width = 16384;
+        const uint32_t sc_image_max_height = 16384;
+
+        /**
+         * Decoders hand over one row at a time in file order, top down or
+         * bottom up. Rows are converted straight into a strip of a few rows,
+         * and each full strip goes to the display as one draw_image() window,
+         * so memory and time to first pixel depend on the width and the
+         * strip height, never on the image height. Whatever falls beyond the
+         * 8 bit display coordinates is decoded and dropped.
+         */
+        class ImageDecoder : public IImageDecoder
+        {
+            public:
+                ImageDecoder(uint8_t strip_rows = sc_image_strip_rows);
+                virtual ~ImageDecoder();
+
+                virtual bool draw(std::istream &input, IDisplaySPtr p_display, const data::Coordinate_8t &position) final;
+                virtual void set_background(const data::Color &color) override { m_background = color; }
+                virtual uint32_t get_width() const override { return m_width; }
+                virtual uint32_t get_height() const override { return m_height; }
+
+                // picks a decoder from the first byte of input, nullptr when none fits
+                static IImageDecoderSPtr create(std::istream &input);
+
+            protected:
+                virtual bool on_read_header(std::istream &input) = 0;
+                virtual bool on_decode(std::istream &input) = 0;
+
+                bool set_size(uint32_t width, uint32_t height, bool is_bottom_up);
+                // where the next row's visible pixels go, nullptr when the whole row is off screen
+                data::Color *begin_row();
+                void end_row();
+                uint32_t get_visible_width() const { return m_visible_width; }
+                const data::Color &get_background() const { return m_background; }
+
+                static bool read_bytes(std::istream &input, uint8_t *p_data, size_t length);
+                static bool skip_bytes(std::istream &input, size_t length);
+                static uint16_t get_le16(const uint8_t *p_data) { return (uint16_t)(p_data[0] | (p_data[1] << 8)); }
+                static uint32_t get_le32(const uint8_t *p_data);
+                static uint32_t get_be32(const uint8_t *p_data);
+
+            private:
+                void flush_strip(uint32_t first_row, uint32_t rows);
+
+            private:
+                uint8_t m_strip_rows = sc_image_strip_rows;
+                uint32_t m_width = 0;
+                uint32_t m_height = 0;
+                bool m_is_bottom_up = false;
+                uint32_t m_visible_width = 0;
+                uint32_t m_visible_height = 0;
+                uint32_t m_rows_done = 0;
+                data::Color m_background = constants::BLACK;
+                IDisplaySPtr m_display = nullptr;
+                data::Coordinate_8t m_position = data::Coordinate_8t(1, 1);
+                std::vector<data::Color> m_strip;
+        };
+    }
+}
+#endif
@@ -0,0 +1,123 @@
+/**
+ * MappedFramebuffer.h
+ *
+ * Plain pixel array over a display, changes are found by write protecting its pages
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_MAPPED_FRAMEBUFFER
+#define _H_MAPPED_FRAMEBUFFER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <thread>
+#include <vector>
+
+#include "Constants.h"
+#include "IDisplay.h"
+#include "Surface.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint32_t sc_mapped_framebuffer_refresh_rate_hz = 30;
+
+        // framebuffers that can be tracked at once, the fault handler is shared
+        const size_t sc_max_mapped_framebuffers = 4;
+
+        /**
+         * What the flusher has done since start()
+         */
+        struct MappedFramebufferStatistics
+        {
+            uint64_t    faults = 0;         // first writes to a clean page
+            uint64_t    passes = 0;
+            uint64_t    pages = 0;          // dirty pages looked at
+            uint64_t    rows = 0;           // rows that really changed
+            uint64_t    windows = 0;
+            uint64_t    pixels = 0;
+        };
+
+        class MappedFramebuffer;
+
+        using MappedFramebufferSPtr = std::shared_ptr<MappedFramebuffer>;
+
+        /**
+         * For renderers that only know how to write into a linear pixel
+         * array, like fbdev: get_pixels() is x_resolution * y_resolution
+         * data::Color, row by row, and nothing has to be called after
+         * drawing into it.
+         *
+         * The array is mapped read only. The first write to a page faults,
+         * the SIGSEGV handler marks the page dirty and opens it, and the
+         * write goes through; every other write to that page is free. Each
+         * pass of the flusher write protects the dirty pages again, diffs
+         * the rows they hold against the copy last sent, and sends the
+         * changed span of each changed row, merged into a few windows, so
+         * the bus only sees pixels that are really different.
+         *
+         * A SIGSEGV handler is installed while any framebuffer is running;
+         * faults outside our pages go on to the handler that was there
+         * before. The kernel doesn't fault on our behalf, so read() and
+         * friends must not write into the array directly. A refresh rate of
+         * 0 starts no flusher, flush() then does a pass on demand.
+         */
+        class MappedFramebuffer
+        {
+            public:
+                MappedFramebuffer(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution);
+                virtual ~MappedFramebuffer();
+
+                bool start(uint32_t refresh_rate_hz = sc_mapped_framebuffer_refresh_rate_hz);
+                void stop();
+                bool is_running() const { return m_p_pixels != nullptr; }
+
+                void flush();
+
+                data::Color *get_pixels() const { return m_p_pixels; }
+                uint16_t get_width() const { return m_width; }
+                uint16_t get_height() const { return m_height; }
+
+                MappedFramebufferStatistics get_statistics();
+
+            private:
+                void run();
+                void present();
+                void diff_row(uint16_t row);
+                bool mark_dirty(void *p_address);
+
+                static void on_fault(int signal_number, siginfo_t *p_information, void *p_context);
+                static bool install(MappedFramebuffer *p_framebuffer);
+                static void uninstall(MappedFramebuffer *p_framebuffer);
+
+            private:
+                IDisplaySPtr m_display = nullptr;
+                uint16_t m_width = 0;
+                uint16_t m_height = 0;
+
+                data::Color *m_p_pixels = nullptr;
+                size_t m_page_size = 0;
+                size_t m_mapped_size = 0;
+                size_t m_dirty_words = 0;
+                std::unique_ptr<std::atomic<uint64_t>[]> m_dirty_pages;      // one bit per page, set by the fault handler
+                std::atomic<uint64_t> m_faults;
+
+                std::mutex m_mutex;                                         // one pass at a time
+                std::vector<data::Color> m_shown;                           // what the display has
+                std::vector<uint8_t> m_is_row_dirty;
+                std::vector<data::Color> m_staging;
+                DamageRegion m_damage;
+                MappedFramebufferStatistics m_statistics;
+
+                std::atomic<bool> m_running;
+                uint64_t m_period_ns = 0;
+                std::thread m_flusher_thread;
+        };
+    }
+}
+#endif
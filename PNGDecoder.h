@@ -0,0 +1,77 @@
+/**
+ * PNGDecoder.h
+ *
+ * Streaming decoder for PNG images, built when zlib is available
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_PNG_DECODER
+#define _H_PNG_DECODER
+
+#include <memory>
+#include <vector>
+
+#include "ImageDecoder.h"
+
+struct z_stream_s;
+
+namespace afm
+{
+    namespace graphic
+    {
+        // compressed bytes handed to inflate per read
+        const size_t sc_png_input_size = 1024;
+        const size_t sc_png_max_palette = 256;
+
+        /**
+         * Every color type and bit depth of non interlaced PNG. IDAT is
+         * inflated straight into the current row, which is unfiltered against
+         * the previous one, so two file rows are all it holds. 16 bit samples
+         * keep their high byte and alpha is blended over the background.
+         * Adam7 interlacing needs the whole image and isn't supported.
+         */
+        class PNGDecoder : public ImageDecoder
+        {
+            public:
+                PNGDecoder(uint8_t strip_rows = sc_image_strip_rows);
+                virtual ~PNGDecoder();
+
+            protected:
+                virtual bool on_read_header(std::istream &input) override;
+                virtual bool on_decode(std::istream &input) override;
+
+            private:
+                bool read_chunk_header(std::istream &input, uint32_t &length, uint32_t &type);
+                bool read_chunk_data(std::istream &input, uint8_t *p_data, size_t length);
+                bool finish_chunk(std::istream &input);
+                bool read_palette(std::istream &input, uint32_t length);
+                bool read_transparency(std::istream &input, uint32_t length);
+                bool inflate_chunk(std::istream &input, uint32_t length);
+                bool complete_row();
+                void convert_row(data::Color *p_row) const;
+                uint16_t get_sample(const uint8_t *p_data, uint32_t index) const;
+                data::Color blend(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) const;
+
+            private:
+                std::unique_ptr<z_stream_s> m_p_stream;
+                bool m_is_stream_ready = false;
+                uint32_t m_crc = 0;
+                uint8_t m_bit_depth = 0;
+                uint8_t m_color_type = 0;
+                uint8_t m_channels = 0;
+                uint32_t m_pixel_bytes = 0;             // for filtering, at least 1
+                uint32_t m_stride = 0;                  // filter byte not included
+                uint32_t m_rows_inflated = 0;
+                size_t m_row_fill = 0;
+                bool m_has_key = false;
+                uint16_t m_key[3] = {0};
+                std::vector<data::Color> m_palette;
+                std::vector<uint8_t> m_palette_alpha;
+                std::vector<uint8_t> m_input;
+                std::vector<uint8_t> m_row;             // filter byte then the row
+                std::vector<uint8_t> m_previous;
+        };
+    }
+}
+#endif
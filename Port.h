@@ -11,9 +11,12 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 
+#include "Constants.h"
 #include "DataTypes.h"
 #include "IPort.h"
+#include "PortStatistics.h"
 
 namespace afm
 {
@@ -33,17 +36,27 @@ namespace afm
                 virtual uint16_t write(const data::Buffer &buffer) override;
                 virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
                 virtual bool is_port(uint32_t instance, uint32_t device) final;
+                virtual void lock() final { m_transaction_mutex.lock(); }
+                virtual void unlock() final { m_transaction_mutex.unlock(); }
+                virtual bool try_lock() final { return m_transaction_mutex.try_lock(); }
+
+                uint32_t get_instance() const { return m_instance; }
+                uint32_t get_device() const { return m_device; }
+
+                // handle ready for plain read/write, for callers driving the port asynchronously
+                virtual int get_file_handle() { return constants::sc_invalid_file_handle; }
+
+                const PortStatisticsSPtr &get_statistics() const { return m_statistics; }
 
             protected:
                 virtual bool setup_device() = 0;
                 virtual void shutdown_device() { }
 
-                uint32_t get_instance() { return m_instance; }
-                uint32_t get_device() { return m_device; }
-
             private:
                 uint32_t    m_instance = 0;
                 uint32_t    m_device = 0;
+                PortStatisticsSPtr  m_statistics;
+                std::recursive_mutex    m_transaction_mutex;
         };
     }
 }
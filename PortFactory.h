@@ -11,6 +11,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 
 #include "DataTypes.h"
 #include "IPort.h"
@@ -20,11 +21,16 @@ namespace afm
     namespace communication
     {
         using PortMap = std::multimap<data::PortType, IPortSPtr>;
+        using PortMapSPtr = std::shared_ptr<const PortMap>;
 
         class PortFactory;
 
         using PortFactorySPtr = std::shared_ptr<PortFactory>;
 
+        /**
+         * Lookups read an immutable snapshot of the registry without taking a
+         * lock, creating a port copies the registry and swaps it in
+         */
         class PortFactory
         {
             public:
@@ -37,7 +43,12 @@ namespace afm
                 IPortSPtr createPort(std::string port_type, uint32_t instance, uint32_t device);
 
             private:
-                PortMap m_ports;
+                IPortSPtr findPort(const PortMapSPtr &p_ports, data::PortType port_type, uint32_t instance, uint32_t device);
+                IPortSPtr makePort(data::PortType port_type, uint32_t device);
+
+            private:
+                PortMapSPtr m_ports;
+                std::mutex  m_create_mutex;
         };
     }
 }
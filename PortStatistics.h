@@ -0,0 +1,178 @@
+/**
+ * PortStatistics.h
+ *
+ * Per port operation counters, byte totals and latency histograms
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_PORT_STATISTICS
+#define _H_PORT_STATISTICS
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace afm
+{
+    namespace communication
+    {
+        enum PortOperation
+        {
+            PORT_OPERATION_READ,
+            PORT_OPERATION_WRITE,
+            PORT_OPERATION_TRANSFER,
+            PORT_OPERATION_CONTROL,     // configuration ioctls, address selects, direction changes
+            END_PORT_OPERATIONS
+        };
+
+        // bucket n holds latencies below 2^n ns, the last one everything slower (~1s)
+        const size_t sc_port_latency_buckets = 32;
+
+        /**
+         * Plain copy of one operation kind's counters
+         */
+        struct PortOperationSnapshot
+        {
+            uint64_t    count = 0;
+            uint64_t    errors = 0;
+            uint64_t    bytes_in = 0;
+            uint64_t    bytes_out = 0;
+            uint64_t    syscalls = 0;
+            uint64_t    total_ns = 0;
+            uint64_t    max_ns = 0;
+            uint64_t    latency_buckets[sc_port_latency_buckets] = {0};
+        };
+
+        struct PortStatisticsSnapshot
+        {
+            std::string             port_type;
+            uint32_t                instance = 0;
+            uint32_t                device = 0;
+            PortOperationSnapshot   operations[END_PORT_OPERATIONS];
+        };
+
+        /**
+         * Lives in every Port. Recording is a handful of relaxed atomic adds,
+         * and nothing at all (not even the clock reads) while collection is
+         * disabled, which is the default.
+         */
+        class PortStatistics
+        {
+            public:
+                PortStatistics();
+
+                static void set_enabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+                static bool is_enabled() { return s_enabled.load(std::memory_order_relaxed); }
+                static uint64_t get_timestamp();
+
+                void record(PortOperation operation, uint64_t bytes_in, uint64_t bytes_out, uint32_t syscalls, uint64_t latency_ns, bool failed);
+                PortOperationSnapshot get_snapshot(PortOperation operation) const;
+                void clear();
+
+            private:
+                struct Counters
+                {
+                    std::atomic<uint64_t>   count{0};
+                    std::atomic<uint64_t>   errors{0};
+                    std::atomic<uint64_t>   bytes_in{0};
+                    std::atomic<uint64_t>   bytes_out{0};
+                    std::atomic<uint64_t>   syscalls{0};
+                    std::atomic<uint64_t>   total_ns{0};
+                    std::atomic<uint64_t>   max_ns{0};
+                    std::atomic<uint64_t>   latency_buckets[sc_port_latency_buckets];
+                };
+
+                static std::atomic<bool>    s_enabled;
+
+                Counters                    m_counters[END_PORT_OPERATIONS];
+        };
+
+        using PortStatisticsSPtr = std::shared_ptr<PortStatistics>;
+
+        /**
+         * Times one port operation and records it when it goes out of scope.
+         * A no-op when collection is disabled.
+         */
+        class PortStatisticsScope
+        {
+            public:
+                PortStatisticsScope(const PortStatisticsSPtr &p_statistics, PortOperation operation)
+                    : m_p_statistics(PortStatistics::is_enabled() == true ? p_statistics.get() : nullptr)
+                    , m_operation(operation)
+                {
+                    if (m_p_statistics != nullptr)
+                    {
+                        m_start_ns = PortStatistics::get_timestamp();
+                    }
+                }
+
+                ~PortStatisticsScope()
+                {
+                    if (m_p_statistics != nullptr)
+                    {
+                        m_p_statistics->record(m_operation, m_bytes_in, m_bytes_out, m_syscalls,
+                            PortStatistics::get_timestamp() - m_start_ns, m_failed);
+                    }
+                }
+
+                void add_syscall(uint32_t count = 1) { m_syscalls += count; }
+                void add_bytes_in(uint64_t bytes) { m_bytes_in += bytes; }
+                void add_bytes_out(uint64_t bytes) { m_bytes_out += bytes; }
+                void set_failed(bool failed) { m_failed = failed; }
+
+            private:
+                PortStatistics     *m_p_statistics = nullptr;
+                PortOperation       m_operation;
+                uint64_t            m_start_ns = 0;
+                uint64_t            m_bytes_in = 0;
+                uint64_t            m_bytes_out = 0;
+                uint32_t            m_syscalls = 0;
+                bool                m_failed = false;
+        };
+
+        class PortMonitor;
+
+        using PortMonitorSPtr = std::shared_ptr<PortMonitor>;
+
+        /**
+         * Knows every port the factory created and turns their statistics into
+         * snapshots, JSON or Prometheus text exposition
+         */
+        class PortMonitor
+        {
+            public:
+                PortMonitor();
+                virtual ~PortMonitor();
+
+                static PortMonitorSPtr getInstance();
+
+                void add_port(const std::string &port_type, uint32_t instance, uint32_t device, PortStatisticsSPtr p_statistics);
+                void clear();
+
+                std::vector<PortStatisticsSnapshot> get_snapshots();
+                nlohmann::json to_json();
+                std::string to_prometheus();
+
+                bool dump_json(const std::string &file_name);
+                bool dump_prometheus(const std::string &file_name);
+
+            private:
+                struct MonitoredPort
+                {
+                    std::string                     port_type;
+                    uint32_t                        instance;
+                    uint32_t                        device;
+                    std::weak_ptr<PortStatistics>   p_statistics;
+                };
+
+                std::mutex                  m_mutex;
+                std::vector<MonitoredPort>  m_ports;
+        };
+    }
+}
+#endif
@@ -0,0 +1,75 @@
+/**
+ * RegisterMap.h
+ *
+ * Cached view of an 8 bit register file behind a port
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_REGISTER_MAP
+#define _H_REGISTER_MAP
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+
+#include "DataTypes.h"
+#include "IPort.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const size_t sc_register_count = 256;
+
+        class I2C;
+        class I2CTransaction;
+
+        /**
+         * Registers are assumed to hold their value (configuration) unless
+         * marked volatile (status, counters, fifos). Non volatile reads are
+         * answered from the cache once known and writes of the value already
+         * held are dropped. With write back enabled writes only mark the
+         * register dirty, sync() then sends contiguous dirty registers as
+         * auto increment bursts.
+         */
+        class RegisterMap
+        {
+            public:
+                RegisterMap(IPortSPtr p_port, bool auto_increment = true);
+                virtual ~RegisterMap();
+
+                void set_volatile(uint8_t target_register, bool is_volatile);
+                void set_default(uint8_t target_register, uint8_t value);
+                void set_write_back(bool enable) { m_write_back = enable; }
+
+                bool read(uint8_t target_register, uint8_t &value);
+                bool write(uint8_t target_register, uint8_t value);
+                bool update_bits(uint8_t target_register, uint8_t mask, uint8_t value);
+
+                bool sync();
+                void invalidate();
+
+                size_t get_dirty_count() const { return m_dirty.count(); }
+
+            private:
+                bool read_register(uint8_t target_register, uint8_t &value);
+                bool write_registers(uint8_t first_register, size_t count);
+                bool submit(const std::shared_ptr<I2C> &p_i2c, I2CTransaction &transaction, std::bitset<sc_register_count> &queued);
+
+            private:
+                IPortSPtr                       m_pport = nullptr;
+                bool                            m_auto_increment = true;
+                bool                            m_write_back = false;
+                uint8_t                         m_values[sc_register_count] = {0};
+                std::bitset<sc_register_count>  m_valid;
+                std::bitset<sc_register_count>  m_dirty;
+                std::bitset<sc_register_count>  m_volatile;
+                data::Buffer                    m_output_buffer;
+                data::Buffer                    m_input_buffer;
+        };
+
+        using RegisterMapSPtr = std::shared_ptr<RegisterMap>;
+    }
+}
+#endif
@@ -0,0 +1,784 @@
+/**
+ * SESP525Driver.h
+ *
+ * SESP525 register protocol and rasterization with the bus and control pin
+ * types fixed at compile time
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_SESP525_DRIVER
+#define _H_SESP525_DRIVER
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sys/param.h>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Constants.h"
+#include "DataTypes.h"
+#include "IFont.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        enum SESP525_Command
+        {
+            SESP525_INDEX,
+            SESP525_STATUS_READ,
+            SESP525_OSC_CTL,
+            SESP525_CLOCK_DIV,
+            SESP525_REDUCE_CURRENT,
+            SESP525_SOFT_RESET,
+            SESP525_DISP_ON_OFF,
+            SESP525_PRECHARGE_TIME_R = 0x08,
+            SESP525_PRECHARGE_TIME_G,
+            SESP525_PRECHARGE_TIME_B,
+            SESP525_PRECHARGE_CURRENT_R,
+            SESP525_PRECHARGE_CURRENT_G,
+            SESP525_PRECHARGE_CURRENT_B,
+            SESP525_DRIVING_CURRENT_R = 0x10,
+            SESP525_DRIVING_CURRENT_G,
+            SESP525_DRIVING_CURRENT_B,
+            SESP525_DISPLAY_MODE,
+            SESP525_RGB_INTERFACE,
+            SESP525_RGB_POLARITY,
+            SESP525_MEMORY_WRITE_MODE,
+            SESP525_MX1_ADDRESS,
+            SESP525_MX2_ADDRESS,
+            SESP525_MY1_ADDRESS,
+            SESP525_MY2_ADDRESS,
+            SESP525_MEMORY_ACCESS_POINTER_X = 0x20,
+            SESP525_MEMORY_ACCESS_POINTER_Y,
+            SESP525_DDRAM_DATA_ACCESS_PORT,
+            SESP525_DISPLAY_DUTY_RATIO = 0x28,
+            SESP525_DISPLAY_START_LINE,
+            SESP525_D1_DDRAM_FAC_HORIZONTAL = 0x2E,
+            SESP525_D1_DDRAM_FAR_VERTICAL,
+            SESP525_D2_DDRAM_SAC_HORIZONTAL = 0x31,
+            SESP525_D2_DDRAM_SAR_VERTICAL,
+            SESP525_SCREEN1_FX1,
+            SESP525_SCREEN1_FX2,
+            SESP525_SCREEN1_FY1,
+            SESP525_SCREEN1_FY2,
+            SESP525_SCREEN2_SX1,
+            SESP525_SCREEN2_SX2,
+            SESP525_SCREEN2_SY1,
+            SESP525_SCREEN2_SY2,
+            SESP525_SCREEN_SAVER_CONTROL,
+            SESP525_SCREEN_SAVER_SLEEP_TIMER,
+            SESP525_SCREEN_SAVER_MODE,
+            SESP525_SCREEN_SAVER_SCREEN1_FU,
+            SESP525_SCREEN_SAVER_SCREEN1_MXY,
+            SESP525_SCREEN_SAVER_SCREEN2_FU,
+            SESP525_SCREEN_SAVER_SCREEN2_MXY,
+            SESP525_MOVING_DIRECTION,
+            SESP525_SCREEN_SAVER_SCREEN2_SX1 = 0x47,
+            SESP525_SCREEN_SAVER_SCREEN2_SX2,
+            SESP525_SCREEN_SAVER_SCREEN2_SY1,
+            SESP525_SCREEN_SAVER_SCREEN2_SY2,
+            SESP525_GRAY_SCALE_TABLE_INDEX = 0x50,
+            SESP525_GRAY_SCALE_TABLE_DATA,
+            SESP525_IREF = 0x80,
+            END_SESP525_Commands
+        };
+
+        const uint8_t sc_sesp525_6_bits = 0x3F; // mask for 6 bit color
+        const uint8_t sc_sesp525_bytes_per_pixel = 3;
+        // whole pixels and under spidev's default bufsiz
+        const size_t sc_sesp525_buffer_size = 4095;
+        const size_t sc_sesp525_registers = 256;
+        // triple transfer, horizontal then vertical increment, horizontal write
+        const uint8_t sc_sesp525_write_mode_mask = 0x17;
+        const uint8_t sc_sesp525_write_mode_modelled = 0x16;
+        // rough bus bytes a port call is worth, for weighing commands against pixel data
+        const uint32_t sc_sesp525_call_cost = 16;
+        const uint32_t sc_sesp525_register_cost = 4 * sc_sesp525_call_cost;    // RS low, index, RS high, value
+        const uint32_t sc_sesp525_restart_cost = 4 * sc_sesp525_call_cost;     // reselecting data and splitting its write
+        // longest gap resent instead of moving, past that the guess above is too far off to bet bytes on
+        const uint32_t sc_sesp525_gap_fill_limit = 8;
+        const uint16_t sc_sesp525_data_bit = 0x100;     // the 9th bit of a 3-wire word, set for data
+        const uint8_t sc_sesp525_3_wire_bits_per_word = 9;
+
+        /**
+         * 4-wire has a separate RS line, 3-wire sends it as the first bit of
+         * each 9 bit word, which spidev takes in 16 bit host order containers
+         */
+        enum SESP525Interface
+        {
+            SESP525_INTERFACE_4_WIRE,
+            SESP525_INTERFACE_3_WIRE,
+            END_SESP525_INTERFACES
+        };
+
+        /**
+         * What the runtime display needs from a driver, one virtual call per
+         * primitive rather than per byte. Coordinates are 1 based and the
+         * caller holds the bus.
+         */
+        class ISESP525Driver
+        {
+            public:
+                virtual ~ISESP525Driver() {}
+
+                virtual void write_register(uint8_t target_register, uint8_t value) = 0;
+                virtual void select_window(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) = 0;
+                virtual void set_position(uint8_t x, uint8_t y) = 0;
+                virtual void fill_screen(const data::Color &color) = 0;
+                virtual void fill(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, const data::Color &color) = 0;
+                virtual void set_pixel(uint8_t x, uint8_t y, const data::Color &color) = 0;
+                virtual void draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color) = 0;
+                virtual void draw_image(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const data::Color *p_pixels) = 0;
+                virtual void set_pixels(const data::Pixel *p_pixels, size_t count) = 0;
+                virtual void draw_text(uint8_t x, uint8_t y, const char *p_text, size_t length, const IFont &font,
+                    const data::Color &foreground, const data::Color &background) = 0;
+                virtual void flush() = 0;
+                // forget what the controller is believed to hold, e.g. after a hardware reset
+                virtual void invalidate() = 0;
+        };
+
+        using ISESP525DriverSPtr = std::shared_ptr<ISESP525Driver>;
+
+        /**
+         * Bus and ControlPin are the concrete port classes. They are final, so
+         * calls through them bind statically; with IPort for either the driver
+         * still works, just through the vtable. Pixel data is encoded straight
+         * into a pooled buffer and goes out in one bus write when it fills up or
+         * RS has to drop for the next command.
+         *
+         * The driver also shadows the controller: register values (window and
+         * write mode included), the selected index, the RS level, and the
+         * memory pointer as it auto increments and wraps inside the window.
+         * Anything already in effect isn't sent again, so a run of adjacent
+         * pixels is just pixel data. What has been written to DDRAM is
+         * mirrored too, so batched points can stream across short gaps by
+         * resending what is already there instead of moving the pointer.
+         *
+         * On 3-wire there is no RS line and ControlPin goes unused; commands
+         * queue in the same buffer as data, so a whole command and data
+         * sequence is one transfer.
+         */
+        template <class Bus, class ControlPin, SESP525Interface bus_interface = SESP525_INTERFACE_4_WIRE>
+        class SESP525Driver final : public ISESP525Driver
+        {
+            private:
+                static constexpr bool sc_is_3_wire = bus_interface == SESP525_INTERFACE_3_WIRE;
+                static constexpr size_t sc_value_size = sc_is_3_wire == true ? sizeof(uint16_t) : 1;
+                static constexpr size_t sc_pixel_size = sc_value_size * sc_sesp525_bytes_per_pixel;
+                // whole pixels, whole words
+                static constexpr size_t sc_buffer_limit = (sc_sesp525_buffer_size / sc_pixel_size) * sc_pixel_size;
+                static constexpr uint32_t sc_register_cost = sc_is_3_wire == true ? (2 * sc_value_size) : sc_sesp525_register_cost;
+                static constexpr uint32_t sc_restart_cost = sc_is_3_wire == true ? sc_value_size : sc_sesp525_restart_cost;
+
+            public:
+                SESP525Driver(std::shared_ptr<Bus> p_bus, std::shared_ptr<ControlPin> p_rs_pin, uint16_t width, uint16_t height)
+                    : m_p_bus(p_bus)
+                    , m_p_rs_pin(p_rs_pin)
+                    , m_width(width)
+                    , m_height(height)
+                    , m_buffer(data::BufferPool::getInstance()->acquire(sc_sesp525_buffer_size))
+                    , m_ddram((size_t)width * height * sc_sesp525_bytes_per_pixel, 0)
+                    , m_ddram_known((size_t)width * height, 0)
+                {
+                    m_registers.fill(0);
+                }
+
+                virtual ~SESP525Driver()
+                {
+                    flush();
+                }
+
+                virtual void write_register(uint8_t target_register, uint8_t value) override
+                {
+                    // a soft reset acts on the write, everything else just stores
+                    if ((target_register == SESP525_SOFT_RESET) || (m_known.test(target_register) == false) ||
+                        (m_registers[target_register] != value))
+                    {
+                        write_command(target_register);
+                        write_data(value);
+
+                        if ((target_register == SESP525_SOFT_RESET) && (value != 0))
+                        {
+                            invalidate();
+                        }
+                        else
+                        {
+                            m_registers[target_register] = value;
+                            m_known.set(target_register);
+                        }
+                    }
+                }
+
+                virtual void select_window(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) override
+                {
+                    AFM_TRACE_SCOPE("display", "select_window");
+
+                    // convert to 0 based indicies
+                    write_register(SESP525_MX1_ADDRESS, x1 - 1);
+                    write_register(SESP525_MX2_ADDRESS, x2 - 1);
+                    write_register(SESP525_MY1_ADDRESS, y1 - 1);
+                    write_register(SESP525_MY2_ADDRESS, y2 - 1);
+                }
+
+                virtual void set_position(uint8_t x, uint8_t y) override
+                {
+                    AFM_TRACE_SCOPE("display", "set_position");
+
+                    write_register(SESP525_MEMORY_ACCESS_POINTER_X, x - 1);
+                    write_register(SESP525_MEMORY_ACCESS_POINTER_Y, y - 1);
+                }
+
+                virtual void fill_screen(const data::Color &color) override
+                {
+                    select_window(1, 1, m_width, m_height);
+                    set_position(1, 1);
+                    write_command(SESP525_DDRAM_DATA_ACCESS_PORT);
+                    write_pixels(color, (uint32_t)m_width * m_height);
+                    flush();
+                }
+
+                virtual void fill(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, const data::Color &color) override
+                {
+                    if (begin_window(x1, y1, x2, y2) == true)
+                    {
+                        write_pixels(color, (uint32_t)(m_window_x2 - m_window_x1 + 1) * (m_window_y2 - m_window_y1 + 1));
+                        end_window();
+                    }
+                }
+
+                virtual void set_pixel(uint8_t x, uint8_t y, const data::Color &color) override
+                {
+                    plot(x, y, color);
+                    flush();
+                }
+
+                virtual void draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color) override
+                {
+                    uint8_t x1 = MIN(start.x, end.x);
+                    uint8_t x2 = MAX(start.x, end.x);
+                    uint8_t y1 = MIN(start.y, end.y);
+                    uint8_t y2 = MAX(start.y, end.y);
+
+                    uint8_t dy = y2 - y1;
+                    uint8_t dx = x2 - x1;
+
+                    if (x1 >= m_width)
+                    {
+                        x1 = m_width - 1;
+                    }
+
+                    if (x2 >= m_width)
+                    {
+                        x2 = m_width - 1;
+                    }
+
+                    if (x1 == x2)
+                    {
+                        x2++; // give us one pixel width
+                    }
+
+                    /* Utilizing the Bresenham algorithm */
+                    int eps = 0;
+
+                    if (y1 != y2)
+                    {
+                        for (/* set above */; y1 < y2; y1++)
+                        {
+                            for (uint8_t xCord = x1; xCord < x2; xCord++)
+                            {
+                                plot(xCord, y1, color);
+                                eps += dy;
+
+                                if ((eps * 2) >= dx)
+                                {
+                                    y1++;
+                                    eps -= dx;
+                                }
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (uint8_t xCord = x1; xCord < x2; xCord++)
+                        {
+                            plot(xCord, y1, color);
+                        }
+                    }
+                    flush();
+                }
+
+                virtual void draw_image(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const data::Color *p_pixels) override
+                {
+                    if ((width > 0) && (height > 0) && (p_pixels != nullptr) &&
+                        (begin_window(x, y, MIN(x + width - 1, m_width), MIN(y + height - 1, m_height)) == true))
+                    {
+                        // rows are clipped to the window, skip what falls off screen
+                        for (uint8_t row = 0; row <= (m_window_y2 - y); row++)
+                        {
+                            const data::Color *p_row = &p_pixels[row * width];
+
+                            for (uint8_t column = 0; column <= (m_window_x2 - x); column++)
+                            {
+                                write_pixel(p_row[column]);
+                            }
+                        }
+
+                        end_window();
+                    }
+                }
+
+                virtual void set_pixels(const data::Pixel *p_pixels, size_t count) override
+                {
+                    uint8_t left = UINT8_MAX;
+                    uint8_t right = 0;
+                    uint8_t top = UINT8_MAX;
+                    uint8_t bottom = 0;
+
+                    // row major, the index rides in the low half so the last write to a point wins
+                    m_order.clear();
+                    for (size_t index = 0; index < count; index++)
+                    {
+                        const data::Coordinate_8t &position = p_pixels[index].position;
+
+                        if ((position.x >= 1) && (position.x <= m_width) && (position.y >= 1) && (position.y <= m_height))
+                        {
+                            m_order.push_back(((uint64_t)position.y << 40) | ((uint64_t)position.x << 32) | (uint32_t)index);
+                            left = MIN(left, position.x);
+                            right = MAX(right, position.x);
+                            top = MIN(top, position.y);
+                            bottom = MAX(bottom, position.y);
+                        }
+                    }
+
+                    if (m_order.empty() == false)
+                    {
+                        std::sort(m_order.begin(), m_order.end());
+
+                        // the whole screen is cheap to stay in, the bounding box shortens the wrap between rows
+                        if (stream_points(p_pixels, left, top, right, bottom, false) <
+                            stream_points(p_pixels, 1, 1, m_width, m_height, false))
+                        {
+                            stream_points(p_pixels, left, top, right, bottom, true);
+                        }
+                        else
+                        {
+                            stream_points(p_pixels, 1, 1, m_width, m_height, true);
+                        }
+
+                        flush();
+                    }
+                }
+
+                virtual void draw_text(uint8_t x, uint8_t y, const char *p_text, size_t length, const IFont &font,
+                    const data::Color &foreground, const data::Color &background) override
+                {
+                    uint8_t width = font.get_width();
+                    uint8_t height = font.get_height();
+
+                    if ((length > 0) && (begin_window(x, y, MIN(x + (length * width) - 1, m_width), MIN(y + height - 1, m_height)) == true))
+                    {
+                        // the window wraps rows for us, stream the run one scan line at a time;
+                        // only what is inside the clipped window, anything more would wrap over it
+                        uint32_t columns = m_window_x2 - x + 1;
+
+                        for (uint8_t row = 0; row <= (m_window_y2 - y); row++)
+                        {
+                            for (uint32_t column = 0; column < columns; column++)
+                            {
+                                bool is_set = ((font.get_column(p_text[column / width], column % width) >> row) & 1) != 0;
+
+                                write_pixel(is_set == true ? foreground : background);
+                            }
+                        }
+
+                        end_window();
+                    }
+                }
+
+                virtual void flush() override
+                {
+                    if (m_buffered > 0)
+                    {
+                        AFM_TRACE_SCOPE("display", "flush");
+
+                        // RS is only raised once there is data to go with it
+                        if (sc_is_3_wire == false)
+                        {
+                            set_rs(constants::sc_gpio_high);
+                        }
+
+                        // resizing inside the capacity never allocates
+                        m_buffer->resize(m_buffered);
+                        m_p_bus->write(*m_buffer);
+                        m_buffer->resize(sc_sesp525_buffer_size);
+                        m_buffered = 0;
+                    }
+                }
+
+                virtual void invalidate() override
+                {
+                    m_known.reset();
+                    m_is_index_known = false;
+                    m_is_tracking = false;
+                    std::fill(m_ddram_known.begin(), m_ddram_known.end(), 0);
+                }
+
+            private:
+                void write_command(uint8_t command)
+                {
+                    // data keeps going to the selected index, no need to select it again
+                    if ((m_is_index_known == false) || (m_index != command))
+                    {
+                        if (sc_is_3_wire == true)
+                        {
+                            // in band, it just queues up behind the data
+                            write_value(command, false);
+                        }
+                        else
+                        {
+                            // whatever is buffered was meant for the previous index
+                            flush();
+
+                            set_rs(constants::sc_gpio_low);
+                            m_p_bus->write(command);
+                        }
+                        m_index = command;
+                        m_is_index_known = true;
+
+                        if (command == SESP525_DDRAM_DATA_ACCESS_PORT)
+                        {
+                            begin_stream();
+                        }
+                    }
+                }
+
+                inline void write_data(uint8_t value)
+                {
+                    write_value(value, true);
+                }
+
+                inline void write_value(uint8_t value, bool is_data)
+                {
+                    if ((m_buffered + sc_value_size) > sc_buffer_limit)
+                    {
+                        flush();
+                    }
+
+                    encode(&(*m_buffer)[m_buffered], value, is_data);
+                    m_buffered += sc_value_size;
+                }
+
+                static inline void encode(uint8_t *p_data, uint8_t value, bool is_data)
+                {
+                    if (sc_is_3_wire == true)
+                    {
+                        uint16_t word = value | (is_data == true ? sc_sesp525_data_bit : 0);
+
+                        memcpy(p_data, &word, sizeof(word));
+                    }
+                    else
+                    {
+                        p_data[0] = value;
+                    }
+                }
+
+                inline void set_rs(uint8_t level)
+                {
+                    if ((m_is_rs_known == false) || (m_rs_level != level))
+                    {
+                        m_p_rs_pin->write(level);
+                        m_rs_level = level;
+                        m_is_rs_known = true;
+                    }
+                }
+
+                void begin_stream()
+                {
+                    // only the usual write mode is modelled, and only from inside the window
+                    m_is_tracking = (m_known.test(SESP525_MEMORY_WRITE_MODE) == true) &&
+                        ((m_registers[SESP525_MEMORY_WRITE_MODE] & sc_sesp525_write_mode_mask) == sc_sesp525_write_mode_modelled) &&
+                        (m_known.test(SESP525_MX1_ADDRESS) == true) && (m_known.test(SESP525_MX2_ADDRESS) == true) &&
+                        (m_known.test(SESP525_MY1_ADDRESS) == true) && (m_known.test(SESP525_MY2_ADDRESS) == true) &&
+                        (m_known.test(SESP525_MEMORY_ACCESS_POINTER_X) == true) && (m_known.test(SESP525_MEMORY_ACCESS_POINTER_Y) == true) &&
+                        (m_registers[SESP525_MX1_ADDRESS] <= m_registers[SESP525_MEMORY_ACCESS_POINTER_X]) &&
+                        (m_registers[SESP525_MEMORY_ACCESS_POINTER_X] <= m_registers[SESP525_MX2_ADDRESS]) &&
+                        (m_registers[SESP525_MY1_ADDRESS] <= m_registers[SESP525_MEMORY_ACCESS_POINTER_Y]) &&
+                        (m_registers[SESP525_MEMORY_ACCESS_POINTER_Y] <= m_registers[SESP525_MY2_ADDRESS]) &&
+                        (m_registers[SESP525_MX2_ADDRESS] < m_width) && (m_registers[SESP525_MY2_ADDRESS] < m_height);
+
+                    if (m_is_tracking == false)
+                    {
+                        // pixels are about to land somewhere we can't follow
+                        m_known.reset(SESP525_MEMORY_ACCESS_POINTER_X);
+                        m_known.reset(SESP525_MEMORY_ACCESS_POINTER_Y);
+                        std::fill(m_ddram_known.begin(), m_ddram_known.end(), 0);
+                    }
+                }
+
+                inline void mirror_pixels(const uint8_t *p_pixel, uint32_t count)
+                {
+                    // x steps every pixel and wraps to the next row, the last row wraps to the first
+                    while (count > 0)
+                    {
+                        uint8_t &x = m_registers[SESP525_MEMORY_ACCESS_POINTER_X];
+                        uint8_t &y = m_registers[SESP525_MEMORY_ACCESS_POINTER_Y];
+                        uint32_t run = MIN(count, (uint32_t)(m_registers[SESP525_MX2_ADDRESS] - x + 1));
+                        size_t index = ((size_t)y * m_width) + x;
+
+                        for (uint32_t pixel = 0; pixel < run; pixel++)
+                        {
+                            memcpy(&m_ddram[(index + pixel) * sc_sesp525_bytes_per_pixel], p_pixel, sc_sesp525_bytes_per_pixel);
+                        }
+                        memset(&m_ddram_known[index], 1, run);
+
+                        x += run;
+                        if (x > m_registers[SESP525_MX2_ADDRESS])
+                        {
+                            x = m_registers[SESP525_MX1_ADDRESS];
+                            y = (y >= m_registers[SESP525_MY2_ADDRESS]) ? m_registers[SESP525_MY1_ADDRESS] : y + 1;
+                        }
+                        count -= run;
+                    }
+                }
+
+                inline void write_pixel(const data::Color &color)
+                {
+                    const uint8_t encoded[sc_sesp525_bytes_per_pixel] =
+                    {
+                        (uint8_t)(color.red & sc_sesp525_6_bits),
+                        (uint8_t)(color.green & sc_sesp525_6_bits),
+                        (uint8_t)(color.blue & sc_sesp525_6_bits)
+                    };
+
+                    write_encoded(encoded);
+                }
+
+                inline void write_encoded(const uint8_t *p_pixel)
+                {
+                    if ((m_buffered + sc_pixel_size) > sc_buffer_limit)
+                    {
+                        flush();
+                    }
+
+                    uint8_t *p_data = &(*m_buffer)[m_buffered];
+
+                    encode(&p_data[0], p_pixel[0], true);
+                    encode(&p_data[sc_value_size], p_pixel[1], true);
+                    encode(&p_data[2 * sc_value_size], p_pixel[2], true);
+                    m_buffered += sc_pixel_size;
+
+                    if (m_is_tracking == true)
+                    {
+                        mirror_pixels(p_pixel, 1);
+                    }
+                }
+
+                void write_pixels(const data::Color &color, uint32_t count)
+                {
+                    const uint8_t red = color.red & sc_sesp525_6_bits;
+                    const uint8_t green = color.green & sc_sesp525_6_bits;
+                    const uint8_t blue = color.blue & sc_sesp525_6_bits;
+                    const uint8_t encoded[sc_sesp525_bytes_per_pixel] = { red, green, blue };
+
+                    if (m_is_tracking == true)
+                    {
+                        mirror_pixels(encoded, count);
+                    }
+
+                    while (count > 0)
+                    {
+                        uint32_t room = (sc_buffer_limit - m_buffered) / sc_pixel_size;
+
+                        if (room == 0)
+                        {
+                            flush();
+                            room = sc_buffer_limit / sc_pixel_size;
+                        }
+
+                        uint32_t run = MIN(room, count);
+                        uint8_t *p_data = &(*m_buffer)[m_buffered];
+
+                        // plain stores, no calls, so the compiler is free to unroll
+                        for (uint32_t pixel = 0; pixel < run; pixel++)
+                        {
+                            encode(&p_data[(pixel * sc_pixel_size)], red, true);
+                            encode(&p_data[(pixel * sc_pixel_size) + sc_value_size], green, true);
+                            encode(&p_data[(pixel * sc_pixel_size) + (2 * sc_value_size)], blue, true);
+                        }
+                        m_buffered += run * sc_pixel_size;
+                        count -= run;
+                    }
+                }
+
+                void plot(uint8_t x, uint8_t y, const data::Color &color)
+                {
+                    select_window(1, 1, m_width, m_height);
+                    set_position(x, y);
+                    write_command(SESP525_DDRAM_DATA_ACCESS_PORT);
+                    write_pixel(color);
+                }
+
+                inline uint32_t register_cost(uint8_t target_register, uint8_t value) const
+                {
+                    return ((m_known.test(target_register) == true) && (m_registers[target_register] == value)) ? 0 : sc_register_cost;
+                }
+
+                /**
+                 * Walks the sorted points through a window and returns the cost
+                 * in bus bytes, emitting as it goes when asked. Between points
+                 * the stream either carries on over the gap, resending mirrored
+                 * pixels, or the pointer moves, whichever is cheaper. Gaps over
+                 * sc_sesp525_gap_fill_limit always move.
+                 */
+                uint32_t stream_points(const data::Pixel *p_pixels, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, bool is_emitting)
+                {
+                    uint32_t width = x2 - x1 + 1;
+                    uint32_t next = 0;      // window offset the stream writes to next
+                    bool is_streaming = false;
+                    uint32_t cost = register_cost(SESP525_MX1_ADDRESS, x1 - 1) + register_cost(SESP525_MX2_ADDRESS, x2 - 1) +
+                        register_cost(SESP525_MY1_ADDRESS, y1 - 1) + register_cost(SESP525_MY2_ADDRESS, y2 - 1);
+
+                    if (is_emitting == true)
+                    {
+                        select_window(x1, y1, x2, y2);
+                    }
+
+                    for (size_t order = 0; order < m_order.size(); order++)
+                    {
+                        // repeats of a point sit together, only the last is drawn
+                        if (((order + 1) < m_order.size()) && ((m_order[order + 1] >> 32) == (m_order[order] >> 32)))
+                        {
+                            continue;
+                        }
+
+                        const data::Pixel &pixel = p_pixels[(uint32_t)m_order[order]];
+                        uint8_t x = pixel.position.x;
+                        uint8_t y = pixel.position.y;
+                        uint32_t offset = ((y - y1) * width) + (x - x1);
+                        uint32_t gap = offset - next;
+                        uint32_t move_cost = sc_restart_cost;
+
+                        if (is_streaming == true)
+                        {
+                            move_cost += (((x1 + (next % width)) != x) ? sc_register_cost : 0) +
+                                (((y1 + (next / width)) != y) ? sc_register_cost : 0);
+                        }
+                        else
+                        {
+                            move_cost += register_cost(SESP525_MEMORY_ACCESS_POINTER_X, x - 1) +
+                                register_cost(SESP525_MEMORY_ACCESS_POINTER_Y, y - 1);
+                        }
+
+                        if ((is_streaming == true) && (gap <= sc_sesp525_gap_fill_limit) && ((gap * sc_pixel_size) <= move_cost) &&
+                            (is_mirrored(next, offset, x1, y1, width) == true))
+                        {
+                            cost += gap * sc_pixel_size;
+                            for (uint32_t fill = next; (is_emitting == true) && (fill < offset); fill++)
+                            {
+                                uint8_t encoded[sc_sesp525_bytes_per_pixel];
+                                size_t index = ((size_t)(y1 - 1 + (fill / width)) * m_width) + (x1 - 1 + (fill % width));
+
+                                memcpy(encoded, &m_ddram[index * sc_sesp525_bytes_per_pixel], sc_sesp525_bytes_per_pixel);
+                                write_encoded(encoded);
+                            }
+                        }
+                        else
+                        {
+                            cost += move_cost;
+                            if (is_emitting == true)
+                            {
+                                set_position(x, y);
+                                write_command(SESP525_DDRAM_DATA_ACCESS_PORT);
+                            }
+                            is_streaming = true;
+                        }
+
+                        cost += sc_pixel_size;
+                        if (is_emitting == true)
+                        {
+                            write_pixel(pixel.color);
+                        }
+                        next = offset + 1;
+                    }
+
+                    return cost;
+                }
+
+                // only what went out while tracking is known, an untracked stream clears the lot
+                bool is_mirrored(uint32_t first, uint32_t last, uint8_t x1, uint8_t y1, uint32_t width) const
+                {
+                    bool is_known = true;
+
+                    for (uint32_t offset = first; (is_known == true) && (offset < last); offset++)
+                    {
+                        is_known = m_ddram_known[((size_t)(y1 - 1 + (offset / width)) * m_width) + (x1 - 1 + (offset % width))] != 0;
+                    }
+
+                    return is_known;
+                }
+
+                bool begin_window(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
+                {
+                    bool success = false;
+                    uint8_t left = MIN(x1, x2);
+                    uint8_t right = MIN(MAX(x1, x2), m_width);
+                    uint8_t top = MIN(y1, y2);
+                    uint8_t bottom = MIN(MAX(y1, y2), m_height);
+
+                    // 1 based, anything entirely off screen is dropped
+                    if ((left >= 1) && (top >= 1) && (left <= right) && (top <= bottom))
+                    {
+                        m_window_x1 = left;
+                        m_window_y1 = top;
+                        m_window_x2 = right;
+                        m_window_y2 = bottom;
+
+                        select_window(left, top, right, bottom);
+                        set_position(left, top);
+                        write_command(SESP525_DDRAM_DATA_ACCESS_PORT);
+                        success = true;
+                    }
+
+                    return success;
+                }
+
+                void end_window()
+                {
+                    // left selected, whatever comes next selects its own and the shadow drops repeats
+                    flush();
+                }
+
+            private:
+                std::shared_ptr<Bus>        m_p_bus;
+                std::shared_ptr<ControlPin> m_p_rs_pin;
+                uint16_t                    m_width;
+                uint16_t                    m_height;
+                data::PooledBuffer          m_buffer;
+                size_t                      m_buffered = 0;
+                uint8_t                     m_window_x1 = 1;
+                uint8_t                     m_window_y1 = 1;
+                uint8_t                     m_window_x2 = 1;
+                uint8_t                     m_window_y2 = 1;
+
+                // controller shadow, a clear bit means unknown and the write always goes out
+                std::array<uint8_t, sc_sesp525_registers>   m_registers;
+                std::bitset<sc_sesp525_registers>           m_known;
+                uint8_t                     m_index = 0;
+                bool                        m_is_index_known = false;
+                uint8_t                     m_rs_level = 0;
+                bool                        m_is_rs_known = false;
+                bool                        m_is_tracking = false;  // the pointer is followed through the current data stream
+                data::Buffer                m_ddram;
+                std::vector<uint8_t>        m_ddram_known;
+                std::vector<uint64_t>       m_order;                // set_pixels scratch, grows to the largest batch
+        };
+    }
+}
+#endif
@@ -0,0 +1,116 @@
+/**
+ * Surface.h
+ *
+ * Off-screen pixel surface that remembers which parts of it changed
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_SURFACE
+#define _H_SURFACE
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Constants.h"
+#include "IFont.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint8_t sc_alpha_transparent = 0;
+        const uint8_t sc_alpha_opaque = 0xFF;
+
+        // past this many rectangles a region merges instead of growing
+        const size_t sc_max_damage_rectangles = 16;
+
+        // extra pixels worth sending to save a window, roughly what setting one up costs on the bus
+        const uint32_t sc_damage_merge_slack = 32;
+
+        /**
+         * Inclusive and 1 based, like the display
+         */
+        struct DamageRectangle
+        {
+            uint16_t    x1;
+            uint16_t    y1;
+            uint16_t    x2;
+            uint16_t    y2;
+        };
+
+        /**
+         * A handful of rectangles covering everything that changed. Adding
+         * one folds it into any rectangle where sending the union costs
+         * about the same as sending both, so the region stays a short list
+         * of windows rather than a pixel mask.
+         */
+        class DamageRegion
+        {
+            public:
+                DamageRegion();
+                virtual ~DamageRegion();
+
+                void add(const DamageRectangle &rectangle);
+                void clear() { m_rectangles.clear(); }
+                bool is_empty() const { return m_rectangles.empty(); }
+                const std::vector<DamageRectangle> &get_rectangles() const { return m_rectangles; }
+
+                static uint32_t get_area(const DamageRectangle &rectangle);
+                static DamageRectangle get_union(const DamageRectangle &left, const DamageRectangle &right);
+                static bool intersect(const DamageRectangle &left, const DamageRectangle &right, DamageRectangle &result);
+
+            private:
+                std::vector<DamageRectangle> m_rectangles;
+        };
+
+        class Surface;
+
+        using SurfaceSPtr = std::shared_ptr<Surface>;
+
+        /**
+         * Pixels kept off screen for a compositor layer. Opaque surfaces hold
+         * colors only, the others an alpha per pixel as well, starting fully
+         * transparent. Every drawing call adds what it touched to the damage
+         * region, which the compositor reads and clears.
+         */
+        class Surface
+        {
+            public:
+                Surface(uint16_t width, uint16_t height, bool is_opaque);
+                virtual ~Surface();
+
+                void clear(const data::Color &color, uint8_t alpha = sc_alpha_opaque);
+                void set_pixel(const data::Coordinate_8t &position, const data::Color &color, uint8_t alpha = sc_alpha_opaque);
+                void fill_rectangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const data::Color &color,
+                    uint8_t alpha = sc_alpha_opaque);
+                void draw_image(const data::Coordinate_8t &position, uint16_t width, uint16_t height, const data::Color *p_pixels);
+                void draw_text(const data::Coordinate_8t &position, const char *p_text, const IFont &font,
+                    const data::Color &foreground, const data::Color &background, uint8_t background_alpha = sc_alpha_opaque);
+
+                uint16_t get_width() const { return m_width; }
+                uint16_t get_height() const { return m_height; }
+                bool is_opaque() const { return m_is_opaque; }
+
+                // 1 based row, nullptr for the alpha of an opaque surface
+                const data::Color *get_row(uint16_t y) const { return &m_pixels[(size_t)(y - 1) * m_width]; }
+                const uint8_t *get_alpha_row(uint16_t y) const;
+
+                DamageRegion &get_damage() { return m_damage; }
+
+            private:
+                bool clip(uint16_t &x1, uint16_t &y1, uint16_t &x2, uint16_t &y2) const;
+                void put(uint16_t x, uint16_t y, const data::Color &color, uint8_t alpha);
+
+            private:
+                uint16_t m_width = 0;
+                uint16_t m_height = 0;
+                bool m_is_opaque = false;
+                std::vector<data::Color> m_pixels;
+                std::vector<uint8_t> m_alpha;
+                DamageRegion m_damage;
+        };
+    }
+}
+#endif
@@ -0,0 +1,162 @@
+/**
+ * Task.h
+ *
+ * Lazily started coroutine that hands its result to whoever awaits it
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_TASK
+#define _H_TASK
+
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+namespace afm
+{
+    namespace communication
+    {
+        template <typename T>
+        class Task;
+
+        /**
+         * Everything but the result, shared by Task<T> and Task<void>
+         */
+        class TaskPromiseBase
+        {
+            public:
+                /**
+                 * Finishing goes straight on with the awaiting coroutine, no
+                 * trip through the event loop and no stack growth however
+                 * deep the chain of co_awaits is
+                 */
+                struct FinalAwaiter
+                {
+                    bool await_ready() noexcept { return false; }
+                    void await_resume() noexcept {}
+
+                    template <typename Promise>
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                    {
+                        return handle.promise().m_continuation;
+                    }
+                };
+
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                FinalAwaiter final_suspend() noexcept { return {}; }
+
+                // the library doesn't throw, anything that does is a bug
+                void unhandled_exception() noexcept { std::terminate(); }
+
+                void set_continuation(std::coroutine_handle<> continuation) { m_continuation = continuation; }
+
+            private:
+                std::coroutine_handle<> m_continuation = std::noop_coroutine();
+        };
+
+        template <typename T>
+        class TaskPromise : public TaskPromiseBase
+        {
+            public:
+                Task<T> get_return_object() noexcept;
+
+                void return_value(T value) { m_value = std::move(value); }
+                T &get_value() { return m_value; }
+
+            private:
+                T m_value {};
+        };
+
+        template <>
+        class TaskPromise<void> : public TaskPromiseBase
+        {
+            public:
+                Task<void> get_return_object() noexcept;
+
+                void return_void() noexcept {}
+        };
+
+        /**
+         * Nothing runs until the task is co_awaited (or given to
+         * EventLoop::spawn()); the awaiting coroutine is resumed with the
+         * co_return value once the task finishes. A task is awaited once
+         * and owns its frame, so dropping it unfinished destroys it along
+         * with everything it was awaiting.
+         */
+        template <typename T = void>
+        class Task
+        {
+            public:
+                using promise_type = TaskPromise<T>;
+                using Handle = std::coroutine_handle<promise_type>;
+
+                Task() = default;
+                explicit Task(Handle handle) : m_handle(handle) {}
+                Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+                Task(const Task &) = delete;
+                Task &operator=(const Task &) = delete;
+
+                Task &operator=(Task &&other) noexcept
+                {
+                    if (this != &other)
+                    {
+                        destroy();
+                        m_handle = std::exchange(other.m_handle, nullptr);
+                    }
+                    return *this;
+                }
+
+                ~Task()
+                {
+                    destroy();
+                }
+
+                bool is_valid() const { return m_handle != nullptr; }
+                bool is_done() const { return (m_handle == nullptr) || (m_handle.done() == true); }
+                std::coroutine_handle<> get_handle() const { return m_handle; }
+
+                bool await_ready() const noexcept { return is_done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    m_handle.promise().set_continuation(awaiting);
+                    return m_handle;
+                }
+
+                T await_resume()
+                {
+                    if constexpr (std::is_void_v<T> == false)
+                    {
+                        return std::move(m_handle.promise().get_value());
+                    }
+                }
+
+            private:
+                void destroy()
+                {
+                    if (m_handle != nullptr)
+                    {
+                        m_handle.destroy();
+                        m_handle = nullptr;
+                    }
+                }
+
+            private:
+                Handle m_handle = nullptr;
+        };
+
+        template <typename T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>(Task<T>::Handle::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>(Task<void>::Handle::from_promise(*this));
+        }
+    }
+}
+#endif
@@ -0,0 +1,130 @@
+/**
+ * Trace.h
+ *
+ * Scoped event tracing written out in the Chrome trace event format, loadable
+ * in chrome://tracing or Perfetto
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_TRACE
+#define _H_TRACE
+
+/**
+ * Everything here compiles out unless the library is built with
+ * -DDISPLAY_TRACING=ON (which defines AFM_TRACING). Category and name must be
+ * string literals, only the pointers are recorded.
+ *
+ * AFM_TRACE_SCOPE("port", "spi write");      complete event for the enclosing scope
+ * AFM_TRACE_INSTANT("gpio", "edge");         zero length marker
+ * AFM_TRACE_DUMP("/tmp/frame.json");         true when the file was written
+ */
+#ifdef AFM_TRACING
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ~2.5MB per tracing thread, override with -DAFM_TRACE_EVENTS_PER_THREAD=n
+#ifndef AFM_TRACE_EVENTS_PER_THREAD
+#define AFM_TRACE_EVENTS_PER_THREAD 65536
+#endif
+
+namespace afm
+{
+    namespace data
+    {
+        const size_t sc_trace_events_per_thread = AFM_TRACE_EVENTS_PER_THREAD;
+
+        struct TraceEvent
+        {
+            const char  *category;
+            const char  *name;
+            uint64_t    start_ns;
+            uint64_t    duration_ns;
+            char        phase;
+        };
+
+        /**
+         * Owned by one thread, only that thread appends. The count is published
+         * with release so a dump on another thread sees whole events. Full
+         * buffers drop new events rather than overwrite ones being read.
+         */
+        struct TraceBuffer
+        {
+            TraceBuffer(uint32_t thread) : thread_id(thread), events(sc_trace_events_per_thread) {}
+
+            uint32_t                    thread_id;
+            std::vector<TraceEvent>     events;
+            std::atomic<size_t>         count{0};
+            std::atomic<uint64_t>       dropped{0};
+        };
+
+        using TraceBufferSPtr = std::shared_ptr<TraceBuffer>;
+
+        class Tracer;
+
+        using TracerSPtr = std::shared_ptr<Tracer>;
+
+        class Tracer
+        {
+            public:
+                Tracer();
+                virtual ~Tracer();
+
+                static TracerSPtr getInstance();
+                static uint64_t get_timestamp();
+
+                // lock free after the first event on each thread
+                static void record(const char *category, const char *name, uint64_t start_ns, uint64_t duration_ns, char phase);
+                bool dump(const std::string &file_name);
+
+            private:
+                static TraceBuffer *get_thread_buffer();
+                TraceBuffer *add_thread_buffer();
+
+            private:
+                std::mutex                      m_mutex;
+                std::vector<TraceBufferSPtr>    m_buffers;
+        };
+
+        class TraceScope
+        {
+            public:
+                TraceScope(const char *category, const char *name)
+                    : m_category(category)
+                    , m_name(name)
+                    , m_start_ns(Tracer::get_timestamp())
+                {
+                }
+
+                ~TraceScope()
+                {
+                    Tracer::record(m_category, m_name, m_start_ns, Tracer::get_timestamp() - m_start_ns, 'X');
+                }
+
+            private:
+                const char  *m_category;
+                const char  *m_name;
+                uint64_t    m_start_ns;
+        };
+    }
+}
+
+#define AFM_TRACE_CONCAT_INNER(a, b) a##b
+#define AFM_TRACE_CONCAT(a, b) AFM_TRACE_CONCAT_INNER(a, b)
+#define AFM_TRACE_SCOPE(category, name) afm::data::TraceScope AFM_TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define AFM_TRACE_INSTANT(category, name) afm::data::Tracer::record(category, name, afm::data::Tracer::get_timestamp(), 0, 'i')
+#define AFM_TRACE_DUMP(file_name) afm::data::Tracer::getInstance()->dump(file_name)
+
+#else
+
+#define AFM_TRACE_SCOPE(category, name) do { } while (0)
+#define AFM_TRACE_INSTANT(category, name) do { } while (0)
+#define AFM_TRACE_DUMP(file_name) (false)
+
+#endif
+#endif
@@ -0,0 +1,597 @@
+/**
+ * display_bench.cpp
+ *
+ * Repeatable measurements of the display primitives against the emulated
+ * SEPS525, reported as JSON so runs can be diffed against each other
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "Compositor.h"
+#include "Console.h"
+#include "Constants.h"
+#include "DataTypes.h"
+#include "DisplayFactory.h"
+#include "Font5x7.h"
+#include "ImageDecoder.h"
+#include "MappedFramebuffer.h"
+#include "PortFactory.h"
+#include "PortStatistics.h"
+#include "SEPS525Emulator.h"
+#include "SPIBusScheduler.h"
+#include "Trace.h"
+
+#ifdef AFM_PNG
+#include <zlib.h>
+#endif
+
+namespace
+{
+    // every heap allocation in the process, the primitives should add none once warmed up
+    std::atomic<uint64_t> s_allocations(0);
+}
+
+void *operator new(size_t size)
+{
+    void *p_memory = malloc(size == 0 ? 1 : size);
+
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (p_memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p_memory;
+}
+
+void operator delete(void *p_memory) noexcept
+{
+    free(p_memory);
+}
+
+void operator delete(void *p_memory, size_t size) noexcept
+{
+    free(p_memory);
+}
+
+namespace
+{
+    const uint32_t sc_default_iterations = 200;
+    const uint32_t sc_random_seed = 0x5EB5525;
+    const uint32_t sc_emulator_instance = 0;
+
+    const char *sc_bench_configuration = R"({
+        "ports": [
+            { "port_type": "emulated", "instance": 0, "device": 0, "port_name": "primary interface" },
+            { "port_type": "emulated", "instance": 0, "device": 1, "port_name": "RS" },
+            { "port_type": "emulated", "instance": 0, "device": 2, "port_name": "RESET" }
+        ],
+        "x_resolution": 160,
+        "y_resolution": 128
+    })";
+
+    void put_le(std::string &data, uint32_t value, size_t length)
+    {
+        for (size_t index = 0; index < length; index++)
+        {
+            data.push_back((char)(value >> (8 * index)));
+        }
+    }
+
+    void put_be(std::string &data, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            data.push_back((char)(value >> shift));
+        }
+    }
+
+    // 24 bit bottom up bitmap of random pixels
+    std::string make_bmp(uint32_t size, std::mt19937 &random)
+    {
+        uint32_t stride = ((size * 3) + 3) & ~3u;
+        std::string data = "BM";
+
+        put_le(data, 54 + (stride * size), 4);
+        put_le(data, 0, 4);
+        put_le(data, 54, 4);
+        put_le(data, 40, 4);
+        put_le(data, size, 4);
+        put_le(data, size, 4);
+        put_le(data, 1, 2);
+        put_le(data, 24, 2);
+        put_le(data, 0, 4);
+        put_le(data, stride * size, 4);
+        put_le(data, 0, 16);
+        for (uint32_t index = 0; index < (stride * size); index++)
+        {
+            data.push_back((char)random());
+        }
+
+        return data;
+    }
+
+#ifdef AFM_PNG
+    void put_chunk(std::string &data, const char *p_type, const std::string &payload)
+    {
+        std::string chunk = std::string(p_type, 4) + payload;
+
+        put_be(data, (uint32_t)payload.size());
+        data += chunk;
+        put_be(data, (uint32_t)crc32(0, (const Bytef *)chunk.data(), (uInt)chunk.size()));
+    }
+
+    // 8 bit RGB, a smooth gradient with some noise so inflate has real work, Paeth filtered rows
+    std::string make_png(uint32_t size, std::mt19937 &random)
+    {
+        std::string header;
+        std::string raw;
+        std::string data = "\x89PNG\r\n\x1A\n";
+        std::vector<uint8_t> compressed;
+        uLongf compressed_size = 0;
+
+        put_be(header, size);
+        put_be(header, size);
+        header += std::string("\x08\x02\x00\x00\x00", 5);
+
+        for (uint32_t y = 0; y < size; y++)
+        {
+            raw.push_back(y == 0 ? 0 : 2);
+            for (uint32_t x = 0; x < size; x++)
+            {
+                raw.push_back((char)(y == 0 ? x : (random() & 3)));
+                raw.push_back((char)(y == 0 ? (x / 2) : (random() & 3)));
+                raw.push_back((char)(y == 0 ? 0x80 : (random() & 3)));
+            }
+        }
+
+        compressed_size = compressBound(raw.size());
+        compressed.resize(compressed_size);
+        compress(compressed.data(), &compressed_size, (const Bytef *)raw.data(), raw.size());
+
+        put_chunk(data, "IHDR", header);
+        put_chunk(data, "IDAT", std::string((const char *)compressed.data(), compressed_size));
+        put_chunk(data, "IEND", "");
+
+        return data;
+    }
+#endif
+
+    /**
+     * One measured case: run() is called once per iteration and returns the
+     * number of pixels it asked the display to touch
+     */
+    struct BenchCase
+    {
+        std::string                 primitive;
+        uint32_t                    size;
+        std::function<uint64_t ()>  run;
+    };
+
+    double percentile(const std::vector<double> &sorted_samples, double fraction)
+    {
+        size_t index = (size_t)(fraction * (sorted_samples.size() - 1) + 0.5);
+
+        return sorted_samples[std::min(index, sorted_samples.size() - 1)];
+    }
+
+    nlohmann::json run_case(const BenchCase &bench_case, uint32_t iterations, afm::communication::SEPS525EmulatorSPtr p_emulator)
+    {
+        std::vector<double> samples;
+        uint64_t pixels = 0;
+        double total_ns = 0;
+
+        samples.reserve(iterations);
+
+        // first run pays for pools, caches and buffers growing to size
+        bench_case.run();
+        p_emulator->clear_counters();
+        uint64_t allocations = s_allocations.load(std::memory_order_relaxed);
+
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            pixels += bench_case.run();
+            auto end = std::chrono::steady_clock::now();
+
+            double elapsed_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            samples.push_back(elapsed_ns);
+            total_ns += elapsed_ns;
+        }
+
+        allocations = s_allocations.load(std::memory_order_relaxed) - allocations;
+        const afm::communication::EmulatorCounters &counters = p_emulator->get_counters();
+        std::sort(samples.begin(), samples.end());
+
+        nlohmann::json result;
+        result["primitive"] = bench_case.primitive;
+        result["size"] = bench_case.size;
+        result["iterations"] = iterations;
+        result["wall_ns"]["p50"] = percentile(samples, 0.50);
+        result["wall_ns"]["p90"] = percentile(samples, 0.90);
+        result["wall_ns"]["p99"] = percentile(samples, 0.99);
+        result["wall_ns"]["mean"] = total_ns / iterations;
+        result["pixels_per_second"] = (total_ns > 0) ? (pixels * 1e9 / total_ns) : 0;
+        result["bus_bytes_per_pixel"] = (pixels > 0) ? ((double)counters.bus_bytes / pixels) : 0;
+        result["bus_bytes_per_op"] = (double)counters.bus_bytes / iterations;
+        // every bus or RS/RESET write is one write() on real hardware
+        result["syscalls_per_op"] = (double)(counters.bus_writes + counters.gpio_writes) / iterations;
+        result["allocations"] = allocations;
+
+        return result;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = sc_default_iterations;
+    std::string output_file;
+    std::string statistics_file;
+    std::string trace_file;
+    std::string bus_interface = "4-wire";
+    bool assert_no_allocations = false;
+    int exit_code = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if ((strcmp(argv[index], "--iterations") == 0) && ((index + 1) < argc))
+        {
+            iterations = std::max(1, atoi(argv[++index]));
+        }
+        else if ((strcmp(argv[index], "--output") == 0) && ((index + 1) < argc))
+        {
+            output_file = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--port-statistics") == 0) && ((index + 1) < argc))
+        {
+            // .prom gets Prometheus text, anything else JSON
+            statistics_file = argv[++index];
+            afm::communication::PortStatistics::set_enabled(true);
+        }
+        else if ((strcmp(argv[index], "--interface") == 0) && ((index + 1) < argc))
+        {
+            // 4-wire or 3-wire
+            bus_interface = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--trace") == 0) && ((index + 1) < argc))
+        {
+            // only has events when built with DISPLAY_TRACING
+            trace_file = argv[++index];
+        }
+        else if (strcmp(argv[index], "--assert-no-allocations") == 0)
+        {
+            assert_no_allocations = true;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--iterations n] [--output file.json] [--port-statistics file.json|file.prom] [--trace file.json]"
+                " [--assert-no-allocations] [--interface 4-wire|3-wire]\n";
+            return 1;
+        }
+    }
+
+    nlohmann::json configuration = nlohmann::json::parse(sc_bench_configuration);
+    configuration["interface"] = bus_interface;
+
+    afm::graphic::IDisplaySPtr p_display = afm::graphic::DisplayFactory::getInstance()->createDisplay(
+        afm::constants::sc_sesp525_display, configuration);
+    afm::communication::SEPS525EmulatorSPtr p_emulator = afm::communication::SEPS525Emulator::getInstance(sc_emulator_instance);
+
+    if (p_display != nullptr)
+    {
+        const uint8_t width = afm::communication::sc_emulator_width;
+        const uint8_t height = afm::communication::sc_emulator_height;
+        std::mt19937 random(sc_random_seed);
+        std::vector<BenchCase> cases;
+
+        auto random_coordinate = [&random, width, height]()
+        {
+            return afm::data::Coordinate_8t((uint8_t)(random() % width) + 1, (uint8_t)(random() % height) + 1);
+        };
+
+        cases.push_back({ "clear", (uint32_t)width * height, [&]()
+        {
+            p_display->clear_screen(afm::constants::BLUE);
+            return (uint64_t)width * height;
+        }});
+
+        for (uint32_t size : { 8, 32, 64, 128 })
+        {
+            cases.push_back({ "fill", size, [&, size]()
+            {
+                uint8_t x = (uint8_t)(random() % (width - size + 1)) + 1;
+                uint8_t y = (uint8_t)(random() % (height - size + 1)) + 1;
+
+                p_display->fill_rectangle(x, y, x + size - 1, y + size - 1);
+                return (uint64_t)size * size;
+            }});
+        }
+
+        cases.push_back({ "line", width, [&]()
+        {
+            afm::data::Coordinate_8t start = random_coordinate();
+            afm::data::Coordinate_8t end = random_coordinate();
+
+            p_display->draw_line(start, end, afm::constants::RED);
+            return (uint64_t)std::max(std::abs(end.x - start.x), std::abs(end.y - start.y)) + 1;
+        }});
+
+        for (uint32_t count : { 1, 64, 1024 })
+        {
+            cases.push_back({ "pixel", count, [&, count]()
+            {
+                for (uint32_t pixel = 0; pixel < count; pixel++)
+                {
+                    p_display->set_pixel(random_coordinate(), afm::constants::GREEN);
+                }
+                return (uint64_t)count;
+            }});
+        }
+
+        for (uint32_t count : { 64, 1024 })
+        {
+            std::shared_ptr<std::vector<afm::data::Pixel>> p_points = std::make_shared<std::vector<afm::data::Pixel>>(
+                count, afm::data::Pixel{ afm::data::Coordinate_8t(1, 1), afm::constants::GREEN });
+
+            cases.push_back({ "pixels", count, [&, p_points]()
+            {
+                for (afm::data::Pixel &point : *p_points)
+                {
+                    point.position = random_coordinate();
+                }
+                p_display->set_pixels(p_points->data(), p_points->size());
+                return (uint64_t)p_points->size();
+            }});
+        }
+
+        // half the points of a 32x32 block, per pixel and batched
+        for (bool is_batched : { false, true })
+        {
+            const uint8_t cluster_size = 32;
+            std::shared_ptr<std::vector<afm::data::Pixel>> p_points = std::make_shared<std::vector<afm::data::Pixel>>(
+                (cluster_size * cluster_size) / 2, afm::data::Pixel{ afm::data::Coordinate_8t(1, 1), afm::constants::RED });
+
+            cases.push_back({ is_batched == true ? "cluster" : "cluster_per_pixel", (uint32_t)p_points->size(), [&, p_points, is_batched, cluster_size]()
+            {
+                uint8_t x = (uint8_t)(random() % (width - cluster_size + 1)) + 1;
+                uint8_t y = (uint8_t)(random() % (height - cluster_size + 1)) + 1;
+
+                for (afm::data::Pixel &point : *p_points)
+                {
+                    point.position = afm::data::Coordinate_8t(x + (random() % cluster_size), y + (random() % cluster_size));
+                }
+
+                if (is_batched == true)
+                {
+                    p_display->set_pixels(p_points->data(), p_points->size());
+                }
+                else
+                {
+                    for (const afm::data::Pixel &point : *p_points)
+                    {
+                        p_display->set_pixel(point.position, point.color);
+                    }
+                }
+                return (uint64_t)p_points->size();
+            }});
+        }
+
+        for (uint32_t length : { 1, 8, 26 })
+        {
+            cases.push_back({ "text", length, [&, length]()
+            {
+                char text[32] = {0};
+
+                for (uint32_t character = 0; character < length; character++)
+                {
+                    text[character] = (char)('A' + (random() % 26));
+                }
+                p_display->set_cursor(afm::data::Coordinate_8t(1, 1));
+                p_display->print(text);
+                return (uint64_t)length * 6 * 8;
+            }});
+        }
+
+        // a full status console where only a counter moves, the first (warm up) run fills it
+        afm::graphic::ConsoleSPtr p_console = std::make_shared<afm::graphic::Console>(p_display, width, height);
+        std::shared_ptr<uint32_t> p_frame = std::make_shared<uint32_t>(0);
+
+        cases.push_back({ "console", 5, [&, p_console, p_frame]()
+        {
+            if (*p_frame == 0)
+            {
+                for (uint8_t row = 0; row < p_console->get_rows(); row++)
+                {
+                    p_console->printf("\x1b[3%umstatus %2u\x1b[0m ........ ok\n", (row % 7) + 1, row);
+                }
+                p_console->invalidate();
+            }
+
+            p_console->printf("\x1b[1;20H%5u", (*p_frame)++);
+            p_console->refresh();
+            return (uint64_t)6 * 8;
+        }});
+
+        // opaque background, translucent chrome and a data layer where a counter moves
+        afm::graphic::CompositorSPtr p_compositor = std::make_shared<afm::graphic::Compositor>(p_display, width, height);
+        afm::graphic::SurfaceSPtr p_background = p_compositor->add_layer(afm::data::Coordinate_8t(1, 1), width, height, true);
+        afm::graphic::SurfaceSPtr p_chrome = p_compositor->add_layer(afm::data::Coordinate_8t(1, 1), width, 16, false);
+        afm::graphic::SurfaceSPtr p_data = p_compositor->add_layer(afm::data::Coordinate_8t(100, 40), 30, 8, false);
+        std::shared_ptr<afm::graphic::Font5x7> p_font = std::make_shared<afm::graphic::Font5x7>();
+        std::shared_ptr<uint32_t> p_count = std::make_shared<uint32_t>(0);
+
+        for (uint8_t y = 1; y <= height; y++)
+        {
+            p_background->fill_rectangle(1, y, width, y, afm::data::Color(0, 0, y / 2));
+        }
+        p_chrome->clear(afm::constants::GREY, 0x80);
+        p_chrome->draw_text(afm::data::Coordinate_8t(4, 5), "STATUS", *p_font, afm::constants::WHITE, afm::constants::BLACK,
+            afm::graphic::sc_alpha_transparent);
+
+        cases.push_back({ "compose", 5, [&, p_compositor, p_data, p_font, p_count]()
+        {
+            char text[8];
+
+            snprintf(text, sizeof(text), "%5u", (*p_count)++);
+            p_data->draw_text(afm::data::Coordinate_8t(1, 1), text, *p_font, afm::constants::GREEN, afm::constants::BLACK,
+                afm::graphic::sc_alpha_transparent);
+            p_compositor->compose();
+            return (uint64_t)p_compositor->get_statistics().pixels;
+        }});
+
+        // a renderer writing a moving bar straight into memory, passes on demand so runs are repeatable
+        afm::graphic::MappedFramebufferSPtr p_mapped = std::make_shared<afm::graphic::MappedFramebuffer>(p_display, width, height);
+        std::shared_ptr<uint32_t> p_tick = std::make_shared<uint32_t>(0);
+
+        cases.push_back({ "mapped", 30, [&, p_mapped, p_tick]()
+        {
+            if (p_mapped->is_running() == false)
+            {
+                p_mapped->start(0);
+            }
+
+            afm::data::Color *p_pixels = p_mapped->get_pixels();
+            uint32_t length = (*p_tick)++ % 30;
+
+            for (uint32_t y = 40; y < 48; y++)
+            {
+                for (uint32_t x = 0; x < 30; x++)
+                {
+                    p_pixels[(y * width) + 100 + x] = x <= length ? afm::constants::GREEN : afm::constants::BLACK;
+                }
+            }
+            p_mapped->flush();
+            return (uint64_t)8;
+        }});
+
+        for (uint32_t size : { 16, 64, 128 })
+        {
+            std::shared_ptr<std::vector<afm::data::Color>> p_image = std::make_shared<std::vector<afm::data::Color>>();
+
+            for (uint32_t pixel = 0; pixel < (size * size); pixel++)
+            {
+                p_image->push_back(afm::data::Color((uint8_t)random(), (uint8_t)random(), (uint8_t)random()));
+            }
+
+            cases.push_back({ "blit", size, [&, size, p_image]()
+            {
+                p_display->draw_image(afm::data::Coordinate_8t(1, 1), size, size, p_image->data());
+                return (uint64_t)size * size;
+            }});
+        }
+
+        // decoded straight from memory, strip by strip
+        std::vector<std::pair<std::string, std::string>> images = { { "bmp", make_bmp(128, random) } };
+#ifdef AFM_PNG
+        images.push_back({ "png", make_png(128, random) });
+#endif
+
+        for (const std::pair<std::string, std::string> &image : images)
+        {
+            std::shared_ptr<std::istringstream> p_input = std::make_shared<std::istringstream>(image.second);
+            afm::graphic::IImageDecoderSPtr p_decoder = afm::graphic::ImageDecoder::create(*p_input);
+
+            cases.push_back({ "decode_" + image.first, 128, [&, p_input, p_decoder]()
+            {
+                p_input->clear();
+                p_input->seekg(0);
+                p_decoder->draw(*p_input, p_display, afm::data::Coordinate_8t(1, 1));
+                return (uint64_t)p_decoder->get_width() * p_decoder->get_height();
+            }});
+        }
+
+        // the same bus the display is on, through the scheduler's generic port path
+        afm::communication::SPIBusSchedulerSPtr p_scheduler = afm::communication::SPIBusScheduler::getInstance(sc_emulator_instance);
+        uint32_t client_id = 0;
+
+        if (p_scheduler->start() == true)
+        {
+            client_id = p_scheduler->add_client(afm::communication::PortFactory::getInstance()->createPort(
+                afm::data::PORT_EMULATED, sc_emulator_instance, 0), 0, 0, 8);
+        }
+
+        for (uint32_t length : { 64, 16384 })
+        {
+            std::shared_ptr<afm::data::Buffer> p_data = std::make_shared<afm::data::Buffer>(length, 0x15);
+
+            cases.push_back({ "transfer", length, [&, length, p_data]()
+            {
+                p_scheduler->transfer(client_id, p_data->data(), nullptr, length, afm::communication::sc_spi_priority_normal);
+                // counted as pixel data so bytes per pixel stays meaningful
+                return (uint64_t)length / 3;
+            }});
+        }
+
+        nlohmann::json report;
+        report["display"] = afm::constants::sc_sesp525_display;
+        report["seed"] = sc_random_seed;
+        report["iterations"] = iterations;
+        report["interface"] = bus_interface;
+        report["results"] = nlohmann::json::array();
+
+        for (const BenchCase &bench_case : cases)
+        {
+            nlohmann::json result = run_case(bench_case, iterations, p_emulator);
+
+            if ((assert_no_allocations == true) && (result["allocations"].get<uint64_t>() > 0))
+            {
+                std::cerr << bench_case.primitive << " " << bench_case.size << " allocated "
+                    << result["allocations"].get<uint64_t>() << " times after warm up\n";
+                exit_code = 1;
+            }
+            report["results"].push_back(result);
+        }
+
+        if (output_file.empty() == true)
+        {
+            std::cout << report.dump(4) << "\n";
+        }
+        else
+        {
+            std::ofstream output(output_file);
+            output << report.dump(4) << "\n";
+        }
+
+        if (statistics_file.empty() == false)
+        {
+            afm::communication::PortMonitorSPtr p_monitor = afm::communication::PortMonitor::getInstance();
+            bool is_prometheus = (statistics_file.size() > 5) && (statistics_file.compare(statistics_file.size() - 5, 5, ".prom") == 0);
+
+            if (is_prometheus == true)
+            {
+                p_monitor->dump_prometheus(statistics_file);
+            }
+            else
+            {
+                p_monitor->dump_json(statistics_file);
+            }
+        }
+
+        if ((trace_file.empty() == false) && (AFM_TRACE_DUMP(trace_file) == false))
+        {
+            std::cerr << "no trace written, tracing is compiled out\n";
+        }
+    }
+    else
+    {
+        std::cerr << "could not create the emulated display\n";
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,117 @@
+/**
+ * DisplayServer.h
+ *
+ * Owns the display and flushes what clients draw into a shared framebuffer
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_DISPLAY_SERVER
+#define _H_DISPLAY_SERVER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Constants.h"
+#include "IDisplay.h"
+#include "SharedFramebuffer.h"
+#include "Surface.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const std::string sc_display_server_socket = "/run/afm-display.sock";
+
+        // damage arriving this close together goes out in one flush
+        const uint32_t sc_display_server_flush_interval_us = 8000;
+
+        /**
+         * Sent to every client as it connects, along with two file handles:
+         * the shared framebuffer and the eventfd that wakes the server
+         */
+        struct DisplayServerHello
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            uint32_t    width;
+            uint32_t    height;
+        };
+
+        /**
+         * What the server has sent so far
+         */
+        struct DisplayServerStatistics
+        {
+            uint64_t    flushes = 0;
+            uint64_t    windows = 0;
+            uint64_t    pixels = 0;
+            uint64_t    overflows = 0;          // times the queue was full and damage was widened
+            uint32_t    clients = 0;
+        };
+
+        class DisplayServer;
+
+        using DisplayServerSPtr = std::shared_ptr<DisplayServer>;
+
+        /**
+         * The one process talking to the panel. Clients connect to a Unix
+         * socket and get the shared framebuffer; they draw into it and queue
+         * damage rectangles, then wake the server through an eventfd. The
+         * server drains the queue into one damage region for every client,
+         * waits out the flush interval so a burst of updates goes together,
+         * and sends each merged rectangle with one draw_image(). Full width
+         * rectangles go straight from the shared memory, narrower ones are
+         * gathered into a buffer first since the window wants them packed.
+         *
+         * run() blocks on the calling thread until stop(), which is safe to
+         * call from a signal handler.
+         */
+        class DisplayServer
+        {
+            public:
+                DisplayServer(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution,
+                    uint32_t flush_interval_us = sc_display_server_flush_interval_us);
+                virtual ~DisplayServer();
+
+                bool start(const std::string &socket_path = sc_display_server_socket);
+                void run();
+                void stop();
+
+                const DisplayServerStatistics &get_statistics() const { return m_statistics; }
+
+            private:
+                bool watch(int file_handle);
+                void accept_clients();
+                void drop_client(int file_handle);
+                void drain();
+                void flush();
+                void flush_rectangle(const DamageRectangle &rectangle);
+                void close_all();
+
+            private:
+                IDisplaySPtr m_display = nullptr;
+                uint16_t m_width = 0;
+                uint16_t m_height = 0;
+                uint32_t m_flush_interval_us = 0;
+                std::string m_socket_path;
+
+                SharedFramebuffer m_framebuffer;
+                DamageRegion m_damage;
+                std::vector<data::Color> m_staging;
+                std::vector<int> m_clients;
+
+                int m_epoll_handle = constants::sc_invalid_file_handle;
+                int m_listen_handle = constants::sc_invalid_file_handle;
+                int m_damage_handle = constants::sc_invalid_file_handle;     // eventfd the clients write
+                int m_wakeup_handle = constants::sc_invalid_file_handle;     // eventfd stop() writes
+                std::atomic<bool> m_running;
+
+                DisplayServerStatistics m_statistics;
+        };
+    }
+}
+#endif
@@ -0,0 +1,79 @@
+/**
+ * EmulatedPort.h
+ *
+ * Ports wired to an in memory SEPS525 controller instead of hardware
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_EMULATED_PORT
+#define _H_EMULATED_PORT
+
+#include "Constants.h"
+#include "Port.h"
+#include "SEPS525Emulator.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const uint8_t sc_emulated_default_bits_per_word = 8;
+        const uint8_t sc_emulated_word_bits_per_word = 9;
+
+        /**
+         * The data bus, instance selects the emulator. At 9 bits per word
+         * it takes 16 bit containers like spidev and decodes the D/C bit.
+         */
+        class EmulatedSPI final : public Port
+        {
+            public:
+                EmulatedSPI();
+
+                virtual bool read(uint8_t &value) override;
+                virtual bool write(uint8_t value) override;
+                virtual uint16_t read(data::Buffer &buffer) override;
+                virtual uint16_t write(const data::Buffer &buffer) override;
+                virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+
+                SEPS525EmulatorSPtr get_emulator() const { return m_emulator; }
+
+                bool set_bits_per_word(uint8_t num_bits);
+                uint8_t get_bits_per_word() const { return m_bits_per_word; }
+
+            protected:
+                virtual bool setup_device() override;
+
+            private:
+                void receive(const data::Buffer &buffer);
+
+            private:
+                SEPS525EmulatorSPtr m_emulator = nullptr;
+                uint8_t             m_bits_per_word = sc_emulated_default_bits_per_word;
+        };
+
+        /**
+         * A control pin, device selects RS or RESET
+         */
+        class EmulatedGPIO final : public Port
+        {
+            public:
+                EmulatedGPIO();
+
+                virtual bool read(uint8_t &value) override;
+                virtual bool write(uint8_t value) override;
+                virtual uint16_t read(data::Buffer &buffer) override;
+                virtual uint16_t write(const data::Buffer &buffer) override;
+                virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+
+                SEPS525EmulatorSPtr get_emulator() const { return m_emulator; }
+
+            protected:
+                virtual bool setup_device() override;
+
+            private:
+                uint8_t             m_level = constants::sc_gpio_high;
+                SEPS525EmulatorSPtr m_emulator = nullptr;
+        };
+    }
+}
+#endif
@@ -14,32 +14,41 @@
 #include <map>
 #include <memory>
 #include <string>
-#include <thread>
 
 #include "Constants.h"
+#include "GPIOEventDispatcher.h"
+#include "GPIOEventLoop.h"
 #include "Port.h"
 
 namespace afm
 {
     namespace communication
     {        
-        class GPIO : public Port
+        class GPIO final : public Port
         {
             public:
                 GPIO();
+                virtual ~GPIO();
 
                 virtual bool read(uint8_t &value) override;
                 virtual bool write(uint8_t value) override;
                 virtual uint16_t read(data::Buffer &buffer) override;
                 virtual uint16_t write(const data::Buffer &buffer) override;
                 virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+                virtual int get_file_handle() override;
 
                 bool enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOInterruptRoutine interrupt_callback);
+                bool enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOEventRoutine event_callback);
+                bool enable_interrupt(data::GPIOInterruptEdge edge);
+                size_t poll_events(data::GPIOEvent *events, size_t max_events) { return m_event_sink.poll(events, max_events); }
+                uint64_t get_overflow_count() const { return m_event_sink.get_overflow_count(); }
+                void disable_interrupt();
+                void set_debounce(uint32_t debounce_us) { m_debounce_ns = (uint64_t)debounce_us * 1000; }
 
             protected:
                 virtual bool setup_device() override;
                 virtual void shutdown_device() override;
-                void run();
+                void on_interrupt();
 
             private:
                 void set_direction(bool make_input);
@@ -49,9 +58,13 @@ namespace afm
                 bool                        m_is_write = false;
                 std::atomic<bool>           m_pin_exported;
                 int                         m_device_handle = constants::sc_invalid_file_handle;
+                int                         m_interrupt_handle = constants::sc_invalid_file_handle;
+                data::GPIOInterruptEdge     m_interrupt_edge = data::GPIOInterruptEdge::NONE;
+                uint64_t                    m_debounce_ns = (uint64_t)constants::sc_gpio_default_debounce_us * 1000;
+                uint64_t                    m_last_event_ns = 0;
                 std::string                 m_base_path;
-                data::GPIOInterruptRoutine  m_interrupt_callback = nullptr;
-                std::thread                 m_interrupt_observer_thread;
+                GPIOEventSink               m_event_sink;
+                GPIOEventLoopSPtr           m_event_loop = nullptr;
        };
     }
 }
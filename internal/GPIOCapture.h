@@ -0,0 +1,95 @@
+/**
+ * GPIOCapture.h
+ *
+ * Fixed rate sampling of several gpiochip lines at once
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_GPIO_CAPTURE
+#define _H_GPIO_CAPTURE
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GPIOLines.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * One sample, bit n is the level of the nth captured line
+         */
+        struct GPIOSample
+        {
+            uint64_t    timestamp_ns;
+            uint64_t    bits;
+        };
+
+        struct GPIOCaptureStatistics
+        {
+            uint64_t    samples = 0;            // total taken since start
+            uint64_t    overwritten = 0;        // lost to ring wrap around
+            uint64_t    missed_periods = 0;     // sampler fell a whole period behind
+            uint64_t    read_errors = 0;        // periods whose read failed, no sample stored
+            double      requested_rate_hz = 0.0;
+            double      achieved_rate_hz = 0.0;
+            double      jitter_mean_ns = 0.0;   // deviation of each sample from its slot
+            double      jitter_stddev_ns = 0.0;
+            uint64_t    jitter_max_ns = 0;
+        };
+
+        /**
+         * Samples its lines with a single GPIO_V2_LINE_GET_VALUES_IOCTL per
+         * period into a ring that is allocated up front, oldest samples are
+         * overwritten once it fills. Lines must not already be held by a port.
+         */
+        class GPIOCapture
+        {
+            public:
+                GPIOCapture();
+                virtual ~GPIOCapture();
+
+                bool start(uint32_t chip, const std::vector<uint32_t> &lines, uint32_t sample_rate_hz, size_t sample_capacity);
+                void stop();
+                bool is_running() const { return m_running; }
+
+                GPIOCaptureStatistics get_statistics() const;
+                size_t get_samples(std::vector<GPIOSample> &samples) const;
+
+                bool export_csv(const std::string &file_name) const;
+                bool export_vcd(const std::string &file_name) const;
+
+            private:
+                void run();
+
+            private:
+                GPIOLines               m_lines;
+                uint32_t                m_chip = 0;
+                std::vector<uint32_t>   m_captured_lines;       // kept past stop() for the exports
+                std::atomic<bool>       m_running;
+                std::thread             m_sampling_thread;
+                std::vector<GPIOSample> m_samples;
+                uint64_t                m_period_ns = 0;
+                uint32_t                m_sample_rate_hz = 0;
+
+                // written by the sampler, read once it has stopped
+                uint64_t                m_sample_count = 0;
+                uint64_t                m_missed_periods = 0;
+                uint64_t                m_read_errors = 0;
+                uint64_t                m_start_ns = 0;
+                uint64_t                m_last_ns = 0;
+                double                  m_jitter_sum = 0.0;
+                double                  m_jitter_sum_squares = 0.0;
+                uint64_t                m_jitter_max = 0;
+        };
+
+        using GPIOCaptureSPtr = std::shared_ptr<GPIOCapture>;
+    }
+}
+#endif
@@ -0,0 +1,69 @@
+/**
+ * GPIOChip.h
+ *
+ * GPIO character device implementation defining a port that can read/write
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_GPIO_CHIP
+#define _H_GPIO_CHIP
+
+#include <cstdint>
+#include <memory>
+
+#include "Constants.h"
+#include "GPIOEventDispatcher.h"
+#include "GPIOEventLoop.h"
+#include "GPIOLines.h"
+#include "Port.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * Single line port backed by /dev/gpiochipN
+         *
+         * instance is the line offset on the chip, device is the chip number
+         */
+        class GPIOChip final : public Port
+        {
+            public:
+                GPIOChip();
+                virtual ~GPIOChip();
+
+                virtual bool read(uint8_t &value) override;
+                virtual bool write(uint8_t value) override;
+                virtual uint16_t read(data::Buffer &buffer) override;
+                virtual uint16_t write(const data::Buffer &buffer) override;
+                virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+                virtual int get_file_handle() override { return m_line.get_file_handle(); }
+
+                bool enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOInterruptRoutine interrupt_callback);
+                bool enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOEventRoutine event_callback);
+                bool enable_interrupt(data::GPIOInterruptEdge edge);
+                size_t poll_events(data::GPIOEvent *events, size_t max_events) { return m_event_sink.poll(events, max_events); }
+                uint64_t get_overflow_count() const { return m_event_sink.get_overflow_count(); }
+                void disable_interrupt();
+
+                // edges stay queued in the kernel for whoever polls get_file_handle(), no reactor involved
+                bool enable_edge_events(data::GPIOInterruptEdge edge);
+                size_t read_edge_events(data::GPIOEvent *events, size_t max_events) { return m_line.read_events(events, max_events); }
+                void set_debounce(uint32_t debounce_us) { m_debounce_us = debounce_us; }
+
+            protected:
+                virtual bool setup_device() override;
+                virtual void shutdown_device() override;
+                void on_interrupt();
+
+            private:
+                GPIOLines               m_line;
+                bool                    m_interrupt_active = false;
+                uint32_t                m_debounce_us = constants::sc_gpio_default_debounce_us;
+                GPIOEventSink           m_event_sink;
+                GPIOEventLoopSPtr       m_event_loop = nullptr;
+        };
+    }
+}
+#endif
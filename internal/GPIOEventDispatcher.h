@@ -0,0 +1,121 @@
+/**
+ * GPIOEventDispatcher.h
+ *
+ * Moves GPIO events off the reactor thread onto a pool of workers
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_GPIO_EVENT_DISPATCHER
+#define _H_GPIO_EVENT_DISPATCHER
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DataTypes.h"
+#include "RingBuffer.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const size_t sc_gpio_default_workers = 1;
+        const size_t sc_gpio_default_ring_capacity = 1024;
+        const size_t sc_gpio_default_batch_size = 32;
+        const size_t sc_gpio_poll_capacity = 256;
+
+        struct GPIOQueuedEvent
+        {
+            data::GPIOEvent event;
+            uint32_t        handler_id;
+        };
+
+        class GPIOEventDispatcher;
+
+        using GPIOEventDispatcherSPtr = std::shared_ptr<GPIOEventDispatcher>;
+
+        /**
+         * Each worker owns a ring fed only by the reactor thread. A handler is
+         * always serviced by the same worker so its events stay in order.
+         */
+        class GPIOEventDispatcher
+        {
+            public:
+                GPIOEventDispatcher();
+                virtual ~GPIOEventDispatcher();
+
+                static GPIOEventDispatcherSPtr getInstance();
+
+                bool configure(size_t worker_count, size_t ring_capacity, size_t batch_size);
+
+                uint32_t register_handler(data::GPIOEventRoutine handler);
+                void unregister_handler(uint32_t handler_id);
+
+                // reactor thread only
+                size_t dispatch(uint32_t handler_id, const data::GPIOEvent *events, size_t count);
+
+                uint64_t get_overflow_count() const;
+
+            private:
+                struct Worker
+                {
+                    explicit Worker(size_t capacity) : ring(capacity) {}
+
+                    data::RingBuffer<GPIOQueuedEvent>   ring;
+                    std::thread                         thread;
+                    std::mutex                          wake_mutex;
+                    std::condition_variable             wake;
+                    std::atomic<bool>                   sleeping { false };
+                    std::mutex                          batch_mutex;
+                    std::atomic<uint64_t>               overflow { 0 };
+                };
+
+                using HandlerSPtr = std::shared_ptr<const data::GPIOEventRoutine>;
+
+                bool start();
+                void stop();
+                void run(Worker *p_worker);
+
+            private:
+                size_t                                  m_worker_count = sc_gpio_default_workers;
+                size_t                                  m_ring_capacity = sc_gpio_default_ring_capacity;
+                size_t                                  m_batch_size = sc_gpio_default_batch_size;
+                std::atomic<bool>                       m_running;
+                uint32_t                                m_next_handler_id = 1;
+                std::mutex                              m_mutex;
+                std::map<uint32_t, HandlerSPtr>         m_handlers;
+                std::vector<std::unique_ptr<Worker>>    m_workers;
+        };
+
+        /**
+         * Per pin delivery, either to a callback through the dispatcher
+         * or into a local ring the owner polls
+         */
+        class GPIOEventSink
+        {
+            public:
+                GPIOEventSink();
+                virtual ~GPIOEventSink();
+
+                void attach(data::GPIOEventRoutine handler);
+                void detach();
+
+                void deliver(const data::GPIOEvent *events, size_t count);
+                size_t poll(data::GPIOEvent *events, size_t max_events);
+
+                uint64_t get_overflow_count() const { return m_overflow; }
+
+            private:
+                uint32_t                            m_handler_id = 0;
+                GPIOEventDispatcherSPtr             m_dispatcher = nullptr;
+                data::RingBuffer<data::GPIOEvent>   m_polled_events;
+                std::atomic<uint64_t>               m_overflow;
+        };
+    }
+}
+#endif
@@ -0,0 +1,63 @@
+/**
+ * GPIOEventLoop.h
+ *
+ * Single epoll reactor shared by every pin with interrupts enabled
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_GPIO_EVENT_LOOP
+#define _H_GPIO_EVENT_LOOP
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Constants.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * Called on the reactor thread when its file handle is ready,
+         * the source is responsible for draining the handle
+         */
+        using GPIOEventHandler = std::function<void ()>;
+
+        class GPIOEventLoop;
+
+        using GPIOEventLoopSPtr = std::shared_ptr<GPIOEventLoop>;
+
+        class GPIOEventLoop
+        {
+            public:
+                GPIOEventLoop();
+                virtual ~GPIOEventLoop();
+
+                static GPIOEventLoopSPtr getInstance();
+
+                bool add_source(int file_handle, uint32_t events, GPIOEventHandler handler);
+                void remove_source(int file_handle);
+
+                static uint64_t get_timestamp();
+
+            private:
+                bool start();
+                void stop();
+                void run();
+
+            private:
+                int                                 m_epoll_handle = constants::sc_invalid_file_handle;
+                int                                 m_wakeup_handle = constants::sc_invalid_file_handle;
+                std::atomic<bool>                   m_running;
+                std::recursive_mutex                m_mutex;
+                std::map<int, GPIOEventHandler>     m_handlers;
+                std::thread                         m_reactor_thread;
+        };
+    }
+}
+#endif
@@ -0,0 +1,62 @@
+/**
+ * GPIOLines.h
+ *
+ * Holds a set of lines requested from a GPIO character device
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_GPIO_LINES
+#define _H_GPIO_LINES
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Constants.h"
+#include "DataTypes.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * A line request against /dev/gpiochipN
+         *
+         * The request handle is held until release() or destruction so that
+         * reads and writes are a single ioctl each. Values are bit masks where
+         * bit n refers to the nth line given to request(), allowing several
+         * lines to be changed atomically.
+         */
+        class GPIOLines
+        {
+            public:
+                GPIOLines();
+                virtual ~GPIOLines();
+
+                bool request(uint32_t chip, const std::vector<uint32_t> &lines, bool make_input);
+                void release();
+
+                bool set_values(uint64_t mask, uint64_t bits);
+                bool get_values(uint64_t mask, uint64_t &bits);
+                bool set_direction(bool make_input);
+                bool configure_events(data::GPIOInterruptEdge edge, uint32_t debounce_us);
+                size_t read_events(data::GPIOEvent *events, size_t max_events);
+
+                bool is_input() const { return m_is_input; }
+                int get_file_handle() const { return m_line_handle; }
+                size_t get_line_count() const { return m_lines.size(); }
+                uint32_t get_chip() const { return m_chip; }
+                const std::vector<uint32_t> &get_lines() const { return m_lines; }
+
+            private:
+                int                     m_line_handle = constants::sc_invalid_file_handle;
+                bool                    m_is_input = false;
+                uint32_t                m_chip = 0;
+                std::vector<uint32_t>   m_lines;
+        };
+
+        using GPIOLinesSPtr = std::shared_ptr<GPIOLines>;
+    }
+}
+#endif
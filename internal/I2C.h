@@ -1,14 +1,17 @@
 /**
  * I2C.h
- * 
+ *
  * I2C implementation defining a port that can read/write
- * 
+ *
  * Copyright 2020 AFM Software
  */
 
 #ifndef _H_I2C
 #define _H_I2C
 
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
 #include "Constants.h"
 #include "Port.h"
 
@@ -16,7 +19,32 @@ namespace afm
 {
     namespace communication
     {
-        class I2C : public Port
+        const size_t sc_i2c_max_batch = I2C_RDWR_IOCTL_MAX_MSGS;
+
+        /**
+         * A list of reads and writes, possibly to different addresses,
+         * issued as a single I2C_RDWR. The buffers belong to the caller
+         * and must stay valid until the transaction is submitted.
+         */
+        class I2CTransaction
+        {
+            public:
+                I2CTransaction() {}
+
+                bool add_write(uint16_t address, const uint8_t *p_data, uint16_t length);
+                bool add_read(uint16_t address, uint8_t *p_data, uint16_t length);
+                void clear() { m_message_count = 0; }
+
+                size_t get_message_count() const { return m_message_count; }
+
+            private:
+                friend class I2C;
+
+                struct i2c_msg  m_messages[sc_i2c_max_batch];
+                size_t          m_message_count = 0;
+        };
+
+        class I2C final : public Port
         {
             public:
                 I2C();
@@ -26,6 +54,9 @@ namespace afm
                 virtual uint16_t read(data::Buffer &buffer) override;
                 virtual uint16_t write(const data::Buffer &buffer) override;
                 virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+                virtual int get_file_handle() override;
+
+                uint16_t submit(I2CTransaction &transaction);
 
             protected:
                 virtual bool setup_device() override;
@@ -36,7 +67,8 @@ namespace afm
 
             private:
                 int m_device_handle = constants::sc_invalid_file_handle;
+                int m_selected_address = -1;
         };
     }
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,75 @@
+/**
+ * IoUring.h
+ *
+ * Minimal io_uring submission/completion ring over the raw syscalls
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_IO_URING
+#define _H_IO_URING
+
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include "Constants.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * Not thread safe on its own, one thread may fill/submit while
+         * another reaps completions as the two rings are independent.
+         */
+        class IoUring
+        {
+            public:
+                IoUring();
+                virtual ~IoUring();
+
+                bool setup(uint32_t entries);
+                void shutdown();
+
+                struct io_uring_sqe *get_sqe();
+                int submit();
+                int wait(uint32_t min_complete);
+
+                struct io_uring_cqe *peek_cqe();
+                void cqe_seen();
+
+                bool register_buffers(const struct iovec *p_buffers, uint32_t count);
+                void unregister_buffers();
+
+                bool is_setup() const { return m_ring_handle != constants::sc_invalid_file_handle; }
+
+                // polls readable while completions are waiting
+                int get_file_handle() const { return m_ring_handle; }
+
+            private:
+                int                     m_ring_handle = constants::sc_invalid_file_handle;
+                bool                    m_buffers_registered = false;
+
+                void                    *m_sq_ring = nullptr;
+                size_t                  m_sq_ring_size = 0;
+                void                    *m_cq_ring = nullptr;
+                size_t                  m_cq_ring_size = 0;
+                struct io_uring_sqe     *m_sqes = nullptr;
+                size_t                  m_sqes_size = 0;
+
+                uint32_t                *m_sq_head = nullptr;
+                uint32_t                *m_sq_tail = nullptr;
+                uint32_t                *m_sq_array = nullptr;
+                uint32_t                m_sq_mask = 0;
+                uint32_t                m_sq_entries = 0;
+                uint32_t                m_sq_pending = 0;
+
+                uint32_t                *m_cq_head = nullptr;
+                uint32_t                *m_cq_tail = nullptr;
+                uint32_t                m_cq_mask = 0;
+                struct io_uring_cqe     *m_cqes = nullptr;
+        };
+    }
+}
+#endif
@@ -0,0 +1,88 @@
+/**
+ * RingBuffer.h
+ *
+ * Bounded lock-free single producer/single consumer queue
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_RING_BUFFER
+#define _H_RING_BUFFER
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace afm
+{
+    namespace data
+    {
+        const size_t sc_cache_line_size = 64;
+
+        /**
+         * Exactly one thread may push and exactly one thread may pop.
+         * Capacity is rounded up to a power of two, push fails rather
+         * than overwrite when full so the caller can account for it.
+         */
+        template <typename T>
+        class RingBuffer
+        {
+            public:
+                explicit RingBuffer(size_t capacity)
+                {
+                    size_t size = 1;
+
+                    while (size < capacity)
+                    {
+                        size <<= 1;
+                    }
+                    m_buffer.resize(size);
+                    m_mask = size - 1;
+                }
+
+                bool push(const T &value)
+                {
+                    bool success = false;
+                    size_t head = m_head.load(std::memory_order_relaxed);
+
+                    if ((head - m_tail.load(std::memory_order_acquire)) < m_buffer.size())
+                    {
+                        m_buffer[head & m_mask] = value;
+                        m_head.store(head + 1, std::memory_order_release);
+                        success = true;
+                    }
+
+                    return success;
+                }
+
+                size_t pop(T *values, size_t max_count)
+                {
+                    size_t tail = m_tail.load(std::memory_order_relaxed);
+                    size_t available = m_head.load(std::memory_order_acquire) - tail;
+                    size_t count = available < max_count ? available : max_count;
+
+                    for (size_t index = 0; index < count; index++)
+                    {
+                        values[index] = m_buffer[(tail + index) & m_mask];
+                    }
+                    m_tail.store(tail + count, std::memory_order_release);
+
+                    return count;
+                }
+
+                bool empty() const
+                {
+                    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+                }
+
+                size_t capacity() const { return m_buffer.size(); }
+
+            private:
+                std::vector<T>                                  m_buffer;
+                size_t                                          m_mask = 0;
+                alignas(sc_cache_line_size) std::atomic<size_t> m_head { 0 };
+                alignas(sc_cache_line_size) std::atomic<size_t> m_tail { 0 };
+        };
+    }
+}
+#endif
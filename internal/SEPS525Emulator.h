@@ -0,0 +1,111 @@
+/**
+ * SEPS525Emulator.h
+ *
+ * In memory model of the SEPS525 controller for hardware free runs
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_SEPS525_EMULATOR
+#define _H_SEPS525_EMULATOR
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * The device number of an emulated port picks its role
+         */
+        enum EmulatedRole
+        {
+            EMULATED_BUS,
+            EMULATED_RS,
+            EMULATED_RESET,
+            END_EMULATED_ROLES
+        };
+
+        const uint16_t sc_emulator_width = 160;
+        const uint16_t sc_emulator_height = 128;
+
+        /**
+         * Everything the emulator saw since the last clear_counters()
+         */
+        struct EmulatorCounters
+        {
+            uint64_t    bus_writes = 0;     // write calls on the bus, i.e. syscalls on real hardware
+            uint64_t    bus_bytes = 0;      // bytes clocked onto the wire
+            uint64_t    commands = 0;       // index (RS low) bytes
+            uint64_t    register_writes = 0;
+            uint64_t    data_bytes = 0;     // DDRAM bytes
+            uint64_t    pixels = 0;
+            uint64_t    gpio_writes = 0;    // RS/RESET write calls
+            uint64_t    rs_toggles = 0;     // RS level changes
+        };
+
+        class SEPS525Emulator;
+
+        using SEPS525EmulatorSPtr = std::shared_ptr<SEPS525Emulator>;
+
+        /**
+         * Models the register file, window, memory access pointer with auto
+         * increment and the DDRAM. Not thread safe, one display drives it.
+         *
+         * Memory write mode bits as used by the driver:
+         * bit 0 vertical write direction, bit 1 vertical increment,
+         * bit 2 horizontal increment, bit 4 triple (6-6-6) transfer,
+         * otherwise dual (5-6-5) transfer
+         */
+        class SEPS525Emulator
+        {
+            public:
+                SEPS525Emulator();
+                virtual ~SEPS525Emulator();
+
+                static SEPS525EmulatorSPtr getInstance(uint32_t instance);
+
+                void receive(const uint8_t *p_data, size_t length);
+                // 3-wire, every value carries its own D/C bit and RS is ignored
+                void receive_words(const uint8_t *p_data, size_t length);
+                void set_rs(uint8_t level);
+                void set_reset(uint8_t level);
+                void reset();
+
+                uint8_t get_register(uint8_t target_register) const { return m_registers[target_register]; }
+                data::Color get_pixel(uint16_t x, uint16_t y) const;
+                uint16_t get_pointer_x() const { return m_pointer_x; }
+                uint16_t get_pointer_y() const { return m_pointer_y; }
+                uint8_t get_rs() const { return m_rs_level; }
+
+                const EmulatorCounters &get_counters() const { return m_counters; }
+                void clear_counters() { m_counters = EmulatorCounters(); }
+                void clear_ddram();
+
+            private:
+                void receive_value(uint8_t value, bool is_command);
+                void write_register(uint8_t value);
+                void write_ddram(uint8_t value);
+                void advance_pointer();
+
+            private:
+                uint8_t                     m_registers[256];
+                uint8_t                     m_index = 0;
+                uint8_t                     m_rs_level = 1;
+                uint8_t                     m_reset_level = 1;
+                uint16_t                    m_pointer_x = 0;
+                uint16_t                    m_pointer_y = 0;
+                uint8_t                     m_pixel_bytes[3] = {0};
+                uint8_t                     m_pixel_byte_count = 0;
+                std::vector<data::Color>    m_ddram;
+                EmulatorCounters            m_counters;
+        };
+    }
+}
+#endif
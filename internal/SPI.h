@@ -16,7 +16,7 @@ namespace afm
 {
     namespace communication
     {
-        class SPI : public Port
+        class SPI final : public Port
         {
             public:
                 SPI();
@@ -26,18 +26,25 @@ namespace afm
                 virtual uint16_t read(data::Buffer &buffer) override;
                 virtual uint16_t write(const data::Buffer &buffer) override;
                 virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+                virtual int get_file_handle() override;
 
-            protected:
-                virtual bool setup_device() override;
-                virtual void shutdown_device() override;
+                // one full duplex segment at its own clock, either buffer may be null
+                uint16_t transfer(const uint8_t *p_output, uint8_t *p_input, size_t length, uint32_t frequency, uint8_t bits_per_word);
 
-            private:
                 bool set_frequency(uint32_t frequency);
                 bool set_mode(uint8_t mode);
                 bool set_bits_per_word(uint8_t num_bits);
+                uint32_t get_frequency() const { return m_frequency; }
+                uint8_t get_mode() const { return m_mode; }
+                uint8_t get_bits_per_word() const { return m_bits_per_word; }
+
+            protected:
+                virtual bool setup_device() override;
+                virtual void shutdown_device() override;
 
             private:
                 int         m_device_handle = constants::sc_invalid_file_handle;
+                uint8_t     m_mode = 0;
                 uint8_t     m_bits_per_word;
                 uint32_t    m_frequency;
         };
@@ -0,0 +1,148 @@
+/**
+ * SPIBusScheduler.h
+ *
+ * Arbitrates one SPI controller between several devices by priority and
+ * deadline, splitting large transfers so urgent ones can get in between
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_SPI_BUS_SCHEDULER
+#define _H_SPI_BUS_SCHEDULER
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "IPort.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        // spidev's default bufsiz, one chunk always fits a single message
+        const size_t sc_spi_default_chunk_size = 4096;
+        const uint64_t sc_spi_no_deadline = 0;
+
+        const uint8_t sc_spi_priority_low = 0;
+        const uint8_t sc_spi_priority_normal = 128;
+        const uint8_t sc_spi_priority_high = 255;
+
+        /**
+         * Bytes is how much made it onto the bus
+         */
+        using SPIBusCompletion = std::function<void (bool success, size_t bytes)>;
+
+        /**
+         * Wait is submit to first chunk on the wire, latency is submit to completion
+         */
+        struct SPIBusClientStatistics
+        {
+            uint64_t    transactions = 0;
+            uint64_t    chunks = 0;
+            uint64_t    bytes = 0;
+            uint64_t    preemptions = 0;        // times another client went between our chunks
+            uint64_t    deadline_misses = 0;
+            uint64_t    total_wait_ns = 0;
+            uint64_t    max_wait_ns = 0;
+            uint64_t    total_latency_ns = 0;
+            uint64_t    max_latency_ns = 0;
+        };
+
+        class SPIBusScheduler;
+
+        using SPIBusSchedulerSPtr = std::shared_ptr<SPIBusScheduler>;
+
+        /**
+         * One per controller (spidevN.*). Each client is a port on that
+         * controller with its own mode, clock and word size, applied to every
+         * segment it sends. Transactions run in priority order, earliest
+         * deadline first within a priority, then in submission order; after
+         * each chunk the queue is looked at again so a high priority read
+         * waits for at most one chunk of someone else's upload.
+         *
+         * Ports that aren't spidev (e.g. the emulator) are driven through
+         * the plain IPort calls, without per segment clock or mode.
+         */
+        class SPIBusScheduler
+        {
+            public:
+                SPIBusScheduler();
+                virtual ~SPIBusScheduler();
+
+                static SPIBusSchedulerSPtr getInstance(uint32_t instance);
+
+                bool start(size_t chunk_size = sc_spi_default_chunk_size);
+                void stop();
+
+                uint32_t add_client(IPortSPtr p_port, uint8_t mode, uint32_t frequency, uint8_t bits_per_word);
+                void remove_client(uint32_t client_id);
+
+                // deadline is CLOCK_MONOTONIC ns, buffers must stay valid until completion
+                bool submit(uint32_t client_id, const uint8_t *p_output, uint8_t *p_input, size_t length,
+                    uint8_t priority, uint64_t deadline_ns, SPIBusCompletion completion);
+                size_t transfer(uint32_t client_id, const uint8_t *p_output, uint8_t *p_input, size_t length,
+                    uint8_t priority, uint64_t deadline_ns = sc_spi_no_deadline);
+
+                SPIBusClientStatistics get_statistics(uint32_t client_id);
+                void clear_statistics(uint32_t client_id);
+
+                static uint64_t get_timestamp();
+
+            private:
+                struct Client
+                {
+                    IPortSPtr               p_port;
+                    uint8_t                 mode;
+                    uint32_t                frequency;
+                    uint8_t                 bits_per_word;
+                    SPIBusClientStatistics  statistics;
+                };
+
+                struct Transaction
+                {
+                    uint32_t            client_id;
+                    const uint8_t      *p_output;
+                    uint8_t            *p_input;
+                    size_t              length;
+                    size_t              offset;
+                    uint8_t             priority;
+                    uint64_t            deadline_ns;
+                    uint64_t            sequence;
+                    uint64_t            submitted_ns;
+                    bool                started;
+                    bool                success;
+                    SPIBusCompletion    completion;
+                };
+
+                using TransactionSPtr = std::shared_ptr<Transaction>;
+
+                struct TransactionOrder
+                {
+                    bool operator()(const TransactionSPtr &p_left, const TransactionSPtr &p_right) const;
+                };
+
+                void run();
+                bool send_chunk(Client &client, Transaction &transaction, size_t length);
+
+            private:
+                std::mutex                      m_mutex;
+                std::condition_variable         m_wake;
+                std::map<uint32_t, Client>      m_clients;
+                std::priority_queue<TransactionSPtr, std::vector<TransactionSPtr>, TransactionOrder> m_queue;
+                std::vector<TransactionSPtr>    m_free_transactions;
+                uint32_t                        m_next_client_id = 1;
+                uint64_t                        m_next_sequence = 0;
+                size_t                          m_chunk_size = sc_spi_default_chunk_size;
+                bool                            m_running = false;
+                std::thread                     m_thread;
+        };
+    }
+}
+#endif
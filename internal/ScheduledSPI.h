@@ -0,0 +1,70 @@
+/**
+ * ScheduledSPI.h
+ *
+ * A device on a shared SPI controller whose traffic goes through the
+ * controller's SPIBusScheduler
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_SCHEDULED_SPI
+#define _H_SCHEDULED_SPI
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "DataTypes.h"
+#include "IPort.h"
+#include "SPIBusScheduler.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        /**
+         * Stands in for the device port so a driver written against IPort
+         * queues behind the other clients instead of taking the bus. Every
+         * call waits for its transfer, so an RS or chip select toggled in
+         * between still lines up with the data. lock() is this client's
+         * own, the device port is only locked per chunk by the scheduler;
+         * holding it across a transfer would stall the scheduler.
+         */
+        class ScheduledSPI final : public IPort
+        {
+            public:
+                ScheduledSPI(SPIBusSchedulerSPtr p_scheduler, IPortSPtr p_port, uint8_t priority);
+                virtual ~ScheduledSPI();
+
+                // wired up when constructed, this only tells whether it is that device
+                virtual bool initialize(uint32_t instance, uint32_t device) override;
+
+                virtual bool read(uint8_t &value) override;
+                virtual bool write(uint8_t value) override;
+                virtual uint16_t read(data::Buffer &buffer) override;
+                virtual uint16_t write(const data::Buffer &buffer) override;
+                virtual uint16_t transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer) override;
+                virtual bool is_port(uint32_t instance, uint32_t device) override;
+                virtual void lock() override { m_transaction_mutex.lock(); }
+                virtual void unlock() override { m_transaction_mutex.unlock(); }
+                virtual bool try_lock() override { return m_transaction_mutex.try_lock(); }
+
+                bool set_bits_per_word(uint8_t num_bits);
+                uint32_t get_client_id() const { return m_client_id; }
+                const IPortSPtr &get_device_port() const { return m_pport; }
+
+            private:
+                SPIBusSchedulerSPtr     m_p_scheduler = nullptr;
+                IPortSPtr               m_pport = nullptr;
+                uint8_t                 m_priority = sc_spi_priority_normal;
+                uint8_t                 m_mode = 0;
+                uint32_t                m_frequency = 0;
+                uint8_t                 m_bits_per_word = 8;
+                uint32_t                m_client_id = 0;
+                std::recursive_mutex    m_transaction_mutex;
+        };
+
+        using ScheduledSPISPtr = std::shared_ptr<ScheduledSPI>;
+    }
+}
+#endif
@@ -0,0 +1,128 @@
+/**
+ * SharedFramebuffer.h
+ *
+ * Framebuffer and damage queue in one memfd, shared by the display server and its clients
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#ifndef _H_SHARED_FRAMEBUFFER
+#define _H_SHARED_FRAMEBUFFER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Constants.h"
+#include "RingBuffer.h"
+#include "Surface.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint32_t sc_shared_framebuffer_magic = 0x41464D46;   // "AFMF"
+        const uint32_t sc_shared_framebuffer_version = 1;
+
+        // power of two, the queue indexes with a mask
+        const uint32_t sc_shared_damage_slots = 256;
+
+        // positions are addressed with 8 bit coordinates on the wire
+        const uint16_t sc_shared_framebuffer_max_size = 255;
+
+        /**
+         * One queue slot. The sequence says whose turn it is: equal to the
+         * position it is free for that producer, one past it the rectangle
+         * is ready for the consumer.
+         */
+        struct SharedDamage
+        {
+            std::atomic<uint32_t>   sequence;
+            uint16_t                x1;
+            uint16_t                y1;
+            uint16_t                x2;
+            uint16_t                y2;
+        };
+
+        /**
+         * Start of the shared memory, the pixels follow at pixel_offset,
+         * width * height data::Color row by row. Only atomics that are lock
+         * free work across processes, so nothing here may take a lock.
+         */
+        struct SharedFramebufferHeader
+        {
+            uint32_t                                                magic;
+            uint32_t                                                version;
+            uint32_t                                                width;
+            uint32_t                                                height;
+            uint32_t                                                pixel_offset;
+            std::atomic<uint32_t>                                   overflow;           // packed bounds of what missed a full queue, 0 when none
+            std::atomic<uint32_t>                                   is_wake_pending;    // someone already signalled the server
+            alignas(data::sc_cache_line_size) std::atomic<uint32_t> enqueue_position;
+            alignas(data::sc_cache_line_size) std::atomic<uint32_t> dequeue_position;
+            alignas(data::sc_cache_line_size) SharedDamage          damage[sc_shared_damage_slots];
+        };
+
+        static_assert(std::atomic<uint32_t>::is_always_lock_free == true, "shared memory atomics have to be lock free");
+
+        class SharedFramebuffer;
+
+        using SharedFramebufferSPtr = std::shared_ptr<SharedFramebuffer>;
+
+        /**
+         * The server create()s the memory and hands the file handle to each
+         * client, which attach()es it. Clients draw straight into the pixels
+         * and push_damage() what they touched; any number of processes may
+         * push at once (a bounded multi producer queue, after Vyukov). Only
+         * the server pops. A push that finds the queue full is folded into
+         * one overflow rectangle instead, so damage is never lost, only
+         * widened.
+         *
+         * Waking the server is left to the caller: request_wake() says
+         * whether this push is the first since the server last looked, so
+         * only that one needs a syscall.
+         */
+        class SharedFramebuffer
+        {
+            public:
+                SharedFramebuffer();
+                virtual ~SharedFramebuffer();
+
+                bool create(uint16_t width, uint16_t height);
+                bool attach(int file_handle);
+
+                int get_file_handle() const { return m_file_handle; }
+                uint16_t get_width() const { return m_width; }
+                uint16_t get_height() const { return m_height; }
+                data::Color *get_pixels() const { return m_p_pixels; }
+                data::Color *get_row(uint16_t y) const { return m_p_pixels + (size_t)(y - 1) * m_width; }
+
+                // any process
+                void push_damage(const DamageRectangle &rectangle);
+                bool request_wake();
+
+                // the server only
+                bool pop_damage(DamageRectangle &rectangle);
+                bool take_overflow(DamageRectangle &rectangle);
+                void clear_wake();
+
+            private:
+                void push_overflow(const DamageRectangle &rectangle);
+                bool map(size_t size);
+                void unmap();
+
+                static uint32_t pack(const DamageRectangle &rectangle);
+                static DamageRectangle unpack(uint32_t packed);
+
+            private:
+                int m_file_handle = constants::sc_invalid_file_handle;
+                void *m_p_memory = nullptr;
+                size_t m_size = 0;
+                SharedFramebufferHeader *m_p_header = nullptr;
+                data::Color *m_p_pixels = nullptr;
+                uint16_t m_width = 0;
+                uint16_t m_height = 0;
+        };
+    }
+}
+#endif
@@ -0,0 +1,101 @@
+/**
+ * display_server.cpp
+ *
+ * Daemon that owns the panel and shares it with client processes
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <streambuf>
+#include <string>
+
+#include "Constants.h"
+#include "Display.h"
+#include "DisplayFactory.h"
+#include "DisplayServer.h"
+
+static afm::graphic::DisplayServer *sp_server = nullptr;
+
+static void on_signal(int signal_number)
+{
+    (void)signal_number;
+
+    if (sp_server != nullptr)
+    {
+        sp_server->stop();
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    int result = EXIT_FAILURE;
+    std::string configuration_file;
+    std::string socket_path = afm::graphic::sc_display_server_socket;
+    uint32_t flush_interval_us = afm::graphic::sc_display_server_flush_interval_us;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if ((strcmp(argv[index], "--config") == 0) && ((index + 1) < argc))
+        {
+            configuration_file = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--socket") == 0) && ((index + 1) < argc))
+        {
+            socket_path = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--interval") == 0) && ((index + 1) < argc))
+        {
+            flush_interval_us = strtoul(argv[++index], nullptr, 10);
+        }
+    }
+
+    std::ifstream t(configuration_file);
+
+    if (t.is_open() == false)
+    {
+        std::cerr << "usage: " << argv[0] << " --config display.json [--socket path] [--interval us]\n";
+    }
+    else
+    {
+        std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+        nlohmann::json configuration_data = nlohmann::json::parse(str);
+
+        afm::graphic::IDisplaySPtr p_display = afm::graphic::DisplayFactory::getInstance()->createDisplay(afm::constants::sc_sesp525_display, configuration_data);
+
+        if (p_display != nullptr)
+        {
+            afm::graphic::DisplayServer server(p_display, configuration_data[afm::graphic::sc_x_resolution].get<uint16_t>(),
+                configuration_data[afm::graphic::sc_y_resolution].get<uint16_t>(), flush_interval_us);
+
+            if (server.start(socket_path) == true)
+            {
+                sp_server = &server;
+                signal(SIGTERM, on_signal);
+                signal(SIGINT, on_signal);
+
+                server.run();
+
+                signal(SIGTERM, SIG_DFL);
+                signal(SIGINT, SIG_DFL);
+                sp_server = nullptr;
+                result = EXIT_SUCCESS;
+            }
+            else
+            {
+                std::cerr << "can't serve on " << socket_path << "\n";
+            }
+        }
+        else
+        {
+            std::cerr << "no display from " << configuration_file << "\n";
+        }
+    }
+
+    return result;
+}
@@ -6,14 +6,28 @@
 #ifndef _H_SESP525
 #define _H_SESP525
 
+#include <vector>
+
 #include "DataTypes.h"
 #include "Display.h"
+#include "Font5x7.h"
 #include "IPort.h"
+#include "SESP525Driver.h"
 
 namespace afm
 {
     namespace graphic
     {
+        /**
+         * One step of the power up sequence, the delay holds off the next write
+         */
+        struct SESP525InitCommand
+        {
+            uint8_t     target_register;
+            uint8_t     value;
+            uint32_t    delay_us;
+        };
+
         class SESP525Display : public Display
         {
             public:
@@ -22,10 +36,12 @@ namespace afm
 
                 virtual void clear_screen(const data::Color &color) override;
                 virtual void set_pixel(const data::Coordinate_8t &position, const data::Color &color) override;
+                virtual void set_pixels(const data::Pixel *p_pixels, size_t count) override;
                 virtual void draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) override;
                 virtual void draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t thickness) override;
                 virtual void fill_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) override;
                 virtual void draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color) override;
+                virtual void draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels) override;
                 virtual void print(char *data) override;
                 virtual void print_line(char *data) override;
                 virtual void printf(const char * __format, ...) override;
@@ -35,16 +51,15 @@ namespace afm
                 virtual bool on_reset() override;
 
             private:
-                void select_window(data::Coordinate_8t start, data::Coordinate_8t end);
-                void set_position(uint8_t x, uint8_t y);
-                void write_register(uint8_t target_register, uint8_t value);
-                void write_data_start();
-                void write_pixel(data::Color color);
-                void set_pixel(const uint8_t x, const uint8_t y, const data::Color color);
+                void run_init_sequence();
 
             private:
+                ISESP525DriverSPtr m_driver = nullptr;
+                communication::IPortSPtr m_bus = nullptr; // the primary port, or our client of its bus scheduler
                 communication::IPortSPtr m_rs_pin = nullptr;
                 communication::IPortSPtr m_reset_pin = nullptr;
+                Font5x7 m_font;
+                std::vector<SESP525InitCommand> m_init_sequence;
         };
     }
 }
@@ -0,0 +1,377 @@
+/**
+ * AsyncPort.cpp
+ *
+ * Asynchronous reads and writes on a port's file handle through io_uring
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <cerrno>
+#include <chrono>
+
+#include "AsyncPort.h"
+#include "IoUring.h"
+#include "Port.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const uint64_t sc_async_wakeup = ~0ULL;
+        const uint32_t sc_async_shutdown_polls = 200;
+        const std::chrono::milliseconds sc_async_shutdown_poll_interval(5);
+
+        AsyncPort::AsyncPort()
+            : m_ring(new IoUring())
+            , m_in_flight(0)
+            , m_running(false)
+        {
+
+        }
+
+        AsyncPort::~AsyncPort()
+        {
+            shutdown();
+        }
+
+        bool AsyncPort::initialize(int file_handle, uint32_t queue_depth, bool completion_thread)
+        {
+            bool success = false;
+
+            shutdown();
+
+            if ((file_handle != constants::sc_invalid_file_handle) && (queue_depth > 0))
+            {
+                if (m_ring->setup(queue_depth) == true)
+                {
+                    m_file_handle = file_handle;
+
+                    // one slot per possible in flight operation, never grown afterwards
+                    m_completions.resize(queue_depth);
+                    m_free_slots.clear();
+                    for (uint32_t slot = queue_depth; slot > 0; slot--)
+                    {
+                        m_free_slots.push_back(slot - 1);
+                    }
+
+                    if (completion_thread == true)
+                    {
+                        m_running = true;
+                        m_completion_thread = std::thread(&AsyncPort::run, this);
+                    }
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        bool AsyncPort::initialize(IPortSPtr p_port, uint32_t queue_depth, bool completion_thread)
+        {
+            bool success = false;
+            std::shared_ptr<Port> p_concrete_port = std::dynamic_pointer_cast<Port>(p_port);
+
+            if (p_concrete_port != nullptr)
+            {
+                success = initialize(p_concrete_port->get_file_handle(), queue_depth, completion_thread);
+                if (success == true)
+                {
+                    // keep the handle open for as long as we use it
+                    m_pport = p_port;
+                }
+            }
+
+            return success;
+        }
+
+        void AsyncPort::shutdown()
+        {
+            if (m_running == true)
+            {
+                m_running = false;
+
+                {
+                    std::lock_guard<std::mutex> guard(m_submit_mutex);
+
+                    // a full submission queue has no room for the wakeup, hand what's
+                    // queued to the kernel and it frees up as soon as the kernel takes it
+                    struct io_uring_sqe *p_sqe = m_ring->get_sqe();
+                    for (uint32_t poll = 0; (p_sqe == nullptr) && (poll < sc_async_shutdown_polls); poll++)
+                    {
+                        m_ring->submit();
+                        p_sqe = m_ring->get_sqe();
+                        if (p_sqe == nullptr)
+                        {
+                            std::this_thread::sleep_for(sc_async_shutdown_poll_interval);
+                        }
+                    }
+
+                    if (p_sqe != nullptr)
+                    {
+                        p_sqe->opcode = IORING_OP_NOP;
+                        p_sqe->user_data = sc_async_wakeup;
+                    }
+                    m_ring->submit();
+                }
+                m_completion_thread.join();
+            }
+
+            // let anything still queued finish before the ring goes away, but don't
+            // wait forever on a read nobody answers: cancel it, and whatever even
+            // that doesn't shift is failed here
+            if ((drain() == false) && (cancel_in_flight() > 0) && (drain() == false))
+            {
+                std::vector<AsyncCompletion> abandoned;
+
+                {
+                    std::lock_guard<std::mutex> guard(m_slot_mutex);
+
+                    for (uint32_t slot = 0; slot < m_completions.size(); slot++)
+                    {
+                        if (m_completions[slot] != nullptr)
+                        {
+                            abandoned.push_back(std::move(m_completions[slot]));
+                            m_completions[slot] = nullptr;
+                            m_free_slots.push_back(slot);
+                            m_in_flight--;
+                        }
+                    }
+                }
+
+                for (auto &completion : abandoned)
+                {
+                    completion(-ECANCELED);
+                }
+            }
+
+            m_ring->shutdown();
+            m_registered_buffers.clear();
+            m_file_handle = constants::sc_invalid_file_handle;
+            m_pport = nullptr;
+        }
+
+        bool AsyncPort::register_buffers(std::vector<data::Buffer> &buffers)
+        {
+            std::vector<struct iovec> vectors;
+
+            m_registered_buffers.clear();
+            for (auto &buffer : buffers)
+            {
+                vectors.push_back({ buffer.data(), buffer.size() });
+                m_registered_buffers.push_back(&buffer);
+            }
+
+            std::lock_guard<std::mutex> guard(m_submit_mutex);
+
+            return m_ring->register_buffers(vectors.data(), vectors.size());
+        }
+
+        bool AsyncPort::write(const uint8_t *p_data, size_t length, AsyncCompletion completion, int64_t offset)
+        {
+            return submit(IORING_OP_WRITE, const_cast<uint8_t *>(p_data), length, 0, offset, completion);
+        }
+
+        bool AsyncPort::read(uint8_t *p_data, size_t length, AsyncCompletion completion, int64_t offset)
+        {
+            return submit(IORING_OP_READ, p_data, length, 0, offset, completion);
+        }
+
+        bool AsyncPort::write_fixed(uint16_t buffer_index, size_t length, AsyncCompletion completion, int64_t offset)
+        {
+            bool success = false;
+
+            if ((buffer_index < m_registered_buffers.size()) && (length <= m_registered_buffers[buffer_index]->size()))
+            {
+                success = submit(IORING_OP_WRITE_FIXED, m_registered_buffers[buffer_index]->data(), length, buffer_index, offset, completion);
+            }
+
+            return success;
+        }
+
+        bool AsyncPort::read_fixed(uint16_t buffer_index, size_t length, AsyncCompletion completion, int64_t offset)
+        {
+            bool success = false;
+
+            if ((buffer_index < m_registered_buffers.size()) && (length <= m_registered_buffers[buffer_index]->size()))
+            {
+                success = submit(IORING_OP_READ_FIXED, m_registered_buffers[buffer_index]->data(), length, buffer_index, offset, completion);
+            }
+
+            return success;
+        }
+
+        std::future<int> AsyncPort::write(const uint8_t *p_data, size_t length, int64_t offset)
+        {
+            return submit(IORING_OP_WRITE, const_cast<uint8_t *>(p_data), length, offset);
+        }
+
+        std::future<int> AsyncPort::read(uint8_t *p_data, size_t length, int64_t offset)
+        {
+            return submit(IORING_OP_READ, p_data, length, offset);
+        }
+
+        size_t AsyncPort::process_completions(bool wait)
+        {
+            size_t completed = 0;
+
+            std::lock_guard<std::mutex> reap_guard(m_reap_mutex);
+
+            if ((wait == true) && (m_ring->peek_cqe() == nullptr))
+            {
+                m_ring->wait(1);
+            }
+
+            struct io_uring_cqe *p_cqe = m_ring->peek_cqe();
+            while (p_cqe != nullptr)
+            {
+                uint64_t slot = p_cqe->user_data;
+                int result = p_cqe->res;
+                AsyncCompletion completion = nullptr;
+
+                m_ring->cqe_seen();
+
+                if (slot != sc_async_wakeup)
+                {
+                    std::lock_guard<std::mutex> guard(m_slot_mutex);
+
+                    completion = std::move(m_completions[slot]);
+                    m_completions[slot] = nullptr;
+                    m_free_slots.push_back((uint32_t)slot);
+                    m_in_flight--;
+                    completed++;
+                }
+
+                if (completion != nullptr)
+                {
+                    completion(result);
+                }
+
+                p_cqe = m_ring->peek_cqe();
+            }
+
+            return completed;
+        }
+
+        int AsyncPort::get_completion_handle() const
+        {
+            return m_ring->get_file_handle();
+        }
+
+        // private parts
+        bool AsyncPort::submit(uint8_t opcode, void *p_data, size_t length, uint16_t buffer_index, int64_t offset, AsyncCompletion completion)
+        {
+            bool success = false;
+            uint32_t slot = 0;
+
+            {
+                std::lock_guard<std::mutex> guard(m_slot_mutex);
+
+                if ((m_ring->is_setup() == true) && (m_free_slots.empty() == false))
+                {
+                    slot = m_free_slots.back();
+                    m_free_slots.pop_back();
+                    m_completions[slot] = completion;
+                    m_in_flight++;
+                    success = true;
+                }
+            }
+
+            if (success == true)
+            {
+                std::lock_guard<std::mutex> guard(m_submit_mutex);
+
+                struct io_uring_sqe *p_sqe = m_ring->get_sqe();
+                if (p_sqe != nullptr)
+                {
+                    p_sqe->opcode = opcode;
+                    p_sqe->fd = m_file_handle;
+                    p_sqe->addr = (uint64_t)p_data;
+                    p_sqe->len = (uint32_t)length;
+                    p_sqe->off = (uint64_t)offset;
+                    p_sqe->buf_index = buffer_index;
+                    p_sqe->user_data = slot;
+
+                    // once published the kernel owns the slot whatever the enter says,
+                    // an entry it didn't take goes along with the next submit
+                    m_ring->submit();
+                }
+                else
+                {
+                    std::lock_guard<std::mutex> slot_guard(m_slot_mutex);
+
+                    // never reached the ring, nothing can complete into the slot
+                    m_completions[slot] = nullptr;
+                    m_free_slots.push_back(slot);
+                    m_in_flight--;
+                    success = false;
+                }
+            }
+
+            return success;
+        }
+
+        std::future<int> AsyncPort::submit(uint8_t opcode, void *p_data, size_t length, int64_t offset)
+        {
+            std::shared_ptr<std::promise<int>> p_promise = std::make_shared<std::promise<int>>();
+            std::future<int> result = p_promise->get_future();
+
+            if (submit(opcode, p_data, length, 0, offset, [p_promise](int bytes) { p_promise->set_value(bytes); }) == false)
+            {
+                p_promise->set_value(-EBUSY);
+            }
+
+            return result;
+        }
+
+        bool AsyncPort::drain()
+        {
+            for (uint32_t poll = 0; (m_in_flight > 0) && (poll < sc_async_shutdown_polls); poll++)
+            {
+                {
+                    std::lock_guard<std::mutex> guard(m_submit_mutex);
+
+                    m_ring->submit();
+                }
+
+                if (process_completions(false) == 0)
+                {
+                    std::this_thread::sleep_for(sc_async_shutdown_poll_interval);
+                }
+            }
+
+            return m_in_flight == 0;
+        }
+
+        size_t AsyncPort::cancel_in_flight()
+        {
+            size_t cancelled = 0;
+            std::lock_guard<std::mutex> guard(m_submit_mutex);
+            std::lock_guard<std::mutex> slot_guard(m_slot_mutex);
+
+            for (uint32_t slot = 0; slot < m_completions.size(); slot++)
+            {
+                struct io_uring_sqe *p_sqe = m_completions[slot] != nullptr ? m_ring->get_sqe() : nullptr;
+
+                if (p_sqe != nullptr)
+                {
+                    // the operation itself completes with -ECANCELED
+                    p_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    p_sqe->addr = slot;
+                    p_sqe->user_data = sc_async_wakeup;
+                    cancelled++;
+                }
+            }
+            m_ring->submit();
+
+            return cancelled;
+        }
+
+        void AsyncPort::run()
+        {
+            while (m_running == true)
+            {
+                process_completions(true);
+            }
+        }
+    }
+}
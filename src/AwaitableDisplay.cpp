@@ -0,0 +1,75 @@
+/**
+ * AwaitableDisplay.cpp
+ *
+ * Mapped framebuffer whose flush a coroutine can co_await on an EventLoop
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include "AwaitableDisplay.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint64_t sc_nanoseconds_per_second = 1000000000ULL;
+
+        AwaitableDisplay::AwaitableDisplay(communication::EventLoopSPtr p_loop, IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution,
+            uint32_t refresh_rate_hz)
+            : m_loop(p_loop)
+            , m_framebuffer(p_display, x_resolution, y_resolution)
+            , m_period_ns(refresh_rate_hz > 0 ? sc_nanoseconds_per_second / refresh_rate_hz : 0)
+        {
+
+        }
+
+        AwaitableDisplay::~AwaitableDisplay()
+        {
+            stop();
+        }
+
+        bool AwaitableDisplay::start()
+        {
+            // no flusher thread, the passes are ours
+            return (m_loop != nullptr) && (m_framebuffer.start(0) == true);
+        }
+
+        void AwaitableDisplay::stop()
+        {
+            // waiters are left to the loop's shutdown, which destroys them
+            m_waiters.clear();
+            m_is_pass_pending = false;
+            m_framebuffer.stop();
+        }
+
+        communication::Task<void> AwaitableDisplay::flush()
+        {
+            if (m_is_pass_pending == false)
+            {
+                m_is_pass_pending = true;
+
+                // whatever is drawn until the frame is due goes out with this pass
+                co_await m_loop->sleep_until(m_last_pass_ns + m_period_ns);
+
+                {
+                    AFM_TRACE_SCOPE("display", "awaitable flush");
+
+                    m_last_pass_ns = communication::EventLoop::get_timestamp();
+                    m_framebuffer.flush();
+                }
+
+                for (std::coroutine_handle<> handle : m_waiters)
+                {
+                    m_loop->schedule(handle);
+                }
+                m_waiters.clear();
+                m_is_pass_pending = false;
+            }
+            else
+            {
+                co_await PassAwaiter { this };
+            }
+        }
+    }
+}
@@ -0,0 +1,193 @@
+/**
+ * AwaitablePort.cpp
+ *
+ * Port reads and writes, and gpio edges, that a coroutine can co_await on an EventLoop
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <cerrno>
+#include <sys/epoll.h>
+
+#include "AwaitablePort.h"
+#include "GPIOChip.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        bool PortAwaiter::await_suspend(std::coroutine_handle<> handle)
+        {
+            bool success = false;
+            AsyncCompletion completion = [this](int result)
+            {
+                m_result = result;
+                m_p_port->m_loop->schedule(m_handle);
+            };
+
+            m_handle = handle;
+
+            if (m_is_write == true)
+            {
+                success = m_p_port->m_async.write(m_p_data, m_length, completion, m_offset);
+            }
+            else
+            {
+                success = m_p_port->m_async.read(m_p_data, m_length, completion, m_offset);
+            }
+
+            // the queue is full or the port isn't set up, carry on without suspending
+            if (success == false)
+            {
+                m_result = -EBUSY;
+            }
+
+            return success;
+        }
+
+        AwaitablePort::AwaitablePort(EventLoopSPtr p_loop)
+            : m_loop(p_loop)
+        {
+
+        }
+
+        AwaitablePort::~AwaitablePort()
+        {
+            shutdown();
+        }
+
+        bool AwaitablePort::initialize(int file_handle, uint32_t queue_depth)
+        {
+            shutdown();
+
+            return (m_async.initialize(file_handle, queue_depth, false) == true) && (attach() == true);
+        }
+
+        bool AwaitablePort::initialize(IPortSPtr p_port, uint32_t queue_depth)
+        {
+            shutdown();
+
+            return (m_async.initialize(p_port, queue_depth, false) == true) && (attach() == true);
+        }
+
+        void AwaitablePort::shutdown()
+        {
+            if (m_completion_handle != constants::sc_invalid_file_handle)
+            {
+                m_loop->remove_source(m_completion_handle);
+                m_completion_handle = constants::sc_invalid_file_handle;
+            }
+
+            // runs whatever is still in flight to completion first
+            m_async.shutdown();
+        }
+
+        PortAwaiter AwaitablePort::write(std::span<const uint8_t> data, int64_t offset)
+        {
+            return PortAwaiter(this, true, const_cast<uint8_t *>(data.data()), data.size(), offset);
+        }
+
+        PortAwaiter AwaitablePort::read(std::span<uint8_t> data, int64_t offset)
+        {
+            return PortAwaiter(this, false, data.data(), data.size(), offset);
+        }
+
+        // private parts
+        bool AwaitablePort::attach()
+        {
+            bool success = false;
+            int completion_handle = m_async.get_completion_handle();
+
+            if (m_loop != nullptr)
+            {
+                success = m_loop->add_source(completion_handle, EPOLLIN, [this]()
+                {
+                    m_async.process_completions(false);
+                });
+            }
+
+            if (success == true)
+            {
+                m_completion_handle = completion_handle;
+            }
+            else
+            {
+                m_async.shutdown();
+            }
+
+            return success;
+        }
+
+        AwaitableGPIO::AwaitableGPIO(EventLoopSPtr p_loop)
+            : m_loop(p_loop)
+        {
+
+        }
+
+        AwaitableGPIO::~AwaitableGPIO()
+        {
+            shutdown();
+        }
+
+        bool AwaitableGPIO::initialize(IPortSPtr p_port)
+        {
+            shutdown();
+
+            m_gpio = std::dynamic_pointer_cast<GPIOChip>(p_port);
+
+            return (m_loop != nullptr) && (m_gpio != nullptr);
+        }
+
+        void AwaitableGPIO::shutdown()
+        {
+            if (m_gpio != nullptr)
+            {
+                m_loop->forget(m_gpio->get_file_handle());
+                if (m_edge != data::GPIOInterruptEdge::NONE)
+                {
+                    m_gpio->enable_edge_events(data::GPIOInterruptEdge::NONE);
+                }
+                m_gpio = nullptr;
+            }
+
+            m_edge = data::GPIOInterruptEdge::NONE;
+            m_event_count = 0;
+            m_next_event = 0;
+        }
+
+        Task<data::GPIOEvent> AwaitableGPIO::wait_edge(data::GPIOInterruptEdge edge)
+        {
+            data::GPIOEvent event = { 0, data::GPIOInterruptEdge::NONE, 0 };
+            bool is_waiting = (m_gpio != nullptr) && (edge != data::GPIOInterruptEdge::NONE);
+
+            if ((is_waiting == true) && (edge != m_edge))
+            {
+                m_event_count = 0;
+                m_next_event = 0;
+                m_edge = m_gpio->enable_edge_events(edge) == true ? edge : data::GPIOInterruptEdge::NONE;
+                is_waiting = m_edge == edge;
+            }
+
+            while ((is_waiting == true) && (m_next_event == m_event_count))
+            {
+                m_next_event = 0;
+                m_event_count = m_gpio->read_edge_events(m_events, sc_awaitable_gpio_events);
+
+                if (m_event_count == 0)
+                {
+                    uint32_t ready = co_await m_loop->readable(m_gpio->get_file_handle());
+
+                    // someone else is already waiting on the line, or it went away
+                    is_waiting = (ready & EPOLLIN) != 0;
+                }
+            }
+
+            if (m_next_event < m_event_count)
+            {
+                event = m_events[m_next_event++];
+            }
+
+            co_return event;
+        }
+    }
+}
@@ -0,0 +1,259 @@
+/**
+ * BMPDecoder.cpp
+ *
+ * Streaming decoder for Windows bitmaps
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <sys/param.h>
+
+#include "BMPDecoder.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const size_t sc_bmp_file_header_size = 14;
+        const size_t sc_bmp_core_header_size = 12;
+        const size_t sc_bmp_info_header_size = 40;
+        const size_t sc_bmp_v2_header_size = 52;            // first one with the masks inside
+        const size_t sc_bmp_max_header_size = 124;          // BITMAPV5HEADER
+        const size_t sc_bmp_mask_size = 12;
+        const uint32_t sc_bmp_rgb = 0;
+        const uint32_t sc_bmp_bitfields = 3;
+        const uint32_t sc_bmp_alpha_bitfields = 6;
+
+        BMPDecoder::BMPDecoder(uint8_t strip_rows) :
+            ImageDecoder(strip_rows)
+        {
+            m_palette.reserve(sc_bmp_max_palette);
+        }
+
+        BMPDecoder::~BMPDecoder()
+        {
+
+        }
+
+        // internal parts
+        bool BMPDecoder::on_read_header(std::istream &input)
+        {
+            bool success = false;
+            uint8_t file_header[sc_bmp_file_header_size];
+            uint8_t header[sc_bmp_max_header_size] = {0};
+
+            if ((read_bytes(input, file_header, sizeof(file_header)) == true) && (file_header[0] == 'B') && (file_header[1] == 'M') &&
+                (read_bytes(input, header, sizeof(uint32_t)) == true))
+            {
+                uint32_t pixel_offset = get_le32(&file_header[10]);
+                uint32_t header_size = get_le32(header);
+                size_t consumed = sizeof(file_header) + header_size;
+                size_t palette_entry_size = 4;
+                int32_t width = 0;
+                int32_t height = 0;
+                uint32_t compression = sc_bmp_rgb;
+                uint32_t colors_used = 0;
+                bool is_valid = false;
+
+                if ((header_size == sc_bmp_core_header_size) &&
+                    (read_bytes(input, &header[4], sc_bmp_core_header_size - 4) == true))
+                {
+                    width = get_le16(&header[4]);
+                    height = (int16_t)get_le16(&header[6]);
+                    m_bits_per_pixel = get_le16(&header[10]);
+                    palette_entry_size = 3;
+                    is_valid = true;
+                }
+                else if ((header_size >= sc_bmp_info_header_size) && (header_size <= sc_bmp_max_header_size) &&
+                    (read_bytes(input, &header[4], header_size - 4) == true))
+                {
+                    width = (int32_t)get_le32(&header[4]);
+                    height = (int32_t)get_le32(&header[8]);
+                    m_bits_per_pixel = get_le16(&header[14]);
+                    compression = get_le32(&header[16]);
+                    colors_used = get_le32(&header[32]);
+                    is_valid = true;
+                }
+
+                // 555 and BGR(X) unless the file says otherwise
+                if (m_bits_per_pixel == 16)
+                {
+                    set_masks(0x7C00, 0x03E0, 0x001F);
+                }
+                else
+                {
+                    set_masks(0x00FF0000, 0x0000FF00, 0x000000FF);
+                }
+
+                if ((is_valid == true) && ((compression == sc_bmp_bitfields) || (compression == sc_bmp_alpha_bitfields)))
+                {
+                    uint8_t masks[sc_bmp_mask_size + sizeof(uint32_t)];
+                    size_t masks_size = (compression == sc_bmp_alpha_bitfields) ? sizeof(masks) : sc_bmp_mask_size;
+                    const uint8_t *p_masks = &header[sc_bmp_info_header_size];
+
+                    // a plain info header has them after it, later versions inside it
+                    if (header_size < sc_bmp_v2_header_size)
+                    {
+                        is_valid = read_bytes(input, masks, masks_size);
+                        consumed += masks_size;
+                        p_masks = masks;
+                    }
+
+                    is_valid = is_valid && ((m_bits_per_pixel == 16) || (m_bits_per_pixel == 32));
+                    set_masks(get_le32(&p_masks[0]), get_le32(&p_masks[4]), get_le32(&p_masks[8]));
+                }
+                else if (compression != sc_bmp_rgb)
+                {
+                    is_valid = false;
+                }
+
+                m_palette.clear();
+                if ((is_valid == true) && (m_bits_per_pixel <= 8))
+                {
+                    size_t count = (colors_used > 0) ? MIN(colors_used, sc_bmp_max_palette) : ((size_t)1 << m_bits_per_pixel);
+
+                    for (size_t entry = 0; (entry < count) && (is_valid == true); entry++)
+                    {
+                        uint8_t bgr[4];
+
+                        is_valid = read_bytes(input, bgr, palette_entry_size);
+                        m_palette.push_back(data::Color(bgr[2], bgr[1], bgr[0]));
+                    }
+                    consumed += count * palette_entry_size;
+
+                    // a colors used past 256 still has all its entries in the file
+                    if ((colors_used > count) && (is_valid == true))
+                    {
+                        is_valid = skip_bytes(input, (colors_used - count) * palette_entry_size);
+                        consumed += (colors_used - count) * palette_entry_size;
+                    }
+                }
+
+                if ((is_valid == true) && (width > 0) && (height != 0) && (pixel_offset >= consumed) &&
+                    ((m_bits_per_pixel == 1) || (m_bits_per_pixel == 4) || (m_bits_per_pixel == 8) ||
+                     (m_bits_per_pixel == 16) || (m_bits_per_pixel == 24) || (m_bits_per_pixel == 32)) &&
+                    (set_size((uint32_t)width, (uint32_t)((height < 0) ? -(int64_t)height : height), height > 0) == true))
+                {
+                    // rows are padded to 4 bytes
+                    m_stride = ((((uint32_t)width * m_bits_per_pixel) + 31) / 32) * 4;
+                    m_row.resize(m_stride);
+                    success = skip_bytes(input, pixel_offset - consumed);
+                }
+            }
+
+            return success;
+        }
+
+        bool BMPDecoder::on_decode(std::istream &input)
+        {
+            bool success = true;
+
+            for (uint32_t row = 0; (row < get_height()) && (success == true); row++)
+            {
+                success = read_bytes(input, m_row.data(), m_stride);
+                if (success == true)
+                {
+                    data::Color *p_row = begin_row();
+
+                    if (p_row != nullptr)
+                    {
+                        convert_row(p_row);
+                    }
+                    end_row();
+                }
+            }
+
+            return success;
+        }
+
+        // private parts
+        void BMPDecoder::set_masks(uint32_t red, uint32_t green, uint32_t blue)
+        {
+            m_red = make_channel(red);
+            m_green = make_channel(green);
+            m_blue = make_channel(blue);
+        }
+
+        BMPDecoder::Channel BMPDecoder::make_channel(uint32_t mask)
+        {
+            Channel channel = { mask, 0, 0 };
+
+            if (mask != 0)
+            {
+                channel.shift = (uint8_t)__builtin_ctz(mask);
+                channel.maximum = mask >> channel.shift;
+            }
+
+            return channel;
+        }
+
+        uint8_t BMPDecoder::get_channel(const Channel &channel, uint32_t pixel)
+        {
+            uint32_t value = 0;
+
+            if (channel.maximum > 0)
+            {
+                value = (pixel & channel.mask) >> channel.shift;
+                value = (channel.maximum == UINT8_MAX) ? value : ((value * UINT8_MAX) + (channel.maximum / 2)) / channel.maximum;
+            }
+
+            return (uint8_t)MIN(value, UINT8_MAX);
+        }
+
+        void BMPDecoder::convert_row(data::Color *p_row) const
+        {
+            const uint8_t *p_data = m_row.data();
+            const data::Color black = constants::BLACK;
+            uint32_t width = get_visible_width();
+
+            switch (m_bits_per_pixel)
+            {
+                case 1:
+                case 4:
+                case 8:
+                {
+                    uint8_t pixels_per_byte = 8 / m_bits_per_pixel;
+                    uint8_t mask = (uint8_t)((1 << m_bits_per_pixel) - 1);
+
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        // leftmost pixel in the high bits
+                        uint8_t shift = (uint8_t)((pixels_per_byte - 1 - (x % pixels_per_byte)) * m_bits_per_pixel);
+                        uint8_t index = (p_data[x / pixels_per_byte] >> shift) & mask;
+
+                        p_row[x] = (index < m_palette.size()) ? m_palette[index] : black;
+                    }
+                    break;
+                }
+
+                case 16:
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        uint32_t pixel = get_le16(&p_data[x * 2]);
+
+                        p_row[x] = data::Color(get_channel(m_red, pixel), get_channel(m_green, pixel), get_channel(m_blue, pixel));
+                    }
+                    break;
+
+                case 24:
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        p_row[x] = data::Color(p_data[(x * 3) + 2], p_data[(x * 3) + 1], p_data[x * 3]);
+                    }
+                    break;
+
+                case 32:
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        uint32_t pixel = get_le32(&p_data[x * 4]);
+
+                        p_row[x] = data::Color(get_channel(m_red, pixel), get_channel(m_green, pixel), get_channel(m_blue, pixel));
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
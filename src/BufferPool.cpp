@@ -0,0 +1,154 @@
+/**
+ * BufferPool.cpp
+ *
+ * Transfer buffers recycled between the port and display layers so steady
+ * state traffic doesn't touch the heap
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+
+#include "BufferPool.h"
+
+namespace afm
+{
+    namespace data
+    {
+        PooledBuffer::PooledBuffer()
+        {
+
+        }
+
+        PooledBuffer::PooledBuffer(BufferPool *p_pool, std::unique_ptr<Buffer> p_buffer)
+            : m_p_pool(p_pool)
+            , m_p_buffer(std::move(p_buffer))
+        {
+
+        }
+
+        PooledBuffer::PooledBuffer(PooledBuffer &&other)
+            : m_p_pool(other.m_p_pool)
+            , m_p_buffer(std::move(other.m_p_buffer))
+        {
+            other.m_p_pool = nullptr;
+        }
+
+        PooledBuffer::~PooledBuffer()
+        {
+            release();
+        }
+
+        PooledBuffer &PooledBuffer::operator=(PooledBuffer &&other)
+        {
+            if (this != &other)
+            {
+                release();
+                m_p_pool = other.m_p_pool;
+                m_p_buffer = std::move(other.m_p_buffer);
+                other.m_p_pool = nullptr;
+            }
+
+            return *this;
+        }
+
+        void PooledBuffer::release()
+        {
+            if ((m_p_pool != nullptr) && (m_p_buffer != nullptr))
+            {
+                m_p_pool->release(std::move(m_p_buffer));
+            }
+
+            m_p_pool = nullptr;
+            m_p_buffer = nullptr;
+        }
+
+        BufferPool::BufferPool(size_t buffer_size, size_t count)
+            : m_buffer_size(buffer_size)
+            , m_total(count)
+        {
+            m_free.reserve(count);
+            for (size_t index = 0; index < count; index++)
+            {
+                std::unique_ptr<Buffer> p_buffer(new Buffer());
+
+                p_buffer->reserve(buffer_size);
+                m_free.push_back(std::move(p_buffer));
+            }
+        }
+
+        BufferPool::~BufferPool()
+        {
+
+        }
+
+        BufferPoolSPtr BufferPool::getInstance()
+        {
+            static BufferPoolSPtr p_instance = std::make_shared<BufferPool>();
+
+            return p_instance;
+        }
+
+        PooledBuffer BufferPool::acquire(size_t length)
+        {
+            std::unique_ptr<Buffer> p_buffer = nullptr;
+
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                if (m_free.empty() == false)
+                {
+                    p_buffer = std::move(m_free.back());
+                    m_free.pop_back();
+                }
+                else
+                {
+                    // room to take it back later without growing then
+                    m_misses++;
+                    m_total++;
+                    m_free.reserve(m_total);
+                }
+            }
+
+            if (p_buffer == nullptr)
+            {
+                p_buffer.reset(new Buffer());
+                p_buffer->reserve(std::max(m_buffer_size, length));
+            }
+
+            // inside the capacity this is just a size change
+            p_buffer->resize(length);
+
+            return PooledBuffer(this, std::move(p_buffer));
+        }
+
+        size_t BufferPool::get_available()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            return m_free.size();
+        }
+
+        size_t BufferPool::get_total()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            return m_total;
+        }
+
+        uint64_t BufferPool::get_misses()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            return m_misses;
+        }
+
+        // private parts
+        void BufferPool::release(std::unique_ptr<Buffer> p_buffer)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            m_free.push_back(std::move(p_buffer));
+        }
+    }
+}
@@ -0,0 +1,249 @@
+/**
+ * Compositor.cpp
+ *
+ * Stacks retained surfaces and sends only what changed to a display
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <sys/param.h>
+
+#include "Compositor.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        // source * alpha + destination * (255 - alpha), divided by 255 with rounding
+        static inline uint8_t blend_channel(uint8_t source, uint8_t destination, uint8_t alpha)
+        {
+            uint32_t sum = (uint32_t)source * alpha + (uint32_t)destination * (sc_alpha_opaque - alpha) + 128;
+
+            return (uint8_t)((sum + (sum >> 8)) >> 8);
+        }
+
+        Compositor::Compositor(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution, const data::Color &background) :
+            m_display(p_display),
+            m_width(x_resolution),
+            m_height(y_resolution),
+            m_background(background)
+        {
+            m_output.assign((size_t)x_resolution * y_resolution, background);
+            invalidate();
+        }
+
+        Compositor::~Compositor()
+        {
+        }
+
+        SurfaceSPtr Compositor::add_layer(const data::Coordinate_8t &position, uint16_t width, uint16_t height, bool is_opaque)
+        {
+            SurfaceSPtr p_surface = std::make_shared<Surface>(width, height, is_opaque);
+
+            m_layers.push_back(Layer{ p_surface, position.x, position.y, true });
+            damage_layer(m_layers.back());
+
+            return p_surface;
+        }
+
+        void Compositor::remove_layer(const SurfaceSPtr &p_surface)
+        {
+            Layer *p_layer = find(p_surface);
+
+            if (p_layer != nullptr)
+            {
+                damage_layer(*p_layer);
+                m_layers.erase(m_layers.begin() + (p_layer - m_layers.data()));
+            }
+        }
+
+        void Compositor::move_layer(const SurfaceSPtr &p_surface, const data::Coordinate_8t &position)
+        {
+            Layer *p_layer = find(p_surface);
+
+            if ((p_layer != nullptr) && ((p_layer->x != position.x) || (p_layer->y != position.y)))
+            {
+                // where it was and where it is now
+                damage_layer(*p_layer);
+                p_layer->x = position.x;
+                p_layer->y = position.y;
+                damage_layer(*p_layer);
+            }
+        }
+
+        void Compositor::set_visible(const SurfaceSPtr &p_surface, bool is_visible)
+        {
+            Layer *p_layer = find(p_surface);
+
+            if ((p_layer != nullptr) && (p_layer->is_visible != is_visible))
+            {
+                p_layer->is_visible = is_visible;
+                damage_layer(*p_layer);
+            }
+        }
+
+        void Compositor::compose()
+        {
+            AFM_TRACE_SCOPE("compositor", "compose");
+            const DamageRectangle screen = { 1, 1, m_width, m_height };
+
+            m_statistics = CompositorStatistics();
+
+            // layer damage is in surface coordinates, bring it onto the screen
+            for (Layer &layer : m_layers)
+            {
+                DamageRegion &damage = layer.p_surface->get_damage();
+
+                if (layer.is_visible == true)
+                {
+                    for (const DamageRectangle &rectangle : damage.get_rectangles())
+                    {
+                        DamageRectangle moved = { (uint16_t)(rectangle.x1 + layer.x - 1), (uint16_t)(rectangle.y1 + layer.y - 1),
+                            (uint16_t)(rectangle.x2 + layer.x - 1), (uint16_t)(rectangle.y2 + layer.y - 1) };
+                        DamageRectangle clipped;
+
+                        if (DamageRegion::intersect(moved, screen, clipped) == true)
+                        {
+                            m_damage.add(clipped);
+                        }
+                    }
+                }
+                damage.clear();
+            }
+
+            if (m_display != nullptr)
+            {
+                for (const DamageRectangle &rectangle : m_damage.get_rectangles())
+                {
+                    compose_rectangle(rectangle);
+                }
+            }
+            m_damage.clear();
+        }
+
+        void Compositor::invalidate()
+        {
+            if ((m_width > 0) && (m_height > 0))
+            {
+                m_damage.add(DamageRectangle{ 1, 1, m_width, m_height });
+            }
+        }
+
+        void Compositor::copy_row(data::Color *p_destination, const data::Color *p_source, size_t count)
+        {
+            std::copy(p_source, p_source + count, p_destination);
+        }
+
+        void Compositor::blend_row(data::Color *p_destination, const data::Color *p_source, const uint8_t *p_alpha, size_t count)
+        {
+            // no branches on alpha so the loop vectorizes, 0 and 255 come out exact
+            for (size_t index = 0; index < count; index++)
+            {
+                p_destination[index].red = blend_channel(p_source[index].red, p_destination[index].red, p_alpha[index]);
+                p_destination[index].green = blend_channel(p_source[index].green, p_destination[index].green, p_alpha[index]);
+                p_destination[index].blue = blend_channel(p_source[index].blue, p_destination[index].blue, p_alpha[index]);
+            }
+        }
+
+        // private parts
+        Compositor::Layer *Compositor::find(const SurfaceSPtr &p_surface)
+        {
+            Layer *p_layer = nullptr;
+
+            for (Layer &layer : m_layers)
+            {
+                if (layer.p_surface == p_surface)
+                {
+                    p_layer = &layer;
+                    break;
+                }
+            }
+
+            return p_layer;
+        }
+
+        void Compositor::damage_layer(const Layer &layer)
+        {
+            const DamageRectangle screen = { 1, 1, m_width, m_height };
+            DamageRectangle clipped;
+
+            if ((layer.p_surface->get_width() > 0) && (layer.p_surface->get_height() > 0) &&
+                (DamageRegion::intersect(get_bounds(layer), screen, clipped) == true))
+            {
+                m_damage.add(clipped);
+            }
+        }
+
+        DamageRectangle Compositor::get_bounds(const Layer &layer) const
+        {
+            return DamageRectangle{ layer.x, layer.y, (uint16_t)(layer.x + layer.p_surface->get_width() - 1),
+                (uint16_t)(layer.y + layer.p_surface->get_height() - 1) };
+        }
+
+        void Compositor::compose_rectangle(const DamageRectangle &rectangle)
+        {
+            uint16_t width = rectangle.x2 - rectangle.x1 + 1;
+            uint16_t height = rectangle.y2 - rectangle.y1 + 1;
+            size_t first_layer = 0;
+            bool is_covered = false;
+
+            // nothing under an opaque layer covering the whole rectangle can show
+            for (size_t index = m_layers.size(); index > 0; index--)
+            {
+                const Layer &layer = m_layers[index - 1];
+                DamageRectangle overlap;
+
+                if ((layer.is_visible == true) && (layer.p_surface->is_opaque() == true) &&
+                    (DamageRegion::intersect(get_bounds(layer), rectangle, overlap) == true) &&
+                    (DamageRegion::get_area(overlap) == DamageRegion::get_area(rectangle)))
+                {
+                    first_layer = index - 1;
+                    is_covered = true;
+                    break;
+                }
+            }
+
+            for (uint16_t y = rectangle.y1; y <= rectangle.y2; y++)
+            {
+                data::Color *p_row = &m_output[(size_t)(y - rectangle.y1) * width];
+
+                if (is_covered == false)
+                {
+                    std::fill(p_row, p_row + width, m_background);
+                }
+
+                for (size_t index = first_layer; index < m_layers.size(); index++)
+                {
+                    const Layer &layer = m_layers[index];
+                    DamageRectangle overlap;
+
+                    if ((layer.is_visible == true) &&
+                        (DamageRegion::intersect(get_bounds(layer), DamageRectangle{ rectangle.x1, y, rectangle.x2, y }, overlap) == true))
+                    {
+                        const Surface &surface = *layer.p_surface;
+                        uint16_t surface_y = y - layer.y + 1;
+                        size_t offset = overlap.x1 - layer.x;
+                        size_t count = overlap.x2 - overlap.x1 + 1;
+
+                        if (surface.is_opaque() == true)
+                        {
+                            copy_row(p_row + (overlap.x1 - rectangle.x1), surface.get_row(surface_y) + offset, count);
+                        }
+                        else
+                        {
+                            blend_row(p_row + (overlap.x1 - rectangle.x1), surface.get_row(surface_y) + offset,
+                                surface.get_alpha_row(surface_y) + offset, count);
+                        }
+                    }
+                }
+            }
+
+            m_display->draw_image(data::Coordinate_8t((uint8_t)rectangle.x1, (uint8_t)rectangle.y1), (uint8_t)width, (uint8_t)height,
+                m_output.data());
+            m_statistics.windows++;
+            m_statistics.pixels += (uint32_t)width * height;
+        }
+    }
+}
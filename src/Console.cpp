@@ -0,0 +1,651 @@
+/**
+ * Console.cpp
+ *
+ * Character cell console on top of a display, with a small ANSI subset
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <sys/param.h>
+
+#include "Console.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const size_t sc_max_console_printf_length = 256;
+        const uint16_t sc_console_max_parameter = 9999;
+        const uint8_t sc_console_default_color = 0xFF;
+        const uint8_t sc_console_bright = 8;
+        const char sc_console_escape = 0x1B;
+        const char sc_console_blank = ' ';
+
+        // the usual VGA text mode colors, 8 normal then 8 bright
+        const data::Color sc_console_palette[] =
+        {
+            data::Color(0x00, 0x00, 0x00), data::Color(0xAA, 0x00, 0x00),
+            data::Color(0x00, 0xAA, 0x00), data::Color(0xAA, 0x55, 0x00),
+            data::Color(0x00, 0x00, 0xAA), data::Color(0xAA, 0x00, 0xAA),
+            data::Color(0x00, 0xAA, 0xAA), data::Color(0xAA, 0xAA, 0xAA),
+            data::Color(0x55, 0x55, 0x55), data::Color(0xFF, 0x55, 0x55),
+            data::Color(0x55, 0xFF, 0x55), data::Color(0xFF, 0xFF, 0x55),
+            data::Color(0x55, 0x55, 0xFF), data::Color(0xFF, 0x55, 0xFF),
+            data::Color(0x55, 0xFF, 0xFF), data::Color(0xFF, 0xFF, 0xFF)
+        };
+
+        Console::Console(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution,
+            const data::Color &foreground, const data::Color &background) :
+            m_display(p_display),
+            m_default_foreground(foreground),
+            m_default_background(background),
+            m_foreground(foreground),
+            m_background(background),
+            m_foreground_index(sc_console_default_color),
+            m_background_index(sc_console_default_color)
+        {
+            m_columns = (uint8_t)MIN(x_resolution / m_font.get_width(), UINT8_MAX);
+            m_rows = (uint8_t)MIN(y_resolution / m_font.get_height(), UINT8_MAX);
+            m_bottom = m_rows > 0 ? m_rows - 1 : 0;
+
+            m_cells.assign((size_t)m_columns * m_rows, ConsoleCell{ sc_console_blank, foreground, background });
+            m_shown = m_cells;
+            m_is_row_dirty.assign(m_rows, 1);
+            m_run.assign(m_columns + 1, '\0');
+            std::fill(m_parameters, m_parameters + sc_console_max_parameters, 0);
+        }
+
+        Console::~Console()
+        {
+        }
+
+        void Console::write(const char *p_text, size_t length)
+        {
+            if ((p_text != nullptr) && (m_columns > 0) && (m_rows > 0))
+            {
+                for (size_t index = 0; index < length; index++)
+                {
+                    char character = p_text[index];
+
+                    switch (m_state)
+                    {
+                        case CONSOLE_TEXT:
+                            if (character == sc_console_escape)
+                            {
+                                m_state = CONSOLE_ESCAPE;
+                            }
+                            else if (character == '\n')
+                            {
+                                // a log wants a new line, not the bare line feed a tty would do
+                                m_column = 0;
+                                m_is_wrap_pending = false;
+                                line_feed();
+                            }
+                            else if (character == '\r')
+                            {
+                                m_column = 0;
+                                m_is_wrap_pending = false;
+                            }
+                            else if (character == '\b')
+                            {
+                                move_to((int)m_column - 1, m_row);
+                            }
+                            else if (character == '\t')
+                            {
+                                move_to(((m_column / sc_console_tab_width) + 1) * sc_console_tab_width, m_row);
+                            }
+                            else if (((uint8_t)character >= ' ') && (character != 0x7F))
+                            {
+                                put(character);
+                            }
+                            break;
+
+                        case CONSOLE_ESCAPE:
+                            if (character == '[')
+                            {
+                                m_parameter_count = 0;
+                                std::fill(m_parameters, m_parameters + sc_console_max_parameters, 0);
+                                m_state = CONSOLE_CSI;
+                            }
+                            else
+                            {
+                                execute_escape(character);
+                                m_state = CONSOLE_TEXT;
+                            }
+                            break;
+
+                        case CONSOLE_CSI:
+                            if ((character >= '0') && (character <= '9'))
+                            {
+                                uint16_t &parameter = m_parameters[MAX(m_parameter_count, 1) - 1];
+
+                                m_parameter_count = MAX(m_parameter_count, 1);
+                                parameter = (uint16_t)MIN(parameter * 10 + (character - '0'), sc_console_max_parameter);
+                            }
+                            else if (character == ';')
+                            {
+                                // an empty first parameter still takes a slot
+                                m_parameter_count = MAX(m_parameter_count, 1);
+                                if (m_parameter_count < sc_console_max_parameters)
+                                {
+                                    m_parameter_count++;
+                                }
+                            }
+                            else if ((character >= 0x40) && (character <= 0x7E))
+                            {
+                                execute_csi(character);
+                                m_state = CONSOLE_TEXT;
+                            }
+                            // private markers and intermediates are ignored
+                            break;
+
+                        default:
+                            m_state = CONSOLE_TEXT;
+                            break;
+                    }
+                }
+            }
+        }
+
+        void Console::write(const char *p_text)
+        {
+            if (p_text != nullptr)
+            {
+                write(p_text, strlen(p_text));
+            }
+        }
+
+        void Console::printf(const char * __format, ...)
+        {
+            char buffer[sc_max_console_printf_length];
+            va_list arguments;
+            int length = 0;
+
+            va_start(arguments, __format);
+            length = vsnprintf(buffer, sizeof(buffer), __format, arguments);
+            va_end(arguments);
+
+            if (length > 0)
+            {
+                write(buffer, MIN((size_t)length, sizeof(buffer) - 1));
+            }
+        }
+
+        void Console::refresh()
+        {
+            AFM_TRACE_SCOPE("console", "refresh");
+            if (m_display != nullptr)
+            {
+                // nothing known about the screen, start from a clear one rather than sending every blank
+                if (m_is_shown_known == false)
+                {
+                    m_display->clear_screen(m_default_background);
+                    std::fill(m_shown.begin(), m_shown.end(), ConsoleCell{ sc_console_blank, m_default_foreground, m_default_background });
+                    std::fill(m_is_row_dirty.begin(), m_is_row_dirty.end(), 1);
+                    m_is_shown_known = true;
+                }
+
+                for (uint8_t row = 0; row < m_rows; row++)
+                {
+                    if (m_is_row_dirty[row] != 0)
+                    {
+                        refresh_row(row);
+                        m_is_row_dirty[row] = 0;
+                    }
+                }
+            }
+        }
+
+        void Console::invalidate()
+        {
+            m_is_shown_known = false;
+        }
+
+        const ConsoleCell &Console::get_cell(uint8_t column, uint8_t row) const
+        {
+            return m_cells[(size_t)row * m_columns + column];
+        }
+
+        data::Coordinate_8t Console::get_cursor() const
+        {
+            return data::Coordinate_8t(m_column + 1, m_row + 1);
+        }
+
+        // private parts
+        void Console::put(char glyph)
+        {
+            if (m_is_wrap_pending == true)
+            {
+                m_column = 0;
+                m_is_wrap_pending = false;
+                line_feed();
+            }
+
+            cell(m_column, m_row) = ConsoleCell{ glyph, m_foreground, m_background };
+            m_is_row_dirty[m_row] = 1;
+
+            // like a vt100 the cursor sits on the last column until the next glyph
+            if (m_column == (m_columns - 1))
+            {
+                m_is_wrap_pending = true;
+            }
+            else
+            {
+                m_column++;
+            }
+        }
+
+        void Console::execute_escape(char final)
+        {
+            switch (final)
+            {
+                case '7':
+                    m_saved_column = m_column;
+                    m_saved_row = m_row;
+                    break;
+
+                case '8':
+                    move_to(m_saved_column, m_saved_row);
+                    break;
+
+                case 'D':
+                    line_feed();
+                    break;
+
+                case 'M':
+                    reverse_line_feed();
+                    break;
+
+                case 'E':
+                    m_column = 0;
+                    m_is_wrap_pending = false;
+                    line_feed();
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        void Console::execute_csi(char final)
+        {
+            uint16_t count = get_parameter(0, 1);
+            // moves stop at the scroll region when they start inside it
+            int top = m_row >= m_top ? m_top : 0;
+            int bottom = m_row <= m_bottom ? m_bottom : m_rows - 1;
+
+            switch (final)
+            {
+                case 'A':
+                    move_to(m_column, MAX((int)m_row - count, top));
+                    break;
+
+                case 'B':
+                    move_to(m_column, MIN((int)m_row + count, bottom));
+                    break;
+
+                case 'C':
+                    move_to((int)m_column + count, m_row);
+                    break;
+
+                case 'D':
+                    move_to((int)m_column - count, m_row);
+                    break;
+
+                case 'E':
+                    move_to(0, MIN((int)m_row + count, bottom));
+                    break;
+
+                case 'F':
+                    move_to(0, MAX((int)m_row - count, top));
+                    break;
+
+                case 'G':
+                    move_to((int)count - 1, m_row);
+                    break;
+
+                case 'd':
+                    move_to(m_column, (int)count - 1);
+                    break;
+
+                case 'H':
+                case 'f':
+                    move_to((int)get_parameter(1, 1) - 1, (int)get_parameter(0, 1) - 1);
+                    break;
+
+                case 'J':
+                    switch (get_parameter(0, 0))
+                    {
+                        case 0:
+                            erase(m_row, m_column, m_columns - 1);
+                            for (uint8_t row = m_row + 1; row < m_rows; row++)
+                            {
+                                erase(row, 0, m_columns - 1);
+                            }
+                            break;
+
+                        case 1:
+                            for (uint8_t row = 0; row < m_row; row++)
+                            {
+                                erase(row, 0, m_columns - 1);
+                            }
+                            erase(m_row, 0, m_column);
+                            break;
+
+                        case 2:
+                            for (uint8_t row = 0; row < m_rows; row++)
+                            {
+                                erase(row, 0, m_columns - 1);
+                            }
+                            break;
+
+                        default:
+                            break;
+                    }
+                    break;
+
+                case 'K':
+                    switch (get_parameter(0, 0))
+                    {
+                        case 0:
+                            erase(m_row, m_column, m_columns - 1);
+                            break;
+
+                        case 1:
+                            erase(m_row, 0, m_column);
+                            break;
+
+                        case 2:
+                            erase(m_row, 0, m_columns - 1);
+                            break;
+
+                        default:
+                            break;
+                    }
+                    break;
+
+                case 'm':
+                    select_graphic_rendition();
+                    break;
+
+                case 'r':
+                {
+                    uint16_t first = get_parameter(0, 1);
+                    uint16_t last = get_parameter(1, m_rows);
+
+                    // a region needs at least two lines, anything else is ignored
+                    if ((first < last) && (last <= m_rows))
+                    {
+                        m_top = (uint8_t)(first - 1);
+                        m_bottom = (uint8_t)(last - 1);
+                        move_to(0, 0);
+                    }
+                    break;
+                }
+
+                case 'S':
+                    scroll_up(m_top, m_bottom, (uint8_t)MIN(count, m_rows));
+                    break;
+
+                case 'T':
+                    scroll_down(m_top, m_bottom, (uint8_t)MIN(count, m_rows));
+                    break;
+
+                case 's':
+                    m_saved_column = m_column;
+                    m_saved_row = m_row;
+                    break;
+
+                case 'u':
+                    move_to(m_saved_column, m_saved_row);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        void Console::select_graphic_rendition()
+        {
+            // a bare ESC [ m is a reset
+            uint8_t count = MAX(m_parameter_count, 1);
+
+            for (uint8_t index = 0; index < count; index++)
+            {
+                uint16_t parameter = m_parameters[index];
+
+                if (parameter == 0)
+                {
+                    m_foreground_index = sc_console_default_color;
+                    m_background_index = sc_console_default_color;
+                    m_is_bold = false;
+                    m_is_inverse = false;
+                }
+                else if (parameter == 1)
+                {
+                    m_is_bold = true;
+                }
+                else if (parameter == 22)
+                {
+                    m_is_bold = false;
+                }
+                else if (parameter == 7)
+                {
+                    m_is_inverse = true;
+                }
+                else if (parameter == 27)
+                {
+                    m_is_inverse = false;
+                }
+                else if ((parameter >= 30) && (parameter <= 37))
+                {
+                    m_foreground_index = (uint8_t)(parameter - 30);
+                }
+                else if (parameter == 39)
+                {
+                    m_foreground_index = sc_console_default_color;
+                }
+                else if ((parameter >= 40) && (parameter <= 47))
+                {
+                    m_background_index = (uint8_t)(parameter - 40);
+                }
+                else if (parameter == 49)
+                {
+                    m_background_index = sc_console_default_color;
+                }
+                else if ((parameter >= 90) && (parameter <= 97))
+                {
+                    m_foreground_index = (uint8_t)(parameter - 90 + sc_console_bright);
+                }
+                else if ((parameter >= 100) && (parameter <= 107))
+                {
+                    m_background_index = (uint8_t)(parameter - 100 + sc_console_bright);
+                }
+            }
+
+            update_colors();
+        }
+
+        void Console::update_colors()
+        {
+            // bold brightens the 8 normal colors, not the default
+            if (m_foreground_index == sc_console_default_color)
+            {
+                m_foreground = m_default_foreground;
+            }
+            else
+            {
+                m_foreground = sc_console_palette[m_foreground_index | ((m_is_bold == true) ? sc_console_bright : 0)];
+            }
+
+            if (m_background_index == sc_console_default_color)
+            {
+                m_background = m_default_background;
+            }
+            else
+            {
+                m_background = sc_console_palette[m_background_index];
+            }
+
+            if (m_is_inverse == true)
+            {
+                std::swap(m_foreground, m_background);
+            }
+        }
+
+        void Console::line_feed()
+        {
+            if (m_row == m_bottom)
+            {
+                scroll_up(m_top, m_bottom, 1);
+            }
+            else if (m_row < (m_rows - 1))
+            {
+                m_row++;
+            }
+        }
+
+        void Console::reverse_line_feed()
+        {
+            if (m_row == m_top)
+            {
+                scroll_down(m_top, m_bottom, 1);
+            }
+            else if (m_row > 0)
+            {
+                m_row--;
+            }
+        }
+
+        void Console::scroll_up(uint8_t top, uint8_t bottom, uint8_t count)
+        {
+            uint8_t lines = bottom - top + 1;
+
+            count = MIN(count, lines);
+            std::copy(m_cells.begin() + (size_t)(top + count) * m_columns, m_cells.begin() + (size_t)(bottom + 1) * m_columns,
+                m_cells.begin() + (size_t)top * m_columns);
+            for (uint8_t row = bottom - count + 1; row <= bottom; row++)
+            {
+                erase(row, 0, m_columns - 1);
+            }
+            std::fill(m_is_row_dirty.begin() + top, m_is_row_dirty.begin() + bottom + 1, 1);
+        }
+
+        void Console::scroll_down(uint8_t top, uint8_t bottom, uint8_t count)
+        {
+            uint8_t lines = bottom - top + 1;
+
+            count = MIN(count, lines);
+            std::copy_backward(m_cells.begin() + (size_t)top * m_columns, m_cells.begin() + (size_t)(bottom + 1 - count) * m_columns,
+                m_cells.begin() + (size_t)(bottom + 1) * m_columns);
+            for (uint8_t row = top; row < (top + count); row++)
+            {
+                erase(row, 0, m_columns - 1);
+            }
+            std::fill(m_is_row_dirty.begin() + top, m_is_row_dirty.begin() + bottom + 1, 1);
+        }
+
+        void Console::erase(uint8_t row, uint8_t first_column, uint8_t last_column)
+        {
+            // erased cells take the current background, like most terminals
+            for (uint8_t column = first_column; column <= last_column; column++)
+            {
+                cell(column, row) = ConsoleCell{ sc_console_blank, m_foreground, m_background };
+            }
+            m_is_row_dirty[row] = 1;
+        }
+
+        void Console::move_to(int column, int row)
+        {
+            m_column = (uint8_t)MIN(MAX(column, 0), m_columns - 1);
+            m_row = (uint8_t)MIN(MAX(row, 0), m_rows - 1);
+            m_is_wrap_pending = false;
+        }
+
+        uint16_t Console::get_parameter(uint8_t index, uint16_t default_value) const
+        {
+            uint16_t value = default_value;
+
+            if ((index < m_parameter_count) && (m_parameters[index] != 0))
+            {
+                value = m_parameters[index];
+            }
+
+            return value;
+        }
+
+        void Console::refresh_row(uint8_t row)
+        {
+            const size_t first = (size_t)row * m_columns;
+            uint8_t column = 0;
+
+            while (column < m_columns)
+            {
+                if (is_same_cell(m_cells[first + column], m_shown[first + column]) == true)
+                {
+                    column++;
+                }
+                else
+                {
+                    const ConsoleCell &start = m_cells[first + column];
+                    uint8_t last = column;
+
+                    // grow the run over cells in the same colors, bridging short unchanged gaps
+                    for (uint8_t next = column + 1; next < m_columns; next++)
+                    {
+                        if (is_same_colors(m_cells[first + next], start) == false)
+                        {
+                            break;
+                        }
+                        if (is_same_cell(m_cells[first + next], m_shown[first + next]) == false)
+                        {
+                            last = next;
+                        }
+                        else if ((next - last) > sc_console_gap_cells)
+                        {
+                            break;
+                        }
+                    }
+
+                    size_t length = last - column + 1;
+
+                    for (size_t index = 0; index < length; index++)
+                    {
+                        m_run[index] = m_cells[first + column + index].glyph;
+                    }
+                    m_run[length] = '\0';
+
+                    m_display->set_cursor(data::Coordinate_8t(1 + column * m_font.get_width(), 1 + row * m_font.get_height()));
+                    m_display->set_foreground(start.foreground);
+                    m_display->set_background(start.background);
+                    m_display->print(m_run.data());
+
+                    std::copy(m_cells.begin() + first + column, m_cells.begin() + first + last + 1, m_shown.begin() + first + column);
+                    column = last + 1;
+                }
+            }
+        }
+
+        bool Console::is_same_colors(const ConsoleCell &left, const ConsoleCell &right)
+        {
+            return (left.foreground.red == right.foreground.red) && (left.foreground.green == right.foreground.green) &&
+                (left.foreground.blue == right.foreground.blue) && (left.background.red == right.background.red) &&
+                (left.background.green == right.background.green) && (left.background.blue == right.background.blue);
+        }
+
+        bool Console::is_same_cell(const ConsoleCell &left, const ConsoleCell &right)
+        {
+            // a blank only shows its background
+            bool is_blank = (left.glyph == sc_console_blank) && (right.glyph == sc_console_blank) &&
+                (left.background.red == right.background.red) && (left.background.green == right.background.green) &&
+                (left.background.blue == right.background.blue);
+
+            return (is_blank == true) || ((left.glyph == right.glyph) && (is_same_colors(left, right) == true));
+        }
+    }
+}
@@ -56,6 +56,19 @@ namespace afm
             
         }
 
+        void Display::set_pixels(const data::Pixel *p_pixels, size_t count)
+        {
+            for (size_t index = 0; index < count; index++)
+            {
+                set_pixel(p_pixels[index].position, p_pixels[index].color);
+            }
+        }
+
+        void Display::draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels)
+        {
+
+        }
+
         bool Display::reset()
         {
             return on_reset();
@@ -0,0 +1,417 @@
+/**
+ * DisplayClient.cpp
+ *
+ * Display that draws into the display server's shared framebuffer
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "DisplayClient.h"
+#include "DisplayServer.h"
+#include "SharedFramebuffer.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const size_t sc_max_printf_length = 256;
+        const size_t sc_display_server_handles = 2;
+
+        DisplayClient::DisplayClient()
+        {
+        }
+
+        DisplayClient::~DisplayClient()
+        {
+            m_framebuffer = nullptr;
+
+            if (m_socket_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_socket_handle);
+            }
+
+            if (m_damage_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_damage_handle);
+            }
+        }
+
+        bool DisplayClient::initialize(const nlohmann::json &configuration)
+        {
+            return connect(configuration.value(sc_socket, sc_display_server_socket));
+        }
+
+        void DisplayClient::clear_screen(const data::Color &color)
+        {
+            if (m_framebuffer != nullptr)
+            {
+                fill(1, 1, m_width, m_height, color);
+                damage(1, 1, m_width, m_height);
+            }
+        }
+
+        void DisplayClient::set_pixel(const data::Coordinate_8t &position, const data::Color &color)
+        {
+            uint16_t x1 = position.x;
+            uint16_t y1 = position.y;
+            uint16_t x2 = position.x;
+            uint16_t y2 = position.y;
+
+            if (clip(x1, y1, x2, y2) == true)
+            {
+                m_framebuffer->get_row(y1)[x1 - 1] = color;
+                damage(x1, y1, x2, y2);
+            }
+        }
+
+        void DisplayClient::set_pixels(const data::Pixel *p_pixels, size_t count)
+        {
+            // one queue entry per cluster of points rather than per point
+            m_batch.clear();
+            for (size_t index = 0; index < count; index++)
+            {
+                uint16_t x1 = p_pixels[index].position.x;
+                uint16_t y1 = p_pixels[index].position.y;
+                uint16_t x2 = x1;
+                uint16_t y2 = y1;
+
+                if (clip(x1, y1, x2, y2) == true)
+                {
+                    m_framebuffer->get_row(y1)[x1 - 1] = p_pixels[index].color;
+                    m_batch.add(DamageRectangle{ x1, y1, x2, y2 });
+                }
+            }
+
+            for (const DamageRectangle &rectangle : m_batch.get_rectangles())
+            {
+                damage(rectangle.x1, rectangle.y1, rectangle.x2, rectangle.y2);
+            }
+        }
+
+        void DisplayClient::draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
+        {
+            draw_rectangle(x1, y1, x2, y2, 1);
+        }
+
+        void DisplayClient::draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t thickness)
+        {
+            uint8_t left = MIN(x1, x2);
+            uint8_t right = MAX(x1, x2);
+            uint8_t top = MIN(y1, y2);
+            uint8_t bottom = MAX(y1, y2);
+
+            if (thickness > 0)
+            {
+                // bands thicker than the rectangle just fill it
+                if (((right - left + 1) <= (thickness * 2)) || ((bottom - top + 1) <= (thickness * 2)))
+                {
+                    fill_rectangle(left, top, right, bottom);
+                }
+                else
+                {
+                    fill_rectangle(left, top, right, top + thickness - 1);
+                    fill_rectangle(left, bottom - thickness + 1, right, bottom);
+                    fill_rectangle(left, top + thickness, left + thickness - 1, bottom - thickness);
+                    fill_rectangle(right - thickness + 1, top + thickness, right, bottom - thickness);
+                }
+            }
+        }
+
+        void DisplayClient::fill_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
+        {
+            uint16_t left = MIN(x1, x2);
+            uint16_t top = MIN(y1, y2);
+            uint16_t right = MAX(x1, x2);
+            uint16_t bottom = MAX(y1, y2);
+
+            if (clip(left, top, right, bottom) == true)
+            {
+                fill(left, top, right, bottom, m_foreground);
+                damage(left, top, right, bottom);
+            }
+        }
+
+        void DisplayClient::draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color)
+        {
+            uint16_t left = MAX(MIN(start.x, end.x), 1);
+            uint16_t top = MAX(MIN(start.y, end.y), 1);
+            uint16_t right = MAX(start.x, end.x);
+            uint16_t bottom = MAX(start.y, end.y);
+
+            if (clip(left, top, right, bottom) == true)
+            {
+                int x = start.x;
+                int y = start.y;
+                int dx = abs(end.x - start.x);
+                int dy = -abs(end.y - start.y);
+                int step_x = start.x < end.x ? 1 : -1;
+                int step_y = start.y < end.y ? 1 : -1;
+                int error = dx + dy;
+                bool is_done = false;
+
+                // Bresenham, points off the screen are walked but not drawn
+                while (is_done == false)
+                {
+                    if ((x >= left) && (x <= right) && (y >= top) && (y <= bottom))
+                    {
+                        m_framebuffer->get_row(y)[x - 1] = color;
+                    }
+
+                    if ((x == end.x) && (y == end.y))
+                    {
+                        is_done = true;
+                    }
+                    else
+                    {
+                        int doubled = error * 2;
+
+                        if (doubled >= dy)
+                        {
+                            error += dy;
+                            x += step_x;
+                        }
+                        if (doubled <= dx)
+                        {
+                            error += dx;
+                            y += step_y;
+                        }
+                    }
+                }
+
+                damage(left, top, right, bottom);
+            }
+        }
+
+        void DisplayClient::draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels)
+        {
+            uint16_t x1 = position.x;
+            uint16_t y1 = position.y;
+            uint16_t x2 = position.x + width - 1;
+            uint16_t y2 = position.y + height - 1;
+
+            if ((p_pixels != nullptr) && (width > 0) && (height > 0) && (clip(x1, y1, x2, y2) == true))
+            {
+                for (uint16_t y = y1; y <= y2; y++)
+                {
+                    const data::Color *p_source = p_pixels + (size_t)(y - position.y) * width + (x1 - position.x);
+
+                    std::copy(p_source, p_source + (x2 - x1 + 1), m_framebuffer->get_row(y) + (x1 - 1));
+                }
+                damage(x1, y1, x2, y2);
+            }
+        }
+
+        void DisplayClient::print(char *data)
+        {
+            if ((data != nullptr) && (m_framebuffer != nullptr))
+            {
+                size_t characters_per_line = m_width / m_font.get_width();
+                const char *p_run = data;
+                size_t run_length = 0;
+
+                while (*p_run != '\0')
+                {
+                    size_t room = characters_per_line - MIN(characters_per_line, (size_t)((m_cursor.x - 1) / m_font.get_width()));
+
+                    run_length = 0;
+                    while ((p_run[run_length] != '\0') && (p_run[run_length] != '\n') && (run_length < room))
+                    {
+                        run_length++;
+                    }
+
+                    // one damage rectangle per run of characters on a line
+                    if (run_length > 0)
+                    {
+                        draw_text(m_cursor.x, m_cursor.y, p_run, run_length);
+                        m_cursor.x += run_length * m_font.get_width();
+                    }
+
+                    p_run += run_length;
+                    if ((*p_run == '\n') || (run_length == room))
+                    {
+                        m_cursor.x = 1;
+                        m_cursor.y += m_font.get_height();
+                        if ((m_cursor.y + m_font.get_height() - 1) > m_height)
+                        {
+                            m_cursor.y = 1;
+                        }
+
+                        if (*p_run == '\n')
+                        {
+                            p_run++;
+                        }
+                    }
+                }
+            }
+        }
+
+        void DisplayClient::print_line(char *data)
+        {
+            char new_line[] = "\n";
+
+            print(data);
+            print(new_line);
+        }
+
+        void DisplayClient::printf(const char * __format, ...)
+        {
+            char buffer[sc_max_printf_length];
+            va_list arguments;
+
+            va_start(arguments, __format);
+            vsnprintf(buffer, sizeof(buffer), __format, arguments);
+            va_end(arguments);
+
+            print(buffer);
+        }
+
+        bool DisplayClient::reset()
+        {
+            bool success = false;
+
+            if (m_framebuffer != nullptr)
+            {
+                damage(1, 1, m_width, m_height);
+                success = true;
+            }
+
+            return success;
+        }
+
+        // private parts
+        bool DisplayClient::connect(const std::string &socket_path)
+        {
+            bool success = false;
+            struct sockaddr_un address;
+
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+
+            if ((m_framebuffer == nullptr) && (socket_path.size() < sizeof(address.sun_path)))
+            {
+                strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+                m_socket_handle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+                if ((m_socket_handle != constants::sc_invalid_file_handle) &&
+                    (::connect(m_socket_handle, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0))
+                {
+                    DisplayServerHello hello = { 0, 0, 0, 0 };
+                    int handles[sc_display_server_handles] = { constants::sc_invalid_file_handle, constants::sc_invalid_file_handle };
+                    char control[CMSG_SPACE(sizeof(handles))];
+                    struct iovec vector = { &hello, sizeof(hello) };
+                    struct msghdr message;
+                    struct cmsghdr *p_header = nullptr;
+
+                    memset(&message, 0, sizeof(message));
+                    memset(control, 0, sizeof(control));
+                    message.msg_iov = &vector;
+                    message.msg_iovlen = 1;
+                    message.msg_control = control;
+                    message.msg_controllen = sizeof(control);
+
+                    if (recvmsg(m_socket_handle, &message, MSG_CMSG_CLOEXEC | MSG_WAITALL) == sizeof(hello))
+                    {
+                        p_header = CMSG_FIRSTHDR(&message);
+                        if ((p_header != nullptr) && (p_header->cmsg_level == SOL_SOCKET) && (p_header->cmsg_type == SCM_RIGHTS) &&
+                            (p_header->cmsg_len == CMSG_LEN(sizeof(handles))))
+                        {
+                            memcpy(handles, CMSG_DATA(p_header), sizeof(handles));
+                        }
+                    }
+
+                    // the framebuffer owns its handle from here, even when it won't attach
+                    m_damage_handle = handles[1];
+                    m_framebuffer = std::make_shared<SharedFramebuffer>();
+                    if ((m_framebuffer->attach(handles[0]) == true) && (m_damage_handle != constants::sc_invalid_file_handle) &&
+                        (hello.magic == sc_shared_framebuffer_magic) && (hello.version == sc_shared_framebuffer_version) &&
+                        (m_framebuffer->get_width() == hello.width) && (m_framebuffer->get_height() == hello.height))
+                    {
+                        m_width = m_framebuffer->get_width();
+                        m_height = m_framebuffer->get_height();
+                        success = true;
+                    }
+                    else
+                    {
+                        m_framebuffer = nullptr;
+                    }
+                }
+            }
+
+            return success;
+        }
+
+        bool DisplayClient::clip(uint16_t &x1, uint16_t &y1, uint16_t &x2, uint16_t &y2) const
+        {
+            bool is_visible = false;
+
+            // like the driver's windows, 1 based and anything starting off screen is dropped
+            if ((m_framebuffer != nullptr) && (x1 <= x2) && (y1 <= y2) && (x1 >= 1) && (y1 >= 1) && (x1 <= m_width) && (y1 <= m_height))
+            {
+                x2 = MIN(x2, m_width);
+                y2 = MIN(y2, m_height);
+                is_visible = true;
+            }
+
+            return is_visible;
+        }
+
+        void DisplayClient::fill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const data::Color &color)
+        {
+            for (uint16_t y = y1; y <= y2; y++)
+            {
+                data::Color *p_row = m_framebuffer->get_row(y);
+
+                std::fill(p_row + (x1 - 1), p_row + x2, color);
+            }
+        }
+
+        void DisplayClient::damage(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+        {
+            m_framebuffer->push_damage(DamageRectangle{ x1, y1, x2, y2 });
+
+            // only the first push since the server last looked has to knock
+            if (m_framebuffer->request_wake() == true)
+            {
+                uint64_t wakeup = 1;
+                ssize_t written = ::write(m_damage_handle, &wakeup, sizeof(wakeup));
+
+                (void)written;
+            }
+        }
+
+        void DisplayClient::draw_text(uint16_t x, uint16_t y, const char *p_text, size_t length)
+        {
+            uint16_t x1 = x;
+            uint16_t y1 = y;
+            uint16_t x2 = MIN(x + (length * m_font.get_width()) - 1, m_width);
+            uint16_t y2 = MIN(y + m_font.get_height() - 1, m_height);
+
+            if (clip(x1, y1, x2, y2) == true)
+            {
+                for (uint16_t row = y1; row <= y2; row++)
+                {
+                    data::Color *p_row = m_framebuffer->get_row(row);
+
+                    for (uint16_t column = x1; column <= x2; column++)
+                    {
+                        uint16_t offset = column - x;
+                        uint8_t bits = m_font.get_column(p_text[offset / m_font.get_width()], offset % m_font.get_width());
+
+                        p_row[column - 1] = ((bits >> (row - y)) & 1) != 0 ? m_foreground : m_background;
+                    }
+                }
+                damage(x1, y1, x2, y2);
+            }
+        }
+    }
+}
@@ -6,6 +6,7 @@
  * Copyright 2020 AFM Software
  */
 
+#include "DisplayClient.h"
 #include "DisplayFactory.h"
 #include "sesp525.h"
 
@@ -25,12 +26,8 @@ namespace afm
 
         DisplayFactorySPtr DisplayFactory::getInstance()
         {
-            static DisplayFactorySPtr p_instance = nullptr;
-
-            if (p_instance == nullptr)
-            {
-                p_instance = std::make_shared<DisplayFactory>();
-            }
+            // constructed once, thread safe
+            static DisplayFactorySPtr p_instance = std::make_shared<DisplayFactory>();
 
             return p_instance;
         }
@@ -46,6 +43,11 @@ namespace afm
                     p_display = std::make_shared<SESP525Display>();
                 }
                 break;
+                case data::DisplayType::DISPLAY_CLIENT:
+                {
+                    p_display = std::make_shared<DisplayClient>();
+                }
+                break;
                 default:
                 {
                     // error
@@ -72,6 +74,10 @@ namespace afm
             {
                 type = data::DisplayType::SESP525;
             }
+            else if (display_type == constants::sc_client_display)
+            {
+                type = data::DisplayType::DISPLAY_CLIENT;
+            }
 
             if (type != data::DisplayType::END_DISPLAY_TYPES)
             {
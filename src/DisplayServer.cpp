@@ -0,0 +1,346 @@
+/**
+ * DisplayServer.cpp
+ *
+ * Owns the display and flushes what clients draw into a shared framebuffer
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "DisplayServer.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const int sc_display_server_backlog = 8;
+        const int sc_max_epoll_events = 16;
+        const int sc_wait_forever = -1;
+        const uint64_t sc_nanoseconds_per_microsecond = 1000ULL;
+        const uint64_t sc_nanoseconds_per_millisecond = 1000000ULL;
+        const uint64_t sc_nanoseconds_per_second = 1000000000ULL;
+
+        static uint64_t get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * sc_nanoseconds_per_second) + (uint64_t)now.tv_nsec;
+        }
+
+        static void close_handle(int &file_handle)
+        {
+            if (file_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(file_handle);
+                file_handle = constants::sc_invalid_file_handle;
+            }
+        }
+
+        DisplayServer::DisplayServer(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution, uint32_t flush_interval_us)
+            : m_display(p_display)
+            , m_width(x_resolution)
+            , m_height(y_resolution)
+            , m_flush_interval_us(flush_interval_us)
+            , m_running(false)
+        {
+        }
+
+        DisplayServer::~DisplayServer()
+        {
+            close_all();
+        }
+
+        bool DisplayServer::start(const std::string &socket_path)
+        {
+            bool success = false;
+            struct sockaddr_un address;
+
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+
+            if ((m_display != nullptr) && (m_epoll_handle == constants::sc_invalid_file_handle) &&
+                (socket_path.size() < sizeof(address.sun_path)) && (m_framebuffer.create(m_width, m_height) == true))
+            {
+                strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+                // a socket left behind by a server that died would fail the bind
+                ::unlink(socket_path.c_str());
+
+                m_epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+                m_damage_handle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+                m_wakeup_handle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+                m_listen_handle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+                if ((m_epoll_handle != constants::sc_invalid_file_handle) && (m_damage_handle != constants::sc_invalid_file_handle) &&
+                    (m_wakeup_handle != constants::sc_invalid_file_handle) && (m_listen_handle != constants::sc_invalid_file_handle) &&
+                    (bind(m_listen_handle, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0) &&
+                    (listen(m_listen_handle, sc_display_server_backlog) == 0) &&
+                    (watch(m_listen_handle) == true) && (watch(m_damage_handle) == true) && (watch(m_wakeup_handle) == true))
+                {
+                    m_socket_path = socket_path;
+                    m_staging.reserve((size_t)m_width * m_height);
+
+                    // the new framebuffer is black, make the panel agree
+                    m_display->clear_screen(constants::BLACK);
+
+                    m_running = true;
+                    success = true;
+                }
+                else
+                {
+                    close_all();
+                }
+            }
+
+            return success;
+        }
+
+        void DisplayServer::run()
+        {
+            struct epoll_event events[sc_max_epoll_events];
+            uint64_t flush_deadline_ns = 0;
+
+            while (m_running == true)
+            {
+                int timeout_ms = sc_wait_forever;
+
+                if (flush_deadline_ns != 0)
+                {
+                    uint64_t now_ns = get_timestamp();
+
+                    timeout_ms = flush_deadline_ns > now_ns ?
+                        (int)((flush_deadline_ns - now_ns + sc_nanoseconds_per_millisecond - 1) / sc_nanoseconds_per_millisecond) : 0;
+                }
+
+                int ready = epoll_wait(m_epoll_handle, events, sc_max_epoll_events, timeout_ms);
+
+                for (int index = 0; index < ready; index++)
+                {
+                    int file_handle = events[index].data.fd;
+
+                    if (file_handle == m_listen_handle)
+                    {
+                        accept_clients();
+                    }
+                    else if (file_handle == m_damage_handle)
+                    {
+                        uint64_t count = 0;
+
+                        if (::read(m_damage_handle, &count, sizeof(count)) == sizeof(count))
+                        {
+                            // from here on the next push signals again
+                            m_framebuffer.clear_wake();
+                            drain();
+
+                            if (flush_deadline_ns == 0)
+                            {
+                                flush_deadline_ns = get_timestamp() + (m_flush_interval_us * sc_nanoseconds_per_microsecond);
+                            }
+                        }
+                    }
+                    else if (file_handle != m_wakeup_handle)
+                    {
+                        char discard[sizeof(DisplayServerHello)];
+
+                        // clients have nothing to say, readable means gone
+                        if (::recv(file_handle, discard, sizeof(discard), MSG_DONTWAIT) <= 0)
+                        {
+                            drop_client(file_handle);
+                        }
+                    }
+                }
+
+                if ((flush_deadline_ns != 0) && (get_timestamp() >= flush_deadline_ns))
+                {
+                    drain();
+                    flush();
+                    flush_deadline_ns = 0;
+                }
+            }
+        }
+
+        void DisplayServer::stop()
+        {
+            uint64_t wakeup = 1;
+
+            // only an atomic store and a write, so a signal handler may call this
+            m_running = false;
+            if (m_wakeup_handle != constants::sc_invalid_file_handle)
+            {
+                ssize_t written = ::write(m_wakeup_handle, &wakeup, sizeof(wakeup));
+                (void)written;
+            }
+        }
+
+        // private parts
+        bool DisplayServer::watch(int file_handle)
+        {
+            struct epoll_event event;
+
+            event.events = EPOLLIN;
+            event.data.fd = file_handle;
+
+            return epoll_ctl(m_epoll_handle, EPOLL_CTL_ADD, file_handle, &event) != -1;
+        }
+
+        void DisplayServer::accept_clients()
+        {
+            int client_handle = accept4(m_listen_handle, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+            while (client_handle != constants::sc_invalid_file_handle)
+            {
+                DisplayServerHello hello = { sc_shared_framebuffer_magic, sc_shared_framebuffer_version, m_width, m_height };
+                int handles[] = { m_framebuffer.get_file_handle(), m_damage_handle };
+                char control[CMSG_SPACE(sizeof(handles))];
+                struct iovec vector = { &hello, sizeof(hello) };
+                struct msghdr message;
+                struct cmsghdr *p_header = nullptr;
+
+                memset(&message, 0, sizeof(message));
+                memset(control, 0, sizeof(control));
+                message.msg_iov = &vector;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+
+                p_header = CMSG_FIRSTHDR(&message);
+                p_header->cmsg_level = SOL_SOCKET;
+                p_header->cmsg_type = SCM_RIGHTS;
+                p_header->cmsg_len = CMSG_LEN(sizeof(handles));
+                memcpy(CMSG_DATA(p_header), handles, sizeof(handles));
+
+                if ((sendmsg(client_handle, &message, MSG_NOSIGNAL) == sizeof(hello)) && (watch(client_handle) == true))
+                {
+                    m_clients.push_back(client_handle);
+                }
+                else
+                {
+                    ::close(client_handle);
+                }
+
+                client_handle = accept4(m_listen_handle, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            }
+
+            m_statistics.clients = m_clients.size();
+        }
+
+        void DisplayServer::drop_client(int file_handle)
+        {
+            auto iter = std::find(m_clients.begin(), m_clients.end(), file_handle);
+
+            if (iter != m_clients.end())
+            {
+                epoll_ctl(m_epoll_handle, EPOLL_CTL_DEL, file_handle, nullptr);
+                ::close(file_handle);
+                m_clients.erase(iter);
+            }
+
+            m_statistics.clients = m_clients.size();
+        }
+
+        void DisplayServer::drain()
+        {
+            const DamageRectangle screen = { 1, 1, m_width, m_height };
+            DamageRectangle rectangle;
+            DamageRectangle visible;
+
+            while (m_framebuffer.pop_damage(rectangle) == true)
+            {
+                // clients are trusted with the pixels, not with the bounds
+                if ((rectangle.x1 <= rectangle.x2) && (rectangle.y1 <= rectangle.y2) &&
+                    (DamageRegion::intersect(rectangle, screen, visible) == true))
+                {
+                    m_damage.add(visible);
+                }
+            }
+
+            if (m_framebuffer.take_overflow(rectangle) == true)
+            {
+                if (DamageRegion::intersect(rectangle, screen, visible) == true)
+                {
+                    m_damage.add(visible);
+                }
+                m_statistics.overflows++;
+            }
+        }
+
+        void DisplayServer::flush()
+        {
+            AFM_TRACE_SCOPE("display", "server flush");
+
+            if (m_damage.is_empty() == false)
+            {
+                for (const DamageRectangle &rectangle : m_damage.get_rectangles())
+                {
+                    flush_rectangle(rectangle);
+                }
+                m_damage.clear();
+                m_statistics.flushes++;
+            }
+        }
+
+        void DisplayServer::flush_rectangle(const DamageRectangle &rectangle)
+        {
+            uint16_t width = rectangle.x2 - rectangle.x1 + 1;
+            uint16_t height = rectangle.y2 - rectangle.y1 + 1;
+            data::Coordinate_8t position(rectangle.x1, rectangle.y1);
+
+            if (width == m_width)
+            {
+                // whole rows are already packed the way the window wants them
+                m_display->draw_image(position, width, height, m_framebuffer.get_row(rectangle.y1));
+            }
+            else
+            {
+                m_staging.clear();
+                for (uint16_t y = rectangle.y1; y <= rectangle.y2; y++)
+                {
+                    const data::Color *p_row = m_framebuffer.get_row(y) + (rectangle.x1 - 1);
+
+                    m_staging.insert(m_staging.end(), p_row, p_row + width);
+                }
+                m_display->draw_image(position, width, height, m_staging.data());
+            }
+
+            m_statistics.windows++;
+            m_statistics.pixels += (uint32_t)width * height;
+        }
+
+        void DisplayServer::close_all()
+        {
+            m_running = false;
+
+            for (int client_handle : m_clients)
+            {
+                ::close(client_handle);
+            }
+            m_clients.clear();
+
+            if (m_listen_handle != constants::sc_invalid_file_handle)
+            {
+                close_handle(m_listen_handle);
+                if (m_socket_path.empty() == false)
+                {
+                    ::unlink(m_socket_path.c_str());
+                    m_socket_path.clear();
+                }
+            }
+
+            close_handle(m_damage_handle);
+            close_handle(m_wakeup_handle);
+            close_handle(m_epoll_handle);
+        }
+    }
+}
@@ -0,0 +1,192 @@
+/**
+ * EmulatedPort.cpp
+ *
+ * Ports wired to an in memory SEPS525 controller instead of hardware
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include "EmulatedPort.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        EmulatedSPI::EmulatedSPI()
+            : Port()
+        {
+
+        }
+
+        bool EmulatedSPI::read(uint8_t &value)
+        {
+            // the serial interface is write only
+            value = 0;
+
+            return true;
+        }
+
+        bool EmulatedSPI::write(uint8_t value)
+        {
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "emulated spi write");
+
+            // counted as the write() the real bus would have cost
+            statistics.add_syscall();
+
+            // a lone byte isn't a whole 9 bit word, spidev refuses it too
+            bool success = m_bits_per_word == sc_emulated_default_bits_per_word;
+            if (success == true)
+            {
+                statistics.add_bytes_out(1);
+                m_emulator->receive(&value, 1);
+            }
+
+            statistics.set_failed(success == false);
+            return success;
+        }
+
+        uint16_t EmulatedSPI::read(data::Buffer &buffer)
+        {
+            return 0;
+        }
+
+        uint16_t EmulatedSPI::write(const data::Buffer &buffer)
+        {
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "emulated spi write");
+
+            statistics.add_syscall();
+            statistics.add_bytes_out(buffer.size());
+            receive(buffer);
+
+            return (uint16_t)buffer.size();
+        }
+
+        uint16_t EmulatedSPI::transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer)
+        {
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_TRANSFER);
+            AFM_TRACE_SCOPE("port", "emulated spi transfer");
+
+            statistics.add_syscall();
+            statistics.add_bytes_out(output_buffer.size());
+            statistics.add_bytes_in(input_buffer.size());
+            receive(output_buffer);
+
+            for (auto &value : input_buffer)
+            {
+                value = 0;
+            }
+
+            return (uint16_t)(output_buffer.size() + input_buffer.size());
+        }
+
+        bool EmulatedSPI::set_bits_per_word(uint8_t num_bits)
+        {
+            bool success = false;
+
+            // plain bytes, or 9 bit words for the 3-wire interface
+            if ((num_bits == sc_emulated_default_bits_per_word) || (num_bits == sc_emulated_word_bits_per_word))
+            {
+                m_bits_per_word = num_bits;
+                success = true;
+            }
+
+            return success;
+        }
+
+        // internal parts
+        bool EmulatedSPI::setup_device()
+        {
+            m_emulator = SEPS525Emulator::getInstance(get_instance());
+
+            return m_emulator != nullptr;
+        }
+
+        // private parts
+        void EmulatedSPI::receive(const data::Buffer &buffer)
+        {
+            if (m_bits_per_word == sc_emulated_word_bits_per_word)
+            {
+                m_emulator->receive_words(buffer.data(), buffer.size());
+            }
+            else
+            {
+                m_emulator->receive(buffer.data(), buffer.size());
+            }
+        }
+
+        EmulatedGPIO::EmulatedGPIO()
+            : Port()
+        {
+
+        }
+
+        bool EmulatedGPIO::read(uint8_t &value)
+        {
+            value = m_level;
+
+            return true;
+        }
+
+        bool EmulatedGPIO::write(uint8_t value)
+        {
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "emulated gpio write");
+
+            statistics.add_syscall();
+            statistics.add_bytes_out(1);
+            m_level = value;
+
+            if (get_device() == EmulatedRole::EMULATED_RS)
+            {
+                m_emulator->set_rs(value);
+            }
+            else
+            {
+                m_emulator->set_reset(value);
+            }
+
+            return true;
+        }
+
+        uint16_t EmulatedGPIO::read(data::Buffer &buffer)
+        {
+            buffer.push_back(m_level);
+
+            return 1;
+        }
+
+        uint16_t EmulatedGPIO::write(const data::Buffer &buffer)
+        {
+            uint16_t bytes_written = 0;
+
+            if (buffer.empty() == false)
+            {
+                bytes_written = write(buffer[0]) == true ? 1 : 0;
+            }
+
+            return bytes_written;
+        }
+
+        uint16_t EmulatedGPIO::transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer)
+        {
+            return 0; // can't really do a transfer
+        }
+
+        // internal parts
+        bool EmulatedGPIO::setup_device()
+        {
+            bool success = false;
+
+            if ((get_device() == EmulatedRole::EMULATED_RS) || (get_device() == EmulatedRole::EMULATED_RESET))
+            {
+                m_emulator = SEPS525Emulator::getInstance(get_instance());
+                success = m_emulator != nullptr;
+            }
+
+            return success;
+        }
+    }
+}
@@ -0,0 +1,447 @@
+/**
+ * EventLoop.cpp
+ *
+ * Single threaded epoll loop that resumes coroutines when their file handle or timer is ready
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const int sc_max_epoll_events = 16;
+        const int sc_wait_forever = -1;
+        const int sc_dont_wait = 0;
+        const uint64_t sc_nanoseconds_per_microsecond = 1000ULL;
+        const uint64_t sc_nanoseconds_per_second = 1000000000ULL;
+
+        static void close_handle(int &file_handle)
+        {
+            if (file_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(file_handle);
+                file_handle = constants::sc_invalid_file_handle;
+            }
+        }
+
+        bool ReadinessAwaiter::await_suspend(std::coroutine_handle<> handle)
+        {
+            m_handle = handle;
+
+            // not suspending resumes straight away with no events
+            return m_p_loop->watch(this);
+        }
+
+        void TimerAwaiter::await_suspend(std::coroutine_handle<> handle)
+        {
+            if (m_deadline_ns > EventLoop::get_timestamp())
+            {
+                m_p_loop->add_timer(m_deadline_ns, handle);
+            }
+            else
+            {
+                m_p_loop->schedule(handle);
+            }
+        }
+
+        EventLoop::EventLoop()
+            : m_running(false)
+        {
+
+        }
+
+        EventLoop::~EventLoop()
+        {
+            shutdown();
+        }
+
+        bool EventLoop::initialize()
+        {
+            bool success = false;
+
+            shutdown();
+
+            m_epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+            m_wakeup_handle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            m_timer_handle = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+            if ((m_epoll_handle != constants::sc_invalid_file_handle) && (m_wakeup_handle != constants::sc_invalid_file_handle) &&
+                (m_timer_handle != constants::sc_invalid_file_handle))
+            {
+                struct epoll_event event;
+
+                event.events = EPOLLIN;
+                event.data.fd = m_wakeup_handle;
+                success = epoll_ctl(m_epoll_handle, EPOLL_CTL_ADD, m_wakeup_handle, &event) != -1;
+
+                event.data.fd = m_timer_handle;
+                success = success && (epoll_ctl(m_epoll_handle, EPOLL_CTL_ADD, m_timer_handle, &event) != -1);
+            }
+
+            if (success == true)
+            {
+                m_running = true;
+            }
+            else
+            {
+                shutdown();
+            }
+
+            return success;
+        }
+
+        void EventLoop::shutdown()
+        {
+            std::vector<Task<void>> tasks;
+
+            m_running = false;
+
+            // nothing may be resumed while the frames go away
+            m_ready.clear();
+            m_watches.clear();
+            m_sources.clear();
+            m_timers = decltype(m_timers)();
+            m_armed_deadline_ns = 0;
+
+            tasks.swap(m_tasks);
+            tasks.clear();
+            m_finished_tasks = 0;
+
+            close_handle(m_timer_handle);
+            close_handle(m_wakeup_handle);
+            close_handle(m_epoll_handle);
+        }
+
+        void EventLoop::spawn(Task<void> task)
+        {
+            if (task.is_valid() == true)
+            {
+                m_tasks.push_back(run_task(this, std::move(task)));
+                schedule(m_tasks.back().get_handle());
+            }
+        }
+
+        void EventLoop::run()
+        {
+            struct epoll_event events[sc_max_epoll_events];
+
+            while ((m_running == true) && (m_tasks.empty() == false))
+            {
+                // only what was ready as the turn started, a task that keeps
+                // yielding must not starve the file handles
+                for (size_t ready = m_ready.size(); (ready > 0) && (m_running == true); ready--)
+                {
+                    std::coroutine_handle<> handle = m_ready.front();
+
+                    m_ready.pop_front();
+                    handle.resume();
+                }
+
+                reap_tasks();
+
+                if ((m_running == true) && (m_tasks.empty() == false))
+                {
+                    int count = epoll_wait(m_epoll_handle, events, sc_max_epoll_events,
+                        m_ready.empty() == true ? sc_wait_forever : sc_dont_wait);
+
+                    for (int index = 0; index < count; index++)
+                    {
+                        dispatch(events[index].data.fd, events[index].events);
+                    }
+                }
+            }
+        }
+
+        void EventLoop::stop()
+        {
+            uint64_t wakeup = 1;
+
+            // only an atomic store and a write, so a signal handler may call this
+            m_running = false;
+            if (m_wakeup_handle != constants::sc_invalid_file_handle)
+            {
+                ssize_t written = ::write(m_wakeup_handle, &wakeup, sizeof(wakeup));
+                (void)written;
+            }
+        }
+
+        ReadinessAwaiter EventLoop::readable(int file_handle)
+        {
+            return ReadinessAwaiter(this, file_handle, EPOLLIN);
+        }
+
+        ReadinessAwaiter EventLoop::writable(int file_handle)
+        {
+            return ReadinessAwaiter(this, file_handle, EPOLLOUT);
+        }
+
+        TimerAwaiter EventLoop::sleep_for(uint64_t duration_us)
+        {
+            return TimerAwaiter(this, get_timestamp() + (duration_us * sc_nanoseconds_per_microsecond));
+        }
+
+        TimerAwaiter EventLoop::sleep_until(uint64_t deadline_ns)
+        {
+            return TimerAwaiter(this, deadline_ns);
+        }
+
+        TimerAwaiter EventLoop::yield()
+        {
+            return TimerAwaiter(this, 0);
+        }
+
+        void EventLoop::schedule(std::coroutine_handle<> handle)
+        {
+            m_ready.push_back(handle);
+        }
+
+        bool EventLoop::add_source(int file_handle, uint32_t events, EventLoopHandler handler)
+        {
+            bool success = false;
+
+            if ((m_epoll_handle != constants::sc_invalid_file_handle) && (m_watches.count(file_handle) == 0))
+            {
+                struct epoll_event event;
+
+                event.events = events;
+                event.data.fd = file_handle;
+
+                if (epoll_ctl(m_epoll_handle, EPOLL_CTL_ADD, file_handle, &event) != -1)
+                {
+                    m_sources[file_handle] = handler;
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        void EventLoop::remove_source(int file_handle)
+        {
+            if (m_sources.erase(file_handle) > 0)
+            {
+                epoll_ctl(m_epoll_handle, EPOLL_CTL_DEL, file_handle, nullptr);
+            }
+        }
+
+        void EventLoop::forget(int file_handle)
+        {
+            auto iter = m_watches.find(file_handle);
+
+            if (iter != m_watches.end())
+            {
+                Watch &watch = iter->second;
+
+                if (watch.is_registered == true)
+                {
+                    epoll_ctl(m_epoll_handle, EPOLL_CTL_DEL, file_handle, nullptr);
+                }
+
+                // anyone still waiting hears the handle is gone
+                for (ReadinessAwaiter *p_awaiter : { watch.p_reader, watch.p_writer })
+                {
+                    if (p_awaiter != nullptr)
+                    {
+                        p_awaiter->m_result = EPOLLHUP;
+                        schedule(p_awaiter->m_handle);
+                    }
+                }
+
+                m_watches.erase(iter);
+            }
+        }
+
+        uint64_t EventLoop::get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * sc_nanoseconds_per_second) + (uint64_t)now.tv_nsec;
+        }
+
+        // private parts
+        Task<void> EventLoop::run_task(EventLoop *p_loop, Task<void> task)
+        {
+            co_await task;
+
+            // the frame is done once this returns, reap_tasks() frees it
+            p_loop->m_finished_tasks++;
+        }
+
+        bool EventLoop::watch(ReadinessAwaiter *p_awaiter)
+        {
+            bool success = false;
+            int file_handle = p_awaiter->m_file_handle;
+
+            if ((m_epoll_handle != constants::sc_invalid_file_handle) && (m_sources.count(file_handle) == 0))
+            {
+                Watch &watch = m_watches[file_handle];
+                ReadinessAwaiter *&p_slot = p_awaiter->m_events == EPOLLIN ? watch.p_reader : watch.p_writer;
+
+                if (p_slot == nullptr)
+                {
+                    p_slot = p_awaiter;
+                    success = arm(file_handle, watch);
+                    if (success == false)
+                    {
+                        p_slot = nullptr;
+                    }
+                }
+
+                if ((watch.p_reader == nullptr) && (watch.p_writer == nullptr) && (watch.is_registered == false))
+                {
+                    m_watches.erase(file_handle);
+                }
+            }
+
+            return success;
+        }
+
+        bool EventLoop::arm(int file_handle, Watch &watch)
+        {
+            struct epoll_event event;
+            int operation = watch.is_registered == true ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+            // one shot, so a handle nobody waits on costs nothing and re-arming is a single call
+            event.events = (uint32_t)EPOLLONESHOT | (watch.p_reader != nullptr ? (uint32_t)EPOLLIN : 0) | (watch.p_writer != nullptr ? (uint32_t)EPOLLOUT : 0);
+            event.data.fd = file_handle;
+
+            int result = epoll_ctl(m_epoll_handle, operation, file_handle, &event);
+            if ((result == -1) && ((errno == ENOENT) || (errno == EEXIST)))
+            {
+                // closed without forget() and the number reused, or the other way around
+                operation = operation == EPOLL_CTL_MOD ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+                result = epoll_ctl(m_epoll_handle, operation, file_handle, &event);
+            }
+
+            watch.is_registered = result != -1;
+
+            return watch.is_registered;
+        }
+
+        void EventLoop::dispatch(int file_handle, uint32_t events)
+        {
+            if (file_handle == m_wakeup_handle)
+            {
+                uint64_t count = 0;
+                ssize_t bytes_read = ::read(m_wakeup_handle, &count, sizeof(count));
+                (void)bytes_read;
+            }
+            else if (file_handle == m_timer_handle)
+            {
+                uint64_t expirations = 0;
+                ssize_t bytes_read = ::read(m_timer_handle, &expirations, sizeof(expirations));
+                (void)bytes_read;
+
+                m_armed_deadline_ns = 0;
+                expire_timers();
+            }
+            else
+            {
+                auto source = m_sources.find(file_handle);
+                auto iter = m_watches.find(file_handle);
+
+                if (source != m_sources.end())
+                {
+                    // the handler may remove itself
+                    EventLoopHandler handler = source->second;
+                    AFM_TRACE_SCOPE("event loop", "source");
+
+                    handler();
+                }
+                else if (iter != m_watches.end())
+                {
+                    Watch &watch = iter->second;
+                    const uint32_t closed_events = EPOLLERR | EPOLLHUP;
+
+                    if ((watch.p_reader != nullptr) && ((events & (EPOLLIN | closed_events)) != 0))
+                    {
+                        watch.p_reader->m_result = events;
+                        schedule(watch.p_reader->m_handle);
+                        watch.p_reader = nullptr;
+                    }
+
+                    if ((watch.p_writer != nullptr) && ((events & (EPOLLOUT | closed_events)) != 0))
+                    {
+                        watch.p_writer->m_result = events;
+                        schedule(watch.p_writer->m_handle);
+                        watch.p_writer = nullptr;
+                    }
+
+                    // one shot disarmed it, whoever is left still needs it
+                    if ((watch.p_reader != nullptr) || (watch.p_writer != nullptr))
+                    {
+                        arm(file_handle, watch);
+                    }
+                }
+            }
+        }
+
+        void EventLoop::add_timer(uint64_t deadline_ns, std::coroutine_handle<> handle)
+        {
+            m_timers.push({ deadline_ns, m_timer_sequence++, handle });
+
+            if ((m_armed_deadline_ns == 0) || (deadline_ns < m_armed_deadline_ns))
+            {
+                arm_timer();
+            }
+        }
+
+        void EventLoop::expire_timers()
+        {
+            uint64_t now_ns = get_timestamp();
+
+            while ((m_timers.empty() == false) && (m_timers.top().deadline_ns <= now_ns))
+            {
+                schedule(m_timers.top().handle);
+                m_timers.pop();
+            }
+
+            arm_timer();
+        }
+
+        void EventLoop::arm_timer()
+        {
+            uint64_t deadline_ns = m_timers.empty() == true ? 0 : m_timers.top().deadline_ns;
+
+            if (deadline_ns != m_armed_deadline_ns)
+            {
+                struct itimerspec setting = {};
+
+                // all zero disarms
+                setting.it_value.tv_sec = deadline_ns / sc_nanoseconds_per_second;
+                setting.it_value.tv_nsec = deadline_ns % sc_nanoseconds_per_second;
+
+                if (timerfd_settime(m_timer_handle, TFD_TIMER_ABSTIME, &setting, nullptr) != -1)
+                {
+                    m_armed_deadline_ns = deadline_ns;
+                }
+            }
+        }
+
+        void EventLoop::reap_tasks()
+        {
+            if (m_finished_tasks > 0)
+            {
+                m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [](const Task<void> &task)
+                {
+                    return task.is_done();
+                }), m_tasks.end());
+                m_finished_tasks = 0;
+            }
+        }
+    }
+}
@@ -9,14 +9,13 @@
 #include <iostream>
 #include <error.h>
 #include <fcntl.h>
-#include <signal.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/stat.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "GPIO.h"
+#include "Trace.h"
 
 namespace afm
 {
@@ -39,6 +38,7 @@ namespace afm
             "both"
         };
         const std::string sc_gpio_edge = "edge";
+        const int sc_gpio_value_size = 64;
 
         GPIO::GPIO()
             : m_pin_exported(false)
@@ -46,9 +46,17 @@ namespace afm
 
         }
 
+        GPIO::~GPIO()
+        {
+            // the reactor holds a reference to us, drop it before we go away
+            disable_interrupt();
+        }
+
         bool GPIO::read(uint8_t &value)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_READ);
+            AFM_TRACE_SCOPE("port", "gpio read");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
@@ -57,18 +65,23 @@ namespace afm
                     set_direction(true);
                 }
 
+                statistics.add_syscall();
                 if (::read(m_device_handle, &value, 1) == 1)
                 {
+                    statistics.add_bytes_in(1);
                     success = true;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
         bool GPIO::write(uint8_t value)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "gpio write");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
@@ -77,12 +90,15 @@ namespace afm
                     set_direction(false);
                 }
                 const char *gpio_value = value == 1 ? sc_gpio_high : sc_gpio_low;
+                statistics.add_syscall();
                 if (::write(m_device_handle, gpio_value, 1) == 1)
                 {
+                    statistics.add_bytes_out(1);
                     success = true;
 		}
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
@@ -93,7 +109,7 @@ namespace afm
 
             if (read(value) == true)
             {
-                buffer.push_back(value);
+                buffer.assign(1, value);
                 success = true;
             }
 
@@ -110,11 +126,28 @@ namespace afm
             return 0; // can't really do a transfer
         }
 
+        int GPIO::get_file_handle()
+        {
+            return m_device_handle;
+        }
+
         bool GPIO::enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOInterruptRoutine interrupt_callback)
+        {
+            return enable_interrupt(edge, [interrupt_callback](const data::GPIOEvent &event)
+            {
+                interrupt_callback(event.pin);
+            });
+        }
+
+        bool GPIO::enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOEventRoutine event_callback)
         {
             bool success = false;
 
-            m_interrupt_callback = interrupt_callback;
+            disable_interrupt();
+
+            // a null callback leaves the events queued for poll_events
+            m_event_sink.attach(event_callback);
+            m_interrupt_edge = edge;
 
             set_direction(true); // interrupts are input oddly enough
 
@@ -132,18 +165,53 @@ namespace afm
                 // do after file handle closed
                 if (success == true)
                 {
-                    if (m_device_handle != constants::sc_invalid_file_handle)
+                    success = false;
+
+                    gpio_path = m_base_path + "/" + sc_gpio_value;
+
+                    m_interrupt_handle = ::open(gpio_path.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (m_interrupt_handle != constants::sc_invalid_file_handle)
                     {
-                        ::close(m_device_handle);
-                        m_device_handle = constants::sc_invalid_file_handle;
+                        char interrupt_value[sc_gpio_value_size];
+
+                        // consume the current value so only new edges are reported
+                        if (::read(m_interrupt_handle, interrupt_value, sizeof(interrupt_value)) >= 0)
+                        {
+                            m_event_loop = GPIOEventLoop::getInstance();
+                            m_interrupt_active = m_event_loop->add_source(m_interrupt_handle, EPOLLPRI | EPOLLERR, [this]()
+                            {
+                                on_interrupt();
+                            });
+                            success = m_interrupt_active;
+                        }
                     }
-                    m_interrupt_active = true;
-                    m_interrupt_observer_thread = std::thread(&GPIO::run, this);
                 }
             }
             return success;
         }
 
+        bool GPIO::enable_interrupt(data::GPIOInterruptEdge edge)
+        {
+            return enable_interrupt(edge, data::GPIOEventRoutine(nullptr));
+        }
+
+        void GPIO::disable_interrupt()
+        {
+            if (m_interrupt_active == true)
+            {
+                m_interrupt_active = false;
+                m_event_loop->remove_source(m_interrupt_handle);
+            }
+
+            if (m_interrupt_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_interrupt_handle);
+                m_interrupt_handle = constants::sc_invalid_file_handle;
+            }
+
+            m_event_sink.detach();
+        }
+
         // internal parts
         bool GPIO::setup_device()
         {
@@ -196,6 +264,8 @@ namespace afm
 
         void GPIO::shutdown_device()
         {
+            disable_interrupt();
+
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
                 ::close(m_device_handle);
@@ -221,92 +291,48 @@ namespace afm
                     ::close(file_handle);
                 }
             }
-
-            if (m_interrupt_active == true)
-            {
-                m_interrupt_active = false;
-                m_interrupt_observer_thread.join();
-            }
         }
 
-        void GPIO::run()
+        void GPIO::on_interrupt()
         {
-            std::string gpio_path = m_base_path + "/" + sc_gpio_value;
+            AFM_TRACE_SCOPE("interrupt", "gpio edge");
+            char interrupt_value[sc_gpio_value_size];
+            uint64_t timestamp = GPIOEventLoop::get_timestamp();
 
-            uint32_t interrupt_debounce = 1000 * 1000 * 200; // 1000 for nanoseconds, 1000 for microseconds, 200 for milli
-            int file_handle = ::open(gpio_path.c_str(), O_RDONLY);
-
-            if (file_handle >= 0) {
-                struct timespec last_time;
-                struct timeval tv = {1, 0}; // 1 second timeout
-                fd_set interrupt_descriptor_set;
-                char interrupt_value[64];
-                bool transition_seen = true;
-
-                // default to current time for last
-                clock_gettime(CLOCK_REALTIME, &last_time);
-
-                while (m_interrupt_active == true) {
-
-                    // reset due to Linux modifying the return value
-                    tv.tv_sec = 1;
-                    tv.tv_usec = 0;
-
-                    // Done in the loop so we reset after every select
-                    FD_ZERO(&interrupt_descriptor_set);
-                    FD_SET(file_handle, &interrupt_descriptor_set);
-
-                    if (select(file_handle + 1, &interrupt_descriptor_set, nullptr, nullptr, &tv) > 0) {
-                        if (FD_ISSET(file_handle, &interrupt_descriptor_set)) {
-                            struct timespec current_time;
-
-                            // Process interrupt if we transition from high to low
-                            bool processInterrupt = true;
-
-                            if (clock_gettime(CLOCK_REALTIME, &current_time) != -1) {
-                                if (current_time.tv_sec == last_time.tv_sec) {
-
-                                    // is current time greater than last time i.e. is it debounced...
-                                    if (current_time.tv_nsec < (last_time.tv_nsec + interrupt_debounce)) {
-                                        processInterrupt = false;
-                                    }
-                                }
-                            }
-
-                            lseek(file_handle, 0, 0);
-
-                            size_t bytesRead = ::read(file_handle, interrupt_value, 64);
-                            if (bytesRead > 0) {
-                                interrupt_value[bytesRead] = '\0';
-                                if (atoi(interrupt_value) == 0) {
-                                    if ((processInterrupt == true) && (transition_seen == true)) {
-                                        m_interrupt_callback(get_instance());
-                                        last_time = current_time;
-                                    }
-                                    transition_seen = false;
-                                } else {
-                                    transition_seen = true;
-                                }
-                                sleep(1);
-                            }
-                        }
-                    }
-                    else
+            lseek(m_interrupt_handle, 0, SEEK_SET);
+
+            ssize_t bytes_read = ::read(m_interrupt_handle, interrupt_value, sizeof(interrupt_value) - 1);
+            if (bytes_read > 0)
+            {
+                interrupt_value[bytes_read] = '\0';
+
+                data::GPIOInterruptEdge edge = atoi(interrupt_value) == 0 ? data::GPIOInterruptEdge::FALLING : data::GPIOInterruptEdge::RISING;
+
+                // sysfs may report the opposite edge when set to both, filter to what was asked for
+                if ((m_interrupt_edge == data::GPIOInterruptEdge::BOTH) || (m_interrupt_edge == edge))
+                {
+                    if ((m_last_event_ns == 0) || ((timestamp - m_last_event_ns) >= m_debounce_ns))
                     {
-                        m_interrupt_active = false;
+                        data::GPIOEvent event = { get_instance(), edge, timestamp };
+
+                        m_last_event_ns = timestamp;
+                        m_event_sink.deliver(&event, 1);
                     }
                 }
-
-                close(file_handle);
             }
         }
 
         // private parts
         void GPIO::set_direction(bool make_input)
         {
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_CONTROL);
+            AFM_TRACE_SCOPE("port", "gpio set_direction");
+
             // Create gpio access string
             std::string gpio_path = m_base_path + "/" + sc_gpio_direction;
 
+            statistics.add_syscall();
+            statistics.set_failed(true);
             int file_handle = ::open(gpio_path.c_str(), O_WRONLY);
 
             if (file_handle != constants::sc_invalid_file_handle) {
@@ -316,8 +342,10 @@ namespace afm
                 }
                 if (::write(file_handle, direction_flag.c_str(), direction_flag.length()) == (int)direction_flag.length()) {
                     m_is_write = make_input == false;
+                    statistics.set_failed(false);
                 }
                 ::close(file_handle);
+                statistics.add_syscall(2);
             }
         }
     }
@@ -0,0 +1,267 @@
+/**
+ * GPIOCapture.cpp
+ *
+ * Fixed rate sampling of several gpiochip lines at once
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <cmath>
+#include <fstream>
+#include <time.h>
+
+#include "GPIOCapture.h"
+#include "GPIOEventLoop.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const uint64_t sc_nanoseconds_per_second = 1000000000ULL;
+        const char sc_vcd_first_identifier = '!';
+
+        GPIOCapture::GPIOCapture()
+            : m_running(false)
+        {
+
+        }
+
+        GPIOCapture::~GPIOCapture()
+        {
+            stop();
+        }
+
+        bool GPIOCapture::start(uint32_t chip, const std::vector<uint32_t> &lines, uint32_t sample_rate_hz, size_t sample_capacity)
+        {
+            bool success = false;
+
+            stop();
+
+            // above a GHz the period rounds to 0 ns, there would be no slot to sleep to
+            if ((sample_rate_hz > 0) && (sample_rate_hz <= sc_nanoseconds_per_second) && (sample_capacity > 0))
+            {
+                if (m_lines.request(chip, lines, true) == true)
+                {
+                    // allocate everything now, the sampler never allocates
+                    m_samples.assign(sample_capacity, { 0, 0 });
+                    m_chip = chip;
+                    m_captured_lines = lines;
+                    m_sample_rate_hz = sample_rate_hz;
+                    m_period_ns = sc_nanoseconds_per_second / sample_rate_hz;
+                    m_sample_count = 0;
+                    m_missed_periods = 0;
+                    m_read_errors = 0;
+                    m_jitter_sum = 0.0;
+                    m_jitter_sum_squares = 0.0;
+                    m_jitter_max = 0;
+
+                    m_running = true;
+                    m_sampling_thread = std::thread(&GPIOCapture::run, this);
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        void GPIOCapture::stop()
+        {
+            if (m_running == true)
+            {
+                m_running = false;
+                m_sampling_thread.join();
+                m_lines.release();
+            }
+        }
+
+        GPIOCaptureStatistics GPIOCapture::get_statistics() const
+        {
+            GPIOCaptureStatistics statistics;
+
+            // only consistent once the sampler has stopped
+            if (m_running == false)
+            {
+                statistics.read_errors = m_read_errors;
+            }
+
+            if ((m_running == false) && (m_sample_count > 0))
+            {
+                statistics.samples = m_sample_count;
+                statistics.overwritten = m_sample_count > m_samples.size() ? m_sample_count - m_samples.size() : 0;
+                statistics.missed_periods = m_missed_periods;
+                statistics.requested_rate_hz = m_sample_rate_hz;
+                if (m_last_ns > m_start_ns)
+                {
+                    statistics.achieved_rate_hz = (double)(m_sample_count - 1) * sc_nanoseconds_per_second / (double)(m_last_ns - m_start_ns);
+                }
+                statistics.jitter_mean_ns = m_jitter_sum / m_sample_count;
+                statistics.jitter_stddev_ns = sqrt(fmax(0.0, (m_jitter_sum_squares / m_sample_count) -
+                    (statistics.jitter_mean_ns * statistics.jitter_mean_ns)));
+                statistics.jitter_max_ns = m_jitter_max;
+            }
+
+            return statistics;
+        }
+
+        size_t GPIOCapture::get_samples(std::vector<GPIOSample> &samples) const
+        {
+            samples.clear();
+
+            if (m_running == false)
+            {
+                // oldest first
+                size_t count = m_sample_count < m_samples.size() ? m_sample_count : m_samples.size();
+                size_t first = m_sample_count - count;
+
+                samples.reserve(count);
+                for (size_t index = 0; index < count; index++)
+                {
+                    samples.push_back(m_samples[(first + index) % m_samples.size()]);
+                }
+            }
+
+            return samples.size();
+        }
+
+        bool GPIOCapture::export_csv(const std::string &file_name) const
+        {
+            bool success = false;
+            std::vector<GPIOSample> samples;
+
+            if (get_samples(samples) > 0)
+            {
+                std::ofstream output(file_name);
+
+                if (output.is_open() == true)
+                {
+                    output << "timestamp_ns";
+                    for (auto line : m_captured_lines)
+                    {
+                        output << ",line" << line;
+                    }
+                    output << "\n";
+
+                    for (auto &sample : samples)
+                    {
+                        output << sample.timestamp_ns;
+                        for (size_t index = 0; index < m_captured_lines.size(); index++)
+                        {
+                            output << "," << ((sample.bits >> index) & 1);
+                        }
+                        output << "\n";
+                    }
+                    success = output.good();
+                }
+            }
+
+            return success;
+        }
+
+        bool GPIOCapture::export_vcd(const std::string &file_name) const
+        {
+            bool success = false;
+            std::vector<GPIOSample> samples;
+
+            if (get_samples(samples) > 0)
+            {
+                std::ofstream output(file_name);
+
+                if (output.is_open() == true)
+                {
+                    const std::vector<uint32_t> &lines = m_captured_lines;
+                    uint64_t origin = samples[0].timestamp_ns;
+
+                    output << "$timescale 1ns $end\n$scope module gpiochip" << m_chip << " $end\n";
+                    for (size_t index = 0; index < lines.size(); index++)
+                    {
+                        output << "$var wire 1 " << (char)(sc_vcd_first_identifier + index) << " line" << lines[index] << " $end\n";
+                    }
+                    output << "$upscope $end\n$enddefinitions $end\n";
+
+                    // value changes only, the first sample dumps everything
+                    uint64_t previous = ~samples[0].bits;
+                    for (auto &sample : samples)
+                    {
+                        uint64_t changed = sample.bits ^ previous;
+
+                        if (changed != 0)
+                        {
+                            output << "#" << (sample.timestamp_ns - origin) << "\n";
+                            for (size_t index = 0; index < lines.size(); index++)
+                            {
+                                if (((changed >> index) & 1) != 0)
+                                {
+                                    output << ((sample.bits >> index) & 1) << (char)(sc_vcd_first_identifier + index) << "\n";
+                                }
+                            }
+                            previous = sample.bits;
+                        }
+                    }
+                    success = output.good();
+                }
+            }
+
+            return success;
+        }
+
+        // private parts
+        void GPIOCapture::run()
+        {
+            uint64_t mask = m_lines.get_line_count() == 64 ? ~0ULL : (1ULL << m_lines.get_line_count()) - 1;
+            struct timespec deadline;
+
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+            uint64_t slot_ns = ((uint64_t)deadline.tv_sec * sc_nanoseconds_per_second) + (uint64_t)deadline.tv_nsec;
+            m_start_ns = slot_ns;
+
+            while (m_running == true)
+            {
+                uint64_t bits = 0;
+                uint64_t now = 0;
+
+                if (m_lines.get_values(mask, bits) == true)
+                {
+                    now = GPIOEventLoop::get_timestamp();
+
+                    uint64_t jitter = now - slot_ns;
+
+                    m_samples[m_sample_count % m_samples.size()] = { now, bits };
+                    if (m_sample_count == 0)
+                    {
+                        m_start_ns = now;
+                    }
+                    m_last_ns = now;
+                    m_sample_count++;
+
+                    m_jitter_sum += (double)jitter;
+                    m_jitter_sum_squares += (double)jitter * (double)jitter;
+                    if (jitter > m_jitter_max)
+                    {
+                        m_jitter_max = jitter;
+                    }
+                }
+                else
+                {
+                    // no sample rather than a made up all low one
+                    now = GPIOEventLoop::get_timestamp();
+                    m_read_errors++;
+                }
+
+                // absolute deadlines so error does not accumulate, skip slots we overran
+                slot_ns += m_period_ns;
+                if (now >= slot_ns + m_period_ns)
+                {
+                    uint64_t behind = (now - slot_ns) / m_period_ns;
+
+                    m_missed_periods += behind;
+                    slot_ns += behind * m_period_ns;
+                }
+
+                deadline.tv_sec = slot_ns / sc_nanoseconds_per_second;
+                deadline.tv_nsec = slot_ns % sc_nanoseconds_per_second;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+            }
+        }
+    }
+}
@@ -0,0 +1,189 @@
+/**
+ * GPIOChip.cpp
+ *
+ * GPIO character device implementation defining a port that can read/write
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <sys/epoll.h>
+
+#include "GPIOChip.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const uint64_t sc_gpio_line_mask = 1;
+        const size_t sc_max_gpio_events = 16;
+
+        GPIOChip::GPIOChip()
+            : Port()
+        {
+
+        }
+
+        GPIOChip::~GPIOChip()
+        {
+            // the reactor holds a reference to us, drop it before we go away
+            disable_interrupt();
+        }
+
+        bool GPIOChip::read(uint8_t &value)
+        {
+            bool success = false;
+            uint64_t bits = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_READ);
+            AFM_TRACE_SCOPE("port", "gpio read");
+
+            if (m_line.is_input() == false)
+            {
+                // direction changes are one SET_CONFIG ioctl on the line request
+                statistics.add_syscall();
+                m_line.set_direction(true);
+            }
+
+            statistics.add_syscall();
+            if (m_line.get_values(sc_gpio_line_mask, bits) == true)
+            {
+                value = (bits & sc_gpio_line_mask) != 0 ? constants::sc_gpio_high : constants::sc_gpio_low;
+                statistics.add_bytes_in(1);
+                success = true;
+            }
+
+            statistics.set_failed(success == false);
+            return success;
+        }
+
+        bool GPIOChip::write(uint8_t value)
+        {
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "gpio write");
+            bool success = false;
+
+            statistics.add_syscall();
+            success = m_line.set_values(sc_gpio_line_mask, value == constants::sc_gpio_high ? sc_gpio_line_mask : 0);
+            if (success == true)
+            {
+                statistics.add_bytes_out(1);
+            }
+
+            statistics.set_failed(success == false);
+            return success;
+        }
+
+        uint16_t GPIOChip::read(data::Buffer &buffer)
+        {
+            bool success = false;
+            uint8_t value;
+
+            if (read(value) == true)
+            {
+                buffer.assign(1, value);
+                success = true;
+            }
+
+            return success == true ? 1 : 0;
+        }
+
+        uint16_t GPIOChip::write(const data::Buffer &buffer)
+        {
+            uint16_t bytes_written = 0;
+
+            if (buffer.empty() == false)
+            {
+                bytes_written = write(buffer[0]) == true ? 1 : 0;
+            }
+
+            return bytes_written;
+        }
+
+        uint16_t GPIOChip::transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer)
+        {
+            return 0; // can't really do a transfer
+        }
+
+        bool GPIOChip::enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOInterruptRoutine interrupt_callback)
+        {
+            return enable_interrupt(edge, [interrupt_callback](const data::GPIOEvent &event)
+            {
+                interrupt_callback(event.pin);
+            });
+        }
+
+        bool GPIOChip::enable_interrupt(data::GPIOInterruptEdge edge, data::GPIOEventRoutine event_callback)
+        {
+            bool success = false;
+
+            disable_interrupt();
+
+            // a null callback leaves the events queued for poll_events
+            m_event_sink.attach(event_callback);
+
+            // debouncing and timestamping are done by the kernel
+            if (m_line.configure_events(edge, m_debounce_us) == true)
+            {
+                m_event_loop = GPIOEventLoop::getInstance();
+                m_interrupt_active = m_event_loop->add_source(m_line.get_file_handle(), EPOLLIN, [this]()
+                {
+                    on_interrupt();
+                });
+                success = m_interrupt_active;
+            }
+
+            return success;
+        }
+
+        bool GPIOChip::enable_interrupt(data::GPIOInterruptEdge edge)
+        {
+            return enable_interrupt(edge, data::GPIOEventRoutine(nullptr));
+        }
+
+        void GPIOChip::disable_interrupt()
+        {
+            if (m_interrupt_active == true)
+            {
+                m_interrupt_active = false;
+                m_event_loop->remove_source(m_line.get_file_handle());
+                m_line.configure_events(data::GPIOInterruptEdge::NONE, 0);
+            }
+
+            m_event_sink.detach();
+        }
+
+        bool GPIOChip::enable_edge_events(data::GPIOInterruptEdge edge)
+        {
+            disable_interrupt();
+
+            return m_line.configure_events(edge, m_debounce_us);
+        }
+
+        // internal parts
+        bool GPIOChip::setup_device()
+        {
+            // default to output like the sysfs implementation
+            return m_line.request(get_device(), { get_instance() }, false);
+        }
+
+        void GPIOChip::shutdown_device()
+        {
+            disable_interrupt();
+            m_line.release();
+        }
+
+        void GPIOChip::on_interrupt()
+        {
+            AFM_TRACE_SCOPE("interrupt", "gpio edge");
+            data::GPIOEvent events[sc_max_gpio_events];
+            size_t events_read = 0;
+
+            do
+            {
+                // hand the whole batch over, callbacks never run on the reactor
+                events_read = m_line.read_events(events, sc_max_gpio_events);
+                m_event_sink.deliver(events, events_read);
+            } while (events_read == sc_max_gpio_events);
+        }
+    }
+}
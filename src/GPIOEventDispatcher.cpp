@@ -0,0 +1,293 @@
+/**
+ * GPIOEventDispatcher.cpp
+ *
+ * Moves GPIO events off the reactor thread onto a pool of workers
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include "GPIOEventDispatcher.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const uint32_t sc_no_handler = 0;
+
+        GPIOEventDispatcher::GPIOEventDispatcher()
+            : m_running(false)
+        {
+
+        }
+
+        GPIOEventDispatcher::~GPIOEventDispatcher()
+        {
+            stop();
+        }
+
+        GPIOEventDispatcherSPtr GPIOEventDispatcher::getInstance()
+        {
+            static GPIOEventDispatcherSPtr p_instance = std::make_shared<GPIOEventDispatcher>();
+
+            return p_instance;
+        }
+
+        bool GPIOEventDispatcher::configure(size_t worker_count, size_t ring_capacity, size_t batch_size)
+        {
+            bool success = false;
+
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            // the pool is sized once, when the first handler arrives
+            if ((m_running == false) && (worker_count > 0) && (ring_capacity > 0) && (batch_size > 0))
+            {
+                m_worker_count = worker_count;
+                m_ring_capacity = ring_capacity;
+                m_batch_size = batch_size;
+                success = true;
+            }
+
+            return success;
+        }
+
+        uint32_t GPIOEventDispatcher::register_handler(data::GPIOEventRoutine handler)
+        {
+            uint32_t handler_id = sc_no_handler;
+
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if (start() == true)
+            {
+                handler_id = m_next_handler_id++;
+                m_handlers[handler_id] = std::make_shared<const data::GPIOEventRoutine>(handler);
+            }
+
+            return handler_id;
+        }
+
+        void GPIOEventDispatcher::unregister_handler(uint32_t handler_id)
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                m_handlers.erase(handler_id);
+            }
+
+            // wait out any batch that may still be running the handler,
+            // unless we are being called from within that batch
+            std::thread::id current_thread = std::this_thread::get_id();
+
+            for (auto &p_worker : m_workers)
+            {
+                if (p_worker->thread.get_id() != current_thread)
+                {
+                    std::lock_guard<std::mutex> guard(p_worker->batch_mutex);
+                }
+            }
+        }
+
+        size_t GPIOEventDispatcher::dispatch(uint32_t handler_id, const data::GPIOEvent *events, size_t count)
+        {
+            size_t dropped = 0;
+
+            if ((m_running == true) && (count > 0))
+            {
+                Worker *p_worker = m_workers[handler_id % m_workers.size()].get();
+
+                for (size_t index = 0; index < count; index++)
+                {
+                    if (p_worker->ring.push({ events[index], handler_id }) == false)
+                    {
+                        dropped++;
+                    }
+                }
+
+                if (dropped > 0)
+                {
+                    p_worker->overflow += dropped;
+                }
+
+                // pairs with the fence in run() so a worker going to sleep sees our push
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (p_worker->sleeping.exchange(false) == true)
+                {
+                    std::lock_guard<std::mutex> guard(p_worker->wake_mutex);
+                    p_worker->wake.notify_one();
+                }
+            }
+            else
+            {
+                dropped = count;
+            }
+
+            return dropped;
+        }
+
+        uint64_t GPIOEventDispatcher::get_overflow_count() const
+        {
+            uint64_t overflow = 0;
+
+            for (auto &p_worker : m_workers)
+            {
+                overflow += p_worker->overflow;
+            }
+
+            return overflow;
+        }
+
+        // private parts
+        bool GPIOEventDispatcher::start()
+        {
+            if (m_running == false)
+            {
+                m_running = true;
+
+                for (size_t index = 0; index < m_worker_count; index++)
+                {
+                    m_workers.push_back(std::unique_ptr<Worker>(new Worker(m_ring_capacity)));
+                }
+
+                for (auto &p_worker : m_workers)
+                {
+                    p_worker->thread = std::thread(&GPIOEventDispatcher::run, this, p_worker.get());
+                }
+            }
+
+            return m_running;
+        }
+
+        void GPIOEventDispatcher::stop()
+        {
+            if (m_running == true)
+            {
+                m_running = false;
+
+                for (auto &p_worker : m_workers)
+                {
+                    {
+                        std::lock_guard<std::mutex> guard(p_worker->wake_mutex);
+                        p_worker->sleeping = false;
+                        p_worker->wake.notify_one();
+                    }
+                    p_worker->thread.join();
+                }
+                m_workers.clear();
+            }
+        }
+
+        void GPIOEventDispatcher::run(Worker *p_worker)
+        {
+            std::vector<GPIOQueuedEvent> batch(m_batch_size);
+            std::vector<HandlerSPtr> handlers(m_batch_size);
+
+            while (m_running == true)
+            {
+                size_t count = p_worker->ring.pop(batch.data(), batch.size());
+
+                if (count > 0)
+                {
+                    std::lock_guard<std::mutex> batch_guard(p_worker->batch_mutex);
+
+                    // resolve the whole batch under one lock, then run without it
+                    {
+                        std::lock_guard<std::mutex> guard(m_mutex);
+
+                        for (size_t index = 0; index < count; index++)
+                        {
+                            auto iter = m_handlers.find(batch[index].handler_id);
+
+                            handlers[index] = iter != m_handlers.end() ? iter->second : nullptr;
+                        }
+                    }
+
+                    for (size_t index = 0; index < count; index++)
+                    {
+                        if (handlers[index] != nullptr)
+                        {
+                            AFM_TRACE_SCOPE("interrupt", "handler");
+
+                            (*handlers[index])(batch[index].event);
+                            handlers[index] = nullptr;
+                        }
+                    }
+                }
+                else
+                {
+                    std::unique_lock<std::mutex> guard(p_worker->wake_mutex);
+
+                    p_worker->sleeping = true;
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                    if (p_worker->ring.empty() == false)
+                    {
+                        p_worker->sleeping = false;
+                    }
+                    else
+                    {
+                        p_worker->wake.wait(guard, [p_worker, this]()
+                        {
+                            return (p_worker->sleeping == false) || (m_running == false);
+                        });
+                    }
+                }
+            }
+        }
+
+        GPIOEventSink::GPIOEventSink()
+            : m_polled_events(sc_gpio_poll_capacity)
+            , m_overflow(0)
+        {
+
+        }
+
+        GPIOEventSink::~GPIOEventSink()
+        {
+            detach();
+        }
+
+        void GPIOEventSink::attach(data::GPIOEventRoutine handler)
+        {
+            detach();
+
+            // no handler means the owner will poll for its events
+            if (handler != nullptr)
+            {
+                m_dispatcher = GPIOEventDispatcher::getInstance();
+                m_handler_id = m_dispatcher->register_handler(handler);
+            }
+        }
+
+        void GPIOEventSink::detach()
+        {
+            if (m_handler_id != sc_no_handler)
+            {
+                m_dispatcher->unregister_handler(m_handler_id);
+                m_handler_id = sc_no_handler;
+            }
+        }
+
+        void GPIOEventSink::deliver(const data::GPIOEvent *events, size_t count)
+        {
+            if (m_handler_id != sc_no_handler)
+            {
+                m_overflow += m_dispatcher->dispatch(m_handler_id, events, count);
+            }
+            else
+            {
+                for (size_t index = 0; index < count; index++)
+                {
+                    if (m_polled_events.push(events[index]) == false)
+                    {
+                        m_overflow++;
+                    }
+                }
+            }
+        }
+
+        size_t GPIOEventSink::poll(data::GPIOEvent *events, size_t max_events)
+        {
+            return m_polled_events.pop(events, max_events);
+        }
+    }
+}
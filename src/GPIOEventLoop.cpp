@@ -0,0 +1,171 @@
+/**
+ * GPIOEventLoop.cpp
+ *
+ * Single epoll reactor shared by every pin with interrupts enabled
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GPIOEventLoop.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const int sc_max_epoll_events = 16;
+        const int sc_wait_forever = -1;
+        const uint64_t sc_nanoseconds_per_second = 1000000000ULL;
+
+        GPIOEventLoop::GPIOEventLoop()
+            : m_running(false)
+        {
+
+        }
+
+        GPIOEventLoop::~GPIOEventLoop()
+        {
+            stop();
+        }
+
+        GPIOEventLoopSPtr GPIOEventLoop::getInstance()
+        {
+            static GPIOEventLoopSPtr p_instance = std::make_shared<GPIOEventLoop>();
+
+            return p_instance;
+        }
+
+        bool GPIOEventLoop::add_source(int file_handle, uint32_t events, GPIOEventHandler handler)
+        {
+            bool success = false;
+
+            std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+            if (start() == true)
+            {
+                struct epoll_event event;
+
+                event.events = events;
+                event.data.fd = file_handle;
+
+                if (epoll_ctl(m_epoll_handle, EPOLL_CTL_ADD, file_handle, &event) != -1)
+                {
+                    m_handlers[file_handle] = handler;
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        void GPIOEventLoop::remove_source(int file_handle)
+        {
+            // the reactor holds the lock while dispatching so once we have it
+            // the handler is guaranteed not to be running (or to be our caller)
+            std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+            if (m_handlers.erase(file_handle) > 0)
+            {
+                epoll_ctl(m_epoll_handle, EPOLL_CTL_DEL, file_handle, nullptr);
+            }
+        }
+
+        uint64_t GPIOEventLoop::get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * sc_nanoseconds_per_second) + (uint64_t)now.tv_nsec;
+        }
+
+        // private parts
+        bool GPIOEventLoop::start()
+        {
+            if (m_running == false)
+            {
+                m_epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+                m_wakeup_handle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+                if ((m_epoll_handle != constants::sc_invalid_file_handle) && (m_wakeup_handle != constants::sc_invalid_file_handle))
+                {
+                    struct epoll_event event;
+
+                    event.events = EPOLLIN;
+                    event.data.fd = m_wakeup_handle;
+
+                    if (epoll_ctl(m_epoll_handle, EPOLL_CTL_ADD, m_wakeup_handle, &event) != -1)
+                    {
+                        m_running = true;
+                        m_reactor_thread = std::thread(&GPIOEventLoop::run, this);
+                    }
+                }
+            }
+
+            return m_running;
+        }
+
+        void GPIOEventLoop::stop()
+        {
+            if (m_running == true)
+            {
+                uint64_t wakeup = 1;
+
+                m_running = false;
+                if (::write(m_wakeup_handle, &wakeup, sizeof(wakeup)) == sizeof(wakeup))
+                {
+                    m_reactor_thread.join();
+                }
+                else
+                {
+                    m_reactor_thread.detach();
+                }
+            }
+
+            if (m_epoll_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_epoll_handle);
+                m_epoll_handle = constants::sc_invalid_file_handle;
+            }
+
+            if (m_wakeup_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_wakeup_handle);
+                m_wakeup_handle = constants::sc_invalid_file_handle;
+            }
+        }
+
+        void GPIOEventLoop::run()
+        {
+            struct epoll_event events[sc_max_epoll_events];
+
+            while (m_running == true)
+            {
+                int ready = epoll_wait(m_epoll_handle, events, sc_max_epoll_events, sc_wait_forever);
+
+                for (int index = 0; index < ready; index++)
+                {
+                    if (events[index].data.fd != m_wakeup_handle)
+                    {
+                        std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+                        // may have been removed while we were waiting
+                        auto iter = m_handlers.find(events[index].data.fd);
+                        if (iter != m_handlers.end())
+                        {
+                            GPIOEventHandler handler = iter->second;
+                            AFM_TRACE_SCOPE("interrupt", "event loop dispatch");
+
+                            handler();
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,231 @@
+/**
+ * GPIOLines.cpp
+ *
+ * Holds a set of lines requested from a GPIO character device
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <memory.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "GPIOLines.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const static std::string sc_gpio_chip_dev = "gpiochip%u";
+        const int sc_max_device_name = 32;
+        const char *sc_gpio_consumer = "libdisplay";
+        const size_t sc_max_line_events = 16;
+        const uint64_t sc_gpio_edge_flags[] =
+        {
+            0,
+            GPIO_V2_LINE_FLAG_EDGE_FALLING,
+            GPIO_V2_LINE_FLAG_EDGE_RISING,
+            GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING
+        };
+
+        GPIOLines::GPIOLines()
+        {
+
+        }
+
+        GPIOLines::~GPIOLines()
+        {
+            release();
+        }
+
+        bool GPIOLines::request(uint32_t chip, const std::vector<uint32_t> &lines, bool make_input)
+        {
+            bool success = false;
+
+            release();
+
+            if ((lines.size() > 0) && (lines.size() <= GPIO_V2_LINES_MAX))
+            {
+                char device_name[sc_max_device_name] = {0};
+
+                snprintf(device_name, sc_max_device_name - 1, sc_gpio_chip_dev.c_str(), chip);
+
+                std::string device_file_name = constants::sc_device_path + "/" + device_name;
+
+                int chip_handle = ::open(device_file_name.c_str(), O_RDWR | O_CLOEXEC);
+
+                if (chip_handle != constants::sc_invalid_file_handle)
+                {
+                    struct gpio_v2_line_request line_request;
+
+                    memset(&line_request, 0, sizeof(line_request));
+
+                    for (size_t index = 0; index < lines.size(); index++)
+                    {
+                        line_request.offsets[index] = lines[index];
+                    }
+                    strncpy(line_request.consumer, sc_gpio_consumer, sizeof(line_request.consumer) - 1);
+                    line_request.num_lines = lines.size();
+                    line_request.config.flags = make_input == true ? GPIO_V2_LINE_FLAG_INPUT : GPIO_V2_LINE_FLAG_OUTPUT;
+
+                    if (ioctl(chip_handle, GPIO_V2_GET_LINE_IOCTL, &line_request) != -1)
+                    {
+                        // the chip handle is not needed once the lines are held
+                        m_line_handle = line_request.fd;
+                        m_is_input = make_input;
+                        m_chip = chip;
+                        m_lines = lines;
+                        success = true;
+                    }
+                    ::close(chip_handle);
+                }
+            }
+
+            return success;
+        }
+
+        void GPIOLines::release()
+        {
+            if (m_line_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_line_handle);
+                m_line_handle = constants::sc_invalid_file_handle;
+            }
+            m_lines.clear();
+        }
+
+        bool GPIOLines::set_values(uint64_t mask, uint64_t bits)
+        {
+            bool success = false;
+
+            if (m_line_handle != constants::sc_invalid_file_handle)
+            {
+                if (m_is_input == true)
+                {
+                    set_direction(false);
+                }
+
+                struct gpio_v2_line_values values;
+
+                values.mask = mask;
+                values.bits = bits;
+
+                if (ioctl(m_line_handle, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) != -1)
+                {
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        bool GPIOLines::get_values(uint64_t mask, uint64_t &bits)
+        {
+            bool success = false;
+
+            if (m_line_handle != constants::sc_invalid_file_handle)
+            {
+                struct gpio_v2_line_values values;
+
+                values.mask = mask;
+                values.bits = 0;
+
+                if (ioctl(m_line_handle, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) != -1)
+                {
+                    bits = values.bits;
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        bool GPIOLines::set_direction(bool make_input)
+        {
+            bool success = false;
+
+            if (m_line_handle != constants::sc_invalid_file_handle)
+            {
+                struct gpio_v2_line_config line_config;
+
+                memset(&line_config, 0, sizeof(line_config));
+
+                line_config.flags = make_input == true ? GPIO_V2_LINE_FLAG_INPUT : GPIO_V2_LINE_FLAG_OUTPUT;
+
+                if (ioctl(m_line_handle, GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) != -1)
+                {
+                    m_is_input = make_input;
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        bool GPIOLines::configure_events(data::GPIOInterruptEdge edge, uint32_t debounce_us)
+        {
+            bool success = false;
+
+            if ((m_line_handle != constants::sc_invalid_file_handle) && (edge < data::GPIOInterruptEdge::END_GPIO_INTERRUPT_EDGES))
+            {
+                struct gpio_v2_line_config line_config;
+
+                memset(&line_config, 0, sizeof(line_config));
+
+                // edge detection requires input, timestamps default to CLOCK_MONOTONIC
+                line_config.flags = GPIO_V2_LINE_FLAG_INPUT | sc_gpio_edge_flags[edge];
+
+                if ((edge != data::GPIOInterruptEdge::NONE) && (debounce_us > 0))
+                {
+                    line_config.num_attrs = 1;
+                    line_config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+                    line_config.attrs[0].attr.debounce_period_us = debounce_us;
+                    line_config.attrs[0].mask = (1ULL << m_lines.size()) - 1;
+                }
+
+                if (ioctl(m_line_handle, GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) != -1)
+                {
+                    // never block the reactor when it drains us
+                    int flags = fcntl(m_line_handle, F_GETFL);
+                    if (fcntl(m_line_handle, F_SETFL, flags | O_NONBLOCK) != -1)
+                    {
+                        m_is_input = true;
+                        success = true;
+                    }
+                }
+            }
+
+            return success;
+        }
+
+        size_t GPIOLines::read_events(data::GPIOEvent *events, size_t max_events)
+        {
+            size_t events_read = 0;
+
+            if (m_line_handle != constants::sc_invalid_file_handle)
+            {
+                struct gpio_v2_line_event line_events[sc_max_line_events];
+
+                size_t requested = max_events < sc_max_line_events ? max_events : sc_max_line_events;
+
+                ssize_t bytes_read = ::read(m_line_handle, line_events, requested * sizeof(struct gpio_v2_line_event));
+                if (bytes_read > 0)
+                {
+                    events_read = (size_t)bytes_read / sizeof(struct gpio_v2_line_event);
+
+                    for (size_t index = 0; index < events_read; index++)
+                    {
+                        events[index].pin = line_events[index].offset;
+                        events[index].edge = line_events[index].id == GPIO_V2_LINE_EVENT_RISING_EDGE ?
+                            data::GPIOInterruptEdge::RISING : data::GPIOInterruptEdge::FALLING;
+                        events[index].timestamp_ns = line_events[index].timestamp_ns;
+                    }
+                }
+            }
+
+            return events_read;
+        }
+    }
+}
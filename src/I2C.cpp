@@ -10,13 +10,13 @@
 #include <cstdlib>
 
 #include <fcntl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 #include <memory.h>
 #include <sys/ioctl.h>
+#include <sys/param.h>
 #include <unistd.h>
 
 #include "I2C.h"
+#include "Trace.h"
 
 namespace afm
 {
@@ -29,6 +29,42 @@ namespace afm
         const int sc_tx_buffer_slot = 0;  // slot in an i2c buffer messages
         const int sc_rx_buffer_slot = 1;
         const int sc_i2c_max_messages = 2;
+        const int sc_no_address_selected = -1;
+
+        bool I2CTransaction::add_write(uint16_t address, const uint8_t *p_data, uint16_t length)
+        {
+            bool success = false;
+
+            if (m_message_count < sc_i2c_max_batch)
+            {
+                // the kernel only reads from write buffers
+                m_messages[m_message_count].addr = address;
+                m_messages[m_message_count].flags = 0;
+                m_messages[m_message_count].len = length;
+                m_messages[m_message_count].buf = const_cast<uint8_t *>(p_data);
+                m_message_count++;
+                success = true;
+            }
+
+            return success;
+        }
+
+        bool I2CTransaction::add_read(uint16_t address, uint8_t *p_data, uint16_t length)
+        {
+            bool success = false;
+
+            if (m_message_count < sc_i2c_max_batch)
+            {
+                m_messages[m_message_count].addr = address;
+                m_messages[m_message_count].flags = I2C_M_RD;
+                m_messages[m_message_count].len = length;
+                m_messages[m_message_count].buf = p_data;
+                m_message_count++;
+                success = true;
+            }
+
+            return success;
+        }
 
         I2C::I2C()
             : Port()
@@ -39,85 +75,115 @@ namespace afm
         bool I2C::read(uint8_t &value)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_READ);
+            AFM_TRACE_SCOPE("port", "i2c read");
 
-            if (m_device_handle != constants::sc_invalid_file_handle)
+            if (select_address() == true)
             {
-                if (::read(m_device_handle, &value, sc_max_buffer_size) == 1)
+                statistics.add_syscall();
+                if (::read(m_device_handle, &value, 1) == 1)
                 {
+                    statistics.add_bytes_in(1);
                     success = true;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
         bool I2C::write(uint8_t value)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "i2c write");
 
-            if (m_device_handle != constants::sc_invalid_file_handle)
+            if (select_address() == true)
             {
-                if (::write(m_device_handle, &value, sc_max_buffer_size) == 1)
+                statistics.add_syscall();
+                if (::write(m_device_handle, &value, 1) == 1)
                 {
+                    statistics.add_bytes_out(1);
                     success = true;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
         uint16_t I2C::read(data::Buffer &buffer)
         {
             uint16_t bytes_read = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_READ);
+            AFM_TRACE_SCOPE("port", "i2c read");
 
             if (select_address() == true)
             {
-                data::BufferDataType data_buffer[sc_max_buffer_size] = {0};
+                // a sized buffer is filled to its size, an empty one grows until the device runs dry
+                bool is_streaming = buffer.empty();
+                size_t length = is_streaming == true ? UINT16_MAX : MIN(buffer.size(), (size_t)UINT16_MAX);
+                size_t request = 0;
                 int data_read = 0;
                 do
                 {
-                    data_read = ::read(m_device_handle, data_buffer, sc_max_buffer_size);
+                    request = MIN((size_t)sc_max_buffer_size, length - bytes_read);
+
+                    if (is_streaming == true)
+                    {
+                        // straight into the caller's storage, no bounce buffer
+                        buffer.resize(bytes_read + request);
+                    }
+
+                    statistics.add_syscall();
+                    data_read = ::read(m_device_handle, &buffer[bytes_read], request);
                     if (data_read > 0)
                     {
-                        buffer.reserve(bytes_read + (uint16_t)data_read);
-                        memcpy(&buffer.data()[bytes_read], data_buffer, data_read);
                         bytes_read += (uint16_t)data_read;
                     }
-                } while (data_read == sc_max_buffer_size);
+                } while ((data_read == (int)request) && (bytes_read < length));
+
+                buffer.resize(bytes_read);
             }
 
+            statistics.add_bytes_in(bytes_read);
+            statistics.set_failed(bytes_read == 0);
             return bytes_read;
         }
 
         uint16_t I2C::write(const data::Buffer &buffer)
         {
             uint16_t bytes_written = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "i2c write");
 
             if (select_address() == true)
             {
+                statistics.add_syscall();
                 bytes_written = ::write(m_device_handle, buffer.data(), buffer.size());
             }
 
+            statistics.add_bytes_out(bytes_written);
+            statistics.set_failed(bytes_written != buffer.size());
             return bytes_written;
         }
 
         uint16_t I2C::transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer)
         {
             uint16_t bytes_transferred = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_TRANSFER);
+            AFM_TRACE_SCOPE("port", "i2c transfer");
 
-            if (select_address() == true)
+            if (m_device_handle != constants::sc_invalid_file_handle)
             {
-                data::BufferDataType *tx_data = new data::BufferDataType[output_buffer.size()];
-
                 struct i2c_rdwr_ioctl_data i2c_data;
                 struct i2c_msg messages[sc_i2c_max_messages];
 
-                memcpy(tx_data, output_buffer.data(), output_buffer.size());
-
+                // I2C_RDWR carries its own addresses and the kernel only reads tx buffers
                 messages[sc_tx_buffer_slot].addr = get_device();
                 messages[sc_tx_buffer_slot].flags = 0;
                 messages[sc_tx_buffer_slot].len = output_buffer.size();
-                messages[sc_tx_buffer_slot].buf = tx_data;
+                messages[sc_tx_buffer_slot].buf = const_cast<data::BufferDataType *>(output_buffer.data());
 
                 messages[sc_rx_buffer_slot].addr = get_device();
                 messages[sc_rx_buffer_slot].flags = I2C_M_RD;
@@ -127,18 +193,65 @@ namespace afm
                 i2c_data.nmsgs = sc_i2c_max_messages;
                 i2c_data.msgs = messages;
 
+                statistics.add_syscall();
                 int ioctl_bytes = ioctl(m_device_handle, I2C_RDWR, &i2c_data);
                 if (ioctl_bytes != -1)
                 {
                     bytes_transferred = (uint16_t)ioctl_bytes;
+                    statistics.add_bytes_out(output_buffer.size());
+                    statistics.add_bytes_in(input_buffer.size());
                 }
-
-                delete [] tx_data;
             }
 
+            statistics.set_failed(bytes_transferred == 0);
+
             return bytes_transferred;
         }
 
+        uint16_t I2C::submit(I2CTransaction &transaction)
+        {
+            uint16_t messages_transferred = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_TRANSFER);
+            AFM_TRACE_SCOPE("port", "i2c submit");
+
+            if ((m_device_handle != constants::sc_invalid_file_handle) && (transaction.m_message_count > 0))
+            {
+                struct i2c_rdwr_ioctl_data i2c_data;
+
+                i2c_data.nmsgs = transaction.m_message_count;
+                i2c_data.msgs = transaction.m_messages;
+
+                statistics.add_syscall();
+                int ioctl_messages = ioctl(m_device_handle, I2C_RDWR, &i2c_data);
+                if (ioctl_messages != -1)
+                {
+                    messages_transferred = (uint16_t)ioctl_messages;
+                    for (size_t message = 0; message < transaction.m_message_count; message++)
+                    {
+                        if ((transaction.m_messages[message].flags & I2C_M_RD) != 0)
+                        {
+                            statistics.add_bytes_in(transaction.m_messages[message].len);
+                        }
+                        else
+                        {
+                            statistics.add_bytes_out(transaction.m_messages[message].len);
+                        }
+                    }
+                }
+            }
+
+            statistics.set_failed(messages_transferred != transaction.m_message_count);
+            return messages_transferred;
+        }
+
+        int I2C::get_file_handle()
+        {
+            // plain read/write on i2c-dev goes to the selected address
+            select_address();
+
+            return m_device_handle;
+        }
+
         // internal parts
         bool I2C::setup_device()
         {
@@ -166,6 +279,7 @@ namespace afm
                 ::close(m_device_handle);
                 m_device_handle = constants::sc_invalid_file_handle;
             }
+            m_selected_address = sc_no_address_selected;
         }
 
         // private parts
@@ -175,10 +289,24 @@ namespace afm
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
-                if (ioctl(m_device_handle, I2C_SLAVE, get_device()) >= sc_i2c_success)
+                // the address sticks to the file handle, only set it once
+                if (m_selected_address == (int)get_device())
                 {
                     success = true;
                 }
+                else
+                {
+                    PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_CONTROL);
+                    AFM_TRACE_SCOPE("port", "i2c select_address");
+
+                    statistics.add_syscall();
+                    if (ioctl(m_device_handle, I2C_SLAVE, get_device()) >= sc_i2c_success)
+                    {
+                        m_selected_address = (int)get_device();
+                        success = true;
+                    }
+                    statistics.set_failed(success == false);
+                }
             }
             return success;
         }
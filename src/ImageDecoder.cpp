@@ -0,0 +1,167 @@
+/**
+ * ImageDecoder.cpp
+ *
+ * Base for decoders that stream an image to a display a strip at a time
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <sys/param.h>
+
+#include "BMPDecoder.h"
+#include "ImageDecoder.h"
+#include "PNGDecoder.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const int sc_bmp_first_byte = 'B';
+        const int sc_png_first_byte = 0x89;
+
+        ImageDecoder::ImageDecoder(uint8_t strip_rows) :
+            m_strip_rows(MAX(strip_rows, 1))
+        {
+
+        }
+
+        ImageDecoder::~ImageDecoder()
+        {
+
+        }
+
+        bool ImageDecoder::draw(std::istream &input, IDisplaySPtr p_display, const data::Coordinate_8t &position)
+        {
+            AFM_TRACE_SCOPE("image", "draw");
+            bool success = false;
+
+            if (p_display != nullptr)
+            {
+                m_display = p_display;
+                m_position = position;
+                m_width = 0;
+                m_height = 0;
+
+                if (on_read_header(input) == true)
+                {
+                    success = on_decode(input);
+                }
+                m_display = nullptr;
+            }
+
+            return success;
+        }
+
+        IImageDecoderSPtr ImageDecoder::create(std::istream &input)
+        {
+            IImageDecoderSPtr p_decoder = nullptr;
+            int first_byte = input.peek();
+
+            if (first_byte == sc_bmp_first_byte)
+            {
+                p_decoder = std::make_shared<BMPDecoder>();
+            }
+#ifdef AFM_PNG
+            else if (first_byte == sc_png_first_byte)
+            {
+                p_decoder = std::make_shared<PNGDecoder>();
+            }
+#endif
+
+            return p_decoder;
+        }
+
+        // internal parts
+        bool ImageDecoder::set_size(uint32_t width, uint32_t height, bool is_bottom_up)
+        {
+            bool success = false;
+
+            if ((width > 0) && (height > 0) && (width <= sc_image_max_width) && (height <= sc_image_max_height))
+            {
+                m_width = width;
+                m_height = height;
+                m_is_bottom_up = is_bottom_up;
+                m_rows_done = 0;
+
+                // draw_image and the display coordinates are 8 bit
+                m_visible_width = MIN(width, (uint32_t)(UINT8_MAX - m_position.x + 1));
+                m_visible_height = MIN(height, (uint32_t)(UINT8_MAX - m_position.y + 1));
+
+                // keeps its capacity between images of the same width
+                m_strip.resize((size_t)m_visible_width * m_strip_rows, m_background);
+                success = true;
+            }
+
+            return success;
+        }
+
+        data::Color *ImageDecoder::begin_row()
+        {
+            data::Color *p_row = nullptr;
+            uint32_t row = (m_is_bottom_up == true) ? (m_height - 1 - m_rows_done) : m_rows_done;
+
+            if ((m_rows_done < m_height) && (row < m_visible_height) && (m_visible_width > 0))
+            {
+                p_row = &m_strip[(size_t)(row % m_strip_rows) * m_visible_width];
+            }
+
+            return p_row;
+        }
+
+        void ImageDecoder::end_row()
+        {
+            if (m_rows_done < m_height)
+            {
+                uint32_t row = (m_is_bottom_up == true) ? (m_height - 1 - m_rows_done) : m_rows_done;
+                uint32_t first_row = row - (row % m_strip_rows);
+                uint32_t last_row = MIN(first_row + m_strip_rows, m_height) - 1;
+
+                // strips line up from the top either way, bottom up files finish one at its first row
+                if (((m_is_bottom_up == false) && (row == last_row)) || ((m_is_bottom_up == true) && (row == first_row)))
+                {
+                    flush_strip(first_row, last_row - first_row + 1);
+                }
+                m_rows_done++;
+            }
+        }
+
+        bool ImageDecoder::read_bytes(std::istream &input, uint8_t *p_data, size_t length)
+        {
+            input.read((char *)p_data, length);
+
+            return (size_t)input.gcount() == length;
+        }
+
+        bool ImageDecoder::skip_bytes(std::istream &input, size_t length)
+        {
+            // read rather than seek, pipes and sockets don't seek
+            input.ignore(length);
+
+            return (size_t)input.gcount() == length;
+        }
+
+        uint32_t ImageDecoder::get_le32(const uint8_t *p_data)
+        {
+            return (uint32_t)p_data[0] | ((uint32_t)p_data[1] << 8) | ((uint32_t)p_data[2] << 16) | ((uint32_t)p_data[3] << 24);
+        }
+
+        uint32_t ImageDecoder::get_be32(const uint8_t *p_data)
+        {
+            return ((uint32_t)p_data[0] << 24) | ((uint32_t)p_data[1] << 16) | ((uint32_t)p_data[2] << 8) | (uint32_t)p_data[3];
+        }
+
+        // private parts
+        void ImageDecoder::flush_strip(uint32_t first_row, uint32_t rows)
+        {
+            if ((first_row < m_visible_height) && (m_visible_width > 0))
+            {
+                rows = MIN(rows, m_visible_height - first_row);
+
+                AFM_TRACE_SCOPE("image", "strip");
+                m_display->draw_image(data::Coordinate_8t(m_position.x, (uint8_t)(m_position.y + first_row)),
+                    (uint8_t)m_visible_width, (uint8_t)rows, m_strip.data());
+            }
+        }
+    }
+}
@@ -0,0 +1,228 @@
+/**
+ * IoUring.cpp
+ *
+ * Minimal io_uring submission/completion ring over the raw syscalls
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <memory.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "IoUring.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        template <typename T>
+        T *ring_offset(void *p_ring, uint32_t offset)
+        {
+            return reinterpret_cast<T *>(static_cast<uint8_t *>(p_ring) + offset);
+        }
+
+        IoUring::IoUring()
+        {
+
+        }
+
+        IoUring::~IoUring()
+        {
+            shutdown();
+        }
+
+        bool IoUring::setup(uint32_t entries)
+        {
+            bool success = false;
+            struct io_uring_params params;
+
+            shutdown();
+
+            memset(&params, 0, sizeof(params));
+
+            m_ring_handle = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+            if (m_ring_handle != constants::sc_invalid_file_handle)
+            {
+                m_sq_ring_size = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+                m_cq_ring_size = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+
+                // newer kernels share one mapping between both rings
+                if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+                {
+                    m_sq_ring_size = m_sq_ring_size > m_cq_ring_size ? m_sq_ring_size : m_cq_ring_size;
+                    m_cq_ring_size = 0;
+                }
+
+                m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_handle, IORING_OFF_SQ_RING);
+
+                if (m_sq_ring != MAP_FAILED)
+                {
+                    if (m_cq_ring_size == 0)
+                    {
+                        m_cq_ring = m_sq_ring;
+                    }
+                    else
+                    {
+                        m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_handle, IORING_OFF_CQ_RING);
+                    }
+
+                    m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+                    m_sqes = static_cast<struct io_uring_sqe *>(mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_handle, IORING_OFF_SQES));
+
+                    if ((m_cq_ring != MAP_FAILED) && (m_sqes != MAP_FAILED))
+                    {
+                        m_sq_head = ring_offset<uint32_t>(m_sq_ring, params.sq_off.head);
+                        m_sq_tail = ring_offset<uint32_t>(m_sq_ring, params.sq_off.tail);
+                        m_sq_array = ring_offset<uint32_t>(m_sq_ring, params.sq_off.array);
+                        m_sq_mask = *ring_offset<uint32_t>(m_sq_ring, params.sq_off.ring_mask);
+                        m_sq_entries = params.sq_entries;
+
+                        m_cq_head = ring_offset<uint32_t>(m_cq_ring, params.cq_off.head);
+                        m_cq_tail = ring_offset<uint32_t>(m_cq_ring, params.cq_off.tail);
+                        m_cq_mask = *ring_offset<uint32_t>(m_cq_ring, params.cq_off.ring_mask);
+                        m_cqes = ring_offset<struct io_uring_cqe>(m_cq_ring, params.cq_off.cqes);
+
+                        success = true;
+                    }
+                }
+            }
+
+            if (success == false)
+            {
+                shutdown();
+            }
+
+            return success;
+        }
+
+        void IoUring::shutdown()
+        {
+            unregister_buffers();
+
+            if ((m_sqes != nullptr) && (m_sqes != MAP_FAILED))
+            {
+                munmap(m_sqes, m_sqes_size);
+            }
+            if ((m_cq_ring != nullptr) && (m_cq_ring != MAP_FAILED) && (m_cq_ring != m_sq_ring))
+            {
+                munmap(m_cq_ring, m_cq_ring_size);
+            }
+            if ((m_sq_ring != nullptr) && (m_sq_ring != MAP_FAILED))
+            {
+                munmap(m_sq_ring, m_sq_ring_size);
+            }
+            m_sqes = nullptr;
+            m_cq_ring = nullptr;
+            m_sq_ring = nullptr;
+            m_sq_pending = 0;
+
+            if (m_ring_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_ring_handle);
+                m_ring_handle = constants::sc_invalid_file_handle;
+            }
+        }
+
+        struct io_uring_sqe *IoUring::get_sqe()
+        {
+            struct io_uring_sqe *p_sqe = nullptr;
+
+            if (is_setup() == true)
+            {
+                uint32_t tail = *m_sq_tail + m_sq_pending;
+                uint32_t head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+
+                if ((tail - head) < m_sq_entries)
+                {
+                    p_sqe = &m_sqes[tail & m_sq_mask];
+                    memset(p_sqe, 0, sizeof(*p_sqe));
+                    m_sq_array[tail & m_sq_mask] = tail & m_sq_mask;
+                    m_sq_pending++;
+                }
+            }
+
+            return p_sqe;
+        }
+
+        int IoUring::submit()
+        {
+            int submitted = 0;
+
+            if (is_setup() == true)
+            {
+                // publish the new entries before telling the kernel about them
+                if (m_sq_pending > 0)
+                {
+                    __atomic_store_n(m_sq_tail, *m_sq_tail + m_sq_pending, __ATOMIC_RELEASE);
+                    m_sq_pending = 0;
+                }
+
+                // entries an earlier failed enter left behind go along too
+                uint32_t to_submit = *m_sq_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+                if (to_submit > 0)
+                {
+                    submitted = (int)syscall(__NR_io_uring_enter, m_ring_handle, to_submit, 0, 0, nullptr, 0);
+                }
+            }
+
+            return submitted;
+        }
+
+        int IoUring::wait(uint32_t min_complete)
+        {
+            return (int)syscall(__NR_io_uring_enter, m_ring_handle, 0, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+        }
+
+        struct io_uring_cqe *IoUring::peek_cqe()
+        {
+            struct io_uring_cqe *p_cqe = nullptr;
+
+            if (is_setup() == true)
+            {
+                uint32_t head = *m_cq_head;
+
+                if (head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+                {
+                    p_cqe = &m_cqes[head & m_cq_mask];
+                }
+            }
+
+            return p_cqe;
+        }
+
+        void IoUring::cqe_seen()
+        {
+            __atomic_store_n(m_cq_head, *m_cq_head + 1, __ATOMIC_RELEASE);
+        }
+
+        bool IoUring::register_buffers(const struct iovec *p_buffers, uint32_t count)
+        {
+            bool success = false;
+
+            unregister_buffers();
+
+            if (is_setup() == true)
+            {
+                if (syscall(__NR_io_uring_register, m_ring_handle, IORING_REGISTER_BUFFERS, p_buffers, count) == 0)
+                {
+                    m_buffers_registered = true;
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        void IoUring::unregister_buffers()
+        {
+            if (m_buffers_registered == true)
+            {
+                syscall(__NR_io_uring_register, m_ring_handle, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+                m_buffers_registered = false;
+            }
+        }
+    }
+}
@@ -0,0 +1,392 @@
+/**
+ * MappedFramebuffer.cpp
+ *
+ * Plain pixel array over a display, changes are found by write protecting its pages
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MappedFramebuffer.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const size_t sc_bits_per_dirty_word = 64;
+        const uint64_t sc_nanoseconds_per_second = 1000000000ULL;
+
+        static std::mutex s_mutex;
+        static std::atomic<MappedFramebuffer *> s_framebuffers[sc_max_mapped_framebuffers];
+        static size_t s_installed = 0;
+        static struct sigaction s_previous_action;
+
+        static uint64_t get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * sc_nanoseconds_per_second) + (uint64_t)now.tv_nsec;
+        }
+
+        static void sleep_until(uint64_t deadline_ns)
+        {
+            struct timespec deadline;
+
+            deadline.tv_sec = deadline_ns / sc_nanoseconds_per_second;
+            deadline.tv_nsec = deadline_ns % sc_nanoseconds_per_second;
+
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+            {
+            }
+        }
+
+        static inline bool is_same(const data::Color &left, const data::Color &right)
+        {
+            return (left.red == right.red) && (left.green == right.green) && (left.blue == right.blue);
+        }
+
+        MappedFramebuffer::MappedFramebuffer(IDisplaySPtr p_display, uint16_t x_resolution, uint16_t y_resolution)
+            : m_display(p_display)
+            , m_width(x_resolution)
+            , m_height(y_resolution)
+            , m_faults(0)
+            , m_running(false)
+        {
+        }
+
+        MappedFramebuffer::~MappedFramebuffer()
+        {
+            stop();
+        }
+
+        bool MappedFramebuffer::start(uint32_t refresh_rate_hz)
+        {
+            bool success = false;
+
+            stop();
+
+            if ((m_display != nullptr) && (m_width > 0) && (m_height > 0))
+            {
+                size_t page_size = sysconf(_SC_PAGESIZE);
+                size_t size = (((size_t)m_width * m_height * sizeof(data::Color)) + page_size - 1) & ~(page_size - 1);
+
+                // read only from the start, the first write to every page has to be seen
+                void *p_memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if (p_memory != MAP_FAILED)
+                {
+                    m_p_pixels = static_cast<data::Color *>(p_memory);
+                    m_page_size = page_size;
+                    m_mapped_size = size;
+                    m_dirty_words = ((size / page_size) + sc_bits_per_dirty_word - 1) / sc_bits_per_dirty_word;
+                    m_dirty_pages.reset(new std::atomic<uint64_t>[m_dirty_words]);
+                    for (size_t word = 0; word < m_dirty_words; word++)
+                    {
+                        m_dirty_pages[word].store(0, std::memory_order_relaxed);
+                    }
+                    m_faults = 0;
+
+                    // everything the flusher touches is sized here, a pass never allocates
+                    m_shown.assign((size_t)m_width * m_height, constants::BLACK);
+                    m_is_row_dirty.assign(m_height, 0);
+                    m_staging.reserve((size_t)m_width * m_height);
+                    m_damage.clear();
+                    m_statistics = MappedFramebufferStatistics();
+
+                    if (install(this) == true)
+                    {
+                        // fresh pages are zero, which is black, make the panel agree
+                        m_display->clear_screen(constants::BLACK);
+
+                        if (refresh_rate_hz > 0)
+                        {
+                            m_period_ns = sc_nanoseconds_per_second / refresh_rate_hz;
+                            m_running = true;
+                            m_flusher_thread = std::thread(&MappedFramebuffer::run, this);
+                        }
+                        success = true;
+                    }
+                    else
+                    {
+                        munmap(p_memory, size);
+                        m_p_pixels = nullptr;
+                        m_dirty_pages.reset();
+                    }
+                }
+            }
+
+            return success;
+        }
+
+        void MappedFramebuffer::stop()
+        {
+            if (m_running == true)
+            {
+                m_running = false;
+                m_flusher_thread.join();
+            }
+
+            if (m_p_pixels != nullptr)
+            {
+                // whatever was drawn since the last pass still goes out
+                flush();
+
+                uninstall(this);
+                munmap(m_p_pixels, m_mapped_size);
+                m_p_pixels = nullptr;
+                m_dirty_pages.reset();
+            }
+        }
+
+        void MappedFramebuffer::flush()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if (m_p_pixels != nullptr)
+            {
+                present();
+            }
+        }
+
+        MappedFramebufferStatistics MappedFramebuffer::get_statistics()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            MappedFramebufferStatistics statistics = m_statistics;
+
+            statistics.faults = m_faults.load(std::memory_order_relaxed);
+
+            return statistics;
+        }
+
+        // private parts
+        void MappedFramebuffer::run()
+        {
+            uint64_t deadline_ns = get_timestamp();
+
+            while (m_running == true)
+            {
+                uint64_t now_ns = get_timestamp();
+
+                // a slow pass skips the periods it overran rather than catching up
+                deadline_ns = (deadline_ns + m_period_ns) > now_ns ? (deadline_ns + m_period_ns) : now_ns;
+                sleep_until(deadline_ns);
+
+                flush();
+            }
+        }
+
+        void MappedFramebuffer::present()
+        {
+            AFM_TRACE_SCOPE("display", "mapped framebuffer pass");
+            uint8_t *p_base = reinterpret_cast<uint8_t *>(m_p_pixels);
+            size_t pixel_bytes = (size_t)m_width * m_height * sizeof(data::Color);
+            size_t row_bytes = (size_t)m_width * sizeof(data::Color);
+
+            m_statistics.passes++;
+
+            for (size_t word = 0; word < m_dirty_words; word++)
+            {
+                uint64_t bits = m_dirty_pages[word].exchange(0, std::memory_order_acq_rel);
+
+                for (size_t bit = 0; (bits != 0) && (bit < sc_bits_per_dirty_word); bit++)
+                {
+                    if (((bits >> bit) & 1) != 0)
+                    {
+                        size_t page = (word * sc_bits_per_dirty_word) + bit;
+                        size_t first_byte = page * m_page_size;
+                        size_t last_byte = std::min(first_byte + m_page_size, pixel_bytes) - 1;
+
+                        // protect before reading, a write landing during the diff faults and marks the page again
+                        mprotect(p_base + first_byte, m_page_size, PROT_READ);
+
+                        if (first_byte < pixel_bytes)
+                        {
+                            for (size_t row = first_byte / row_bytes; row <= (last_byte / row_bytes); row++)
+                            {
+                                m_is_row_dirty[row] = 1;
+                            }
+                        }
+                        bits &= ~((uint64_t)1 << bit);
+                        m_statistics.pages++;
+                    }
+                }
+            }
+
+            for (uint16_t row = 0; row < m_height; row++)
+            {
+                if (m_is_row_dirty[row] != 0)
+                {
+                    m_is_row_dirty[row] = 0;
+                    diff_row(row);
+                }
+            }
+
+            // sent from the copy, which is what was compared, not from pixels that may be moving
+            for (const DamageRectangle &rectangle : m_damage.get_rectangles())
+            {
+                uint16_t width = rectangle.x2 - rectangle.x1 + 1;
+                uint16_t height = rectangle.y2 - rectangle.y1 + 1;
+                const data::Color *p_first = &m_shown[(size_t)(rectangle.y1 - 1) * m_width + (rectangle.x1 - 1)];
+
+                if (width == m_width)
+                {
+                    m_display->draw_image(data::Coordinate_8t(rectangle.x1, rectangle.y1), width, height, p_first);
+                }
+                else
+                {
+                    m_staging.clear();
+                    for (uint16_t y = 0; y < height; y++)
+                    {
+                        m_staging.insert(m_staging.end(), p_first + (size_t)y * m_width, p_first + (size_t)y * m_width + width);
+                    }
+                    m_display->draw_image(data::Coordinate_8t(rectangle.x1, rectangle.y1), width, height, m_staging.data());
+                }
+
+                m_statistics.windows++;
+                m_statistics.pixels += (uint32_t)width * height;
+            }
+            m_damage.clear();
+        }
+
+        void MappedFramebuffer::diff_row(uint16_t row)
+        {
+            const data::Color *p_live = m_p_pixels + (size_t)row * m_width;
+            data::Color *p_shown = &m_shown[(size_t)row * m_width];
+            uint16_t first = 0;
+            uint16_t last = m_width;
+
+            while ((first < m_width) && (is_same(p_live[first], p_shown[first]) == true))
+            {
+                first++;
+            }
+
+            if (first < m_width)
+            {
+                while (is_same(p_live[last - 1], p_shown[last - 1]) == true)
+                {
+                    last--;
+                }
+
+                std::copy(p_live + first, p_live + last, p_shown + first);
+                m_damage.add(DamageRectangle{ (uint16_t)(first + 1), (uint16_t)(row + 1), last, (uint16_t)(row + 1) });
+                m_statistics.rows++;
+            }
+        }
+
+        bool MappedFramebuffer::mark_dirty(void *p_address)
+        {
+            bool is_ours = false;
+            uint8_t *p_base = reinterpret_cast<uint8_t *>(m_p_pixels);
+            uint8_t *p_fault = static_cast<uint8_t *>(p_address);
+
+            if ((p_base != nullptr) && (p_fault >= p_base) && (p_fault < (p_base + m_mapped_size)))
+            {
+                size_t page = (p_fault - p_base) / m_page_size;
+
+                // open first, then mark: a pass clearing the mark in between protects the page again after us
+                mprotect(p_base + (page * m_page_size), m_page_size, PROT_READ | PROT_WRITE);
+                m_dirty_pages[page / sc_bits_per_dirty_word].fetch_or((uint64_t)1 << (page % sc_bits_per_dirty_word), std::memory_order_release);
+                m_faults.fetch_add(1, std::memory_order_relaxed);
+                is_ours = true;
+            }
+
+            return is_ours;
+        }
+
+        void MappedFramebuffer::on_fault(int signal_number, siginfo_t *p_information, void *p_context)
+        {
+            bool is_handled = false;
+
+            for (size_t index = 0; (index < sc_max_mapped_framebuffers) && (is_handled == false); index++)
+            {
+                MappedFramebuffer *p_framebuffer = s_framebuffers[index].load(std::memory_order_acquire);
+
+                if (p_framebuffer != nullptr)
+                {
+                    is_handled = p_framebuffer->mark_dirty(p_information->si_addr);
+                }
+            }
+
+            if (is_handled == false)
+            {
+                // not ours, behave as if we had never been installed
+                if (((s_previous_action.sa_flags & SA_SIGINFO) != 0) && (s_previous_action.sa_sigaction != nullptr))
+                {
+                    s_previous_action.sa_sigaction(signal_number, p_information, p_context);
+                }
+                else if ((s_previous_action.sa_handler != SIG_DFL) && (s_previous_action.sa_handler != SIG_IGN))
+                {
+                    s_previous_action.sa_handler(signal_number);
+                }
+                else
+                {
+                    // the faulting access runs again on return and takes the default action
+                    sigaction(signal_number, &s_previous_action, nullptr);
+                }
+            }
+        }
+
+        bool MappedFramebuffer::install(MappedFramebuffer *p_framebuffer)
+        {
+            std::lock_guard<std::mutex> guard(s_mutex);
+            bool success = false;
+
+            for (size_t index = 0; (index < sc_max_mapped_framebuffers) && (success == false); index++)
+            {
+                if (s_framebuffers[index].load(std::memory_order_relaxed) == nullptr)
+                {
+                    // first one in takes over SIGSEGV
+                    if (s_installed == 0)
+                    {
+                        struct sigaction action;
+
+                        memset(&action, 0, sizeof(action));
+                        sigemptyset(&action.sa_mask);
+                        action.sa_sigaction = &MappedFramebuffer::on_fault;
+                        action.sa_flags = SA_SIGINFO | SA_RESTART;
+
+                        if (sigaction(SIGSEGV, &action, &s_previous_action) != 0)
+                        {
+                            break;
+                        }
+                    }
+
+                    s_framebuffers[index].store(p_framebuffer, std::memory_order_release);
+                    s_installed++;
+                    success = true;
+                }
+            }
+
+            return success;
+        }
+
+        void MappedFramebuffer::uninstall(MappedFramebuffer *p_framebuffer)
+        {
+            std::lock_guard<std::mutex> guard(s_mutex);
+
+            for (size_t index = 0; index < sc_max_mapped_framebuffers; index++)
+            {
+                if (s_framebuffers[index].load(std::memory_order_relaxed) == p_framebuffer)
+                {
+                    s_framebuffers[index].store(nullptr, std::memory_order_release);
+                    s_installed--;
+
+                    // last one out puts back whoever had it before
+                    if (s_installed == 0)
+                    {
+                        sigaction(SIGSEGV, &s_previous_action, nullptr);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,511 @@
+/**
+ * PNGDecoder.cpp
+ *
+ * Streaming decoder for PNG images, built when zlib is available
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/param.h>
+#include <zlib.h>
+
+#include "PNGDecoder.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const uint8_t sc_png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        const size_t sc_png_header_size = 13;
+        const uint32_t sc_png_ihdr = 0x49484452;
+        const uint32_t sc_png_plte = 0x504C5445;
+        const uint32_t sc_png_trns = 0x74524E53;
+        const uint32_t sc_png_idat = 0x49444154;
+        const uint32_t sc_png_iend = 0x49454E44;
+        const uint32_t sc_png_ancillary_bit = 0x20000000;   // lower case first letter
+
+        enum PNGColorType
+        {
+            PNG_GRAY = 0,
+            PNG_RGB = 2,
+            PNG_PALETTE = 3,
+            PNG_GRAY_ALPHA = 4,
+            PNG_RGB_ALPHA = 6
+        };
+
+        enum PNGFilter
+        {
+            PNG_FILTER_NONE,
+            PNG_FILTER_SUB,
+            PNG_FILTER_UP,
+            PNG_FILTER_AVERAGE,
+            PNG_FILTER_PAETH,
+            END_PNG_FILTERS
+        };
+
+        static uint8_t paeth(uint8_t left, uint8_t up, uint8_t up_left)
+        {
+            int estimate = (int)left + up - up_left;
+            int left_distance = abs(estimate - left);
+            int up_distance = abs(estimate - up);
+            int up_left_distance = abs(estimate - up_left);
+            uint8_t predictor = up_left;
+
+            if ((left_distance <= up_distance) && (left_distance <= up_left_distance))
+            {
+                predictor = left;
+            }
+            else if (up_distance <= up_left_distance)
+            {
+                predictor = up;
+            }
+
+            return predictor;
+        }
+
+        PNGDecoder::PNGDecoder(uint8_t strip_rows) :
+            ImageDecoder(strip_rows),
+            m_p_stream(new z_stream_s())
+        {
+            m_palette.reserve(sc_png_max_palette);
+            m_palette_alpha.reserve(sc_png_max_palette);
+            m_input.resize(sc_png_input_size);
+        }
+
+        PNGDecoder::~PNGDecoder()
+        {
+            if (m_is_stream_ready == true)
+            {
+                inflateEnd(m_p_stream.get());
+            }
+        }
+
+        // internal parts
+        bool PNGDecoder::on_read_header(std::istream &input)
+        {
+            bool success = false;
+            uint8_t signature[sizeof(sc_png_signature)];
+            uint8_t header[sc_png_header_size];
+            uint32_t length = 0;
+            uint32_t type = 0;
+
+            if ((read_bytes(input, signature, sizeof(signature)) == true) &&
+                (memcmp(signature, sc_png_signature, sizeof(signature)) == 0) &&
+                (read_chunk_header(input, length, type) == true) && (type == sc_png_ihdr) && (length == sizeof(header)) &&
+                (read_chunk_data(input, header, sizeof(header)) == true) && (finish_chunk(input) == true))
+            {
+                uint32_t width = get_be32(&header[0]);
+                uint32_t height = get_be32(&header[4]);
+                uint8_t depth = header[8];
+                bool is_valid = (header[10] == 0) && (header[11] == 0) && (header[12] == 0);   // deflate, adaptive, not interlaced
+
+                m_bit_depth = depth;
+                m_color_type = header[9];
+                switch (m_color_type)
+                {
+                    case PNG_GRAY:
+                        m_channels = 1;
+                        is_valid = is_valid && ((depth == 1) || (depth == 2) || (depth == 4) || (depth == 8) || (depth == 16));
+                        break;
+
+                    case PNG_RGB:
+                        m_channels = 3;
+                        is_valid = is_valid && ((depth == 8) || (depth == 16));
+                        break;
+
+                    case PNG_PALETTE:
+                        m_channels = 1;
+                        is_valid = is_valid && ((depth == 1) || (depth == 2) || (depth == 4) || (depth == 8));
+                        break;
+
+                    case PNG_GRAY_ALPHA:
+                        m_channels = 2;
+                        is_valid = is_valid && ((depth == 8) || (depth == 16));
+                        break;
+
+                    case PNG_RGB_ALPHA:
+                        m_channels = 4;
+                        is_valid = is_valid && ((depth == 8) || (depth == 16));
+                        break;
+
+                    default:
+                        is_valid = false;
+                        break;
+                }
+
+                if ((is_valid == true) && (set_size(width, height, false) == true))
+                {
+                    m_stride = ((width * m_channels * m_bit_depth) + 7) / 8;
+                    m_pixel_bytes = MAX((uint32_t)(m_channels * m_bit_depth) / 8, 1);
+                    m_row.assign(m_stride + 1, 0);
+                    m_previous.assign(m_stride + 1, 0);
+                    m_row_fill = 0;
+                    m_rows_inflated = 0;
+                    m_has_key = false;
+                    m_palette.clear();
+                    m_palette_alpha.clear();
+
+                    // one inflate state for the life of the decoder
+                    if (m_is_stream_ready == true)
+                    {
+                        success = (inflateReset(m_p_stream.get()) == Z_OK);
+                    }
+                    else
+                    {
+                        memset(m_p_stream.get(), 0, sizeof(z_stream_s));
+                        m_is_stream_ready = (inflateInit(m_p_stream.get()) == Z_OK);
+                        success = m_is_stream_ready;
+                    }
+                }
+            }
+
+            return success;
+        }
+
+        bool PNGDecoder::on_decode(std::istream &input)
+        {
+            bool success = true;
+            bool is_done = false;
+
+            while ((success == true) && (is_done == false))
+            {
+                uint32_t length = 0;
+                uint32_t type = 0;
+
+                success = read_chunk_header(input, length, type);
+                if (success == true)
+                {
+                    if (type == sc_png_idat)
+                    {
+                        success = inflate_chunk(input, length);
+                    }
+                    else if (type == sc_png_plte)
+                    {
+                        success = read_palette(input, length);
+                    }
+                    else if (type == sc_png_trns)
+                    {
+                        success = read_transparency(input, length);
+                    }
+                    else if (type == sc_png_iend)
+                    {
+                        success = finish_chunk(input);
+                        is_done = true;
+                    }
+                    else if ((type & sc_png_ancillary_bit) != 0)
+                    {
+                        // not needed for drawing, not worth checking
+                        success = skip_bytes(input, (size_t)length + sizeof(uint32_t));
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+                }
+            }
+
+            return (success == true) && (m_rows_inflated == get_height());
+        }
+
+        // private parts
+        bool PNGDecoder::read_chunk_header(std::istream &input, uint32_t &length, uint32_t &type)
+        {
+            bool success = false;
+            uint8_t header[2 * sizeof(uint32_t)];
+
+            if (read_bytes(input, header, sizeof(header)) == true)
+            {
+                length = get_be32(&header[0]);
+                type = get_be32(&header[4]);
+                m_crc = crc32(0, &header[4], sizeof(uint32_t));
+                success = (length <= INT32_MAX);
+            }
+
+            return success;
+        }
+
+        bool PNGDecoder::read_chunk_data(std::istream &input, uint8_t *p_data, size_t length)
+        {
+            bool success = read_bytes(input, p_data, length);
+
+            if (success == true)
+            {
+                m_crc = crc32(m_crc, p_data, (uInt)length);
+            }
+
+            return success;
+        }
+
+        bool PNGDecoder::finish_chunk(std::istream &input)
+        {
+            uint8_t crc[sizeof(uint32_t)];
+
+            return (read_bytes(input, crc, sizeof(crc)) == true) && (get_be32(crc) == m_crc);
+        }
+
+        bool PNGDecoder::read_palette(std::istream &input, uint32_t length)
+        {
+            bool success = ((length % 3) == 0) && ((length / 3) <= sc_png_max_palette) && (read_chunk_data(input, m_input.data(), length) == true);
+
+            if (success == true)
+            {
+                m_palette.clear();
+                for (uint32_t entry = 0; entry < (length / 3); entry++)
+                {
+                    m_palette.push_back(data::Color(m_input[entry * 3], m_input[(entry * 3) + 1], m_input[(entry * 3) + 2]));
+                }
+                success = finish_chunk(input);
+            }
+
+            return success;
+        }
+
+        bool PNGDecoder::read_transparency(std::istream &input, uint32_t length)
+        {
+            bool success = (length <= sc_png_max_palette) && (read_chunk_data(input, m_input.data(), length) == true);
+
+            if (success == true)
+            {
+                // alpha per palette entry, or the one gray / rgb value that is fully transparent
+                if (m_color_type == PNG_PALETTE)
+                {
+                    m_palette_alpha.assign(m_input.begin(), m_input.begin() + length);
+                }
+                else if ((m_color_type == PNG_GRAY) && (length >= 2))
+                {
+                    m_key[0] = (uint16_t)((m_input[0] << 8) | m_input[1]);
+                    m_has_key = true;
+                }
+                else if ((m_color_type == PNG_RGB) && (length >= 6))
+                {
+                    for (uint8_t channel = 0; channel < 3; channel++)
+                    {
+                        m_key[channel] = (uint16_t)((m_input[channel * 2] << 8) | m_input[(channel * 2) + 1]);
+                    }
+                    m_has_key = true;
+                }
+                success = finish_chunk(input);
+            }
+
+            return success;
+        }
+
+        bool PNGDecoder::inflate_chunk(std::istream &input, uint32_t length)
+        {
+            AFM_TRACE_SCOPE("image", "inflate");
+            bool success = true;
+            z_stream_s *p_stream = m_p_stream.get();
+
+            while ((length > 0) && (success == true))
+            {
+                uint32_t count = MIN(length, (uint32_t)m_input.size());
+
+                success = read_chunk_data(input, m_input.data(), count);
+                length -= count;
+
+                p_stream->next_in = m_input.data();
+                p_stream->avail_in = count;
+
+                // inflate into whatever is left of the current row, a row at a time
+                while ((success == true) && (p_stream->avail_in > 0) && (m_rows_inflated < get_height()))
+                {
+                    p_stream->next_out = &m_row[m_row_fill];
+                    p_stream->avail_out = (uInt)(m_row.size() - m_row_fill);
+
+                    int result = inflate(p_stream, Z_NO_FLUSH);
+
+                    m_row_fill = m_row.size() - p_stream->avail_out;
+                    if (m_row_fill == m_row.size())
+                    {
+                        success = complete_row();
+                    }
+
+                    if ((result == Z_STREAM_END) || (result == Z_BUF_ERROR))
+                    {
+                        break;
+                    }
+                    success = success && (result == Z_OK);
+                }
+            }
+
+            return (success == true) && (finish_chunk(input) == true);
+        }
+
+        bool PNGDecoder::complete_row()
+        {
+            bool success = true;
+            uint8_t *p_data = &m_row[1];
+            const uint8_t *p_prior = &m_previous[1];
+
+            switch (m_row[0])
+            {
+                case PNG_FILTER_NONE:
+                    break;
+
+                case PNG_FILTER_SUB:
+                    for (uint32_t index = m_pixel_bytes; index < m_stride; index++)
+                    {
+                        p_data[index] += p_data[index - m_pixel_bytes];
+                    }
+                    break;
+
+                case PNG_FILTER_UP:
+                    for (uint32_t index = 0; index < m_stride; index++)
+                    {
+                        p_data[index] += p_prior[index];
+                    }
+                    break;
+
+                case PNG_FILTER_AVERAGE:
+                    for (uint32_t index = 0; index < m_stride; index++)
+                    {
+                        uint8_t left = (index >= m_pixel_bytes) ? p_data[index - m_pixel_bytes] : 0;
+
+                        p_data[index] += (uint8_t)(((uint32_t)left + p_prior[index]) / 2);
+                    }
+                    break;
+
+                case PNG_FILTER_PAETH:
+                    for (uint32_t index = 0; index < m_stride; index++)
+                    {
+                        uint8_t left = (index >= m_pixel_bytes) ? p_data[index - m_pixel_bytes] : 0;
+                        uint8_t up_left = (index >= m_pixel_bytes) ? p_prior[index - m_pixel_bytes] : 0;
+
+                        p_data[index] += paeth(left, p_prior[index], up_left);
+                    }
+                    break;
+
+                default:
+                    success = false;
+                    break;
+            }
+
+            if (success == true)
+            {
+                data::Color *p_row = begin_row();
+
+                if (p_row != nullptr)
+                {
+                    convert_row(p_row);
+                }
+                end_row();
+
+                // this row is what the next one is filtered against
+                std::swap(m_row, m_previous);
+                m_row_fill = 0;
+                m_rows_inflated++;
+            }
+
+            return success;
+        }
+
+        void PNGDecoder::convert_row(data::Color *p_row) const
+        {
+            const uint8_t *p_data = &m_row[1];
+            const uint32_t maximum = (1u << m_bit_depth) - 1;
+            uint32_t width = get_visible_width();
+
+            // samples to 8 bits, 16 bit keeps its high byte
+            auto scale = [this, maximum](uint16_t sample)
+            {
+                return (uint8_t)((m_bit_depth == 16) ? (sample >> 8) : ((m_bit_depth == 8) ? sample : ((sample * 255) / maximum)));
+            };
+
+            for (uint32_t x = 0; x < width; x++)
+            {
+                switch (m_color_type)
+                {
+                    case PNG_GRAY:
+                    {
+                        uint16_t gray = get_sample(p_data, x);
+                        uint8_t alpha = ((m_has_key == true) && (gray == m_key[0])) ? 0 : UINT8_MAX;
+
+                        p_row[x] = blend(scale(gray), scale(gray), scale(gray), alpha);
+                        break;
+                    }
+
+                    case PNG_RGB:
+                    {
+                        uint16_t red = get_sample(p_data, (x * 3));
+                        uint16_t green = get_sample(p_data, (x * 3) + 1);
+                        uint16_t blue = get_sample(p_data, (x * 3) + 2);
+                        bool is_key = (m_has_key == true) && (red == m_key[0]) && (green == m_key[1]) && (blue == m_key[2]);
+
+                        p_row[x] = blend(scale(red), scale(green), scale(blue), (is_key == true) ? 0 : UINT8_MAX);
+                        break;
+                    }
+
+                    case PNG_PALETTE:
+                    {
+                        uint16_t index = get_sample(p_data, x);
+                        data::Color color = (index < m_palette.size()) ? m_palette[index] : constants::BLACK;
+                        uint8_t alpha = (index < m_palette_alpha.size()) ? m_palette_alpha[index] : UINT8_MAX;
+
+                        p_row[x] = blend(color.red, color.green, color.blue, alpha);
+                        break;
+                    }
+
+                    case PNG_GRAY_ALPHA:
+                    {
+                        uint8_t gray = scale(get_sample(p_data, x * 2));
+
+                        p_row[x] = blend(gray, gray, gray, scale(get_sample(p_data, (x * 2) + 1)));
+                        break;
+                    }
+
+                    case PNG_RGB_ALPHA:
+                        p_row[x] = blend(scale(get_sample(p_data, x * 4)), scale(get_sample(p_data, (x * 4) + 1)),
+                            scale(get_sample(p_data, (x * 4) + 2)), scale(get_sample(p_data, (x * 4) + 3)));
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+
+        uint16_t PNGDecoder::get_sample(const uint8_t *p_data, uint32_t index) const
+        {
+            uint16_t sample = 0;
+
+            if (m_bit_depth == 8)
+            {
+                sample = p_data[index];
+            }
+            else if (m_bit_depth == 16)
+            {
+                sample = (uint16_t)((p_data[index * 2] << 8) | p_data[(index * 2) + 1]);
+            }
+            else
+            {
+                // packed from the high bits down
+                uint32_t bit = index * m_bit_depth;
+                uint8_t shift = (uint8_t)(8 - m_bit_depth - (bit % 8));
+
+                sample = (p_data[bit / 8] >> shift) & ((1 << m_bit_depth) - 1);
+            }
+
+            return sample;
+        }
+
+        data::Color PNGDecoder::blend(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) const
+        {
+            data::Color color(red, green, blue);
+
+            if (alpha != UINT8_MAX)
+            {
+                const data::Color &background = get_background();
+
+                color.red = (uint8_t)(((red * alpha) + (background.red * (UINT8_MAX - alpha)) + 127) / UINT8_MAX);
+                color.green = (uint8_t)(((green * alpha) + (background.green * (UINT8_MAX - alpha)) + 127) / UINT8_MAX);
+                color.blue = (uint8_t)(((blue * alpha) + (background.blue * (UINT8_MAX - alpha)) + 127) / UINT8_MAX);
+            }
+
+            return color;
+        }
+    }
+}
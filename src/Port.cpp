@@ -11,6 +11,7 @@ namespace afm
     namespace communication
     {
         Port::Port()
+            : m_statistics(std::make_shared<PortStatistics>())
         {
 
         }
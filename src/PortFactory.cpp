@@ -8,86 +8,76 @@
 
 #include "PortFactory.h"
 
+#include "EmulatedPort.h"
 #include "GPIO.h"
+#include "GPIOChip.h"
 #include "I2C.h"
+#include "PortStatistics.h"
 #include "SPI.h"
 
 namespace afm
 {
     namespace communication
     {
+        const std::string sc_port_type_names[data::PortType::END_PORT_TYPES] =
+        {
+            constants::sc_i2c_port,
+            constants::sc_spi_port,
+            constants::sc_gpio_port,
+            constants::sc_gpio_chip_port,
+            constants::sc_emulated_port
+        };
+
         PortFactory::PortFactory()
+            : m_ports(std::make_shared<PortMap>())
         {
 
         }
 
         PortFactory::~PortFactory()
         {
-            m_ports.clear();
+            m_ports = nullptr;
         }
 
         PortFactorySPtr PortFactory::getInstance()
         {
-            static PortFactorySPtr p_instance = nullptr;
-
-            if (p_instance == nullptr)
-            {
-                p_instance = std::make_shared<PortFactory>();
-            }
+            // constructed once, thread safe
+            static PortFactorySPtr p_instance = std::make_shared<PortFactory>();
 
             return p_instance;
         }
 
         IPortSPtr PortFactory::createPort(data::PortType port_type, uint32_t instance, uint32_t device)
         {
-            IPortSPtr p_port = nullptr;
-
             // might already exist, lets check
-            for (auto iter = m_ports.lower_bound(port_type); iter != m_ports.upper_bound(port_type); iter++)
-            {
-                if (iter->second->is_port(instance, device) == true)
-                {
-                    p_port = iter->second;
-                    break;
-                }
-            }
+            IPortSPtr p_port = findPort(std::atomic_load(&m_ports), port_type, instance, device);
 
             if (p_port == nullptr)
             {
-                switch (port_type)
-                {
-                    case data::PortType::PORT_I2C:
-                    {
-                        p_port = std::make_shared<communication::I2C>();
-                    }
-                    break;
-                    case data::PortType::PORT_SPI:
-                    {
-                        p_port = std::make_shared<communication::SPI>();
-                    }
-                    break;
-                    case data::PortType::PORT_GPIO:
-                    {
-                        p_port = std::make_shared<communication::GPIO>();
-                    }
-                    break;
-                    default:
-                    {
-                        // error
-                    }
-                    break;
-                }
+                std::lock_guard<std::mutex> guard(m_create_mutex);
 
-                if (p_port != nullptr)
+                // someone else may have created it while we waited
+                p_port = findPort(std::atomic_load(&m_ports), port_type, instance, device);
+                if (p_port == nullptr)
                 {
-                    if (p_port->initialize(instance, device) == true)
+                    p_port = makePort(port_type, device);
+                    if (p_port != nullptr)
                     {
-                        m_ports.insert(std::make_pair(port_type, p_port));
+                        if (p_port->initialize(instance, device) == true)
+                        {
+                            std::shared_ptr<PortMap> p_ports = std::make_shared<PortMap>(*std::atomic_load(&m_ports));
+
+                            p_ports->insert(std::make_pair(port_type, p_port));
+                            std::atomic_store(&m_ports, PortMapSPtr(p_ports));
+
+                            PortMonitor::getInstance()->add_port(sc_port_type_names[port_type], instance, device,
+                                std::static_pointer_cast<Port>(p_port)->get_statistics());
+                        }
+                        else
+                        {
+                            p_port = nullptr;
+                        }
                     }
-                    else
-                    {
-                        p_port = nullptr;
-                    }                    
                 }
             }
 
@@ -102,6 +92,10 @@ namespace afm
             {
                 type = data::PortType::PORT_GPIO;
             }
+            else if (port_type == constants::sc_gpio_chip_port)
+            {
+                type = data::PortType::PORT_GPIO_CHIP;
+            }
             else if (port_type == constants::sc_i2c_port)
             {
                 type = data::PortType::PORT_I2C;
@@ -110,8 +104,78 @@ namespace afm
             {
                 type = data::PortType::PORT_SPI;
             }
+            else if (port_type == constants::sc_emulated_port)
+            {
+                type = data::PortType::PORT_EMULATED;
+            }
 
             return createPort(type, instance, device);
         }
+
+        // private parts
+        IPortSPtr PortFactory::findPort(const PortMapSPtr &p_ports, data::PortType port_type, uint32_t instance, uint32_t device)
+        {
+            IPortSPtr p_port = nullptr;
+
+            for (auto iter = p_ports->lower_bound(port_type); iter != p_ports->upper_bound(port_type); iter++)
+            {
+                if (iter->second->is_port(instance, device) == true)
+                {
+                    p_port = iter->second;
+                    break;
+                }
+            }
+
+            return p_port;
+        }
+
+        IPortSPtr PortFactory::makePort(data::PortType port_type, uint32_t device)
+        {
+            IPortSPtr p_port = nullptr;
+
+            switch (port_type)
+            {
+                case data::PortType::PORT_I2C:
+                {
+                    p_port = std::make_shared<communication::I2C>();
+                }
+                break;
+                case data::PortType::PORT_SPI:
+                {
+                    p_port = std::make_shared<communication::SPI>();
+                }
+                break;
+                case data::PortType::PORT_GPIO:
+                {
+                    p_port = std::make_shared<communication::GPIO>();
+                }
+                break;
+                case data::PortType::PORT_GPIO_CHIP:
+                {
+                    p_port = std::make_shared<communication::GPIOChip>();
+                }
+                break;
+                case data::PortType::PORT_EMULATED:
+                {
+                    // device 0 is the data bus, anything else a control pin
+                    if (device == EmulatedRole::EMULATED_BUS)
+                    {
+                        p_port = std::make_shared<communication::EmulatedSPI>();
+                    }
+                    else
+                    {
+                        p_port = std::make_shared<communication::EmulatedGPIO>();
+                    }
+                }
+                break;
+                default:
+                {
+                    // error
+                }
+                break;
+            }
+
+            return p_port;
+        }
     }
 }
\ No newline at end of file
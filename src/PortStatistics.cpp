@@ -0,0 +1,315 @@
+/**
+ * PortStatistics.cpp
+ *
+ * Per port operation counters, byte totals and latency histograms
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <fstream>
+#include <sstream>
+#include <time.h>
+
+#include "PortStatistics.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const char *sc_port_operation_names[END_PORT_OPERATIONS] = { "read", "write", "transfer", "control" };
+
+        std::atomic<bool> PortStatistics::s_enabled(false);
+
+        PortStatistics::PortStatistics()
+        {
+            clear();
+        }
+
+        uint64_t PortStatistics::get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * 1000000000ULL) + now.tv_nsec;
+        }
+
+        void PortStatistics::record(PortOperation operation, uint64_t bytes_in, uint64_t bytes_out, uint32_t syscalls, uint64_t latency_ns, bool failed)
+        {
+            if (operation < END_PORT_OPERATIONS)
+            {
+                Counters &counters = m_counters[operation];
+                size_t bucket = 0;
+
+                // log2 bucket, i.e. the bit length of the latency
+                if (latency_ns != 0)
+                {
+                    bucket = 64 - __builtin_clzll(latency_ns);
+                }
+                if (bucket >= sc_port_latency_buckets)
+                {
+                    bucket = sc_port_latency_buckets - 1;
+                }
+
+                counters.count.fetch_add(1, std::memory_order_relaxed);
+                counters.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+                counters.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+                counters.syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+                counters.total_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+                counters.latency_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+                if (failed == true)
+                {
+                    counters.errors.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                uint64_t max_ns = counters.max_ns.load(std::memory_order_relaxed);
+                while ((latency_ns > max_ns) && (counters.max_ns.compare_exchange_weak(max_ns, latency_ns, std::memory_order_relaxed) == false))
+                {
+                }
+            }
+        }
+
+        PortOperationSnapshot PortStatistics::get_snapshot(PortOperation operation) const
+        {
+            PortOperationSnapshot snapshot;
+
+            // each counter is read on its own, a snapshot taken under load may be off by the operations in flight
+            if (operation < END_PORT_OPERATIONS)
+            {
+                const Counters &counters = m_counters[operation];
+
+                snapshot.count = counters.count.load(std::memory_order_relaxed);
+                snapshot.errors = counters.errors.load(std::memory_order_relaxed);
+                snapshot.bytes_in = counters.bytes_in.load(std::memory_order_relaxed);
+                snapshot.bytes_out = counters.bytes_out.load(std::memory_order_relaxed);
+                snapshot.syscalls = counters.syscalls.load(std::memory_order_relaxed);
+                snapshot.total_ns = counters.total_ns.load(std::memory_order_relaxed);
+                snapshot.max_ns = counters.max_ns.load(std::memory_order_relaxed);
+                for (size_t bucket = 0; bucket < sc_port_latency_buckets; bucket++)
+                {
+                    snapshot.latency_buckets[bucket] = counters.latency_buckets[bucket].load(std::memory_order_relaxed);
+                }
+            }
+
+            return snapshot;
+        }
+
+        void PortStatistics::clear()
+        {
+            for (Counters &counters : m_counters)
+            {
+                counters.count.store(0, std::memory_order_relaxed);
+                counters.errors.store(0, std::memory_order_relaxed);
+                counters.bytes_in.store(0, std::memory_order_relaxed);
+                counters.bytes_out.store(0, std::memory_order_relaxed);
+                counters.syscalls.store(0, std::memory_order_relaxed);
+                counters.total_ns.store(0, std::memory_order_relaxed);
+                counters.max_ns.store(0, std::memory_order_relaxed);
+                for (auto &bucket : counters.latency_buckets)
+                {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        PortMonitor::PortMonitor()
+        {
+
+        }
+
+        PortMonitor::~PortMonitor()
+        {
+
+        }
+
+        PortMonitorSPtr PortMonitor::getInstance()
+        {
+            static PortMonitorSPtr p_instance = std::make_shared<PortMonitor>();
+
+            return p_instance;
+        }
+
+        void PortMonitor::add_port(const std::string &port_type, uint32_t instance, uint32_t device, PortStatisticsSPtr p_statistics)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if (p_statistics != nullptr)
+            {
+                m_ports.push_back({ port_type, instance, device, p_statistics });
+            }
+        }
+
+        void PortMonitor::clear()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            for (auto &port : m_ports)
+            {
+                PortStatisticsSPtr p_statistics = port.p_statistics.lock();
+                if (p_statistics != nullptr)
+                {
+                    p_statistics->clear();
+                }
+            }
+        }
+
+        std::vector<PortStatisticsSnapshot> PortMonitor::get_snapshots()
+        {
+            std::vector<PortStatisticsSnapshot> snapshots;
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            // ports that went away are dropped here rather than on destruction
+            for (auto iter = m_ports.begin(); iter != m_ports.end();)
+            {
+                PortStatisticsSPtr p_statistics = iter->p_statistics.lock();
+                if (p_statistics != nullptr)
+                {
+                    PortStatisticsSnapshot snapshot;
+
+                    snapshot.port_type = iter->port_type;
+                    snapshot.instance = iter->instance;
+                    snapshot.device = iter->device;
+                    for (int operation = 0; operation < END_PORT_OPERATIONS; operation++)
+                    {
+                        snapshot.operations[operation] = p_statistics->get_snapshot((PortOperation)operation);
+                    }
+                    snapshots.push_back(snapshot);
+                    iter++;
+                }
+                else
+                {
+                    iter = m_ports.erase(iter);
+                }
+            }
+
+            return snapshots;
+        }
+
+        nlohmann::json PortMonitor::to_json()
+        {
+            nlohmann::json ports = nlohmann::json::array();
+
+            for (const PortStatisticsSnapshot &snapshot : get_snapshots())
+            {
+                nlohmann::json port;
+
+                port["port_type"] = snapshot.port_type;
+                port["instance"] = snapshot.instance;
+                port["device"] = snapshot.device;
+
+                for (int operation = 0; operation < END_PORT_OPERATIONS; operation++)
+                {
+                    const PortOperationSnapshot &counters = snapshot.operations[operation];
+                    nlohmann::json entry;
+
+                    entry["count"] = counters.count;
+                    entry["errors"] = counters.errors;
+                    entry["bytes_in"] = counters.bytes_in;
+                    entry["bytes_out"] = counters.bytes_out;
+                    entry["syscalls"] = counters.syscalls;
+                    entry["total_ns"] = counters.total_ns;
+                    entry["max_ns"] = counters.max_ns;
+                    entry["latency_log2_ns"] = std::vector<uint64_t>(counters.latency_buckets, counters.latency_buckets + sc_port_latency_buckets);
+
+                    port["operations"][sc_port_operation_names[operation]] = entry;
+                }
+
+                ports.push_back(port);
+            }
+
+            return nlohmann::json({ { "enabled", PortStatistics::is_enabled() }, { "ports", ports } });
+        }
+
+        std::string PortMonitor::to_prometheus()
+        {
+            std::vector<PortStatisticsSnapshot> snapshots = get_snapshots();
+            std::ostringstream output;
+
+            struct Metric
+            {
+                const char *name;
+                const char *help;
+                uint64_t PortOperationSnapshot::*p_value;
+            };
+            const Metric metrics[] =
+            {
+                { "port_operations_total", "Operations issued on the port", &PortOperationSnapshot::count },
+                { "port_errors_total", "Operations that failed", &PortOperationSnapshot::errors },
+                { "port_bytes_in_total", "Bytes read from the device", &PortOperationSnapshot::bytes_in },
+                { "port_bytes_out_total", "Bytes written to the device", &PortOperationSnapshot::bytes_out },
+                { "port_syscalls_total", "System calls and ioctls issued", &PortOperationSnapshot::syscalls },
+            };
+
+            for (const Metric &metric : metrics)
+            {
+                output << "# HELP " << metric.name << " " << metric.help << "\n";
+                output << "# TYPE " << metric.name << " counter\n";
+                for (const PortStatisticsSnapshot &snapshot : snapshots)
+                {
+                    for (int operation = 0; operation < END_PORT_OPERATIONS; operation++)
+                    {
+                        output << metric.name << "{type=\"" << snapshot.port_type << "\",instance=\"" << snapshot.instance
+                            << "\",device=\"" << snapshot.device << "\",operation=\"" << sc_port_operation_names[operation]
+                            << "\"} " << snapshot.operations[operation].*metric.p_value << "\n";
+                    }
+                }
+            }
+
+            output << "# HELP port_latency_seconds Time spent in port operations\n";
+            output << "# TYPE port_latency_seconds histogram\n";
+            for (const PortStatisticsSnapshot &snapshot : snapshots)
+            {
+                for (int operation = 0; operation < END_PORT_OPERATIONS; operation++)
+                {
+                    const PortOperationSnapshot &counters = snapshot.operations[operation];
+                    std::ostringstream labels;
+                    uint64_t cumulative = 0;
+
+                    labels << "type=\"" << snapshot.port_type << "\",instance=\"" << snapshot.instance
+                        << "\",device=\"" << snapshot.device << "\",operation=\"" << sc_port_operation_names[operation] << "\"";
+
+                    // the last bucket is open ended and only shows up as +Inf
+                    for (size_t bucket = 0; bucket < (sc_port_latency_buckets - 1); bucket++)
+                    {
+                        cumulative += counters.latency_buckets[bucket];
+                        output << "port_latency_seconds_bucket{" << labels.str() << ",le=\"" << ((double)(1ULL << bucket) / 1e9)
+                            << "\"} " << cumulative << "\n";
+                    }
+                    output << "port_latency_seconds_bucket{" << labels.str() << ",le=\"+Inf\"} " << counters.count << "\n";
+                    output << "port_latency_seconds_sum{" << labels.str() << "} " << ((double)counters.total_ns / 1e9) << "\n";
+                    output << "port_latency_seconds_count{" << labels.str() << "} " << counters.count << "\n";
+                }
+            }
+
+            return output.str();
+        }
+
+        bool PortMonitor::dump_json(const std::string &file_name)
+        {
+            bool success = false;
+            std::ofstream output(file_name);
+
+            if (output.is_open() == true)
+            {
+                output << to_json().dump(4) << "\n";
+                success = output.good();
+            }
+
+            return success;
+        }
+
+        bool PortMonitor::dump_prometheus(const std::string &file_name)
+        {
+            bool success = false;
+            std::ofstream output(file_name);
+
+            if (output.is_open() == true)
+            {
+                output << to_prometheus();
+                success = output.good();
+            }
+
+            return success;
+        }
+    }
+}
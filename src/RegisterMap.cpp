@@ -0,0 +1,240 @@
+/**
+ * RegisterMap.cpp
+ *
+ * Cached view of an 8 bit register file behind a port
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include "I2C.h"
+#include "RegisterMap.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const size_t sc_register_size = 1;
+
+        RegisterMap::RegisterMap(IPortSPtr p_port, bool auto_increment)
+            : m_pport(p_port)
+            , m_auto_increment(auto_increment)
+        {
+            // worst case every register is its own run, sized once here
+            m_output_buffer.reserve(sc_register_count * 2);
+            m_input_buffer.resize(sc_register_size);
+        }
+
+        RegisterMap::~RegisterMap()
+        {
+            m_pport = nullptr;
+        }
+
+        void RegisterMap::set_volatile(uint8_t target_register, bool is_volatile)
+        {
+            m_volatile[target_register] = is_volatile;
+            if (is_volatile == true)
+            {
+                m_valid[target_register] = false;
+            }
+        }
+
+        void RegisterMap::set_default(uint8_t target_register, uint8_t value)
+        {
+            // the power on value, lets the first read be answered without the bus
+            m_values[target_register] = value;
+            m_valid[target_register] = true;
+        }
+
+        bool RegisterMap::read(uint8_t target_register, uint8_t &value)
+        {
+            bool success = false;
+
+            if ((m_volatile[target_register] == false) && (m_valid[target_register] == true))
+            {
+                value = m_values[target_register];
+                success = true;
+            }
+            else if (read_register(target_register, value) == true)
+            {
+                if (m_volatile[target_register] == false)
+                {
+                    m_values[target_register] = value;
+                    m_valid[target_register] = true;
+                }
+                success = true;
+            }
+
+            return success;
+        }
+
+        bool RegisterMap::write(uint8_t target_register, uint8_t value)
+        {
+            bool success = false;
+
+            if (m_volatile[target_register] == true)
+            {
+                m_values[target_register] = value;
+                success = write_registers(target_register, 1);
+            }
+            else if ((m_valid[target_register] == true) && (m_values[target_register] == value))
+            {
+                // already in effect (or already queued)
+                success = true;
+            }
+            else if (m_write_back == true)
+            {
+                m_values[target_register] = value;
+                m_valid[target_register] = true;
+                m_dirty[target_register] = true;
+                success = true;
+            }
+            else
+            {
+                uint8_t previous = m_values[target_register];
+
+                // write_registers() sends from the cache, only trust it once the bus took it
+                m_values[target_register] = value;
+                success = write_registers(target_register, 1);
+                if (success == true)
+                {
+                    m_valid[target_register] = true;
+                }
+                else
+                {
+                    m_values[target_register] = previous;
+                }
+            }
+
+            return success;
+        }
+
+        bool RegisterMap::update_bits(uint8_t target_register, uint8_t mask, uint8_t value)
+        {
+            bool success = false;
+            uint8_t current = 0;
+
+            if (read(target_register, current) == true)
+            {
+                success = write(target_register, (current & ~mask) | (value & mask));
+            }
+
+            return success;
+        }
+
+        bool RegisterMap::sync()
+        {
+            bool success = true;
+            std::shared_ptr<I2C> p_i2c = std::dynamic_pointer_cast<I2C>(m_pport);
+            I2CTransaction transaction;
+            std::bitset<sc_register_count> queued;      // in the transaction, clean once it has gone out
+
+            m_output_buffer.clear();
+
+            size_t target_register = 0;
+            while (target_register < sc_register_count)
+            {
+                if (m_dirty[target_register] == false)
+                {
+                    target_register++;
+                    continue;
+                }
+
+                size_t count = 1;
+                if (m_auto_increment == true)
+                {
+                    while (((target_register + count) < sc_register_count) && (m_dirty[target_register + count] == true))
+                    {
+                        count++;
+                    }
+                }
+
+                if (p_i2c != nullptr)
+                {
+                    // lay the runs end to end in the reserved buffer and send them all in one ioctl
+                    size_t offset = m_output_buffer.size();
+
+                    m_output_buffer.push_back((uint8_t)target_register);
+                    m_output_buffer.insert(m_output_buffer.end(), m_values + target_register, m_values + target_register + count);
+
+                    if (transaction.add_write(p_i2c->get_device(), &m_output_buffer[offset], count + 1) == false)
+                    {
+                        success &= submit(p_i2c, transaction, queued);
+                        transaction.add_write(p_i2c->get_device(), &m_output_buffer[offset], count + 1);
+                    }
+
+                    for (size_t index = 0; index < count; index++)
+                    {
+                        queued.set(target_register + index);
+                    }
+                }
+                else if (write_registers(target_register, count) == true)
+                {
+                    for (size_t index = 0; index < count; index++)
+                    {
+                        m_dirty[target_register + index] = false;
+                    }
+                }
+                else
+                {
+                    // left dirty, the next sync tries again
+                    success = false;
+                }
+                target_register += count;
+            }
+
+            if (transaction.get_message_count() > 0)
+            {
+                success &= submit(p_i2c, transaction, queued);
+            }
+
+            return success;
+        }
+
+        void RegisterMap::invalidate()
+        {
+            // e.g. after the device has been reset underneath us
+            m_valid.reset();
+            m_dirty.reset();
+        }
+
+        // private parts
+        bool RegisterMap::submit(const std::shared_ptr<I2C> &p_i2c, I2CTransaction &transaction, std::bitset<sc_register_count> &queued)
+        {
+            bool success = p_i2c->submit(transaction) == transaction.get_message_count();
+
+            // the device only has what actually went out
+            if (success == true)
+            {
+                m_dirty &= ~queued;
+            }
+
+            queued.reset();
+            transaction.clear();
+
+            return success;
+        }
+
+        bool RegisterMap::read_register(uint8_t target_register, uint8_t &value)
+        {
+            bool success = false;
+
+            m_output_buffer.assign(sc_register_size, target_register);
+
+            if (m_pport->transfer(m_output_buffer, m_input_buffer) > 0)
+            {
+                value = m_input_buffer[0];
+                success = true;
+            }
+
+            return success;
+        }
+
+        bool RegisterMap::write_registers(uint8_t first_register, size_t count)
+        {
+            m_output_buffer.assign(sc_register_size, first_register);
+            m_output_buffer.insert(m_output_buffer.end(), m_values + first_register, m_values + first_register + count);
+
+            return m_pport->write(m_output_buffer) == m_output_buffer.size();
+        }
+    }
+}
@@ -0,0 +1,320 @@
+/**
+ * SEPS525Emulator.cpp
+ *
+ * In memory model of the SEPS525 controller for hardware free runs
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <memory.h>
+
+#include "Constants.h"
+#include "SEPS525Emulator.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        const uint8_t sc_soft_reset_register = 0x05;
+        const uint8_t sc_write_mode_register = 0x16;
+        const uint8_t sc_mx1_register = 0x17;
+        const uint8_t sc_mx2_register = 0x18;
+        const uint8_t sc_my1_register = 0x19;
+        const uint8_t sc_my2_register = 0x1A;
+        const uint8_t sc_pointer_x_register = 0x20;
+        const uint8_t sc_pointer_y_register = 0x21;
+        const uint8_t sc_ddram_register = 0x22;
+
+        const uint8_t sc_write_mode_default = 0x06;
+        const uint8_t sc_write_vertical = 0x01;
+        const uint8_t sc_increment_vertical = 0x02;
+        const uint8_t sc_increment_horizontal = 0x04;
+        const uint8_t sc_triple_transfer = 0x10;
+        const uint16_t sc_data_bit = 0x100;
+
+        SEPS525Emulator::SEPS525Emulator()
+        {
+            m_ddram.assign(sc_emulator_width * sc_emulator_height, data::Color(0, 0, 0));
+            reset();
+        }
+
+        SEPS525Emulator::~SEPS525Emulator()
+        {
+
+        }
+
+        SEPS525EmulatorSPtr SEPS525Emulator::getInstance(uint32_t instance)
+        {
+            static std::mutex s_mutex;
+            static std::map<uint32_t, SEPS525EmulatorSPtr> s_instances;
+
+            std::lock_guard<std::mutex> guard(s_mutex);
+
+            SEPS525EmulatorSPtr &p_instance = s_instances[instance];
+            if (p_instance == nullptr)
+            {
+                p_instance = std::make_shared<SEPS525Emulator>();
+            }
+
+            return p_instance;
+        }
+
+        void SEPS525Emulator::receive(const uint8_t *p_data, size_t length)
+        {
+            m_counters.bus_writes++;
+            m_counters.bus_bytes += length;
+
+            // the controller ignores the bus while held in reset
+            if (m_reset_level == constants::sc_gpio_high)
+            {
+                for (size_t index = 0; index < length; index++)
+                {
+                    receive_value(p_data[index], m_rs_level == constants::sc_gpio_low);
+                }
+            }
+        }
+
+        void SEPS525Emulator::receive_words(const uint8_t *p_data, size_t length)
+        {
+            m_counters.bus_writes++;
+            m_counters.bus_bytes += length;
+
+            if (m_reset_level == constants::sc_gpio_high)
+            {
+                // spidev hands 9 bit words over in 16 bit host order containers, D/C rides in bit 8
+                for (size_t index = 0; (index + sizeof(uint16_t)) <= length; index += sizeof(uint16_t))
+                {
+                    uint16_t word = 0;
+
+                    memcpy(&word, &p_data[index], sizeof(word));
+                    receive_value((uint8_t)word, (word & sc_data_bit) == 0);
+                }
+            }
+        }
+
+        void SEPS525Emulator::set_rs(uint8_t level)
+        {
+            m_counters.gpio_writes++;
+            if (level != m_rs_level)
+            {
+                m_counters.rs_toggles++;
+                m_rs_level = level;
+            }
+        }
+
+        void SEPS525Emulator::set_reset(uint8_t level)
+        {
+            m_counters.gpio_writes++;
+
+            // active low, registers come back on the release
+            if ((m_reset_level == constants::sc_gpio_low) && (level == constants::sc_gpio_high))
+            {
+                reset();
+            }
+            m_reset_level = level;
+        }
+
+        void SEPS525Emulator::reset()
+        {
+            memset(m_registers, 0, sizeof(m_registers));
+
+            m_registers[sc_write_mode_register] = sc_write_mode_default;
+            m_registers[sc_mx2_register] = sc_emulator_width - 1;
+            m_registers[sc_my2_register] = sc_emulator_height - 1;
+            m_index = 0;
+            m_pointer_x = 0;
+            m_pointer_y = 0;
+            m_pixel_byte_count = 0;
+        }
+
+        data::Color SEPS525Emulator::get_pixel(uint16_t x, uint16_t y) const
+        {
+            data::Color color(0, 0, 0);
+
+            if ((x < sc_emulator_width) && (y < sc_emulator_height))
+            {
+                color = m_ddram[(y * sc_emulator_width) + x];
+            }
+
+            return color;
+        }
+
+        void SEPS525Emulator::clear_ddram()
+        {
+            m_ddram.assign(sc_emulator_width * sc_emulator_height, data::Color(0, 0, 0));
+        }
+
+        // private parts
+        void SEPS525Emulator::receive_value(uint8_t value, bool is_command)
+        {
+            if (is_command == true)
+            {
+                m_index = value;
+                m_pixel_byte_count = 0;
+                m_counters.commands++;
+            }
+            else if (m_index == sc_ddram_register)
+            {
+                write_ddram(value);
+            }
+            else
+            {
+                write_register(value);
+            }
+        }
+
+        void SEPS525Emulator::write_register(uint8_t value)
+        {
+            m_counters.register_writes++;
+
+            m_registers[m_index] = value;
+
+            switch (m_index)
+            {
+                case sc_pointer_x_register:
+                {
+                    m_pointer_x = value;
+                }
+                break;
+                case sc_pointer_y_register:
+                {
+                    m_pointer_y = value;
+                }
+                break;
+                case sc_soft_reset_register:
+                {
+                    if (value != 0)
+                    {
+                        reset();
+                    }
+                }
+                break;
+                default:
+                {
+                    // plain storage
+                }
+                break;
+            }
+        }
+
+        void SEPS525Emulator::write_ddram(uint8_t value)
+        {
+            bool triple = (m_registers[sc_write_mode_register] & sc_triple_transfer) != 0;
+
+            m_counters.data_bytes++;
+            m_pixel_bytes[m_pixel_byte_count++] = value;
+
+            if ((triple == true) && (m_pixel_byte_count == 3))
+            {
+                // 6 bits per channel, kept as sent
+                data::Color color(m_pixel_bytes[0] & 0x3F, m_pixel_bytes[1] & 0x3F, m_pixel_bytes[2] & 0x3F);
+
+                if ((m_pointer_x < sc_emulator_width) && (m_pointer_y < sc_emulator_height))
+                {
+                    m_ddram[(m_pointer_y * sc_emulator_width) + m_pointer_x] = color;
+                }
+                m_pixel_byte_count = 0;
+                m_counters.pixels++;
+                advance_pointer();
+            }
+            else if ((triple == false) && (m_pixel_byte_count == 2))
+            {
+                // 5-6-5 widened to the same 6 bit space as triple transfer
+                uint16_t word = ((uint16_t)m_pixel_bytes[0] << 8) | m_pixel_bytes[1];
+                data::Color color(((word >> 11) & 0x1F) << 1, (word >> 5) & 0x3F, (word & 0x1F) << 1);
+
+                if ((m_pointer_x < sc_emulator_width) && (m_pointer_y < sc_emulator_height))
+                {
+                    m_ddram[(m_pointer_y * sc_emulator_width) + m_pointer_x] = color;
+                }
+                m_pixel_byte_count = 0;
+                m_counters.pixels++;
+                advance_pointer();
+            }
+        }
+
+        void SEPS525Emulator::advance_pointer()
+        {
+            uint8_t mode = m_registers[sc_write_mode_register];
+            uint16_t x1 = m_registers[sc_mx1_register];
+            uint16_t x2 = m_registers[sc_mx2_register];
+            uint16_t y1 = m_registers[sc_my1_register];
+            uint16_t y2 = m_registers[sc_my2_register];
+
+            bool vertical = (mode & sc_write_vertical) != 0;
+            bool step_x = false;
+            bool step_y = false;
+
+            // the primary direction steps every pixel and wraps inside the window,
+            // the secondary direction steps on each wrap
+            if (vertical == false)
+            {
+                step_x = true;
+            }
+            else
+            {
+                step_y = true;
+            }
+
+            for (int pass = 0; pass < 2; pass++)
+            {
+                if (step_x == true)
+                {
+                    step_x = false;
+                    if ((mode & sc_increment_horizontal) != 0)
+                    {
+                        if (m_pointer_x >= x2)
+                        {
+                            m_pointer_x = x1;
+                            step_y = vertical == false;
+                        }
+                        else
+                        {
+                            m_pointer_x++;
+                        }
+                    }
+                    else
+                    {
+                        if (m_pointer_x <= x1)
+                        {
+                            m_pointer_x = x2;
+                            step_y = vertical == false;
+                        }
+                        else
+                        {
+                            m_pointer_x--;
+                        }
+                    }
+                }
+                else if (step_y == true)
+                {
+                    step_y = false;
+                    if ((mode & sc_increment_vertical) != 0)
+                    {
+                        if (m_pointer_y >= y2)
+                        {
+                            m_pointer_y = y1;
+                            step_x = vertical == true;
+                        }
+                        else
+                        {
+                            m_pointer_y++;
+                        }
+                    }
+                    else
+                    {
+                        if (m_pointer_y <= y1)
+                        {
+                            m_pointer_y = y2;
+                            step_x = vertical == true;
+                        }
+                        else
+                        {
+                            m_pointer_y--;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -11,9 +11,11 @@
 #include <linux/spi/spidev.h>
 #include <memory.h>
 #include <sys/ioctl.h>
+#include <sys/param.h>
 #include <unistd.h>
 
 #include "SPI.h"
+#include "Trace.h"
 
 namespace afm
 {
@@ -39,71 +41,104 @@ namespace afm
         bool SPI::read(uint8_t &value)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_READ);
+            AFM_TRACE_SCOPE("port", "spi read");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
-                if (::read(m_device_handle, &value, sc_max_buffer_size) == 1)
+                statistics.add_syscall();
+                if (::read(m_device_handle, &value, 1) == 1)
                 {
+                    statistics.add_bytes_in(1);
                     success = true;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
         bool SPI::write(uint8_t value)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "spi write");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
+                statistics.add_syscall();
                 if (::write(m_device_handle, &value, 1) == 1)
                 {
+                    statistics.add_bytes_out(1);
                     success = true;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
         uint16_t SPI::read(data::Buffer &buffer)
         {
             uint16_t bytes_read = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_READ);
+            AFM_TRACE_SCOPE("port", "spi read");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
-                data::BufferDataType data_buffer[sc_max_buffer_size] = {0};
+                // a sized buffer is filled to its size, an empty one grows until the device runs dry
+                bool is_streaming = buffer.empty();
+                size_t length = is_streaming == true ? UINT16_MAX : MIN(buffer.size(), (size_t)UINT16_MAX);
+                size_t request = 0;
                 int data_read = 0;
                 do
                 {
-                    data_read = ::read(m_device_handle, data_buffer, sc_max_buffer_size);
+                    request = MIN((size_t)sc_max_buffer_size, length - bytes_read);
+
+                    if (is_streaming == true)
+                    {
+                        // straight into the caller's storage, no bounce buffer
+                        buffer.resize(bytes_read + request);
+                    }
+
+                    statistics.add_syscall();
+                    data_read = ::read(m_device_handle, &buffer[bytes_read], request);
                     if (data_read > 0)
                     {
-                        buffer.reserve(bytes_read + (uint16_t)data_read);
-                        memcpy(&buffer.data()[bytes_read], data_buffer, data_read);
                         bytes_read += (uint16_t)data_read;
                     }
-                } while (data_read == sc_max_buffer_size);
+                } while ((data_read == (int)request) && (bytes_read < length));
+
+                buffer.resize(bytes_read);
             }
 
+            statistics.add_bytes_in(bytes_read);
+            statistics.set_failed(bytes_read == 0);
             return bytes_read;
         }
 
         uint16_t SPI::write(const data::Buffer &buffer)
         {
             uint16_t bytes_written = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_WRITE);
+            AFM_TRACE_SCOPE("port", "spi write");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
+                statistics.add_syscall();
                 bytes_written = ::write(m_device_handle, buffer.data(), buffer.size());
             }
 
+            statistics.add_bytes_out(bytes_written);
+            statistics.set_failed(bytes_written != buffer.size());
             return bytes_written;
         }
 
         uint16_t SPI::transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer)
         {
             uint16_t bytes_transferred = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_TRANSFER);
+            AFM_TRACE_SCOPE("port", "spi transfer");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
@@ -122,15 +157,57 @@ namespace afm
                 xfer[sc_rx_buffer_slot].speed_hz = m_frequency;
                 xfer[sc_rx_buffer_slot].bits_per_word = m_bits_per_word;
 
+                statistics.add_syscall();
                 int ioctl_bytes = ioctl(m_device_handle, SPI_IOC_MESSAGE(sc_spi_max_messages), &xfer);
                 if (ioctl_bytes != -1)
                 {
                     bytes_transferred = (uint16_t)ioctl_bytes;
+                    statistics.add_bytes_out(output_buffer.size());
+                    statistics.add_bytes_in(input_buffer.size());
                 }
             }
+
+            statistics.set_failed(bytes_transferred == 0);
 			return bytes_transferred;
         }
 
+        uint16_t SPI::transfer(const uint8_t *p_output, uint8_t *p_input, size_t length, uint32_t frequency, uint8_t bits_per_word)
+        {
+            uint16_t bytes_transferred = 0;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_TRANSFER);
+            AFM_TRACE_SCOPE("port", "spi segment");
+
+            if ((m_device_handle != constants::sc_invalid_file_handle) && (length > 0))
+            {
+                struct spi_ioc_transfer xfer;
+
+                // speed and word size are per transfer, no need to touch the device defaults
+                memset(&xfer, 0, sizeof(xfer));
+                xfer.tx_buf = (unsigned long)p_output;
+                xfer.rx_buf = (unsigned long)p_input;
+                xfer.len = length;
+                xfer.speed_hz = frequency;
+                xfer.bits_per_word = bits_per_word;
+
+                statistics.add_syscall();
+                int ioctl_bytes = ioctl(m_device_handle, SPI_IOC_MESSAGE(1), &xfer);
+                if (ioctl_bytes != -1)
+                {
+                    bytes_transferred = (uint16_t)ioctl_bytes;
+                    statistics.add_bytes_out(p_output != nullptr ? length : 0);
+                    statistics.add_bytes_in(p_input != nullptr ? length : 0);
+                }
+            }
+
+            statistics.set_failed(bytes_transferred != length);
+            return bytes_transferred;
+        }
+
+        int SPI::get_file_handle()
+        {
+            return m_device_handle;
+        }
+
         // internal parts
         bool SPI::setup_device()
         {
@@ -169,13 +246,15 @@ uint8_t spi_msb = 0;
             }
         }
 
-        // private parts
         bool SPI::set_frequency(uint32_t frequency)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_CONTROL);
+            AFM_TRACE_SCOPE("port", "spi set_frequency");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
+                statistics.add_syscall(2);
 				if (ioctl(m_device_handle, SPI_IOC_WR_MAX_SPEED_HZ, &frequency) != -1)
 				{
 					if (ioctl(m_device_handle, SPI_IOC_RD_MAX_SPEED_HZ, &frequency) != -1)
@@ -186,33 +265,42 @@ uint8_t spi_msb = 0;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
         
         bool SPI::set_mode(uint8_t mode)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_CONTROL);
+            AFM_TRACE_SCOPE("port", "spi set_mode");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
+                statistics.add_syscall(2);
 				if (ioctl(m_device_handle, SPI_IOC_WR_MODE, &mode) != -1)
 				{
 					if (ioctl(m_device_handle, SPI_IOC_RD_MODE, &mode) != -1)
                     {
+                        m_mode = mode;
                         success = true;
                     }
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
 
         bool SPI::set_bits_per_word(uint8_t num_bits)
         {
             bool success = false;
+            PortStatisticsScope statistics(get_statistics(), PORT_OPERATION_CONTROL);
+            AFM_TRACE_SCOPE("port", "spi set_bits_per_word");
 
             if (m_device_handle != constants::sc_invalid_file_handle)
             {
+                statistics.add_syscall(2);
 				if (ioctl(m_device_handle, SPI_IOC_WR_BITS_PER_WORD, &num_bits) != -1)
 				{
 					if (ioctl(m_device_handle, SPI_IOC_RD_BITS_PER_WORD, &num_bits) != -1)
@@ -223,6 +311,7 @@ uint8_t spi_msb = 0;
                 }
             }
 
+            statistics.set_failed(success == false);
             return success;
         }
     }
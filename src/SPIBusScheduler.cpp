@@ -0,0 +1,444 @@
+/**
+ * SPIBusScheduler.cpp
+ *
+ * Arbitrates one SPI controller between several devices by priority and
+ * deadline, splitting large transfers so urgent ones can get in between
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <memory.h>
+#include <time.h>
+
+#include "BufferPool.h"
+#include "SPI.h"
+#include "SPIBusScheduler.h"
+#include "Trace.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        bool SPIBusScheduler::TransactionOrder::operator()(const TransactionSPtr &p_left, const TransactionSPtr &p_right) const
+        {
+            // true when left runs after right
+            bool later = false;
+
+            if (p_left->priority != p_right->priority)
+            {
+                later = p_left->priority < p_right->priority;
+            }
+            else if (p_left->deadline_ns != p_right->deadline_ns)
+            {
+                // no deadline sorts after any deadline
+                later = (p_left->deadline_ns == sc_spi_no_deadline) ||
+                    ((p_right->deadline_ns != sc_spi_no_deadline) && (p_left->deadline_ns > p_right->deadline_ns));
+            }
+            else
+            {
+                later = p_left->sequence > p_right->sequence;
+            }
+
+            return later;
+        }
+
+        SPIBusScheduler::SPIBusScheduler()
+        {
+
+        }
+
+        SPIBusScheduler::~SPIBusScheduler()
+        {
+            stop();
+        }
+
+        SPIBusSchedulerSPtr SPIBusScheduler::getInstance(uint32_t instance)
+        {
+            static std::mutex s_mutex;
+            static std::map<uint32_t, SPIBusSchedulerSPtr> s_instances;
+
+            std::lock_guard<std::mutex> guard(s_mutex);
+
+            SPIBusSchedulerSPtr &p_instance = s_instances[instance];
+            if (p_instance == nullptr)
+            {
+                p_instance = std::make_shared<SPIBusScheduler>();
+            }
+
+            return p_instance;
+        }
+
+        uint64_t SPIBusScheduler::get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * 1000000000ULL) + now.tv_nsec;
+        }
+
+        bool SPIBusScheduler::start(size_t chunk_size)
+        {
+            bool success = false;
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if ((m_running == false) && (chunk_size > 0))
+            {
+                m_chunk_size = chunk_size;
+                m_running = true;
+                m_thread = std::thread(&SPIBusScheduler::run, this);
+                success = true;
+            }
+
+            return success;
+        }
+
+        void SPIBusScheduler::stop()
+        {
+            std::vector<TransactionSPtr> abandoned;
+
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                m_running = false;
+            }
+            m_wake.notify_all();
+
+            if (m_thread.joinable() == true)
+            {
+                m_thread.join();
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                while (m_queue.empty() == false)
+                {
+                    abandoned.push_back(m_queue.top());
+                    m_queue.pop();
+                }
+            }
+
+            // anyone blocked in transfer() needs to hear about it
+            for (auto &p_transaction : abandoned)
+            {
+                if (p_transaction->completion != nullptr)
+                {
+                    p_transaction->completion(false, p_transaction->offset);
+                }
+            }
+        }
+
+        uint32_t SPIBusScheduler::add_client(IPortSPtr p_port, uint8_t mode, uint32_t frequency, uint8_t bits_per_word)
+        {
+            uint32_t client_id = 0;
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if (p_port != nullptr)
+            {
+                client_id = m_next_client_id++;
+                m_clients[client_id] = { p_port, mode, frequency, bits_per_word, SPIBusClientStatistics() };
+            }
+
+            return client_id;
+        }
+
+        void SPIBusScheduler::remove_client(uint32_t client_id)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            // anything still queued fails when it comes up
+            m_clients.erase(client_id);
+        }
+
+        bool SPIBusScheduler::submit(uint32_t client_id, const uint8_t *p_output, uint8_t *p_input, size_t length,
+            uint8_t priority, uint64_t deadline_ns, SPIBusCompletion completion)
+        {
+            bool success = false;
+
+            if ((length > 0) && ((p_output != nullptr) || (p_input != nullptr)))
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                if ((m_running == true) && (m_clients.find(client_id) != m_clients.end()))
+                {
+                    TransactionSPtr p_transaction = nullptr;
+
+                    // finished ones are reused so a steady stream doesn't allocate
+                    if (m_free_transactions.empty() == false)
+                    {
+                        p_transaction = m_free_transactions.back();
+                        m_free_transactions.pop_back();
+                    }
+                    else
+                    {
+                        p_transaction = std::make_shared<Transaction>();
+                    }
+
+                    p_transaction->client_id = client_id;
+                    p_transaction->p_output = p_output;
+                    p_transaction->p_input = p_input;
+                    p_transaction->length = length;
+                    p_transaction->offset = 0;
+                    p_transaction->priority = priority;
+                    p_transaction->deadline_ns = deadline_ns;
+                    p_transaction->sequence = m_next_sequence++;
+                    p_transaction->submitted_ns = get_timestamp();
+                    p_transaction->started = false;
+                    p_transaction->success = true;
+                    p_transaction->completion = completion;
+
+                    m_queue.push(p_transaction);
+                    success = true;
+                }
+            }
+
+            if (success == true)
+            {
+                m_wake.notify_one();
+            }
+
+            return success;
+        }
+
+        size_t SPIBusScheduler::transfer(uint32_t client_id, const uint8_t *p_output, uint8_t *p_input, size_t length,
+            uint8_t priority, uint64_t deadline_ns)
+        {
+            // lives on this stack until the completion has run, the callback only carries a pointer
+            struct Waiter
+            {
+                std::mutex              mutex;
+                std::condition_variable done;
+                bool                    is_done = false;
+                size_t                  bytes = 0;
+            } waiter;
+            Waiter *p_waiter = &waiter;
+            size_t bytes_transferred = 0;
+
+            if (submit(client_id, p_output, p_input, length, priority, deadline_ns, [p_waiter](bool, size_t bytes)
+            {
+                // notified under the lock so the waiter can't return while we still touch it
+                std::lock_guard<std::mutex> guard(p_waiter->mutex);
+
+                p_waiter->bytes = bytes;
+                p_waiter->is_done = true;
+                p_waiter->done.notify_one();
+            }) == true)
+            {
+                std::unique_lock<std::mutex> guard(waiter.mutex);
+
+                waiter.done.wait(guard, [&waiter]() { return waiter.is_done; });
+                bytes_transferred = waiter.bytes;
+            }
+
+            return bytes_transferred;
+        }
+
+        SPIBusClientStatistics SPIBusScheduler::get_statistics(uint32_t client_id)
+        {
+            SPIBusClientStatistics statistics;
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            auto iter = m_clients.find(client_id);
+            if (iter != m_clients.end())
+            {
+                statistics = iter->second.statistics;
+            }
+
+            return statistics;
+        }
+
+        void SPIBusScheduler::clear_statistics(uint32_t client_id)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            auto iter = m_clients.find(client_id);
+            if (iter != m_clients.end())
+            {
+                iter->second.statistics = SPIBusClientStatistics();
+            }
+        }
+
+        // private parts
+        void SPIBusScheduler::run()
+        {
+            TransactionSPtr p_interrupted = nullptr;
+
+            while (true)
+            {
+                TransactionSPtr p_transaction = nullptr;
+                Client client;
+                bool have_client = false;
+                size_t chunk = 0;
+
+                {
+                    std::unique_lock<std::mutex> guard(m_mutex);
+
+                    m_wake.wait(guard, [this]() { return (m_running == false) || (m_queue.empty() == false); });
+                    if (m_running == false)
+                    {
+                        break;
+                    }
+
+                    p_transaction = m_queue.top();
+                    m_queue.pop();
+
+                    // whatever we were in the middle of just lost the bus
+                    if ((p_interrupted != nullptr) && (p_interrupted != p_transaction))
+                    {
+                        auto iter = m_clients.find(p_interrupted->client_id);
+                        if (iter != m_clients.end())
+                        {
+                            iter->second.statistics.preemptions++;
+                        }
+                    }
+                    p_interrupted = nullptr;
+
+                    auto iter = m_clients.find(p_transaction->client_id);
+                    if (iter != m_clients.end())
+                    {
+                        // copied so the segment runs without holding the queue
+                        client = iter->second;
+                        have_client = true;
+
+                        if (p_transaction->started == false)
+                        {
+                            uint64_t wait_ns = get_timestamp() - p_transaction->submitted_ns;
+
+                            iter->second.statistics.total_wait_ns += wait_ns;
+                            iter->second.statistics.max_wait_ns = std::max(iter->second.statistics.max_wait_ns, wait_ns);
+                            p_transaction->started = true;
+                        }
+                    }
+                }
+
+                if (have_client == true)
+                {
+                    chunk = std::min(m_chunk_size, p_transaction->length - p_transaction->offset);
+                    if (send_chunk(client, *p_transaction, chunk) == true)
+                    {
+                        p_transaction->offset += chunk;
+                    }
+                    else
+                    {
+                        p_transaction->success = false;
+                    }
+                }
+                else
+                {
+                    p_transaction->success = false;
+                }
+
+                bool finished = (p_transaction->success == false) || (p_transaction->offset == p_transaction->length);
+
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+
+                    auto iter = m_clients.find(p_transaction->client_id);
+                    if (iter != m_clients.end())
+                    {
+                        SPIBusClientStatistics &statistics = iter->second.statistics;
+
+                        statistics.chunks += have_client == true ? 1 : 0;
+                        statistics.bytes += p_transaction->success == true ? chunk : 0;
+                        if (finished == true)
+                        {
+                            uint64_t now = get_timestamp();
+                            uint64_t latency_ns = now - p_transaction->submitted_ns;
+
+                            statistics.transactions++;
+                            statistics.total_latency_ns += latency_ns;
+                            statistics.max_latency_ns = std::max(statistics.max_latency_ns, latency_ns);
+                            if ((p_transaction->deadline_ns != sc_spi_no_deadline) && (now > p_transaction->deadline_ns))
+                            {
+                                statistics.deadline_misses++;
+                            }
+                        }
+                    }
+
+                    if (finished == false)
+                    {
+                        // back in line, it keeps its sequence so equals don't jump it
+                        m_queue.push(p_transaction);
+                        p_interrupted = p_transaction;
+                    }
+                }
+
+                if (finished == true)
+                {
+                    // recycled before the caller hears back, so its next submit finds it free
+                    SPIBusCompletion completion = std::move(p_transaction->completion);
+                    bool success = p_transaction->success;
+                    size_t offset = p_transaction->offset;
+
+                    p_transaction->completion = nullptr;
+                    {
+                        std::lock_guard<std::mutex> guard(m_mutex);
+
+                        m_free_transactions.push_back(p_transaction);
+                    }
+
+                    if (completion != nullptr)
+                    {
+                        completion(success, offset);
+                    }
+                }
+            }
+        }
+
+        bool SPIBusScheduler::send_chunk(Client &client, Transaction &transaction, size_t length)
+        {
+            AFM_TRACE_SCOPE("port", "spi bus chunk");
+            bool success = false;
+            const uint8_t *p_output = transaction.p_output != nullptr ? &transaction.p_output[transaction.offset] : nullptr;
+            uint8_t *p_input = transaction.p_input != nullptr ? &transaction.p_input[transaction.offset] : nullptr;
+            std::shared_ptr<SPI> p_spi = std::dynamic_pointer_cast<SPI>(client.p_port);
+
+            // direct users of the port wait for the chunk, not the whole transaction
+            std::lock_guard<IPort> guard(*client.p_port);
+
+            if (p_spi != nullptr)
+            {
+                // mode is a device setting, clock and word size ride along with the segment
+                success = true;
+                if (p_spi->get_mode() != client.mode)
+                {
+                    success = p_spi->set_mode(client.mode);
+                }
+                if (success == true)
+                {
+                    success = p_spi->transfer(p_output, p_input, length, client.frequency, client.bits_per_word) == length;
+                }
+            }
+            else
+            {
+                data::BufferPoolSPtr p_pool = data::BufferPool::getInstance();
+                data::PooledBuffer output = p_pool->acquire(length);
+
+                if (p_output != nullptr)
+                {
+                    memcpy(output->data(), p_output, length);
+                }
+                else
+                {
+                    memset(output->data(), 0, length);
+                }
+
+                if (p_input != nullptr)
+                {
+                    data::PooledBuffer input = p_pool->acquire(length);
+
+                    success = client.p_port->transfer(*output, *input) > 0;
+                    memcpy(p_input, input->data(), length);
+                }
+                else
+                {
+                    success = client.p_port->write(*output) == length;
+                }
+            }
+
+            return success;
+        }
+    }
+}
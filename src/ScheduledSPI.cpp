@@ -0,0 +1,119 @@
+/**
+ * ScheduledSPI.cpp
+ *
+ * A device on a shared SPI controller whose traffic goes through the
+ * controller's SPIBusScheduler
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <sys/param.h>
+
+#include "EmulatedPort.h"
+#include "ScheduledSPI.h"
+#include "SPI.h"
+
+namespace afm
+{
+    namespace communication
+    {
+        ScheduledSPI::ScheduledSPI(SPIBusSchedulerSPtr p_scheduler, IPortSPtr p_port, uint8_t priority)
+            : m_p_scheduler(p_scheduler)
+            , m_pport(p_port)
+            , m_priority(priority)
+        {
+            std::shared_ptr<SPI> p_spi = std::dynamic_pointer_cast<SPI>(p_port);
+            std::shared_ptr<EmulatedSPI> p_emulated_spi = std::dynamic_pointer_cast<EmulatedSPI>(p_port);
+
+            // start out with whatever the device was opened with
+            if (p_spi != nullptr)
+            {
+                m_mode = p_spi->get_mode();
+                m_frequency = p_spi->get_frequency();
+                m_bits_per_word = p_spi->get_bits_per_word();
+            }
+            else if (p_emulated_spi != nullptr)
+            {
+                m_bits_per_word = p_emulated_spi->get_bits_per_word();
+            }
+
+            if ((m_p_scheduler != nullptr) && (m_pport != nullptr))
+            {
+                m_client_id = m_p_scheduler->add_client(m_pport, m_mode, m_frequency, m_bits_per_word);
+            }
+        }
+
+        ScheduledSPI::~ScheduledSPI()
+        {
+            if (m_client_id != 0)
+            {
+                m_p_scheduler->remove_client(m_client_id);
+            }
+        }
+
+        bool ScheduledSPI::initialize(uint32_t instance, uint32_t device)
+        {
+            return is_port(instance, device);
+        }
+
+        bool ScheduledSPI::read(uint8_t &value)
+        {
+            return m_p_scheduler->transfer(m_client_id, nullptr, &value, 1, m_priority) == 1;
+        }
+
+        bool ScheduledSPI::write(uint8_t value)
+        {
+            return m_p_scheduler->transfer(m_client_id, &value, nullptr, 1, m_priority) == 1;
+        }
+
+        uint16_t ScheduledSPI::read(data::Buffer &buffer)
+        {
+            return (uint16_t)m_p_scheduler->transfer(m_client_id, nullptr, buffer.data(), buffer.size(), m_priority);
+        }
+
+        uint16_t ScheduledSPI::write(const data::Buffer &buffer)
+        {
+            return (uint16_t)m_p_scheduler->transfer(m_client_id, buffer.data(), nullptr, buffer.size(), m_priority);
+        }
+
+        uint16_t ScheduledSPI::transfer(const data::Buffer &output_buffer, data::Buffer &input_buffer)
+        {
+            // full duplex, one byte in for every byte out
+            size_t length = MIN(output_buffer.size(), input_buffer.size());
+
+            return (uint16_t)m_p_scheduler->transfer(m_client_id, output_buffer.data(), input_buffer.data(), length, m_priority);
+        }
+
+        bool ScheduledSPI::is_port(uint32_t instance, uint32_t device)
+        {
+            return (m_pport != nullptr) && (m_pport->is_port(instance, device) == true);
+        }
+
+        bool ScheduledSPI::set_bits_per_word(uint8_t num_bits)
+        {
+            bool success = false;
+            std::shared_ptr<SPI> p_spi = std::dynamic_pointer_cast<SPI>(m_pport);
+            std::shared_ptr<EmulatedSPI> p_emulated_spi = std::dynamic_pointer_cast<EmulatedSPI>(m_pport);
+
+            // spidev takes it per segment from the client, anything else only knows its own setting
+            if (p_spi != nullptr)
+            {
+                success = true;
+            }
+            else if (p_emulated_spi != nullptr)
+            {
+                success = p_emulated_spi->set_bits_per_word(num_bits);
+            }
+
+            if ((success == true) && (m_client_id != 0))
+            {
+                // clients are immutable, swap ours for one with the new word size
+                m_p_scheduler->remove_client(m_client_id);
+                m_bits_per_word = num_bits;
+                m_client_id = m_p_scheduler->add_client(m_pport, m_mode, m_frequency, m_bits_per_word);
+            }
+
+            return (success == true) && (m_client_id != 0);
+        }
+    }
+}
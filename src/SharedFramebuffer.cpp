@@ -0,0 +1,260 @@
+/**
+ * SharedFramebuffer.cpp
+ *
+ * Framebuffer and damage queue in one memfd, shared by the display server and its clients
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SharedFramebuffer.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        const char sc_shared_framebuffer_name[] = "afm-display";
+        const uint32_t sc_shared_damage_mask = sc_shared_damage_slots - 1;
+
+        static_assert((sc_shared_damage_slots & sc_shared_damage_mask) == 0, "damage slots have to be a power of two");
+
+        SharedFramebuffer::SharedFramebuffer()
+        {
+        }
+
+        SharedFramebuffer::~SharedFramebuffer()
+        {
+            unmap();
+        }
+
+        bool SharedFramebuffer::create(uint16_t width, uint16_t height)
+        {
+            bool success = false;
+            size_t pixel_offset = (sizeof(SharedFramebufferHeader) + data::sc_cache_line_size - 1) & ~(data::sc_cache_line_size - 1);
+            size_t size = pixel_offset + ((size_t)width * height * sizeof(data::Color));
+
+            if ((m_p_header == nullptr) && (width > 0) && (height > 0) &&
+                (width <= sc_shared_framebuffer_max_size) && (height <= sc_shared_framebuffer_max_size))
+            {
+                m_file_handle = memfd_create(sc_shared_framebuffer_name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+                // sealed so no client can shrink it under the others and fault them
+                if ((m_file_handle != constants::sc_invalid_file_handle) && (ftruncate(m_file_handle, size) == 0) &&
+                    (fcntl(m_file_handle, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0) && (map(size) == true))
+                {
+                    // fresh pages are zero, which is black for the pixels
+                    m_p_header = new (m_p_memory) SharedFramebufferHeader;
+                    m_p_header->width = width;
+                    m_p_header->height = height;
+                    m_p_header->pixel_offset = pixel_offset;
+                    m_p_header->overflow.store(0, std::memory_order_relaxed);
+                    m_p_header->is_wake_pending.store(0, std::memory_order_relaxed);
+                    m_p_header->enqueue_position.store(0, std::memory_order_relaxed);
+                    m_p_header->dequeue_position.store(0, std::memory_order_relaxed);
+                    for (uint32_t index = 0; index < sc_shared_damage_slots; index++)
+                    {
+                        m_p_header->damage[index].sequence.store(index, std::memory_order_relaxed);
+                    }
+                    m_p_header->version = sc_shared_framebuffer_version;
+
+                    // last, a client checking the magic sees everything above
+                    std::atomic_thread_fence(std::memory_order_release);
+                    m_p_header->magic = sc_shared_framebuffer_magic;
+
+                    m_p_pixels = reinterpret_cast<data::Color *>(static_cast<uint8_t *>(m_p_memory) + pixel_offset);
+                    m_width = width;
+                    m_height = height;
+                    success = true;
+                }
+                else
+                {
+                    unmap();
+                }
+            }
+
+            return success;
+        }
+
+        bool SharedFramebuffer::attach(int file_handle)
+        {
+            bool success = false;
+            struct stat status;
+
+            if ((m_p_header == nullptr) && (file_handle != constants::sc_invalid_file_handle))
+            {
+                m_file_handle = file_handle;
+
+                if ((fstat(m_file_handle, &status) == 0) && ((size_t)status.st_size >= sizeof(SharedFramebufferHeader)) &&
+                    (map(status.st_size) == true))
+                {
+                    SharedFramebufferHeader *p_header = static_cast<SharedFramebufferHeader *>(m_p_memory);
+
+                    if ((p_header->magic == sc_shared_framebuffer_magic) && (p_header->version == sc_shared_framebuffer_version) &&
+                        (p_header->width <= sc_shared_framebuffer_max_size) && (p_header->height <= sc_shared_framebuffer_max_size) &&
+                        (p_header->pixel_offset >= sizeof(SharedFramebufferHeader)) &&
+                        ((p_header->pixel_offset + ((size_t)p_header->width * p_header->height * sizeof(data::Color))) <= m_size))
+                    {
+                        m_p_header = p_header;
+                        m_p_pixels = reinterpret_cast<data::Color *>(static_cast<uint8_t *>(m_p_memory) + p_header->pixel_offset);
+                        m_width = p_header->width;
+                        m_height = p_header->height;
+                        success = true;
+                    }
+                }
+
+                if (success == false)
+                {
+                    unmap();
+                }
+            }
+
+            return success;
+        }
+
+        void SharedFramebuffer::push_damage(const DamageRectangle &rectangle)
+        {
+            uint32_t position = m_p_header->enqueue_position.load(std::memory_order_relaxed);
+            bool is_done = false;
+
+            while (is_done == false)
+            {
+                SharedDamage &slot = m_p_header->damage[position & sc_shared_damage_mask];
+                int32_t difference = (int32_t)(slot.sequence.load(std::memory_order_acquire) - position);
+
+                if (difference == 0)
+                {
+                    // claim the slot, fill it, then hand it over with the pixels drawn before it
+                    if (m_p_header->enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) == true)
+                    {
+                        slot.x1 = rectangle.x1;
+                        slot.y1 = rectangle.y1;
+                        slot.x2 = rectangle.x2;
+                        slot.y2 = rectangle.y2;
+                        slot.sequence.store(position + 1, std::memory_order_release);
+                        is_done = true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    // the server is a lap behind, widen the overflow rectangle instead
+                    push_overflow(rectangle);
+                    is_done = true;
+                }
+                else
+                {
+                    // another producer got this one
+                    position = m_p_header->enqueue_position.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool SharedFramebuffer::request_wake()
+        {
+            return m_p_header->is_wake_pending.exchange(1, std::memory_order_acq_rel) == 0;
+        }
+
+        bool SharedFramebuffer::pop_damage(DamageRectangle &rectangle)
+        {
+            bool success = false;
+            uint32_t position = m_p_header->dequeue_position.load(std::memory_order_relaxed);
+            SharedDamage &slot = m_p_header->damage[position & sc_shared_damage_mask];
+
+            if (slot.sequence.load(std::memory_order_acquire) == (position + 1))
+            {
+                rectangle = DamageRectangle{ slot.x1, slot.y1, slot.x2, slot.y2 };
+
+                // a full lap later the slot is free for that producer
+                slot.sequence.store(position + sc_shared_damage_slots, std::memory_order_release);
+                m_p_header->dequeue_position.store(position + 1, std::memory_order_relaxed);
+                success = true;
+            }
+
+            return success;
+        }
+
+        bool SharedFramebuffer::take_overflow(DamageRectangle &rectangle)
+        {
+            uint32_t packed = m_p_header->overflow.exchange(0, std::memory_order_acq_rel);
+
+            if (packed != 0)
+            {
+                rectangle = unpack(packed);
+            }
+
+            return packed != 0;
+        }
+
+        void SharedFramebuffer::clear_wake()
+        {
+            // a read-modify-write, so it picks up every push that found the flag already set
+            m_p_header->is_wake_pending.exchange(0, std::memory_order_acq_rel);
+        }
+
+        // private parts
+        void SharedFramebuffer::push_overflow(const DamageRectangle &rectangle)
+        {
+            uint32_t packed = m_p_header->overflow.load(std::memory_order_relaxed);
+            uint32_t merged = 0;
+
+            // coordinates fit a byte each, so the bounds fit one word and can grow without a lock
+            do
+            {
+                merged = pack(packed == 0 ? rectangle : DamageRegion::get_union(unpack(packed), rectangle));
+            }
+            while (m_p_header->overflow.compare_exchange_weak(packed, merged, std::memory_order_acq_rel, std::memory_order_relaxed) == false);
+        }
+
+        uint32_t SharedFramebuffer::pack(const DamageRectangle &rectangle)
+        {
+            return ((uint32_t)(uint8_t)rectangle.x1 << 24) | ((uint32_t)(uint8_t)rectangle.y1 << 16) |
+                ((uint32_t)(uint8_t)rectangle.x2 << 8) | (uint8_t)rectangle.y2;
+        }
+
+        DamageRectangle SharedFramebuffer::unpack(uint32_t packed)
+        {
+            return DamageRectangle{ (uint16_t)(packed >> 24), (uint16_t)((packed >> 16) & 0xFF), (uint16_t)((packed >> 8) & 0xFF),
+                (uint16_t)(packed & 0xFF) };
+        }
+
+        bool SharedFramebuffer::map(size_t size)
+        {
+            bool success = false;
+            void *p_memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file_handle, 0);
+
+            if (p_memory != MAP_FAILED)
+            {
+                m_p_memory = p_memory;
+                m_size = size;
+                success = true;
+            }
+
+            return success;
+        }
+
+        void SharedFramebuffer::unmap()
+        {
+            if (m_p_memory != nullptr)
+            {
+                munmap(m_p_memory, m_size);
+                m_p_memory = nullptr;
+                m_size = 0;
+            }
+
+            if (m_file_handle != constants::sc_invalid_file_handle)
+            {
+                ::close(m_file_handle);
+                m_file_handle = constants::sc_invalid_file_handle;
+            }
+
+            m_p_header = nullptr;
+            m_p_pixels = nullptr;
+            m_width = 0;
+            m_height = 0;
+        }
+    }
+}
@@ -0,0 +1,236 @@
+/**
+ * Surface.cpp
+ *
+ * Off-screen pixel surface that remembers which parts of it changed
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sys/param.h>
+
+#include "Surface.h"
+
+namespace afm
+{
+    namespace graphic
+    {
+        DamageRegion::DamageRegion()
+        {
+            m_rectangles.reserve(sc_max_damage_rectangles);
+        }
+
+        DamageRegion::~DamageRegion()
+        {
+        }
+
+        void DamageRegion::add(const DamageRectangle &rectangle)
+        {
+            DamageRectangle merged = rectangle;
+            bool is_merged = true;
+
+            // keep absorbing until nothing left is worth sending together
+            while (is_merged == true)
+            {
+                is_merged = false;
+                for (size_t index = 0; index < m_rectangles.size(); index++)
+                {
+                    DamageRectangle candidate = get_union(m_rectangles[index], merged);
+
+                    if (get_area(candidate) <= (get_area(m_rectangles[index]) + get_area(merged) + sc_damage_merge_slack))
+                    {
+                        merged = candidate;
+                        m_rectangles[index] = m_rectangles.back();
+                        m_rectangles.pop_back();
+                        is_merged = true;
+                        break;
+                    }
+                }
+            }
+
+            // full, fold into whichever rectangle grows the least
+            if (m_rectangles.size() == sc_max_damage_rectangles)
+            {
+                size_t best = 0;
+                uint32_t best_growth = UINT32_MAX;
+
+                for (size_t index = 0; index < m_rectangles.size(); index++)
+                {
+                    uint32_t growth = get_area(get_union(m_rectangles[index], merged)) - get_area(m_rectangles[index]);
+
+                    if (growth < best_growth)
+                    {
+                        best = index;
+                        best_growth = growth;
+                    }
+                }
+
+                m_rectangles[best] = get_union(m_rectangles[best], merged);
+            }
+            else
+            {
+                m_rectangles.push_back(merged);
+            }
+        }
+
+        uint32_t DamageRegion::get_area(const DamageRectangle &rectangle)
+        {
+            return (uint32_t)(rectangle.x2 - rectangle.x1 + 1) * (rectangle.y2 - rectangle.y1 + 1);
+        }
+
+        DamageRectangle DamageRegion::get_union(const DamageRectangle &left, const DamageRectangle &right)
+        {
+            return DamageRectangle{ MIN(left.x1, right.x1), MIN(left.y1, right.y1), MAX(left.x2, right.x2), MAX(left.y2, right.y2) };
+        }
+
+        bool DamageRegion::intersect(const DamageRectangle &left, const DamageRectangle &right, DamageRectangle &result)
+        {
+            result = DamageRectangle{ MAX(left.x1, right.x1), MAX(left.y1, right.y1), MIN(left.x2, right.x2), MIN(left.y2, right.y2) };
+
+            return (result.x1 <= result.x2) && (result.y1 <= result.y2);
+        }
+
+        Surface::Surface(uint16_t width, uint16_t height, bool is_opaque) :
+            m_width(width),
+            m_height(height),
+            m_is_opaque(is_opaque)
+        {
+            m_pixels.assign((size_t)width * height, constants::BLACK);
+            if (is_opaque == false)
+            {
+                m_alpha.assign((size_t)width * height, sc_alpha_transparent);
+            }
+        }
+
+        Surface::~Surface()
+        {
+        }
+
+        void Surface::clear(const data::Color &color, uint8_t alpha)
+        {
+            fill_rectangle(1, 1, m_width, m_height, color, alpha);
+        }
+
+        void Surface::set_pixel(const data::Coordinate_8t &position, const data::Color &color, uint8_t alpha)
+        {
+            fill_rectangle(position.x, position.y, position.x, position.y, color, alpha);
+        }
+
+        void Surface::fill_rectangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const data::Color &color, uint8_t alpha)
+        {
+            if (clip(x1, y1, x2, y2) == true)
+            {
+                for (uint16_t y = y1; y <= y2; y++)
+                {
+                    size_t first = (size_t)(y - 1) * m_width + (x1 - 1);
+
+                    std::fill(m_pixels.begin() + first, m_pixels.begin() + first + (x2 - x1 + 1), color);
+                    if (m_is_opaque == false)
+                    {
+                        std::fill(m_alpha.begin() + first, m_alpha.begin() + first + (x2 - x1 + 1), alpha);
+                    }
+                }
+                m_damage.add(DamageRectangle{ x1, y1, x2, y2 });
+            }
+        }
+
+        void Surface::draw_image(const data::Coordinate_8t &position, uint16_t width, uint16_t height, const data::Color *p_pixels)
+        {
+            uint16_t x1 = position.x;
+            uint16_t y1 = position.y;
+            uint16_t x2 = position.x + width - 1;
+            uint16_t y2 = position.y + height - 1;
+
+            if ((p_pixels != nullptr) && (width > 0) && (height > 0) && (clip(x1, y1, x2, y2) == true))
+            {
+                for (uint16_t y = y1; y <= y2; y++)
+                {
+                    const data::Color *p_source = p_pixels + (size_t)(y - position.y) * width + (x1 - position.x);
+                    size_t first = (size_t)(y - 1) * m_width + (x1 - 1);
+
+                    std::copy(p_source, p_source + (x2 - x1 + 1), m_pixels.begin() + first);
+                    if (m_is_opaque == false)
+                    {
+                        std::fill(m_alpha.begin() + first, m_alpha.begin() + first + (x2 - x1 + 1), sc_alpha_opaque);
+                    }
+                }
+                m_damage.add(DamageRectangle{ x1, y1, x2, y2 });
+            }
+        }
+
+        void Surface::draw_text(const data::Coordinate_8t &position, const char *p_text, const IFont &font,
+            const data::Color &foreground, const data::Color &background, uint8_t background_alpha)
+        {
+            if (p_text != nullptr)
+            {
+                uint16_t x1 = position.x;
+                uint16_t y1 = position.y;
+                uint16_t x2 = position.x + (uint16_t)(strlen(p_text) * font.get_width()) - 1;
+                uint16_t y2 = position.y + font.get_height() - 1;
+
+                if ((*p_text != '\0') && (clip(x1, y1, x2, y2) == true))
+                {
+                    for (uint16_t x = x1; x <= x2; x++)
+                    {
+                        uint16_t offset = x - position.x;
+                        uint8_t bits = font.get_column(p_text[offset / font.get_width()], offset % font.get_width());
+
+                        for (uint16_t y = y1; y <= y2; y++)
+                        {
+                            if (((bits >> (y - position.y)) & 1) != 0)
+                            {
+                                put(x, y, foreground, sc_alpha_opaque);
+                            }
+                            else
+                            {
+                                put(x, y, background, background_alpha);
+                            }
+                        }
+                    }
+                    m_damage.add(DamageRectangle{ x1, y1, x2, y2 });
+                }
+            }
+        }
+
+        const uint8_t *Surface::get_alpha_row(uint16_t y) const
+        {
+            const uint8_t *p_row = nullptr;
+
+            if (m_is_opaque == false)
+            {
+                p_row = &m_alpha[(size_t)(y - 1) * m_width];
+            }
+
+            return p_row;
+        }
+
+        // private parts
+        bool Surface::clip(uint16_t &x1, uint16_t &y1, uint16_t &x2, uint16_t &y2) const
+        {
+            bool is_visible = false;
+
+            if ((x1 <= x2) && (y1 <= y2) && (x1 <= m_width) && (y1 <= m_height) && (x2 >= 1) && (y2 >= 1))
+            {
+                x1 = MAX(x1, 1);
+                y1 = MAX(y1, 1);
+                x2 = MIN(x2, m_width);
+                y2 = MIN(y2, m_height);
+                is_visible = true;
+            }
+
+            return is_visible;
+        }
+
+        void Surface::put(uint16_t x, uint16_t y, const data::Color &color, uint8_t alpha)
+        {
+            size_t index = (size_t)(y - 1) * m_width + (x - 1);
+
+            m_pixels[index] = color;
+            if (m_is_opaque == false)
+            {
+                m_alpha[index] = alpha;
+            }
+        }
+    }
+}
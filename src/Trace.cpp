@@ -0,0 +1,148 @@
+/**
+ * Trace.cpp
+ *
+ * Scoped event tracing written out in the Chrome trace event format, loadable
+ * in chrome://tracing or Perfetto
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include "Trace.h"
+
+#ifdef AFM_TRACING
+
+#include <cstdio>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace afm
+{
+    namespace data
+    {
+        Tracer::Tracer()
+        {
+
+        }
+
+        Tracer::~Tracer()
+        {
+
+        }
+
+        TracerSPtr Tracer::getInstance()
+        {
+            static TracerSPtr p_instance = std::make_shared<Tracer>();
+
+            return p_instance;
+        }
+
+        uint64_t Tracer::get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * 1000000000ULL) + now.tv_nsec;
+        }
+
+        void Tracer::record(const char *category, const char *name, uint64_t start_ns, uint64_t duration_ns, char phase)
+        {
+            TraceBuffer *p_buffer = get_thread_buffer();
+            size_t index = p_buffer->count.load(std::memory_order_relaxed);
+
+            if (index < p_buffer->events.size())
+            {
+                p_buffer->events[index] = { category, name, start_ns, duration_ns, phase };
+                p_buffer->count.store(index + 1, std::memory_order_release);
+            }
+            else
+            {
+                p_buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        bool Tracer::dump(const std::string &file_name)
+        {
+            bool success = false;
+            FILE *p_file = fopen(file_name.c_str(), "w");
+
+            if (p_file != nullptr)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                int process_id = getpid();
+                const char *p_separator = "";
+
+                // written by hand, traces get large and every event has the same shape
+                fprintf(p_file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+                for (auto &p_buffer : m_buffers)
+                {
+                    size_t count = p_buffer->count.load(std::memory_order_acquire);
+
+                    fprintf(p_file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                        p_separator, process_id, p_buffer->thread_id, p_buffer->thread_id);
+                    p_separator = ",\n";
+
+                    for (size_t index = 0; index < count; index++)
+                    {
+                        const TraceEvent &event = p_buffer->events[index];
+
+                        // timestamps are in microseconds, keep the nanoseconds as the fraction
+                        fprintf(p_file, "%s{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%u,\"ts\":%llu.%03llu",
+                            p_separator, event.phase, event.category, event.name, process_id, p_buffer->thread_id,
+                            (unsigned long long)(event.start_ns / 1000), (unsigned long long)(event.start_ns % 1000));
+                        if (event.phase == 'X')
+                        {
+                            fprintf(p_file, ",\"dur\":%llu.%03llu",
+                                (unsigned long long)(event.duration_ns / 1000), (unsigned long long)(event.duration_ns % 1000));
+                        }
+                        else
+                        {
+                            fprintf(p_file, ",\"s\":\"t\"");
+                        }
+                        fprintf(p_file, "}");
+                    }
+
+                    uint64_t dropped = p_buffer->dropped.load(std::memory_order_relaxed);
+                    if (dropped > 0)
+                    {
+                        fprintf(p_file, ",\n{\"ph\":\"C\",\"name\":\"dropped events\",\"pid\":%d,\"tid\":%u,\"ts\":0,\"args\":{\"dropped\":%llu}}",
+                            process_id, p_buffer->thread_id, (unsigned long long)dropped);
+                    }
+                }
+                fprintf(p_file, "\n]}\n");
+
+                success = ferror(p_file) == 0;
+                success = (fclose(p_file) == 0) && (success == true);
+            }
+
+            return success;
+        }
+
+        // private parts
+        TraceBuffer *Tracer::get_thread_buffer()
+        {
+            static thread_local TraceBuffer *p_thread_buffer = nullptr;
+
+            if (p_thread_buffer == nullptr)
+            {
+                p_thread_buffer = getInstance()->add_thread_buffer();
+            }
+
+            return p_thread_buffer;
+        }
+
+        TraceBuffer *Tracer::add_thread_buffer()
+        {
+            // kept past the thread's exit so its events still make the dump
+            TraceBufferSPtr p_buffer = std::make_shared<TraceBuffer>((uint32_t)syscall(SYS_gettid));
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            m_buffers.push_back(p_buffer);
+
+            return p_buffer.get();
+        }
+    }
+}
+
+#endif
@@ -4,284 +4,382 @@
  * Copyright 2020 AFM Software
  */
 
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
+#include <time.h>
 #include <unistd.h>
 #include <sys/param.h>
 
 #include "Constants.h"
+#include "EmulatedPort.h"
+#include "GPIO.h"
+#include "GPIOChip.h"
 #include "PortFactory.h"
+#include "ScheduledSPI.h"
+#include "SPI.h"
 #include "sesp525.h"
+#include "Trace.h"
 
 namespace afm
 {
     namespace graphic
     {
         const uint32_t sc_1_millisecond = 1000;
-        const uint8_t sc_6_bits = 0x3F; // mask for 6 bit color
-        const uint8_t sc_screen_width = 160;
-        const uint8_t sc_screen_height = 128;
+        const size_t sc_max_printf_length = 256;
 
         const std::string sc_rs_pin = "RS";
         const std::string sc_reset_pin = "RESET";
-
-        enum SESP525_Command
+        const std::string sc_init_sequence = "init_sequence";
+        const std::string sc_init_register = "register";
+        const std::string sc_init_value = "value";
+        const std::string sc_init_delay = "delay_us";
+        const std::string sc_interface = "interface";
+        const std::string sc_interface_4_wire = "4-wire";
+        const std::string sc_interface_3_wire = "3-wire";
+        const std::string sc_bus_priority = "bus_priority";
+        const uint64_t sc_nanoseconds_per_microsecond = 1000;
+        const uint64_t sc_nanoseconds_per_second = 1000000000;
+
+        /**
+         * Settings based off of:
+         * https://github.com/NewhavenDisplay/NHD-1.69-160128ASC3_Example/blob/master/examples/test/test.ino
+         * A delay holds off the next write, not the current one
+         */
+        constexpr SESP525InitCommand sc_sesp525_init_sequence[] =
         {
-            SESP525_INDEX,
-            SESP525_STATUS_READ,
-            SESP525_OSC_CTL,
-            SESP525_CLOCK_DIV,
-            SESP525_REDUCE_CURRENT,
-            SESP525_SOFT_RESET,
-            SESP525_DISP_ON_OFF,
-            SESP525_PRECHARGE_TIME_R = 0x08,
-            SESP525_PRECHARGE_TIME_G,
-            SESP525_PRECHARGE_TIME_B,
-            SESP525_PRECHARGE_CURRENT_R,
-            SESP525_PRECHARGE_CURRENT_G,
-            SESP525_PRECHARGE_CURRENT_B,
-            SESP525_DRIVING_CURRENT_R = 0x10,
-            SESP525_DRIVING_CURRENT_G,
-            SESP525_DRIVING_CURRENT_B,
-            SESP525_DISPLAY_MODE,
-            SESP525_RGB_INTERFACE,
-            SESP525_RGB_POLARITY,
-            SESP525_MEMORY_WRITE_MODE,
-            SESP525_MX1_ADDRESS,
-            SESP525_MX2_ADDRESS,
-            SESP525_MY1_ADDRESS,
-            SESP525_MY2_ADDRESS,
-            SESP525_MEMORY_ACCESS_POINTER_X = 0x20,
-            SESP525_MEMORY_ACCESS_POINTER_Y,
-            SESP525_DDRAM_DATA_ACCESS_PORT,
-            SESP525_DISPLAY_DUTY_RATIO = 0x28,
-            SESP525_DISPLAY_START_LINE,
-            SESP525_D1_DDRAM_FAC_HORIZONTAL = 0x2E,
-            SESP525_D1_DDRAM_FAR_VERTICAL,
-            SESP525_D2_DDRAM_SAC_HORIZONTAL = 0x31,
-            SESP525_D2_DDRAM_SAR_VERTICAL,
-            SESP525_SCREEN1_FX1,
-            SESP525_SCREEN1_FX2,
-            SESP525_SCREEN1_FY1,
-            SESP525_SCREEN1_FY2,
-            SESP525_SCREEN2_SX1,
-            SESP525_SCREEN2_SX2,
-            SESP525_SCREEN2_SY1,
-            SESP525_SCREEN2_SY2,
-            SESP525_SCREEN_SAVER_CONTROL,
-            SESP525_SCREEN_SAVER_SLEEP_TIMER,
-            SESP525_SCREEN_SAVER_MODE,
-            SESP525_SCREEN_SAVER_SCREEN1_FU,
-            SESP525_SCREEN_SAVER_SCREEN1_MXY,
-            SESP525_SCREEN_SAVER_SCREEN2_FU,
-            SESP525_SCREEN_SAVER_SCREEN2_MXY,
-            SESP525_MOVING_DIRECTION,
-            SESP525_SCREEN_SAVER_SCREEN2_SX1 = 0x47,
-            SESP525_SCREEN_SAVER_SCREEN2_SX2,
-            SESP525_SCREEN_SAVER_SCREEN2_SY1,
-            SESP525_SCREEN_SAVER_SCREEN2_SY2,
-            SESP525_GRAY_SCALE_TABLE_INDEX = 0x50,
-            SESP525_GRAY_SCALE_TABLE_DATA,
-            SESP525_IREF = 0x80,
-            END_SESP525_Commands
+            { SESP525_REDUCE_CURRENT, 1, sc_1_millisecond },
+            { SESP525_REDUCE_CURRENT, 0, 0 },
+            { SESP525_DISP_ON_OFF, 0, sc_1_millisecond },           // display off
+            { SESP525_OSC_CTL, 1, 0 },                              // internal oscillator using external resistor
+            { SESP525_CLOCK_DIV, 0x30, 0 },                         // 90 hz frame rate
+            { SESP525_DISPLAY_DUTY_RATIO, 0x7F, 0 },                // 127 duty cycle
+            { SESP525_DISPLAY_START_LINE, 0, 0 },
+            { SESP525_RGB_INTERFACE, 0x01, 0 },
+            { SESP525_RGB_POLARITY, 0, 0 },
+            { SESP525_MEMORY_WRITE_MODE, 0x76, 0 },                 // triple xfr, 262K, increase horiz, vert, write horiz
+            { SESP525_DRIVING_CURRENT_R, 0x45, 0 },                 // uA
+            { SESP525_DRIVING_CURRENT_G, 0x34, 0 },
+            { SESP525_DRIVING_CURRENT_B, 0x33, 0 },
+            { SESP525_PRECHARGE_TIME_R, 0x04, 0 },                  // x * clk
+            { SESP525_PRECHARGE_TIME_G, 0x05, 0 },
+            { SESP525_PRECHARGE_TIME_B, 0x05, 0 },
+            { SESP525_PRECHARGE_CURRENT_R, 0x9D, 0 },               // 8 x uA
+            { SESP525_PRECHARGE_CURRENT_G, 0x8C, 0 },
+            { SESP525_PRECHARGE_CURRENT_B, 0x57, 0 },
+            { SESP525_IREF, 0, 0 },                                 // reference voltage controlled by external resistor
+            { SESP525_DISPLAY_MODE, 0, 0 },
         };
 
+        static uint64_t get_timestamp()
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            return ((uint64_t)now.tv_sec * sc_nanoseconds_per_second) + now.tv_nsec;
+        }
+
+        static void sleep_until(uint64_t deadline_ns)
+        {
+            struct timespec deadline;
+
+            deadline.tv_sec = deadline_ns / sc_nanoseconds_per_second;
+            deadline.tv_nsec = deadline_ns % sc_nanoseconds_per_second;
+
+            // absolute, so a signal can't stretch or shorten the wait
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+            {
+            }
+        }
+
+        template <class Bus, class ControlPin>
+        static ISESP525DriverSPtr make_driver(communication::IPortSPtr p_port, communication::IPortSPtr p_rs_pin, uint16_t width, uint16_t height)
+        {
+            ISESP525DriverSPtr p_driver = nullptr;
+            std::shared_ptr<Bus> p_bus = std::dynamic_pointer_cast<Bus>(p_port);
+            std::shared_ptr<ControlPin> p_control_pin = std::dynamic_pointer_cast<ControlPin>(p_rs_pin);
+
+            if ((p_bus != nullptr) && (p_control_pin != nullptr))
+            {
+                p_driver = std::make_shared<SESP525Driver<Bus, ControlPin>>(p_bus, p_control_pin, width, height);
+            }
+
+            return p_driver;
+        }
+
+        template <class Bus>
+        static ISESP525DriverSPtr make_3_wire_driver(communication::IPortSPtr p_port, uint16_t width, uint16_t height)
+        {
+            ISESP525DriverSPtr p_driver = nullptr;
+            std::shared_ptr<Bus> p_bus = std::dynamic_pointer_cast<Bus>(p_port);
+
+            // only a bus that can clock 9 bit words will do, there is no RS line to fall back on
+            if ((p_bus != nullptr) && (p_bus->set_bits_per_word(sc_sesp525_3_wire_bits_per_word) == true))
+            {
+                p_driver = std::make_shared<SESP525Driver<Bus, communication::IPort, SESP525_INTERFACE_3_WIRE>>(p_bus, nullptr, width, height);
+            }
+
+            return p_driver;
+        }
+
         SESP525Display::SESP525Display()
+            : m_init_sequence(std::begin(sc_sesp525_init_sequence), std::end(sc_sesp525_init_sequence))
         {
 
         }
 
         SESP525Display::~SESP525Display()
         {
+            m_driver = nullptr;
+            m_bus = nullptr;
             m_rs_pin = nullptr;
             m_reset_pin = nullptr;
         }
 
         void SESP525Display::clear_screen(const data::Color &color)
         {
-            set_position(1, 1);
-
-            write_data_start();
-            for (uint32_t index = 0; index < get_x_resolution() * get_y_resolution(); index++)
-            {
-                write_pixel(color);
-            }
+            AFM_TRACE_SCOPE("display", "clear_screen");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            m_driver->fill_screen(color);
         }
 
         void SESP525Display::set_pixel(const data::Coordinate_8t &position, const data::Color &color)
         {
-            set_pixel(position.x, position.y, color);
+            AFM_TRACE_SCOPE("display", "set_pixel");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            m_driver->set_pixel(position.x, position.y, color);
+        }
+
+        void SESP525Display::set_pixels(const data::Pixel *p_pixels, size_t count)
+        {
+            AFM_TRACE_SCOPE("display", "set_pixels");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            m_driver->set_pixels(p_pixels, count);
         }
 
         void SESP525Display::draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
         {
+            draw_rectangle(x1, y1, x2, y2, 1);
         }
         
         void SESP525Display::draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t thickness)
         {
+            // one transaction for all four edges
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            uint8_t left = MIN(x1, x2);
+            uint8_t right = MAX(x1, x2);
+            uint8_t top = MIN(y1, y2);
+            uint8_t bottom = MAX(y1, y2);
+
+            if (thickness > 0)
+            {
+                // bands thicker than the rectangle just fill it
+                if (((right - left + 1) <= (thickness * 2)) || ((bottom - top + 1) <= (thickness * 2)))
+                {
+                    fill_rectangle(left, top, right, bottom);
+                }
+                else
+                {
+                    fill_rectangle(left, top, right, top + thickness - 1);
+                    fill_rectangle(left, bottom - thickness + 1, right, bottom);
+                    fill_rectangle(left, top + thickness, left + thickness - 1, bottom - thickness);
+                    fill_rectangle(right - thickness + 1, top + thickness, right, bottom - thickness);
+                }
+            }
         }
         
         void SESP525Display::fill_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
         {
+            AFM_TRACE_SCOPE("display", "fill_rectangle");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            m_driver->fill(x1, y1, x2, y2, get_foreground());
         }
         
         void SESP525Display::draw_line(const data::Coordinate_8t &start, const data::Coordinate_8t &end, const data::Color &color)
         {
-            uint8_t x1 = MIN(start.x, end.x);
-            uint8_t x2 = MAX(start.x, end.x);
-            uint8_t y1 = MIN(start.y, end.y);
-            uint8_t y2 = MAX(start.y, end.y);
-            
-            uint8_t dy = y2 - y1;
-            uint8_t dx = x2 - x1;
-                        
-            if (x1 >= sc_screen_width)
-            {
-                x1 = sc_screen_width - 1;
-            }
-            
-            if (x2 >= sc_screen_width)
-            {
-                x2 = sc_screen_width - 1;
-            }
-            
-            if (x1 == x2)
-            {
-                x2++; // give us one pixel width
-            }
-            
-            /* Utilizing the Bresenham algorithm */
-            int eps = 0;
+            AFM_TRACE_SCOPE("display", "draw_line");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            m_driver->draw_line(start, end, color);
+        }
+        
+        void SESP525Display::draw_image(const data::Coordinate_8t &position, uint8_t width, uint8_t height, const data::Color *p_pixels)
+        {
+            AFM_TRACE_SCOPE("display", "draw_image");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            m_driver->draw_image(position.x, position.y, width, height, p_pixels);
+        }
 
-            if (y1 != y2)
+        void SESP525Display::print(char *data)
+        {
+            AFM_TRACE_SCOPE("display", "print");
+            std::lock_guard<communication::IPort> guard(*m_bus);
+            if (data != nullptr)
             {
-                for (/* set above */; y1 < y2; y1++)
+                size_t characters_per_line = get_x_resolution() / m_font.get_width();
+                const char *p_run = data;
+                size_t run_length = 0;
+
+                while (*p_run != '\0')
                 {
-                    for (uint8_t xCord = x1; xCord < x2; xCord++)
+                    data::Coordinate_8t &cursor = get_cursor();
+                    size_t room = characters_per_line - MIN(characters_per_line, (size_t)((cursor.x - 1) / m_font.get_width()));
+
+                    run_length = 0;
+                    while ((p_run[run_length] != '\0') && (p_run[run_length] != '\n') && (run_length < room))
                     {
-                        set_pixel(xCord, y1, color);
-                        eps += dy;
+                        run_length++;
+                    }
 
-                        if ((eps << 1) >= dx)
+                    // one window per run of characters on a line
+                    if (run_length > 0)
+                    {
+                        AFM_TRACE_SCOPE("display", "draw_text");
+                        m_driver->draw_text(cursor.x, cursor.y, p_run, run_length, m_font, get_foreground(), get_background());
+                        cursor.x += run_length * m_font.get_width();
+                    }
+
+                    p_run += run_length;
+                    if ((*p_run == '\n') || (run_length == room))
+                    {
+                        cursor.x = 1;
+                        cursor.y += m_font.get_height();
+                        if ((cursor.y + m_font.get_height() - 1) > get_y_resolution())
                         {
-                            y1++;
-                            eps -= dx;
+                            cursor.y = 1;
+                        }
+
+                        if (*p_run == '\n')
+                        {
+                            p_run++;
                         }
                     }
                 }
             }
-            else// if (y1 == y2)
-            {
-                for (uint8_t xCord = x1; xCord < x2; xCord++)
-                {
-                    set_pixel(xCord, y1, color);
-                }
-            }
-        }
-        
-        void SESP525Display::print(char *data)
-        {
         }
         
         void SESP525Display::print_line(char *data)
         {
+            char new_line[] = "\n";
+
+            print(data);
+            print(new_line);
         }
         
         void SESP525Display::printf(const char * __format, ...)
         {
+            char buffer[sc_max_printf_length];
+            va_list arguments;
+
+            va_start(arguments, __format);
+            vsnprintf(buffer, sizeof(buffer), __format, arguments);
+            va_end(arguments);
+
+            print(buffer);
         }
 
         // internal parts
         bool SESP525Display::on_initialize(const nlohmann::json &configuration)
         {
             bool success = false;
+            bool is_3_wire = configuration.value(sc_interface, sc_interface_4_wire) == sc_interface_3_wire;
 
             // there should be multiple ports in order
-            // to control the required pins
-            if (configuration[sc_ports].size() > 1)
+            // to control the required pins, 3-wire gets by on the bus alone
+            if ((configuration[sc_ports].size() > 1) || ((is_3_wire == true) && (configuration[sc_ports].size() > 0)))
             {
                 for (auto iter : configuration[sc_ports])
                 {
+                    // pins may be sysfs gpio or gpiochip lines, honor the configured type
                     if (iter[sc_port_name] == sc_rs_pin)
                     {
-                        m_rs_pin = communication::PortFactory::getInstance()->createPort(data::PortType::PORT_GPIO,
+                        m_rs_pin = communication::PortFactory::getInstance()->createPort(iter[sc_port_type].get<std::string>(),
                             iter[sc_instance].get<uint32_t>(), iter[sc_device].get<uint32_t>());
                     }
                     if (iter[sc_port_name] == sc_reset_pin)
                     {
-                        m_reset_pin = communication::PortFactory::getInstance()->createPort(data::PortType::PORT_GPIO,
+                        m_reset_pin = communication::PortFactory::getInstance()->createPort(iter[sc_port_type].get<std::string>(),
                             iter[sc_instance].get<uint32_t>(), iter[sc_device].get<uint32_t>());
                     }
                 }
 
-                if (m_rs_pin != nullptr)
+                m_bus = get_port();
+                if (configuration.find(sc_bus_priority) != configuration.end())
                 {
-                    if (m_reset_pin != nullptr)
-                    {
-                        m_reset_pin->write(constants::sc_gpio_high);
-                    }
+                    // share the controller, the driver then queues behind the other devices on it
+                    communication::SPIBusSchedulerSPtr p_scheduler = communication::SPIBusScheduler::getInstance(
+                        configuration[sc_ports][0][sc_instance].get<uint32_t>());
 
-                    /**
-                     * Settings based off of:
-                     * https://github.com/NewhavenDisplay/NHD-1.69-160128ASC3_Example/blob/master/examples/test/test.ino
-                     */
-                    write_register(SESP525_Command::SESP525_REDUCE_CURRENT, 1);
-                    usleep(sc_1_millisecond);
-                    write_register(SESP525_Command::SESP525_REDUCE_CURRENT, 0);
-
-                    // Turn display off
-                    write_register(SESP525_Command::SESP525_DISP_ON_OFF, 0);
-                    usleep(sc_1_millisecond);
-
-                    // Internal oscillator using external resistor
-                    write_register(SESP525_Command::SESP525_OSC_CTL, 1);
-
-                    // 90 hz frame rate
-                    write_register(SESP525_Command::SESP525_CLOCK_DIV, 0x30);
-
-                    // 127 duty cycle
-                    write_register(SESP525_Command::SESP525_DISPLAY_DUTY_RATIO, 0x7F);
-
-                    // display start line of 1
-                    write_register(SESP525_Command::SESP525_DISPLAY_START_LINE, 0);
-
-                    // set rgb interface
-                    write_register(SESP525_Command::SESP525_RGB_INTERFACE, 0x01);    
-
-                    // set rgb polarity
-                    write_register(SESP525_Command::SESP525_RGB_POLARITY, 0);
+                    // already running when another device on the controller got there first
+                    p_scheduler->start();
+                    m_bus = std::make_shared<communication::ScheduledSPI>(p_scheduler, get_port(), configuration[sc_bus_priority].get<uint8_t>());
+                }
 
-                    // set memory write mode - triple xfr, 262K, increase horiz, vert, write horiz
-                    write_register(SESP525_Command::SESP525_MEMORY_WRITE_MODE, 0x76);
+                if (is_3_wire == true)
+                {
+                    m_driver = make_3_wire_driver<communication::SPI>(m_bus, get_x_resolution(), get_y_resolution());
+                    if (m_driver == nullptr)
+                    {
+                        m_driver = make_3_wire_driver<communication::EmulatedSPI>(m_bus, get_x_resolution(), get_y_resolution());
+                    }
+                    if (m_driver == nullptr)
+                    {
+                        m_driver = make_3_wire_driver<communication::ScheduledSPI>(m_bus, get_x_resolution(), get_y_resolution());
+                    }
+                }
+                else if (m_rs_pin != nullptr)
+                {
+                    // most specific first, anything else still works through IPort
+                    m_driver = make_driver<communication::SPI, communication::GPIOChip>(m_bus, m_rs_pin, get_x_resolution(), get_y_resolution());
+                    if (m_driver == nullptr)
+                    {
+                        m_driver = make_driver<communication::SPI, communication::GPIO>(m_bus, m_rs_pin, get_x_resolution(), get_y_resolution());
+                    }
+                    if (m_driver == nullptr)
+                    {
+                        m_driver = make_driver<communication::EmulatedSPI, communication::EmulatedGPIO>(m_bus, m_rs_pin, get_x_resolution(), get_y_resolution());
+                    }
+                    if (m_driver == nullptr)
+                    {
+                        m_driver = make_driver<communication::ScheduledSPI, communication::IPort>(m_bus, m_rs_pin, get_x_resolution(), get_y_resolution());
+                    }
+                    if (m_driver == nullptr)
+                    {
+                        m_driver = make_driver<communication::IPort, communication::IPort>(m_bus, m_rs_pin, get_x_resolution(), get_y_resolution());
+                    }
+                }
 
-                    // set driving current value is in uA
-                    write_register(SESP525_Command::SESP525_DRIVING_CURRENT_R, 0x45);
-                    write_register(SESP525_Command::SESP525_DRIVING_CURRENT_G, 0x34);
-                    write_register(SESP525_Command::SESP525_DRIVING_CURRENT_B, 0x33);
+                if (m_driver != nullptr)
+                {
+                    std::lock_guard<communication::IPort> guard(*m_bus);
 
-                    // set precharge timer (x * clk)
-                    write_register(SESP525_Command::SESP525_PRECHARGE_CURRENT_R, 0x04);
-                    write_register(SESP525_Command::SESP525_PRECHARGE_CURRENT_G, 0x05);
-                    write_register(SESP525_Command::SESP525_PRECHARGE_CURRENT_B, 0x05);
+                    if (m_reset_pin != nullptr)
+                    {
+                        m_reset_pin->write(constants::sc_gpio_high);
+                    }
 
-                    // set prechargce current (8xuA)
-                    write_register(SESP525_PRECHARGE_CURRENT_R, 0x9D);
-                    write_register(SESP525_PRECHARGE_CURRENT_G, 0x8C);
-                    write_register(SESP525_PRECHARGE_CURRENT_B, 0x57);
+                    if (configuration.find(sc_init_sequence) != configuration.end())
+                    {
+                        m_init_sequence.clear();
+                        for (auto &command : configuration[sc_init_sequence])
+                        {
+                            m_init_sequence.push_back({ command[sc_init_register].get<uint8_t>(), command[sc_init_value].get<uint8_t>(),
+                                command.value(sc_init_delay, (uint32_t)0) });
+                        }
+                    }
 
-                    // set reference voltage controlled by extern resistor
-                    write_register(SESP525_Command::SESP525_IREF, 0);
+                    run_init_sequence();
 
-                    // set mode
-                    write_register(SESP525_Command::SESP525_DISPLAY_MODE, 0x0);    
-    
-                    select_window(data::Coordinate_8t(1, 1),
-                        data::Coordinate_8t(get_x_resolution(), get_y_resolution()));
+                    m_driver->select_window(1, 1, get_x_resolution(), get_y_resolution());
 
-                    set_position(1, 1);
+                    m_driver->set_position(1, 1);
 
-                    // Turn display om
-                    write_register(SESP525_Command::SESP525_DISP_ON_OFF, 1);
-                    usleep(sc_1_millisecond);
+                    // Turn display on
+                    m_driver->write_register(SESP525_Command::SESP525_DISP_ON_OFF, 1);
+                    m_driver->flush();
+                    sleep_until(get_timestamp() + (sc_1_millisecond * sc_nanoseconds_per_microsecond));
 
                     success = true;
                 }
@@ -292,73 +390,62 @@ namespace afm
 
         bool SESP525Display::on_reset()
         {
+            AFM_TRACE_SCOPE("display", "reset");
+            std::lock_guard<communication::IPort> guard(*m_bus);
             bool success = false;
 
             // reset is active low
             if (m_reset_pin != nullptr)
             {
                 m_reset_pin->write(constants::sc_gpio_low);
-                usleep(2 * sc_1_millisecond);
+                sleep_until(get_timestamp() + (2 * sc_1_millisecond * sc_nanoseconds_per_microsecond));
                 m_reset_pin->write(constants::sc_gpio_high);
+
+                if (m_driver != nullptr)
+                {
+                    m_driver->invalidate();
+                }
             }
-            else
+            else if (m_driver != nullptr)
             {
                 // soft reset
-                write_register(SESP525_Command::SESP525_SOFT_RESET, 1);
+                m_driver->write_register(SESP525_Command::SESP525_SOFT_RESET, 1);
+                m_driver->flush();
             }
             
             return success;
         }
 
         // private parts
-        void SESP525Display::select_window(data::Coordinate_8t start, data::Coordinate_8t end)
+        void SESP525Display::run_init_sequence()
         {
-            // convert to 0 based indicies
-            write_register(SESP525_Command::SESP525_MX1_ADDRESS, start.x - 1);
-            write_register(SESP525_Command::SESP525_MX2_ADDRESS, end.x - 1);
-            write_register(SESP525_Command::SESP525_MY1_ADDRESS, start.y - 1);
-            write_register(SESP525_Command::SESP525_MY2_ADDRESS, end.y - 1);
-        }
-
-        void SESP525Display::set_position(uint8_t x, uint8_t y)
-        {
-            write_register(SESP525_Command::SESP525_MEMORY_ACCESS_POINTER_X, x - 1);
-            write_register(SESP525_Command::SESP525_MEMORY_ACCESS_POINTER_Y, y - 1);
-        }
-
-        void SESP525Display::write_register(uint8_t target_register, uint8_t value)
-        {
-            m_rs_pin->write(constants::sc_gpio_low);
-
-            get_port()->write(target_register);
-
-            m_rs_pin->write(constants::sc_gpio_high);
+            AFM_TRACE_SCOPE("display", "init sequence");
+            uint64_t not_before_ns = 0;
 
-            get_port()->write(value);
-        }
-
-        void SESP525Display::write_data_start()
-        {
-            m_rs_pin->write(constants::sc_gpio_low);
-
-            get_port()->write(SESP525_Command::SESP525_DDRAM_DATA_ACCESS_PORT);
+            // one pass under the port lock, only sleeping when a delay hasn't already elapsed
+            for (const SESP525InitCommand &command : m_init_sequence)
+            {
+                if (not_before_ns != 0)
+                {
+                    sleep_until(not_before_ns);
+                    not_before_ns = 0;
+                }
 
-            m_rs_pin->write(constants::sc_gpio_high);
-        }
+                m_driver->write_register(command.target_register, command.value);
 
-        void SESP525Display::write_pixel(data::Color color)
-        {
-            get_port()->write(color.red & sc_6_bits);
-            get_port()->write(color.green & sc_6_bits);
-            get_port()->write(color.blue & sc_6_bits);
-        }
-
-        void SESP525Display::set_pixel(const uint8_t x, const uint8_t y, const data::Color color)
-        {
-            set_position(x, y);
+                if (command.delay_us > 0)
+                {
+                    // the register has to be on the wire before the clock starts
+                    m_driver->flush();
+                    not_before_ns = get_timestamp() + (command.delay_us * sc_nanoseconds_per_microsecond);
+                }
+            }
 
-            write_data_start();
-            write_pixel(color);
+            m_driver->flush();
+            if (not_before_ns != 0)
+            {
+                sleep_until(not_before_ns);
+            }
         }
     }
 }
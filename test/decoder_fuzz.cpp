@@ -0,0 +1,373 @@
+/**
+ * decoder_fuzz.cpp
+ *
+ * Feeds mutated BMP and PNG streams through ImageDecoder onto the emulated
+ * SEPS525. Nothing is checked but that every seed decodes and that no
+ * mutation crashes, so it is meant to run under
+ * -DCMAKE_CXX_FLAGS="-fsanitize=address,undefined"
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "Constants.h"
+#include "DataTypes.h"
+#include "DisplayFactory.h"
+#include "ImageDecoder.h"
+
+#ifdef AFM_PNG
+#include <zlib.h>
+#endif
+
+namespace
+{
+    const uint32_t sc_default_iterations = 20000;
+    const uint32_t sc_default_seed = 0x5EB5525;
+    const uint32_t sc_seed_width = 37;         // odd, so every row pads
+    const uint32_t sc_seed_height = 23;
+    const size_t sc_bmp_header_size = 54;
+    const size_t sc_png_signature_size = 8;
+    const uint8_t sc_interesting_bytes[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+
+    const char *sc_fuzz_configuration = R"({
+        "ports": [
+            { "port_type": "emulated", "instance": 3, "device": 0, "port_name": "primary interface" },
+            { "port_type": "emulated", "instance": 3, "device": 1, "port_name": "RS" },
+            { "port_type": "emulated", "instance": 3, "device": 2, "port_name": "RESET" }
+        ],
+        "x_resolution": 160,
+        "y_resolution": 128
+    })";
+
+    void put_le(std::string &data, uint32_t value, size_t length)
+    {
+        for (size_t index = 0; index < length; index++)
+        {
+            data.push_back((char)(value >> (8 * index)));
+        }
+    }
+
+    void put_be(std::string &data, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            data.push_back((char)(value >> shift));
+        }
+    }
+
+    std::string random_bytes(size_t length, std::mt19937 &random)
+    {
+        std::string data;
+
+        for (size_t index = 0; index < length; index++)
+        {
+            data.push_back((char)random());
+        }
+
+        return data;
+    }
+
+    /**
+     * Every depth the decoder knows, palette and bitfields included; the
+     * pixels themselves are noise
+     */
+    std::string make_bmp(uint16_t bits_per_pixel, bool is_top_down, bool is_bitfields, std::mt19937 &random)
+    {
+        uint32_t stride = (((sc_seed_width * bits_per_pixel) + 31) / 32) * 4;
+        uint32_t colors = bits_per_pixel <= 8 ? (1u << bits_per_pixel) : 0;
+        uint32_t masks_size = is_bitfields == true ? 12 : 0;
+        uint32_t offset = sc_bmp_header_size + masks_size + (colors * 4);
+        std::string data = "BM";
+
+        put_le(data, offset + (stride * sc_seed_height), 4);
+        put_le(data, 0, 4);
+        put_le(data, offset, 4);
+        put_le(data, 40, 4);
+        put_le(data, sc_seed_width, 4);
+        put_le(data, is_top_down == true ? (uint32_t)-(int32_t)sc_seed_height : sc_seed_height, 4);
+        put_le(data, 1, 2);
+        put_le(data, bits_per_pixel, 2);
+        put_le(data, is_bitfields == true ? 3 : 0, 4);
+        put_le(data, stride * sc_seed_height, 4);
+        data += std::string(16, '\0');  // resolution and palette counts, all defaulted
+
+        if (is_bitfields == true)
+        {
+            // 565 for 16 bits, BGR byte swapped for 32
+            put_le(data, bits_per_pixel == 16 ? 0xF800 : 0xFF00, 4);
+            put_le(data, bits_per_pixel == 16 ? 0x07E0 : 0xFF0000, 4);
+            put_le(data, bits_per_pixel == 16 ? 0x001F : 0xFF000000, 4);
+        }
+        data += random_bytes((colors * 4) + (stride * sc_seed_height), random);
+
+        return data;
+    }
+
+#ifdef AFM_PNG
+    void put_chunk(std::string &data, const char *p_type, const std::string &payload)
+    {
+        std::string chunk = std::string(p_type, 4) + payload;
+
+        put_be(data, (uint32_t)payload.size());
+        data += chunk;
+        put_be(data, (uint32_t)crc32(0, (const Bytef *)chunk.data(), (uInt)chunk.size()));
+    }
+
+    std::string deflate(const std::string &raw)
+    {
+        uLongf compressed_size = compressBound(raw.size());
+        std::vector<uint8_t> compressed(compressed_size);
+
+        compress(compressed.data(), &compressed_size, (const Bytef *)raw.data(), raw.size());
+
+        return std::string((const char *)compressed.data(), compressed_size);
+    }
+
+    /**
+     * The header is taken as given so a mutation can lie about the image;
+     * the data is split over two IDATs like a streaming encoder would
+     */
+    std::string make_png(const std::string &header, const std::string &raw, std::mt19937 &random)
+    {
+        std::string data = "\x89PNG\r\n\x1A\n";
+        std::string compressed = deflate(raw);
+        size_t split = compressed.size() / 2;
+        uint8_t color_type = (uint8_t)header[9];
+
+        put_chunk(data, "IHDR", header);
+        if (color_type == 3)
+        {
+            put_chunk(data, "PLTE", random_bytes(3 * (1u << std::min((uint8_t)header[8], (uint8_t)8)), random));
+            put_chunk(data, "tRNS", random_bytes(random() % 16, random));
+        }
+        else if ((color_type == 0) || (color_type == 2))
+        {
+            put_chunk(data, "tRNS", random_bytes(color_type == 0 ? 2 : 6, random));
+        }
+        put_chunk(data, "tEXt", std::string("Comment\0fuzz", 12));
+        put_chunk(data, "IDAT", compressed.substr(0, split));
+        put_chunk(data, "IDAT", compressed.substr(split));
+        put_chunk(data, "IEND", "");
+
+        return data;
+    }
+
+    std::string make_png_header(uint32_t width, uint32_t height, uint8_t bit_depth, uint8_t color_type)
+    {
+        std::string header;
+
+        put_be(header, width);
+        put_be(header, height);
+        header.push_back((char)bit_depth);
+        header.push_back((char)color_type);
+        header += std::string(3, '\0');
+
+        return header;
+    }
+
+    // filtered rows of noise, each row with a random one of the five filters
+    std::string make_png_raw(uint8_t bit_depth, uint8_t color_type, std::mt19937 &random)
+    {
+        const uint8_t channels[] = { 1, 0, 3, 1, 2, 0, 4 };
+        uint32_t stride = ((sc_seed_width * channels[color_type] * bit_depth) + 7) / 8;
+        std::string raw;
+
+        for (uint32_t y = 0; y < sc_seed_height; y++)
+        {
+            raw.push_back((char)(random() % 5));
+            raw += random_bytes(stride, random);
+        }
+
+        return raw;
+    }
+#endif
+
+    /**
+     * One seed: the stream, and for PNG what it was built from so a
+     * mutation can rebuild it with valid CRCs and deflate around bad data
+     */
+    struct Seed
+    {
+        std::string     data;
+        bool            is_png;
+        std::string     header;
+        std::string     raw;
+    };
+
+    std::vector<Seed> make_seeds(std::mt19937 &random)
+    {
+        std::vector<Seed> seeds;
+
+        for (uint16_t bits_per_pixel : { 1, 4, 8, 16, 24, 32 })
+        {
+            seeds.push_back({ make_bmp(bits_per_pixel, false, false, random), false, "", "" });
+            seeds.push_back({ make_bmp(bits_per_pixel, true, false, random), false, "", "" });
+        }
+        seeds.push_back({ make_bmp(16, false, true, random), false, "", "" });
+        seeds.push_back({ make_bmp(32, true, true, random), false, "", "" });
+
+#ifdef AFM_PNG
+        // color type and the depths it allows
+        const std::vector<std::pair<uint8_t, std::vector<uint8_t>>> formats =
+        {
+            { 0, { 1, 2, 4, 8, 16 } },
+            { 2, { 8, 16 } },
+            { 3, { 1, 2, 4, 8 } },
+            { 4, { 8, 16 } },
+            { 6, { 8, 16 } },
+        };
+
+        for (auto &format : formats)
+        {
+            for (uint8_t bit_depth : format.second)
+            {
+                Seed seed = { "", true, make_png_header(sc_seed_width, sc_seed_height, bit_depth, format.first),
+                    make_png_raw(bit_depth, format.first, random) };
+
+                seed.data = make_png(seed.header, seed.raw, random);
+                seeds.push_back(seed);
+            }
+        }
+#endif
+
+        return seeds;
+    }
+
+    std::string mutate(const Seed &seed, std::mt19937 &random)
+    {
+        std::string data = seed.data;
+
+        switch (random() % (seed.is_png == true ? 5 : 3))
+        {
+            case 0:
+            {
+                // cut short anywhere, header included
+                data.resize(random() % data.size());
+                break;
+            }
+            case 1:
+            {
+                for (uint32_t count = 1 + (random() % 4); count > 0; count--)
+                {
+                    data[random() % data.size()] = (char)random();
+                }
+                break;
+            }
+            case 2:
+            {
+                // header fields, where the sizes and offsets live
+                size_t header_size = seed.is_png == true ? (sc_png_signature_size + 25) : sc_bmp_header_size;
+
+                for (uint32_t count = 1 + (random() % 3); count > 0; count--)
+                {
+                    data[random() % std::min(header_size, data.size())] = (char)sc_interesting_bytes[random() % sizeof(sc_interesting_bytes)];
+                }
+                break;
+            }
+#ifdef AFM_PNG
+            case 3:
+            {
+                // a header that disagrees with the data, still a well formed stream
+                std::string header = seed.header;
+
+                header[random() % header.size()] = (char)sc_interesting_bytes[random() % sizeof(sc_interesting_bytes)];
+                data = make_png(header, seed.raw, random);
+                break;
+            }
+            case 4:
+            {
+                // bad filter types and rows that are short or long, past inflate intact
+                std::string raw = seed.raw;
+
+                for (uint32_t count = 1 + (random() % 4); count > 0; count--)
+                {
+                    raw[random() % raw.size()] = (char)random();
+                }
+                raw.resize(random() % (raw.size() + (raw.size() / 4)));
+                data = make_png(seed.header, raw, random);
+                break;
+            }
+#endif
+        }
+
+        return data;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = sc_default_iterations;
+    uint32_t seed_value = sc_default_seed;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if ((strcmp(argv[index], "--iterations") == 0) && ((index + 1) < argc))
+        {
+            iterations = (uint32_t)std::max(1, atoi(argv[++index]));
+        }
+        else if ((strcmp(argv[index], "--seed") == 0) && ((index + 1) < argc))
+        {
+            seed_value = (uint32_t)strtoul(argv[++index], nullptr, 0);
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--iterations n] [--seed n]\n";
+            return 1;
+        }
+    }
+
+    std::mt19937 random(seed_value);
+    std::vector<Seed> seeds = make_seeds(random);
+    afm::graphic::IDisplaySPtr p_display = afm::graphic::DisplayFactory::getInstance()->createDisplay(afm::constants::sc_sesp525_display,
+        nlohmann::json::parse(sc_fuzz_configuration));
+    bool success = p_display != nullptr;
+    uint32_t decoded = 0;
+
+    if (success == false)
+    {
+        std::cout << "FAIL could not create the emulated display\n";
+    }
+
+    // unmutated, every seed has to make it through
+    for (size_t index = 0; (success == true) && (index < seeds.size()); index++)
+    {
+        std::istringstream input(seeds[index].data);
+        afm::graphic::IImageDecoderSPtr p_decoder = afm::graphic::ImageDecoder::create(input);
+
+        success = (p_decoder != nullptr) && (p_decoder->draw(input, p_display, afm::data::Coordinate_8t(1, 1)) == true);
+        if (success == false)
+        {
+            std::cout << "FAIL seed " << index << " did not decode\n";
+        }
+    }
+
+    for (uint32_t iteration = 0; (success == true) && (iteration < iterations); iteration++)
+    {
+        std::istringstream input(mutate(seeds[random() % seeds.size()], random));
+        afm::graphic::IImageDecoderSPtr p_decoder = afm::graphic::ImageDecoder::create(input);
+
+        // anywhere on screen or off it, clipping is part of the path
+        afm::data::Coordinate_8t position((uint8_t)(1 + (random() % 255)), (uint8_t)(1 + (random() % 255)));
+
+        if ((p_decoder != nullptr) && (p_decoder->draw(input, p_display, position) == true))
+        {
+            decoded++;
+        }
+    }
+
+    if (success == true)
+    {
+        std::cout << "PASS " << seeds.size() << " seeds, " << iterations << " mutations, " << decoded << " still decoded\n";
+    }
+
+    return success == true ? 0 : 1;
+}
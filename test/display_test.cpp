@@ -0,0 +1,396 @@
+/**
+ * display_test.cpp
+ *
+ * Draws every primitive on the emulated SEPS525, over both the 4-wire and
+ * the 3-wire interface, and checks the emulator's DDRAM against a plain
+ * reference image after each one
+ *
+ * Copyright 2020 AFM Software
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "Constants.h"
+#include "DataTypes.h"
+#include "DisplayFactory.h"
+#include "Font5x7.h"
+#include "SEPS525Emulator.h"
+
+namespace
+{
+    const uint32_t sc_random_seed = 0x5EB5525;
+    const uint8_t sc_width = afm::communication::sc_emulator_width;
+    const uint8_t sc_height = afm::communication::sc_emulator_height;
+
+    // the panel keeps 6 bits a channel
+    const uint8_t sc_channel_mask = 0x3F;
+
+    const char *sc_test_configuration = R"({
+        "ports": [
+            { "port_type": "emulated", "instance": 0, "device": 0, "port_name": "primary interface" },
+            { "port_type": "emulated", "instance": 0, "device": 1, "port_name": "RS" },
+            { "port_type": "emulated", "instance": 0, "device": 2, "port_name": "RESET" }
+        ],
+        "x_resolution": 160,
+        "y_resolution": 128
+    })";
+
+    /**
+     * What the screen should show, drawn pixel by pixel with nothing but
+     * 1 based coordinates and clipping to the screen
+     */
+    class ReferenceScreen
+    {
+        public:
+            ReferenceScreen()
+                : m_pixels((size_t)sc_width * sc_height, afm::constants::BLACK)
+            {
+            }
+
+            void put(int x, int y, const afm::data::Color &color)
+            {
+                if ((x >= 1) && (x <= sc_width) && (y >= 1) && (y <= sc_height))
+                {
+                    m_pixels[((size_t)(y - 1) * sc_width) + (x - 1)] = color;
+                }
+            }
+
+            void fill(int x1, int y1, int x2, int y2, const afm::data::Color &color)
+            {
+                for (int y = std::min(y1, y2); y <= std::max(y1, y2); y++)
+                {
+                    for (int x = std::min(x1, x2); x <= std::max(x1, x2); x++)
+                    {
+                        put(x, y, color);
+                    }
+                }
+            }
+
+            void outline(int x1, int y1, int x2, int y2, int thickness, const afm::data::Color &color)
+            {
+                int left = std::min(x1, x2);
+                int right = std::max(x1, x2);
+                int top = std::min(y1, y2);
+                int bottom = std::max(y1, y2);
+
+                for (int y = top; y <= bottom; y++)
+                {
+                    for (int x = left; x <= right; x++)
+                    {
+                        if ((x < (left + thickness)) || (x > (right - thickness)) || (y < (top + thickness)) || (y > (bottom - thickness)))
+                        {
+                            put(x, y, color);
+                        }
+                    }
+                }
+            }
+
+            // the panel's line, as the driver has always drawn it
+            void line(const afm::data::Coordinate_8t &start, const afm::data::Coordinate_8t &end, const afm::data::Color &color)
+            {
+                uint8_t x1 = std::min(start.x, end.x);
+                uint8_t x2 = std::max(start.x, end.x);
+                uint8_t y1 = std::min(start.y, end.y);
+                uint8_t y2 = std::max(start.y, end.y);
+                uint8_t dy = y2 - y1;
+                uint8_t dx = x2 - x1;
+                int eps = 0;
+
+                x1 = std::min(x1, (uint8_t)(sc_width - 1));
+                x2 = std::min(x2, (uint8_t)(sc_width - 1));
+                if (x1 == x2)
+                {
+                    x2++;
+                }
+
+                if (y1 != y2)
+                {
+                    for (; y1 < y2; y1++)
+                    {
+                        for (uint8_t x = x1; x < x2; x++)
+                        {
+                            put(x, y1, color);
+                            eps += dy;
+                            if ((eps * 2) >= dx)
+                            {
+                                y1++;
+                                eps -= dx;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    for (uint8_t x = x1; x < x2; x++)
+                    {
+                        put(x, y1, color);
+                    }
+                }
+            }
+
+            void image(int x, int y, int width, int height, const afm::data::Color *p_pixels)
+            {
+                for (int row = 0; row < height; row++)
+                {
+                    for (int column = 0; column < width; column++)
+                    {
+                        put(x + column, y + row, p_pixels[(row * width) + column]);
+                    }
+                }
+            }
+
+            void text(int x, int y, const char *p_text, const afm::graphic::IFont &font,
+                const afm::data::Color &foreground, const afm::data::Color &background)
+            {
+                for (size_t character = 0; p_text[character] != '\0'; character++)
+                {
+                    for (int row = 0; row < font.get_height(); row++)
+                    {
+                        for (int column = 0; column < font.get_width(); column++)
+                        {
+                            bool is_set = ((font.get_column(p_text[character], column) >> row) & 1) != 0;
+
+                            put(x + (int)(character * font.get_width()) + column, y + row, is_set == true ? foreground : background);
+                        }
+                    }
+                }
+            }
+
+            // pixels the emulator has wrong
+            size_t compare(const afm::communication::SEPS525EmulatorSPtr &p_emulator) const
+            {
+                size_t wrong = 0;
+
+                for (uint16_t y = 0; y < sc_height; y++)
+                {
+                    for (uint16_t x = 0; x < sc_width; x++)
+                    {
+                        const afm::data::Color &expected = m_pixels[((size_t)y * sc_width) + x];
+                        afm::data::Color actual = p_emulator->get_pixel(x, y);
+
+                        if (((expected.red & sc_channel_mask) != actual.red) || ((expected.green & sc_channel_mask) != actual.green) ||
+                            ((expected.blue & sc_channel_mask) != actual.blue))
+                        {
+                            wrong++;
+                        }
+                    }
+                }
+
+                return wrong;
+            }
+
+        private:
+            std::vector<afm::data::Color> m_pixels;
+    };
+
+    afm::data::Color random_color(std::mt19937 &random)
+    {
+        return afm::data::Color(random() & sc_channel_mask, random() & sc_channel_mask, random() & sc_channel_mask);
+    }
+
+    afm::data::Coordinate_8t random_coordinate(std::mt19937 &random)
+    {
+        return afm::data::Coordinate_8t((uint8_t)(random() % sc_width) + 1, (uint8_t)(random() % sc_height) + 1);
+    }
+
+    /**
+     * Runs each step on the display and the reference, and reports the
+     * first step after which they disagree
+     */
+    class DisplayTest
+    {
+        public:
+            DisplayTest(const std::string &bus_interface, uint32_t instance)
+                : m_interface(bus_interface)
+                , m_random(sc_random_seed)
+            {
+                nlohmann::json configuration = nlohmann::json::parse(sc_test_configuration);
+
+                for (auto &port : configuration["ports"])
+                {
+                    port["instance"] = instance;
+                }
+                configuration["interface"] = bus_interface;
+
+                m_display = afm::graphic::DisplayFactory::getInstance()->createDisplay(afm::constants::sc_sesp525_display, configuration);
+                m_emulator = afm::communication::SEPS525Emulator::getInstance(instance);
+            }
+
+            bool run()
+            {
+                bool success = m_display != nullptr;
+
+                if (success == false)
+                {
+                    std::cout << "FAIL " << m_interface << ": could not create the emulated display\n";
+                }
+
+                success = success && check("clear_screen", [this]()
+                {
+                    m_display->clear_screen(afm::constants::BLUE);
+                    m_reference.fill(1, 1, sc_width, sc_height, afm::constants::BLUE);
+                });
+
+                success = success && check("set_pixel", [this]()
+                {
+                    for (uint32_t count = 0; count < 64; count++)
+                    {
+                        afm::data::Coordinate_8t position = random_coordinate(m_random);
+                        afm::data::Color color = random_color(m_random);
+
+                        m_display->set_pixel(position, color);
+                        m_reference.put(position.x, position.y, color);
+                    }
+                });
+
+                // scattered, clustered and repeated points, some off screen
+                for (uint32_t count : { 1, 7, 64, 1024 })
+                {
+                    success = success && check("set_pixels " + std::to_string(count), [this, count]()
+                    {
+                        std::vector<afm::data::Pixel> pixels;
+                        afm::data::Coordinate_8t origin = random_coordinate(m_random);
+
+                        for (uint32_t index = 0; index < count; index++)
+                        {
+                            afm::data::Coordinate_8t position = (index % 3) == 0 ? random_coordinate(m_random) :
+                                afm::data::Coordinate_8t((uint8_t)(origin.x + (m_random() % 9)), (uint8_t)(origin.y + (m_random() % 5)));
+
+                            pixels.push_back({ position, random_color(m_random) });
+                        }
+                        pixels.push_back(pixels.front());
+                        pixels.back().color = random_color(m_random);
+
+                        m_display->set_pixels(pixels.data(), pixels.size());
+                        for (const afm::data::Pixel &pixel : pixels)
+                        {
+                            m_reference.put(pixel.position.x, pixel.position.y, pixel.color);
+                        }
+                    });
+                }
+
+                success = success && check("fill_rectangle", [this]()
+                {
+                    afm::data::Color color = random_color(m_random);
+
+                    m_display->set_foreground(color);
+                    m_display->fill_rectangle(20, 10, 60, 40);
+                    m_display->fill_rectangle(150, 120, 170, 140);
+                    m_reference.fill(20, 10, 60, 40, color);
+                    m_reference.fill(150, 120, 170, 140, color);
+                });
+
+                success = success && check("draw_rectangle", [this]()
+                {
+                    afm::data::Color color = random_color(m_random);
+
+                    m_display->set_foreground(color);
+                    m_display->draw_rectangle(5, 50, 70, 100);
+                    m_display->draw_rectangle(80, 20, 150, 110, 4);
+                    m_display->draw_rectangle(100, 5, 104, 9, 3);
+                    m_reference.outline(5, 50, 70, 100, 1, color);
+                    m_reference.outline(80, 20, 150, 110, 4, color);
+                    m_reference.outline(100, 5, 104, 9, 3, color);
+                });
+
+                success = success && check("draw_line", [this]()
+                {
+                    for (uint32_t count = 0; count < 32; count++)
+                    {
+                        afm::data::Coordinate_8t start = random_coordinate(m_random);
+                        afm::data::Coordinate_8t end = random_coordinate(m_random);
+                        afm::data::Color color = random_color(m_random);
+
+                        m_display->draw_line(start, end, color);
+                        m_reference.line(start, end, color);
+                    }
+                });
+
+                // inside, hanging off the right and bottom edges
+                for (afm::data::Coordinate_8t position : { afm::data::Coordinate_8t(30, 30), afm::data::Coordinate_8t(140, 60),
+                    afm::data::Coordinate_8t(40, 110) })
+                {
+                    success = success && check("draw_image at " + std::to_string(position.x) + "," + std::to_string(position.y), [this, position]()
+                    {
+                        const uint8_t width = 33;
+                        const uint8_t height = 21;
+                        std::vector<afm::data::Color> pixels;
+
+                        for (uint32_t index = 0; index < (uint32_t)width * height; index++)
+                        {
+                            pixels.push_back(random_color(m_random));
+                        }
+
+                        m_display->draw_image(position, width, height, pixels.data());
+                        m_reference.image(position.x, position.y, width, height, pixels.data());
+                    });
+                }
+
+                // inside, clipped by the right edge and by the bottom edge
+                for (afm::data::Coordinate_8t position : { afm::data::Coordinate_8t(10, 10), afm::data::Coordinate_8t(150, 30),
+                    afm::data::Coordinate_8t(40, 125) })
+                {
+                    success = success && check("print at " + std::to_string(position.x) + "," + std::to_string(position.y), [this, position]()
+                    {
+                        char text[] = "AB";
+                        afm::data::Color foreground = random_color(m_random);
+                        afm::data::Color background = random_color(m_random);
+
+                        m_display->set_foreground(foreground);
+                        m_display->set_background(background);
+                        m_display->set_cursor(position);
+                        m_display->print(text);
+                        m_reference.text(position.x, position.y, text, m_font, foreground, background);
+                    });
+                }
+
+                if (success == true)
+                {
+                    std::cout << "PASS " << m_interface << "\n";
+                }
+
+                return success;
+            }
+
+        private:
+            template <typename Step>
+            bool check(const std::string &name, Step step)
+            {
+                size_t wrong = 0;
+
+                step();
+                wrong = m_reference.compare(m_emulator);
+                if (wrong > 0)
+                {
+                    std::cout << "FAIL " << m_interface << " " << name << ": " << wrong << " wrong pixels\n";
+                }
+
+                return wrong == 0;
+            }
+
+        private:
+            std::string m_interface;
+            std::mt19937 m_random;
+            afm::graphic::IDisplaySPtr m_display = nullptr;
+            afm::communication::SEPS525EmulatorSPtr m_emulator = nullptr;
+            afm::graphic::Font5x7 m_font;
+            ReferenceScreen m_reference;
+    };
+}
+
+int main(int argc, char * argv[])
+{
+    // separate emulators, so one interface can't pass on what the other drew
+    DisplayTest four_wire("4-wire", 0);
+    DisplayTest three_wire("3-wire", 1);
+    bool success = four_wire.run();
+
+    success = (three_wire.run() == true) && (success == true);
+
+    return success == true ? 0 : 1;
+}